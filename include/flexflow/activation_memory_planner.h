@@ -0,0 +1,57 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _FLEXFLOW_ACTIVATION_MEMORY_PLANNER_H_
+#define _FLEXFLOW_ACTIVATION_MEMORY_PLANNER_H_
+
+#include <cstddef>
+#include <vector>
+
+namespace FlexFlow {
+
+/**
+ * @brief An activation buffer that is live from the operator producing it to
+ * its last consumer (both inclusive), in operator order.
+ */
+struct ActivationInterval {
+  size_t size;   ///< Bytes per device
+  int first_use; ///< Index of the producing operator
+  int last_use;  ///< Index of the last consuming operator
+  int arena;     ///< Only buffers of the same arena (e.g., stage) share memory
+};
+
+struct ActivationMemoryPlan {
+  std::vector<size_t> offsets;     ///< Offset of each interval in its arena
+  std::vector<size_t> arena_sizes; ///< Indexed by ActivationInterval::arena
+  size_t naive_peak = 0;   ///< Largest arena if no buffer were shared
+  size_t planned_peak = 0; ///< Largest arena of the plan
+  size_t live_peak = 0; ///< Most bytes live at once in an arena; lower bound
+};
+
+/**
+ * @brief Packs buffers into one arena per ActivationInterval::arena so that
+ * buffers whose intervals do not overlap can share storage whatever their
+ * shapes.
+ *
+ * @details Greedy by size: the largest buffers are placed first, each in the
+ * smallest gap between the buffers already placed that it overlaps in time,
+ * or else after the last of them. Offsets are multiples of alignment.
+ */
+ActivationMemoryPlan
+    plan_activation_memory(std::vector<ActivationInterval> const &intervals,
+                           size_t alignment = 256);
+
+}; // namespace FlexFlow
+
+#endif // _FLEXFLOW_ACTIVATION_MEMORY_PLANNER_H_
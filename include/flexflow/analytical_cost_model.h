@@ -0,0 +1,73 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _FLEXFLOW_ANALYTICAL_COST_MODEL_H_
+#define _FLEXFLOW_ANALYTICAL_COST_MODEL_H_
+
+#include "flexflow/cost_database.h"
+#include "flexflow/machine_view.h"
+#include "flexflow/simulator.h"
+#include <unordered_map>
+
+namespace FlexFlow {
+
+/**
+ * @brief Work done by a single shard of an operator under a MachineView.
+ *
+ * @details FLOPs and bytes are the two axes of the roofline. The memory fields
+ * have the same meaning as the ones in CostMetrics.
+ */
+struct OpWorkload {
+  double forward_flops = 0, backward_flops = 0;
+  double forward_bytes = 0, backward_bytes = 0;
+  size_t inputs_memory = 0, outputs_memory = 0, weights_memory = 0;
+};
+
+/**
+ * @brief A profiling-free cost model that estimates operator run times with a
+ * roofline over the device specs in the MachineModel.
+ *
+ * @details The FLOPs and bytes of every operator are derived from its
+ * OperatorParameters and the shapes of its tensors under a MachineView. An
+ * optional CostDatabase is used in two ways: exact matches return the
+ * profiled numbers, and all records of an operator type and data type are
+ * used to fit an efficiency factor that scales the roofline estimate.
+ */
+class AnalyticalCostModel {
+public:
+  AnalyticalCostModel(MachineModel *machine, CompMode comp_mode);
+  OpWorkload get_workload(Op const *op, MachineView const &view) const;
+  bool estimate_operator_cost(Op const *op,
+                              MachineView const &view,
+                              CostMetrics &cost_metrics) const;
+  CostRecord make_record(Op const *op,
+                         MachineView const &view,
+                         CostMetrics const &cost_metrics) const;
+  void calibrate(CostDatabase const *database);
+
+public:
+  MachineModel *machine;
+  CompMode computationMode;
+  CostDatabase const *database;
+  // efficiency factors fitted from the database, keyed by calibration_key;
+  // first is for forward, second for backward
+  std::unordered_map<int, std::pair<float, float>> calibration_factors;
+
+private:
+  CompDevice const *get_device(MachineView const &view) const;
+};
+
+}; // namespace FlexFlow
+
+#endif // _FLEXFLOW_ANALYTICAL_COST_MODEL_H_
@@ -16,6 +16,7 @@
 #pragma once
 
 #include "flexflow/ffconst.h"
+#include "flexflow/kv_cache_window.h"
 #include "legion.h"
 #include <cstddef>
 #include <cstdlib>
@@ -48,6 +49,9 @@ public:
   static int max_verify_tokens_per_batch();
   static int max_spec_tree_token_num();
   static int max_sequence_length();
+  static KVCacheWindow kv_cache_window();
+  // Slots of the KV cache of a request in incremental decoding
+  static int kv_cache_length();
   friend std::ostream &operator<<(std::ostream &os, BatchConfig const &bc);
   void print() const;
   void save_to_file(std::string const &filename) const;
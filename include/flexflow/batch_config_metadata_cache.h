@@ -0,0 +1,75 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _FLEXFLOW_BATCH_CONFIG_METADATA_CACHE_H_
+#define _FLEXFLOW_BATCH_CONFIG_METADATA_CACHE_H_
+
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace FlexFlow {
+
+/**
+ * @brief Host mirror of the batch config metadata of a GPU
+ * (FFHandler::batch_config_metadata), so that loading a batch only copies the
+ * rows that changed since the previous one.
+ *
+ * @details The mirror starts zeroed, as the device buffer is. Rows are
+ * compared to the mirror, and the runs of changed rows are copied, merging
+ * runs that are less than max_merge_gap bytes apart to save copies. The
+ * mirror assumes it sees every write to the buffer, in stream order.
+ */
+class BatchConfigMetadataCache {
+public:
+  /// Copies size bytes from src to the buffer, at offset
+  using CopyFunc =
+      std::function<void(size_t offset, void const *src, size_t size)>;
+
+  static size_t const default_max_merge_gap = 1024;
+
+  BatchConfigMetadataCache(size_t size,
+                           size_t max_merge_gap = default_max_merge_gap);
+  /// Writes num_rows rows of row_size bytes at offset; returns the bytes
+  /// copied
+  size_t write(size_t offset,
+               void const *rows,
+               size_t row_size,
+               size_t num_rows,
+               CopyFunc const &copy);
+  /// Writes the first num_rows rows of array at offset
+  template <typename T, size_t N>
+  size_t write(size_t offset,
+               T const (&array)[N],
+               size_t num_rows,
+               CopyFunc const &copy) {
+    assert(num_rows <= N);
+    return write(offset, array, sizeof(T), num_rows, copy);
+  }
+  /// Writes array at offset
+  template <typename T, size_t N>
+  size_t write(size_t offset, T const (&array)[N], CopyFunc const &copy) {
+    return write(offset, array, sizeof(T), N, copy);
+  }
+  size_t get_size() const;
+
+private:
+  std::vector<char> mirror;
+  size_t max_merge_gap;
+};
+
+}; // namespace FlexFlow
+
+#endif // _FLEXFLOW_BATCH_CONFIG_METADATA_CACHE_H_
@@ -0,0 +1,91 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _FLEXFLOW_COLLECTIVE_COST_H_
+#define _FLEXFLOW_COLLECTIVE_COST_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace FlexFlow {
+
+enum class CollectiveType {
+  ALLREDUCE,
+  REDUCE_SCATTER,
+  ALLGATHER,
+  ALLTOALL,
+};
+
+enum class CollectiveAlgorithm {
+  // One ring through all participants; a multi-node ring crosses every
+  // node's network interface once per step
+  RING,
+  // Two complementary binary trees over the nodes, each carrying half of
+  // the data, with a chain inside each node (all-reduce only)
+  DOUBLE_BINARY_TREE,
+  // Ring inside each node, then one ring per local rank across nodes on a
+  // 1/gpus_per_node slice of the data; the busiest node bounds the former and
+  // the least busy one the number of slices
+  HIERARCHICAL,
+  // Every participant exchanges directly with every other one (all-to-all
+  // only)
+  DIRECT,
+};
+
+/**
+ * @brief Where the participants of a collective live.
+ */
+struct CollectiveTopology {
+  std::vector<int> gpus_per_node = {1}; ///< Participants on each node spanned
+  float intra_node_bandwidth = 0;       ///< GPU to GPU within a node, in B/ms
+  float inter_node_bandwidth = 0;       ///< Out of (and into) a node, in B/ms
+  float intra_node_latency = 0;         ///< Per message, in ms
+  float inter_node_latency = 0;         ///< Per message, in ms
+
+  int num_nodes() const;
+  int num_participants() const;
+  int max_gpus_per_node() const;
+  int min_gpus_per_node() const;
+};
+
+struct CollectiveCost {
+  CollectiveAlgorithm algorithm;
+  float time; ///< in ms, infinity if the algorithm does not apply
+};
+
+/**
+ * @brief Alpha-beta cost of one collective.
+ *
+ * @param bytes The size of the full buffer on each participant, i.e., the
+ * input of an all-reduce, reduce-scatter or all-to-all and the output of an
+ * all-gather
+ */
+float collective_cost(CollectiveType type,
+                      CollectiveAlgorithm algorithm,
+                      CollectiveTopology const &topology,
+                      size_t bytes);
+
+/**
+ * @brief The cheapest algorithm for a collective on a topology.
+ */
+CollectiveCost cheapest_collective(CollectiveType type,
+                                   CollectiveTopology const &topology,
+                                   size_t bytes);
+
+std::string get_collective_algorithm_name(CollectiveAlgorithm algorithm);
+
+}; // namespace FlexFlow
+
+#endif // _FLEXFLOW_COLLECTIVE_COST_H_
@@ -17,6 +17,7 @@
 #define _FLEXFLOW_CONFIG_H_
 #include "ffconst.h"
 #include "flexflow/batch_config.h"
+#include "flexflow/memory_optimization.h"
 #include "legion.h"
 #include <cstring>
 #if defined(FF_USE_CUDA) || defined(FF_USE_HIP_CUDA)
@@ -65,6 +66,8 @@ constexpr ParameterSyncType CHOSEN_SYNC_TYPE = ParameterSyncType::PS;
 #endif
 
 class FFConfig;
+class WeightOffloadEngine;
+class BatchConfigMetadataCache;
 
 struct FFHandler {
 #if defined(FF_USE_CUDA) || defined(FF_USE_HIP_CUDA)
@@ -86,9 +89,16 @@ struct FFHandler {
       sizeof(BatchConfig::causalMask) +
       sizeof(TreeVerifyBatchConfig::committed_tokens) +
       sizeof(BatchConfig::request_completed);
+  // Host mirror of batch_config_metadata; nullptr if there is none
+  BatchConfigMetadataCache *batch_config_metadata_cache;
   void *offload_reserve_space;
   size_t offload_reserve_space_size;
+  // Stages offloaded weights in the reserve space; nullptr if there is none
+  WeightOffloadEngine *offload_engine;
   DataType quantization_type;
+  // Storage of the KV caches of incremental decoding; DT_NONE keeps the data
+  // type of the model
+  DataType kv_cache_quantization_type;
   bool allowTensorOpMathConversion;
 #ifdef FF_USE_NCCL
   ncclComm_t ncclComm;
@@ -98,7 +108,9 @@ struct FFHandler {
 struct FFInitInfo {
   size_t workSpaceSize;
   size_t offload_reserve_space_size;
+  int offload_prefetch_depth;
   DataType quantization_type;
+  DataType kv_cache_quantization_type;
   bool allowTensorOpMathConversion;
   // int myRank, allRanks;
 };
@@ -154,7 +166,16 @@ public:
   CompMode computationMode;
   bool cpu_offload;
   size_t offload_reserve_space_size;
+  // Offloaded layers loaded ahead of the computing one; -1 picks the depth
+  // from the copy and compute times of the first steps
+  int offload_prefetch_depth;
   DataType quantization_type;
+  // Input channels that share an offset and a scale in quantized linear
+  // weights; 0 keeps the legacy layout of compress_llama_weights.py
+  int quantization_group_size;
+  // DT_INT8 stores the KV caches of incremental decoding in int8, with a
+  // scale per token and head
+  DataType kv_cache_quantization_type;
   // Control parallelizable dimensions
   bool only_data_parallel;
   bool enable_sample_parallel;
@@ -172,6 +193,11 @@ public:
   std::string export_strategy_file;
   std::string export_strategy_task_graph_file;
   std::string export_strategy_computation_graph_file;
+  // Searched strategies are cached here by fingerprint; empty disables it
+  std::string search_cache_dir;
+  // The fusion pass writes the groups it formed and why operators stayed
+  // apart here; empty disables the report
+  std::string fusion_report_file;
   bool include_costs_dot_graph;
   tl::optional<std::string> substitution_json_path = tl::nullopt;
   // We use MappingTagID as the key since we will pass the tag to the mapper
@@ -180,13 +206,26 @@ public:
   std::string machine_model_file;
   int simulator_segment_size;
   int simulator_max_num_segments;
+  CostModelType cost_model_type;
+  std::string cost_database_file;
+  std::string export_cost_database_file;
+  // Pipeline parallelism, tried by --memory-search when no strategy fits in
+  // memory: 1 disables it, 0 searches over the stage counts that evenly
+  // divide the machine
+  int pipeline_stages;
+  // Costed as 1 until the runtime splits iterations into micro-batches
+  int pipeline_micro_batches;
+  tl::optional<PipelineSchedule> pipeline_schedule = tl::nullopt;
   bool enable_propagation;
   tl::optional<int> search_num_nodes = tl::nullopt;
   tl::optional<int> search_num_workers = tl::nullopt;
   int base_optimize_threshold;
+  // Threads that expand search candidates in parallel; 1 searches serially
+  int search_threads;
   bool enable_control_replication;
   int python_data_loader_type;
   bool perform_memory_search{false};
+  MemorySearchAlgo memory_search_algo{MemorySearchAlgo::MULTI_OBJECTIVE};
 };
 
 class FFIterationConfig {
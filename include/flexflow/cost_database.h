@@ -0,0 +1,112 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _FLEXFLOW_COST_DATABASE_H_
+#define _FLEXFLOW_COST_DATABASE_H_
+
+#include "flexflow/ffconst.h"
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace FlexFlow {
+
+/**
+ * @brief Peak throughputs of a compute device, the two axes of the roofline
+ * used by the analytical cost model.
+ *
+ * @details Machine models fill them in from their configuration; zero means
+ * the machine model does not describe the device.
+ */
+struct DeviceRoofline {
+  float peak_flops = 0;      ///< single-precision FLOPs per ms
+  float peak_half_flops = 0; ///< half-precision FLOPs per ms
+  float mem_bandwidth = 0;   ///< B/ms between the device and its local memory
+  static constexpr float KERNEL_LAUNCH_LATENCY = 0.005f; // ms
+  bool is_valid() const;
+  /// ms taken by a kernel, or 0 if it does neither computation nor memory
+  /// accesses
+  float time(double flops, double bytes, DataType data_type) const;
+};
+
+/**
+ * @brief A profiled operator cost together with the workload the analytical
+ * model derives for the same operator and view.
+ *
+ * @details data_type selects the peak FLOPs of the roofline the record is
+ * calibrated against.
+ */
+struct CostRecord {
+  OperatorType op_type;
+  size_t params_hash;
+  size_t view_hash;
+  DataType data_type;
+  double forward_flops, backward_flops;
+  double forward_bytes, backward_bytes;
+  float forward_time, backward_time;
+};
+
+/**
+ * @brief A set of profiled operator costs, stored as a plain text file with
+ * one CostRecord per line.
+ *
+ * @details Databases are recorded on a machine with GPUs by running the search
+ * with --export-cost-database, and loaded with --cost-database to calibrate
+ * the analytical cost model on machines without GPUs. Files of version 1 have
+ * no data type column; their records were profiled in DT_FLOAT.
+ */
+class CostDatabase {
+public:
+  void add_record(CostRecord const &record);
+  CostRecord const *find_record(OperatorType op_type,
+                                size_t params_hash,
+                                size_t view_hash) const;
+  std::vector<CostRecord> const &get_records() const;
+  /**
+   * @return False, with the reason in error, if the file cannot be read or
+   * has a malformed record; the database is then left unchanged
+   */
+  bool load_from_file(std::string const &filename, std::string &error);
+  bool save_to_file(std::string const &filename) const;
+
+private:
+  static size_t record_key(OperatorType op_type,
+                           size_t params_hash,
+                           size_t view_hash);
+  std::vector<CostRecord> records;
+  std::unordered_map<size_t, size_t> key_to_record;
+};
+
+/// Key of the efficiency factors fitted per operator type and data type
+int calibration_key(OperatorType op_type, DataType data_type);
+
+/**
+ * @brief Fits one efficiency factor per operator type and data type as the
+ * ratio between the sum of profiled times and the sum of roofline times.
+ *
+ * @details Each record is compared against the roofline of its own data type
+ * on device, which is assumed to match the device it was profiled on.
+ *
+ * @return The factors by calibration_key; first is for forward, second for
+ * backward
+ */
+std::unordered_map<int, std::pair<float, float>>
+    fit_calibration_factors(std::vector<CostRecord> const &records,
+                            DeviceRoofline const &device);
+
+}; // namespace FlexFlow
+
+#endif // _FLEXFLOW_COST_DATABASE_H_
@@ -0,0 +1,67 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _FLEXFLOW_COST_FRONTIER_H_
+#define _FLEXFLOW_COST_FRONTIER_H_
+
+#include <cstddef>
+#include <vector>
+
+namespace FlexFlow {
+
+/**
+ * @brief The (run time, peak per-device memory in MB) cost of a strategy.
+ */
+struct FrontierPoint {
+  float cost, mem;
+};
+
+/**
+ * @brief A strategy of two combined pieces, built from the points at indices
+ * first and second of their frontiers.
+ */
+struct FrontierPair {
+  float cost, mem;
+  size_t first, second;
+};
+
+/**
+ * @brief Pareto frontier of points, thinned to at most max_points.
+ *
+ * @details Returns the indices of the kept points sorted by increasing run
+ * time and strictly decreasing memory. Points with an infinite run time are
+ * dropped. Thinning always keeps the fastest and the smallest point and picks
+ * the points in between at evenly spaced memory, since the constrained search
+ * looks points up by memory limit.
+ */
+std::vector<size_t> prune_frontier(std::vector<FrontierPoint> const &points,
+                                   size_t max_points);
+
+/**
+ * @brief Frontier of the strategies combining a point of each frontier.
+ *
+ * @details Sequential pieces run on the same devices, so both their run time
+ * and memory add up. Pieces on disjoint devices run concurrently and only the
+ * larger run time and memory count. The result is pruned like
+ * prune_frontier.
+ */
+std::vector<FrontierPair>
+    combine_frontiers(std::vector<FrontierPoint> const &first,
+                      std::vector<FrontierPoint> const &second,
+                      bool disjoint_devices,
+                      size_t max_points);
+
+}; // namespace FlexFlow
+
+#endif // _FLEXFLOW_COST_FRONTIER_H_
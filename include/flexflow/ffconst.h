@@ -72,6 +72,16 @@ enum InferenceMode {
   TREE_VERIFY_MODE = 2003,
 };
 
+enum CostModelType {
+  COST_MODEL_PROFILING = 2101,
+  COST_MODEL_ANALYTICAL = 2102,
+};
+
+enum PipelineSchedule {
+  PIPELINE_SCHEDULE_GPIPE = 2201,
+  PIPELINE_SCHEDULE_1F1B = 2202,
+};
+
 // This is consistent with TASO's OpType
 // https://github.com/jiazhihao/TASO/blob/master/include/taso/ops.h#L75-L138
 enum OperatorType {
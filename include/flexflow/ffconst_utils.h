@@ -12,9 +12,13 @@ size_t data_type_size(DataType type);
 
 #define INT4_NUM_OF_ELEMENTS_PER_GROUP 32
 
-size_t get_quantization_to_byte_size(DataType type,
-                                     DataType quantization_type,
-                                     size_t num_elements);
+// Bytes of num_elements quantized values together with the offset and scale
+// of each group of group_size values
+size_t get_quantization_to_byte_size(
+    DataType type,
+    DataType quantization_type,
+    size_t num_elements,
+    int group_size = INT4_NUM_OF_ELEMENTS_PER_GROUP);
 
 std::ostream &operator<<(std::ostream &, OperatorType);
 
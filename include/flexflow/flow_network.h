@@ -0,0 +1,93 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _FLEXFLOW_FLOW_NETWORK_H_
+#define _FLEXFLOW_FLOW_NETWORK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace FlexFlow {
+
+using FlowId = uint32_t;
+
+/**
+ * @brief Flow-level network model with max-min fair bandwidth sharing.
+ *
+ * @details Every active flow crosses a fixed set of links and gets the rate
+ * assigned by progressive filling: the most contended link is saturated
+ * first, its flows are frozen at its fair share, and the remaining capacity
+ * of the other links is shared among the flows that are left. Rates are only
+ * recomputed when a flow starts or drains, and time advances from event to
+ * event. A drained flow is reported as completed after its fixed delay
+ * (e.g., the latency of its hops), without holding any bandwidth meanwhile.
+ *
+ * Times must be non-decreasing across calls. Flow ids are dense and restart
+ * from 0 after reset().
+ */
+class FlowNetwork {
+public:
+  int add_link(float bandwidth);
+  size_t num_links() const;
+  /**
+   * @brief Start sending bytes over links at time now.
+   */
+  FlowId start_flow(std::vector<int> const &links,
+                    float bytes,
+                    float now,
+                    float delay = 0.0f);
+  bool has_flows() const;
+  /**
+   * @brief Time of the next completion under the current rates.
+   */
+  float next_completion_time() const;
+  /**
+   * @brief Advance to the next completion and return the completed flow.
+   */
+  FlowId complete_next_flow(float &time);
+  float get_rate(FlowId flow) const;
+  void reset();
+
+private:
+  void advance(float time);
+  void update_rates();
+  float next_drain_time(size_t &index) const;
+
+private:
+  float now = 0.0f;
+  std::vector<float> link_bandwidth;
+  // per flow
+  std::vector<float> remaining, rate, delay;
+  std::vector<uint32_t> link_offsets{0};
+  std::vector<int> flow_links;
+  // flows still sending
+  std::vector<FlowId> active;
+  // drained flows waiting out their delay, earliest first
+  std::priority_queue<std::pair<float, FlowId>,
+                      std::vector<std::pair<float, FlowId>>,
+                      std::greater<std::pair<float, FlowId>>>
+      delayed;
+  // scratch space of update_rates
+  std::vector<float> residual;
+  std::vector<int> unfrozen;
+  std::vector<bool> frozen;
+};
+
+}; // namespace FlexFlow
+
+#endif // _FLEXFLOW_FLOW_NETWORK_H_
@@ -0,0 +1,83 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _FLEXFLOW_FUSION_PLANNER_H_
+#define _FLEXFLOW_FUSION_PLANNER_H_
+
+#include <cstddef>
+#include <vector>
+
+namespace FlexFlow {
+
+/**
+ * @brief An operator as seen by the fusion planner. Tensors are identified by
+ * integers, and two operators that read or write the same region use the same
+ * id for it.
+ */
+struct FusionNode {
+  bool fusible = false;         ///< May be part of a fused operator
+  bool can_start_group = false; ///< May be the first operator of one
+  size_t view_hash = 0;         ///< Only operators of one view are fused
+  std::vector<int> inputs, weights, outputs;
+  float run_time = 0.0f; ///< Estimated run time in ms, used for the report
+};
+
+struct FusionCostModel {
+  float launch_overhead = 0.02f; ///< ms saved for each task launch avoided
+  /// Memory that a fused operator may keep mapped at once; a group pays for
+  /// the fraction of it that it uses out of the launch overhead it saves.
+  /// 0 disables the memory pressure term
+  size_t max_mapped_bytes = 0;
+  // Capacity of a FusedOp
+  int max_operators, max_tensors;
+  int max_inputs, max_weights, max_outputs;
+};
+
+enum FusionDecision {
+  FUSION_NOT_FUSIBLE,
+  FUSION_GROUP_HEAD,     ///< First operator of its group
+  FUSION_FUSED,          ///< Added to an earlier group
+  FUSION_VIEW_MISMATCH,  ///< No candidate group with the same view
+  FUSION_OVER_CAPACITY,  ///< The candidate groups were full
+  FUSION_NOT_PROFITABLE, ///< Memory pressure outweighed the launch saved
+};
+
+struct FusionPlan {
+  /// Operators of each group, in an order that respects their dependencies
+  std::vector<std::vector<int>> groups;
+  std::vector<FusionDecision> decisions; ///< Indexed by node
+  std::vector<size_t> group_mapped_bytes;
+  float saved_time = 0.0f; ///< Launch overhead saved per run, in ms
+};
+
+/**
+ * @brief Groups operators into fused operators in a single sweep over the
+ * nodes, which must be in topological order.
+ *
+ * @details Each fusible node is considered for two groups only: the group of
+ * its latest producer, and the latest group. A node joins the candidate with
+ * the best score, launch_overhead * (1 - mapped / max_mapped_bytes), if that
+ * score is positive and the group has room for the node's tensors; otherwise
+ * it starts a group of its own. Groups never join, so the plan takes time
+ * linear in the number of tensors.
+ */
+FusionPlan plan_fusion(std::vector<FusionNode> const &nodes,
+                       std::vector<size_t> const &tensor_bytes,
+                       FusionCostModel const &cost_model);
+
+char const *get_fusion_decision_name(FusionDecision decision);
+
+}; // namespace FlexFlow
+
+#endif // _FLEXFLOW_FUSION_PLANNER_H_
@@ -16,12 +16,14 @@
 #ifndef _FLEXFLOW_GRAPH_H_
 #define _FLEXFLOW_GRAPH_H_
 #include "flexflow/basic_graph.h"
+#include "flexflow/cost_frontier.h"
 #include "flexflow/graph_structures.h"
 #include "flexflow/memory_optimization.h"
 #include "flexflow/model.h"
 #include "flexflow/utils/dot/dot_file.h"
 #include "flexflow/utils/recursive_logger.h"
 #include "legion/legion_utilities.h"
+#include <mutex>
 #include <unordered_set>
 
 extern LegionRuntime::Logger::Category log_dp;
@@ -140,6 +142,38 @@ struct GraphCostResultWithMemory {
                                   GraphCostResultWithMemory const &);
 };
 
+/**
+ * @brief Pareto frontier of (run time, per-device memory) costs of a PCG.
+ *
+ * @details Used by MemorySearchAlgo::CONSTRAINED. Each point is a complete
+ * strategy whose mem_cost is the peak per-device memory in MB
+ * (MemoryUsageType::PER_DEVICE_MAX). Points are sorted by increasing run time
+ * and strictly decreasing memory. Sequential pieces run on the same devices,
+ * so their memory adds up; parallel pieces run on disjoint devices, so the
+ * peak is the max of the two.
+ */
+struct GraphCostFrontier {
+  static constexpr size_t MAX_POINTS = 16;
+  std::vector<GraphCostResultWithMemory> points;
+
+  /**
+   * @brief Drop the dominated points and thin the frontier out to at most
+   * MAX_POINTS points (see prune_frontier).
+   */
+  void prune();
+  std::vector<FrontierPoint> costs() const;
+  void merge(GraphCostFrontier const &other);
+  /**
+   * @brief The fastest point that fits in memory_limit (in MB), or
+   * GraphCostResultWithMemory::invalid() if none does.
+   */
+  GraphCostResultWithMemory fastest_within(float memory_limit) const;
+
+  static GraphCostFrontier invalid();
+
+  friend std::ostream &operator<<(std::ostream &, GraphCostFrontier const &);
+};
+
 template <typename T>
 T sequence_cost(T const &first, T const &second);
 
@@ -274,10 +308,21 @@ private:
                            MachineResource const &resources,
                            SequenceSplit const &split) const;
 
+  std::vector<MachineView>
+      get_valid_bottleneck_views(Graph const *g,
+                                 Node const &bn_node,
+                                 NodeAssignment const &sink,
+                                 MachineResource const &resources) const;
+  std::vector<NonsequenceSplit>
+      get_nonsequence_splits(MachineResource const &resources) const;
+
 private:
   FFModel *model;
 
+  // Guards the caches below, which search threads share
+  mutable std::mutex cache_mutex;
   mutable std::unordered_map<size_t, float> cached_graph_costs;
+  mutable std::unordered_map<size_t, GraphCostFrontier> cached_graph_frontiers;
   mutable std::unordered_map<size_t,
                              std::unique_ptr<const std::vector<MachineView>>>
       cached_operator_valid_views;
@@ -309,6 +354,8 @@ public:
   void contract_out_node(Node const &);
   float optimal_cost() const;
   float optimal_cost_with_memory(float run_time_cost_factor) const;
+  float optimal_cost_with_memory(MemoryOptimConfig const &mem_config) const;
+  GraphCostFrontier optimal_cost_frontier() const;
   std::unordered_map<Node, MachineView> optimal_views() const;
   void remove_input_nodes();
   void duplicate_input_node(Node const &);
@@ -0,0 +1,86 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _FLEXFLOW_GROUPWISE_QUANTIZATION_H_
+#define _FLEXFLOW_GROUPWISE_QUANTIZATION_H_
+
+#include "flexflow/ffconst.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace FlexFlow {
+
+/**
+ * @brief Layout of a [rows x cols] weight quantized to 4 or 8 bits in groups
+ * of group_size consecutive values of a row (i.e., along the input dimension
+ * of a linear layer).
+ *
+ * @details Every row is self-contained, so a weight split by rows across
+ * devices keeps its groups: |values|offsets|scales|. Two 4-bit values share
+ * a byte, the first one in the high nibble. Each group has an offset and a
+ * scale of meta_type_size bytes (the unquantized data type), and its values
+ * dequantize as q / scale + offset, the convention of
+ * inference/utils/compress_llama_weights.py.
+ */
+struct GroupwiseLayout {
+  DataType quantization_type; ///< DT_INT4 or DT_INT8
+  size_t meta_type_size;      ///< sizeof(float) or sizeof(half)
+  size_t rows, cols;
+  int group_size;
+
+  size_t groups_per_row() const;
+  size_t value_bytes_per_row() const;
+  size_t row_bytes() const;
+  size_t total_bytes() const;
+};
+
+/**
+ * @brief Packs pairs of 4-bit values (one per byte) into single bytes, eight
+ * values per step on little-endian hosts. num_values must be even.
+ */
+void pack_int4(uint8_t const *values, size_t num_values, char *packed);
+void unpack_int4(char const *packed, size_t num_values, uint8_t *values);
+
+/**
+ * @brief Lays out quantized values (one per byte, row-major) and the raw
+ * bytes of the offsets and scales of each group (row-major) as in layout.
+ */
+void pack_groupwise_rows(GroupwiseLayout const &layout,
+                         uint8_t const *values,
+                         char const *offsets,
+                         char const *scales,
+                         char *quantized);
+
+// CPU references, for float offsets and scales only
+
+void quantize_groupwise(float const *weight,
+                        GroupwiseLayout const &layout,
+                        char *quantized);
+void dequantize_groupwise(char const *quantized,
+                          GroupwiseLayout const &layout,
+                          float *weight);
+/**
+ * @brief output[b][r] = sum over c of input[b][c] * weight[r][c], dequantizing
+ * the weight one group at a time; the layout of Linear with a quantized
+ * kernel of layout.rows output channels.
+ */
+void reference_dequant_gemm(char const *quantized,
+                            GroupwiseLayout const &layout,
+                            float const *input,
+                            size_t batch_size,
+                            float *output);
+
+}; // namespace FlexFlow
+
+#endif // _FLEXFLOW_GROUPWISE_QUANTIZATION_H_
@@ -0,0 +1,68 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _FLEXFLOW_KV_CACHE_QUANTIZATION_H_
+#define _FLEXFLOW_KV_CACHE_QUANTIZATION_H_
+
+#include "flexflow/ffconst.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace FlexFlow {
+
+/**
+ * @brief Bytes of a key (or value) cache of num_tokens tokens of num_heads
+ * heads of head_dim values, stored as cache_type (DT_NONE for data_type).
+ *
+ * @details An int8 cache has a float scale per token and head after the
+ * values: [num_tokens][num_heads][head_dim] int8, then
+ * [num_tokens][num_heads] float.
+ */
+size_t kv_cache_bytes(DataType cache_type,
+                      DataType data_type,
+                      size_t num_tokens,
+                      int num_heads,
+                      int head_dim);
+
+/**
+ * @brief Quantizes the keys or values of num_tokens tokens,
+ * [num_tokens][num_heads][head_dim], to int8 with a symmetric scale per token
+ * and head: scale = max |x| / 127 and q = round(x / scale).
+ *
+ * @details Scales per token and head keep an outlier from costing precision
+ * to the other heads and tokens, and are written once, when the token enters
+ * the cache. The GPU kernels of IncMultiHeadSelfAttention use the same
+ * scheme; this is their reference.
+ */
+void quantize_kv_int8(float const *values,
+                      int num_tokens,
+                      int num_heads,
+                      int head_dim,
+                      int8_t *quantized,
+                      float *scales);
+
+/**
+ * @brief values = quantized * scale, the inverse of quantize_kv_int8 up to
+ * half a scale per value.
+ */
+void dequantize_kv_int8(int8_t const *quantized,
+                        float const *scales,
+                        int num_tokens,
+                        int num_heads,
+                        int head_dim,
+                        float *values);
+
+}; // namespace FlexFlow
+
+#endif // _FLEXFLOW_KV_CACHE_QUANTIZATION_H_
@@ -0,0 +1,82 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _FLEXFLOW_KV_CACHE_WINDOW_H_
+#define _FLEXFLOW_KV_CACHE_WINDOW_H_
+
+#if defined(__CUDACC__) || defined(__HIPCC__)
+#define KV_CACHE_WINDOW_FUNC __host__ __device__ inline
+#else
+#define KV_CACHE_WINDOW_FUNC inline
+#endif
+
+namespace FlexFlow {
+
+/**
+ * @brief Which tokens of a request the KV cache keeps: every token, or the
+ * first sink_tokens tokens ("attention sinks") and the window_size most
+ * recent ones.
+ *
+ * @details With a window, the cache of a request has sink_tokens +
+ * window_size slots. The sink tokens have the first slots, and the other
+ * tokens go around a ring in the remaining ones, so that a token overwrites
+ * the one window_size positions before it. Tokens keep their absolute
+ * positions (PerTokenInfo::abs_depth_in_request) for the position
+ * embeddings; only the slots wrap. Attention is invariant to the order of the
+ * keys, so kernels attend to the slots in place and use position() for the
+ * causal mask.
+ */
+struct KVCacheWindow {
+  int sink_tokens = 0;
+  int window_size = 0; ///< 0 keeps every token
+
+  KV_CACHE_WINDOW_FUNC bool enabled() const {
+    return window_size > 0;
+  }
+
+  /// Slots per request
+  KV_CACHE_WINDOW_FUNC int cache_length(int max_sequence_length) const {
+    return enabled() ? sink_tokens + window_size : max_sequence_length;
+  }
+
+  /// Slot of the token at position abs_depth
+  KV_CACHE_WINDOW_FUNC int slot(int abs_depth) const {
+    if (!enabled() || abs_depth < sink_tokens) {
+      return abs_depth;
+    }
+    return sink_tokens + (abs_depth - sink_tokens) % window_size;
+  }
+
+  /// Slots holding tokens once the first num_tokens tokens are stored
+  KV_CACHE_WINDOW_FUNC int num_slots(int num_tokens) const {
+    return enabled() && num_tokens > sink_tokens + window_size
+               ? sink_tokens + window_size
+               : num_tokens;
+  }
+
+  /// Position of the token in slot once the first num_tokens tokens are
+  /// stored; slot < num_slots(num_tokens)
+  KV_CACHE_WINDOW_FUNC int position(int slot, int num_tokens) const {
+    if (!enabled() || slot < sink_tokens) {
+      return slot;
+    }
+    // the latest position that maps to slot
+    int last = num_tokens - 1;
+    return last - ((last - slot) % window_size + window_size) % window_size;
+  }
+};
+
+}; // namespace FlexFlow
+
+#endif // _FLEXFLOW_KV_CACHE_WINDOW_H_
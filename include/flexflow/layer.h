@@ -3,6 +3,7 @@
 #include "ffconst.h"
 #include "fftype.h"
 #include "tensor.h"
+#include <cstdint>
 
 namespace FlexFlow {
 
@@ -39,6 +40,8 @@ public:
                                std::vector<int> &value) const;
   bool get_initializer(std::string const &key, Initializer *&initializer) const;
   Tensor get_parameter(int index);
+  // Hash of the data type, shapes and properties, stable across processes
+  uint64_t get_params_hash() const;
   void print();
 
 public:
@@ -17,6 +17,7 @@
 #define __FLEXFLOW_MAPPER_H__
 
 #include "default_mapper.h"
+#include "flexflow/utils/flat_hash_map.h"
 #include "legion.h"
 #include "model.h"
 #include "null_mapper.h"
@@ -44,6 +45,73 @@ private:
   MachineView machine_view;
 };
 
+struct ProcessorHash {
+  size_t operator()(Processor const &p) const {
+    return std::hash<unsigned long long>()(p.id);
+  }
+};
+
+struct MemoryHash {
+  size_t operator()(Memory const &m) const {
+    return std::hash<unsigned long long>()(m.id);
+  }
+};
+
+/**
+ * @brief A NUMA domain of the local node, as exposed by the socket memories
+ * Realm creates with -ll:nsize.
+ */
+struct NumaSocket {
+  Memory memory;               ///< The SOCKET_MEM of the domain
+  std::vector<Processor> cpus; ///< Local CPUs with the best affinity to it
+};
+
+struct LayoutConstraintKeyHash {
+  size_t operator()(std::pair<Memory::Kind, FieldSpace> const &key) const {
+    return std::hash<unsigned long long>()(
+        ((unsigned long long)key.second.get_id() << 8) ^ key.first);
+  }
+};
+
+/**
+ * @brief Key of a memoized slice_task decision. The slices of an index launch
+ * only depend on its task, its machine view (the tag) and its index domain.
+ */
+struct SliceCacheKey {
+  TaskID task_id;
+  MappingTagID tag;
+  Domain domain;
+  bool operator==(SliceCacheKey const &other) const;
+};
+
+struct SliceCacheKeyHash {
+  size_t operator()(SliceCacheKey const &key) const;
+};
+
+/**
+ * @brief Key of a memoized map_task decision. The region hash covers the
+ * regions, fields, privileges and tags of the region requirements.
+ */
+struct MapCacheKey {
+  TaskID task_id;
+  Processor target_proc;
+  unsigned long long region_hash;
+  int numa_socket;
+  bool operator==(MapCacheKey const &other) const;
+};
+
+struct MapCacheKeyHash {
+  size_t operator()(MapCacheKey const &key) const;
+};
+
+struct CachedTaskMapping {
+  VariantID chosen_variant;
+  std::vector<Processor> target_procs;
+  std::vector<std::vector<PhysicalInstance>> chosen_instances;
+  // Checked on replay so that a hash collision cannot reuse wrong instances
+  std::vector<LogicalRegion> regions;
+};
+
 struct InstanceCreationLog {
   std::string task_name;
   size_t size;
@@ -51,6 +119,28 @@ struct InstanceCreationLog {
   Processor processor;
 };
 
+/**
+ * @brief An instance created by the mapper, with its last use counted in
+ * map_task calls of that mapper.
+ */
+struct InstanceLifetime {
+  InstanceCreationLog creation;
+  unsigned long long last_used; ///< The map_task call that last chose it
+  bool collectable;             ///< Handed back to the Legion collector
+};
+
+/**
+ * @brief Usage of a memory by the instances one mapper created in it.
+ */
+struct InstanceMemoryUsage {
+  size_t live_bytes = 0;
+  size_t peak_bytes = 0;
+  size_t live_instances = 0;
+  size_t created_instances = 0;
+  size_t reclaimed_instances = 0; ///< Deleted since creation
+  size_t collectable_bytes = 0;   ///< Live but handed to the collector
+};
+
 class FFMapper : public NullMapper {
 public:
   FFMapper(MapperRuntime *rt,
@@ -58,7 +148,10 @@ public:
            Processor local,
            char const *mapper_name, // const std::string& strategyFile,
            bool _enable_control_replication,
-           bool _log_instance_creation);
+           bool _log_instance_creation,
+           bool _enable_mapper_cache,
+           unsigned long long _instance_gc_idle,
+           char const *_memory_usage_report);
   ~FFMapper();
   virtual char const *get_mapper_name(void) const;
   virtual MapperSyncModel get_mapper_sync_model(void) const;
@@ -331,9 +424,30 @@ private: // Default helper functions
 
 private:
   unsigned long long compute_task_hash(Task const &task);
+  unsigned long long compute_region_hash(Task const &task);
+  bool replay_task_mapping(const MapperContext ctx,
+                           Task const &task,
+                           MapCacheKey const &key,
+                           MapTaskOutput &output);
   bool is_parameter_server_update_task(TaskID tid);
   bool is_initializer_task(TaskID tid);
   std::vector<Processor> const &all_procs_by_kind(Processor::Kind kind);
+  void init_numa_sockets(
+      std::vector<Machine::ProcessorMemoryAffinity> const &affinities);
+  int get_numa_socket(Processor proc) const;
+  int select_numa_socket(MapTaskInput const &input) const;
+  Processor default_cpu() const;
+  void track_instance(PhysicalInstance const &instance,
+                      InstanceCreationLog const &creation);
+  void touch_instances(
+      MapperContext ctx,
+      std::vector<std::vector<PhysicalInstance>> const &instances);
+  size_t release_idle_instances(MapperContext ctx,
+                                Memory memory,
+                                unsigned long long idle_calls);
+  void prune_deleted_instances();
+  void log_memory_usage();
+  void write_memory_usage_report();
 
 protected:
   const Processor local_processor;
@@ -342,15 +456,39 @@ protected:
   char const *mapper_name;
   bool enable_control_replication;
   bool log_instance_creation;
+  bool enable_mapper_cache;
+  // Instances unused for this many map_task calls may be collected, 0 keeps
+  // every instance until its region is destroyed
+  unsigned long long instance_gc_idle;
+  // Prefix of the per-memory usage report written at shutdown, if any
+  char const *memory_usage_report;
   std::vector<Processor> all_gpus, all_cpus, all_pys, local_gpus, local_cpus,
       local_pys;
-  std::map<Processor, Memory> proc_fbmems, proc_zcmems;
-  std::map<unsigned long long, Processor> cache_update_tasks;
+  FlatHashMap<Processor, Memory, ProcessorHash> proc_fbmems, proc_zcmems;
+  FlatHashMap<unsigned long long, Processor> cache_update_tasks;
   // We use MappingTagID has the key since we will pass the tag to the mapper
-  std::map<MappingTagID, MachineView> machine_views;
-  std::map<std::pair<Memory::Kind, FieldSpace>, LayoutConstraintID>
+  FlatHashMap<MappingTagID, MachineView> machine_views;
+  FlatHashMap<std::pair<Memory::Kind, FieldSpace>,
+              LayoutConstraintID,
+              LayoutConstraintKeyHash>
       layout_constraint_cache;
+  // Decisions replayed for repeated launches, e.g., across decoding steps
+  FlatHashMap<SliceCacheKey, std::vector<TaskSlice>, SliceCacheKeyHash>
+      slice_cache;
+  FlatHashMap<MapCacheKey, CachedTaskMapping, MapCacheKeyHash> map_cache;
   std::vector<InstanceCreationLog> created_instances;
+  // Every instance this mapper created that has not been deleted yet
+  std::map<PhysicalInstance, InstanceLifetime> live_instances;
+  FlatHashMap<Memory, InstanceMemoryUsage, MemoryHash> memory_usage;
+  unsigned long long num_map_calls = 0;
+  size_t num_collectable = 0;
+  // NUMA domains of the local node, empty if Realm exposes none
+  std::vector<NumaSocket> numa_sockets;
+  FlatHashMap<Processor, int, ProcessorHash> proc_numa_sockets;
+  FlatHashMap<Memory, int, MemoryHash> mem_numa_sockets;
+  // For CPU tasks launched with a GPU machine view: the CPU that works for
+  // each GPU, on the socket of that GPU when it is known
+  std::vector<Processor> gpu_worker_cpus;
 };
 
 }; // namespace FlexFlow
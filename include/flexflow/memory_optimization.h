@@ -35,6 +35,11 @@ enum class MemorySearchAlgo {
   // Multiple objective DP search. Combine memory cost and run time cost into
   // one single cost function and add a factor to balance them.
   MULTI_OBJECTIVE,
+
+  // Constrained DP search. Keep Pareto frontiers of (run time, per-device
+  // memory) in the DP and pick the fastest strategy that fits the per-device
+  // memory limit in a single pass.
+  CONSTRAINED,
 };
 
 /**
@@ -50,15 +55,18 @@ public:
                               ///< overall cost function; used in
                               ///< MULTI_OBJECTIVE algorithm
                               ///< Valid between and including 0 and 1
+  float per_device_memory_limit; ///< Memory (in MB) available on each device;
+                                 ///< used in CONSTRAINED algorithm
 
   MemoryOptimConfig()
       : mem_usage_type{MemoryUsageType::GLOBAL},
         mem_search_algo{MemorySearchAlgo::MULTI_OBJECTIVE},
-        run_time_cost_factor{0.5} {}
+        run_time_cost_factor{0.5}, per_device_memory_limit{0.0} {}
   MemoryOptimConfig(float factor)
       : mem_usage_type{MemoryUsageType::GLOBAL},
         mem_search_algo{MemorySearchAlgo::MULTI_OBJECTIVE},
-        run_time_cost_factor{factor} {}
+        run_time_cost_factor{factor}, per_device_memory_limit{0.0} {}
+  static MemoryOptimConfig constrained(float per_device_memory_limit);
 };
 
 /**
@@ -21,6 +21,7 @@
 #include "flexflow/memory_optimization.h"
 #include "flexflow/node.h"
 #include "flexflow/operator_params.h"
+#include "flexflow/strategy_file.h"
 #include "flexflow/utils/hash_utils.h"
 #include "flexflow/utils/tuple.h"
 #include "initializer.h"
@@ -35,7 +36,9 @@
 #include "simulator.h"
 #include "tensor.h"
 #include "tl/optional.hpp"
+#include <atomic>
 #include <functional>
+#include <mutex>
 #include <unistd.h>
 #include <utility>
 
@@ -928,6 +931,11 @@ public:
   bool convert_graph_to_operators(
       const PCG::Graph *graph,
       std::unordered_map<PCG::Node, MachineView> const &optimal_views);
+  StrategyFile get_strategy_file() const;
+  uint64_t get_search_fingerprint(StrategyFile const &strategy) const;
+  std::vector<char> search_or_import_strategy(StrategyGuidMap &guid_map);
+  void apply_strategy_guid_map(PCG::Graph *graph,
+                               StrategyGuidMap const &guid_map) const;
   static void register_all_machine_views(int num_nodes,
                                          int gpus_per_node,
                                          int cpus_per_node,
@@ -949,6 +957,7 @@ public:
 
     T *op = nullptr;
 
+    std::lock_guard<std::recursive_mutex> lock(this->node_creation_mutex);
     std::pair<typename ToShape<typename T::Input>::type, Params> key{
         input_shapes, params};
     auto &cache = FlexFlow::get<std::unordered_map<
@@ -1045,6 +1054,11 @@ public:
       std::vector<Op *> &new_operators,
       std::unordered_map<ParallelTensor, std::vector<ParallelTensor>>
           *parallel_tensor_mapping = nullptr);
+  // Fuses the operators in a single pass planned by plan_fusion, and writes
+  // a report to config.fusion_report_file
+  void fuse_operators(
+      std::unordered_map<ParallelTensor, std::vector<ParallelTensor>>
+          *parallel_tensor_mapping = nullptr);
   bool check_operators_integrity(
       std::vector<Op *> const &old_operators,
       std::unordered_map<ParallelTensor, std::vector<ParallelTensor>>
@@ -1116,7 +1130,9 @@ public:
 
 public:
   size_t op_global_guid, layer_global_guid;
-  size_t tensor_global_guid, parallel_tensor_global_guid, node_global_guid;
+  size_t tensor_global_guid, parallel_tensor_global_guid;
+  // Search threads create nodes concurrently (see --search-threads)
+  std::atomic<size_t> node_global_guid;
   size_t current_transformer_layer_id;
   // positional embedding start offset
   int position_offset;
@@ -1248,6 +1264,9 @@ public:
       cached_ops;
   std::unordered_map<size_t, NoOp *> cached_noop_ops;
   std::unordered_map<size_t, NoOp *> cached_input_ops;
+  // Guards the caches of operators above, which the get_or_create_*
+  // functions fill while search threads apply substitutions
+  std::recursive_mutex node_creation_mutex;
   std::vector<MachineView> all_valid_views;
   int model_id; // unique incremental id assigned to each model. Used in the
                 // inference_debugging mode.
@@ -188,21 +188,34 @@ public:
   float scaling_factor;
   void *weight_ptr, *bias_ptr; // for weight offload
   void *devQKVProjArray, *keyCache, *valueCache;
+  // int8 caches: a scale per token and head after the values of each cache,
+  // and a request of the caches dequantized for the prompt phase
+  float *keyCacheScales, *valueCacheScales;
+  void *kvCacheScratch;
   void *qk_prods, *qk_prods_softmax;
   void *attn_heads;
   char *quantized_weight_ptr;
   BatchConfig::PerTokenInfo *token_infos;
   BatchConfig::PerRequestInfo *request_infos;
   DataType quantization_type;
+  // DT_NONE or DT_INT8; incremental decoding only
+  DataType kv_cache_quantization_type;
+  // incremental decoding only; kv_cache_length is the number of slots of the
+  // cache of a request
+  KVCacheWindow kv_cache_window;
+  int kv_cache_length;
   bool offload;
 #if defined(FF_USE_CUDA) || defined(FF_USE_HIP_CUDA)
   // cudaStream_t task_local_stream;
   cudnnTensorDescriptor_t qk_tensor;
   cuFloatComplex *complex_input;
+  // (cos, sin) of the rotary embeddings by position and pair of a head
+  cuFloatComplex *rotary_table;
 #elif defined(FF_USE_HIP_ROCM)
   miopenTensorDescriptor_t qk_tensor;
   //  typedef hipFloatComplex attFloatComplex;
   hipFloatComplex *complex_input;
+  hipFloatComplex *rotary_table;
 #endif
 };
 
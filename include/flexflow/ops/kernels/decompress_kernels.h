@@ -16,6 +16,14 @@ __global__ void decompress_int8_general_weights(char const *input_weight_ptr,
                                                 DT *weight_ptr,
                                                 int in_dim,
                                                 int valueSize);
+// Weights in the GroupwiseLayout of flexflow/groupwise_quantization.h
+template <typename DT>
+__global__ void decompress_groupwise_weights(char const *input_weight_ptr,
+                                             DT *weight_ptr,
+                                             bool int4,
+                                             int in_dim,
+                                             int group_size,
+                                             int valueSize);
 
 template <typename DT>
 __global__ void decompress_int4_attention_weights(char *input_weight_ptr,
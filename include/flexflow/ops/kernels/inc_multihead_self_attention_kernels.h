@@ -100,11 +100,12 @@ void compute_qkv_kernel(IncMultiHeadSelfAttentionMeta const *m,
                         DT const *bias_ptr,
                         ffStream_t stream);
 
+// Returns the device copy of the offloaded weight
 template <typename DT>
-void pre_build_weight_kernel(IncMultiHeadSelfAttentionMeta const *m,
-                             GenericTensorAccessorR const weight,
-                             DataType data_type,
-                             ffStream_t stream);
+DT const *pre_build_weight_kernel(IncMultiHeadSelfAttentionMeta const *m,
+                                  GenericTensorAccessorR const weight,
+                                  DataType data_type,
+                                  ffStream_t stream);
 } // namespace IncMultiHeadAttention
 } // namespace Kernels
 } // namespace FlexFlow
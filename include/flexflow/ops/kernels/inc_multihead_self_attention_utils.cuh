@@ -369,6 +369,28 @@ inline __device__ void convert_from_float(half &dst, float src) {
   dst = __float2half(src);
 }
 
+// Reads a vector from a KV cache; int8 caches are dequantized with the scale
+// of the token and head (see flexflow/kv_cache_quantization.h)
+template <typename Vec, typename DT>
+inline __device__ Vec load_kv_cache_vec(DT const *ptr, float scale) {
+  return *reinterpret_cast<Vec const *>(ptr);
+}
+
+template <typename Vec>
+inline __device__ Vec load_kv_cache_vec(int8_t const *ptr, float scale) {
+  using Vec_float = typename Vec_fp32_<Vec>::Type;
+  constexpr int N = sizeof(Vec_float) / sizeof(float);
+  Vec_float tmp;
+  float *elts = reinterpret_cast<float *>(&tmp);
+#pragma unroll
+  for (int ii = 0; ii < N; ++ii) {
+    elts[ii] = ptr[ii] * scale;
+  }
+  Vec dst;
+  convert_from_float(dst, tmp);
+  return dst;
+}
+
 //////////////////////////////////////utils///////////////////////////////////////////////
 
 template <typename T>
@@ -27,8 +27,8 @@ public:
   void *weight_ptr;
   DataType weight_ptr_type;
   DataType quantization_type;
+  int quantization_group_size;
   bool offload;
-  char *quantized_weight_ptr;
   size_t quantized_weightSize;
   ActiMode activation;
   RegularizerMode kernel_reg_type;
@@ -27,6 +27,7 @@ public:
          bool _use_bias,
          DataType _data_type,
          DataType _quantization_type,
+         int _quantization_group_size,
          bool offload,
          bool allocate_weights,
          char const *name);
@@ -135,6 +136,10 @@ public:
   bool use_bias;
   ParallelTensor replica;
   DataType quantization_type;
+  // 0 for the legacy layout, with groups of INT4_NUM_OF_ELEMENTS_PER_GROUP
+  // output channels; otherwise the GroupwiseLayout with groups of this many
+  // input channels
+  int quantization_group_size;
   bool offload;
 };
 
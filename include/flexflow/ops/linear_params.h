@@ -19,6 +19,7 @@ public:
   RegularizerMode kernel_reg_type;
   float kernel_reg_lambda;
   DataType quantization_type;
+  int quantization_group_size;
   bool offload;
   char name[MAX_OPNAME];
 
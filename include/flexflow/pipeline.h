@@ -0,0 +1,114 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _FLEXFLOW_PIPELINE_H_
+#define _FLEXFLOW_PIPELINE_H_
+
+#include "flexflow/ffconst.h"
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace FlexFlow {
+
+/**
+ * @brief Cost of one segment of the sequence split, measured on the resources
+ * of a single pipeline stage for a full (not micro-batched) iteration.
+ */
+struct PipelineSegmentCost {
+  float forward_time = 0.0f, backward_time = 0.0f;
+  size_t weights_memory = 0;    ///< Per-device weights memory
+  size_t activation_memory = 0; ///< Per-device activations of a full batch
+  size_t boundary_bytes = 0; ///< Bytes sent to the next segment per iteration
+};
+
+/**
+ * @brief A contiguous range [first_segment, last_segment] of segments.
+ */
+struct PipelineStage {
+  int first_segment, last_segment;
+};
+
+struct PipelinePlan {
+  int num_stages = 1;
+  int num_micro_batches = 1;
+  PipelineSchedule schedule = PIPELINE_SCHEDULE_1F1B;
+  std::vector<PipelineStage> stages;
+  std::vector<size_t> stage_memory; ///< Peak per-device memory of each stage
+  float cost = std::numeric_limits<float>::infinity();
+
+  bool is_valid() const;
+};
+
+/**
+ * @brief Number of micro-batches whose activations a stage holds at once.
+ *
+ * @details GPipe runs all forward passes before any backward pass, so every
+ * stage keeps all micro-batches alive. 1F1B starts draining after
+ * num_stages - stage warm-up micro-batches.
+ */
+int pipeline_in_flight_micro_batches(PipelineSchedule schedule,
+                                     int num_stages,
+                                     int stage,
+                                     int num_micro_batches);
+
+/**
+ * @brief Memory-aware stage balancing.
+ *
+ * @details Partitions the segments into num_stages contiguous, non-empty
+ * stages that minimize the slowest stage, subject to every stage fitting in
+ * memory_capacity under the given schedule. Returns false if no partition
+ * fits.
+ */
+bool partition_pipeline_stages(std::vector<PipelineSegmentCost> const &segments,
+                               int num_stages,
+                               int num_micro_batches,
+                               PipelineSchedule schedule,
+                               size_t memory_capacity,
+                               std::vector<PipelineStage> &stages);
+
+/**
+ * @brief Simulate one iteration of a micro-batched pipeline.
+ *
+ * @param stage_forward Forward time of one micro-batch on each stage
+ * @param stage_backward Backward time of one micro-batch on each stage
+ * @param transfer_time Time to send one micro-batch's boundary tensor from
+ * stage i to stage i + 1; the gradient is sent back over a separate link
+ * @param training Whether backward passes are simulated
+ * @return float The simulated iteration time
+ */
+float simulate_pipeline_schedule(std::vector<float> const &stage_forward,
+                                 std::vector<float> const &stage_backward,
+                                 std::vector<float> const &transfer_time,
+                                 int num_micro_batches,
+                                 PipelineSchedule schedule,
+                                 bool training);
+
+/**
+ * @brief Find the best partition, micro-batch count and schedule for a fixed
+ * number of stages.
+ *
+ * @param transfer_bandwidth Bandwidth between consecutive stages in B/ms
+ */
+PipelinePlan plan_pipeline(std::vector<PipelineSegmentCost> const &segments,
+                           int num_stages,
+                           std::vector<int> const &micro_batch_candidates,
+                           std::vector<PipelineSchedule> const &schedules,
+                           float transfer_bandwidth,
+                           size_t memory_capacity,
+                           bool training);
+
+}; // namespace FlexFlow
+
+#endif // _FLEXFLOW_PIPELINE_H_
@@ -50,7 +50,8 @@ public:
   void register_model_weights_loader(FFModel *, FileDataLoader *);
   void load_inference_metadata_batch_config(FFModel *model,
                                             BatchConfigFuture const &bc,
-                                            FFHandler *handlers);
+                                            FFHandler *handlers,
+                                            int batch_index = 0);
 
 public:
   std::unordered_map<ParallelTensor, std::vector<ParallelTensor>> tensor_buffer;
@@ -120,6 +121,11 @@ public:
   void set_max_sequence_length(int max_seq_length);
   void push_spec_infer_tree_width(int tree_width);
   int get_max_sequence_length();
+  // Keeps the first sink_tokens tokens and the window_size most recent tokens
+  // of each request in the KV caches of incremental decoding; window_size 0
+  // keeps every token
+  void set_kv_cache_window(int window_size, int sink_tokens);
+  KVCacheWindow get_kv_cache_window();
   int register_ssm_model(FFModel *model);
   void register_tokenizer(ModelType model_type,
                           int bos_token_id,
@@ -155,13 +161,16 @@ public:
   // Methods to check and mark request completion
   bool is_request_completed(RequestGuid const &guid);
   void trigger_request_completion_future(RequestGuid const &guid);
-  // Methods for preparing next batches
+  // Methods for preparing next batches; replica is the data-parallel replica
+  // of the model that runs the batch
   BatchConfig prepare_next_batch(BatchConfig const &bc,
-                                 InferenceResult const &result);
+                                 InferenceResult const &result,
+                                 int replica = 0);
   BatchConfigFuture prepare_next_batch(BatchConfigFuture const &bc,
                                        InferenceResultFuture const &result,
                                        Legion::Context ctx,
-                                       Legion::Runtime *runtime);
+                                       Legion::Runtime *runtime,
+                                       int replica = 0);
   BeamSearchBatchConfig
       prepare_next_batch_beam(BeamSearchBatchConfig const &old_bc,
                               BeamInferenceResult const &result);
@@ -263,6 +272,7 @@ private:
   int max_tokens_per_batch;
   int max_spec_tree_token_num;
   int max_sequence_length;
+  KVCacheWindow kv_cache_window;
   Status request_manager_status;
 
   // tree width in each speculative step, if not specified 1
@@ -307,6 +317,18 @@ private:
   };
   std::unordered_map<RequestGuid, ProfileInfo> profiling_requests;
   double total_request_run_time;
+
+  // Load of each data-parallel replica as of its last prepared batch
+  struct ReplicaLoad {
+    int num_requests = 0;
+    int num_kv_tokens = 0; ///< Tokens of its requests in the KV cache
+  };
+  std::vector<ReplicaLoad> replica_loads;
+  /**
+   * @brief Pending requests go to the replica with the fewest tokens in its
+   * KV cache among those with a free request slot.
+   */
+  bool should_admit(int replica) const;
 };
 
 }; // namespace FlexFlow
@@ -0,0 +1,53 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _FLEXFLOW_ROTARY_EMBEDDING_H_
+#define _FLEXFLOW_ROTARY_EMBEDDING_H_
+
+#include <cstddef>
+
+namespace FlexFlow {
+
+/**
+ * @brief Number of floats in the rotary table of positions [0, num_positions)
+ * and heads of proj_size values.
+ */
+size_t rotary_table_size(int num_positions, int proj_size);
+
+/**
+ * @brief Fills the (cos, sin) pairs of the rotary position embeddings, so
+ * that the attention operators look them up instead of computing them for
+ * every token.
+ *
+ * @details Entry pos * (proj_size / 2) + i holds the cosine and the sine of
+ * pos * theta^(-2i / proj_size), computed in double precision. The pairs have
+ * the layout of cuFloatComplex and hipFloatComplex.
+ */
+void compute_rotary_table(int num_positions,
+                          int proj_size,
+                          float *table,
+                          double theta = 10000.0);
+
+/**
+ * @brief Rotates the pairs (head[i], head[i + proj_size / 2]) of a head at
+ * position pos, as the HuggingFace models do.
+ */
+void apply_rotary_table(float *head,
+                        int proj_size,
+                        int pos,
+                        float const *table);
+
+}; // namespace FlexFlow
+
+#endif // _FLEXFLOW_ROTARY_EMBEDDING_H_
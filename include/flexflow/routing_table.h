@@ -0,0 +1,75 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _FLEXFLOW_ROUTING_TABLE_H_
+#define _FLEXFLOW_ROUTING_TABLE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace FlexFlow {
+
+/**
+ * @brief All-pairs hop-count shortest paths of a network topology with every
+ * equal-cost next hop.
+ *
+ * @details The topology is a dense total_devs x total_devs connection matrix
+ * whose entries count the parallel links between two devices. build() runs
+ * one BFS per device over a sparse adjacency, then stores the next hops of
+ * every (src, dst) pair in a CSR, sorted by device id so that the result only
+ * depends on the topology. A next hop is weighted by the number of parallel
+ * links to it, which is how ECMP spreads flows over them.
+ */
+class EcmpRoutingTable {
+public:
+  static constexpr int UNREACHABLE = -1;
+
+  struct Path {
+    std::vector<int> nodes; ///< Devices from src to dst, both included
+    float weight;           ///< Share of the traffic taking this path
+  };
+
+  void build(std::vector<int> const &conn, int total_devs);
+  void clear();
+  bool is_built() const;
+  int num_devices() const;
+  /**
+   * @brief Number of links on a shortest path, UNREACHABLE if there is none.
+   */
+  int distance(int src, int dst) const;
+  int const *next_hops_begin(int src, int dst) const;
+  int const *next_hops_end(int src, int dst) const;
+  /**
+   * @brief Expand the next hops into end-to-end paths.
+   *
+   * @details Every device splits its share of the traffic over its next hops
+   * proportionally to their link counts. Paths are enumerated in
+   * lexicographic order; when there are more than max_paths of them, only the
+   * first max_paths are kept and their weights are renormalized.
+   */
+  std::vector<Path> paths(int src, int dst, size_t max_paths) const;
+
+private:
+  int total_devs = 0;
+  bool built = false;
+  std::vector<int> conn;
+  std::vector<int> dist;
+  std::vector<uint32_t> hop_offsets;
+  std::vector<int> hops;
+};
+
+}; // namespace FlexFlow
+
+#endif // _FLEXFLOW_ROUTING_TABLE_H_
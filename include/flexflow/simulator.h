@@ -17,12 +17,19 @@
 
 #include "config.h"
 #include "ffconst.h"
+#include "flexflow/collective_cost.h"
+#include "flexflow/cost_database.h"
+#include "flexflow/flow_network.h"
 #include "flexflow/operator_params.h"
+#include "flexflow/routing_table.h"
+#include "flexflow/simulator_core.h"
+#include "flexflow/task_thread_executor.h"
 #include "flexflow/utils/hash_utils.h"
 #include "mpark/variant.hpp"
 #include "parallel_tensor.h"
 #include <fstream>
 #include <memory>
+#include <mutex>
 #include <queue>
 #include <unordered_map>
 #include <unordered_set>
@@ -115,11 +122,14 @@ public:
   };
   CompDevType comp_type;
   size_t capacity;
+  // consumed by the analytical cost model
+  DeviceRoofline roofline;
   CompDevice(std::string const &name,
              CompDevType comp_type,
              int node_id,
              int socket_id,
-             int device_id);
+             int device_id,
+             DeviceRoofline const &roofline);
 };
 
 class MemDevice : public Device {
@@ -183,7 +193,7 @@ public:
                     int device_id,
                     int nnode,
                     NetworkRoutingStrategy *routing);
-  /* pick one of the weighted ECMP path */
+  /* the heaviest of the weighted ECMP paths */
   Route expand_to_physical() const;
   EcmpRoutes const &get_all_routes();
   void set_physical_paths(EcmpRoutes const &rs);
@@ -208,6 +218,11 @@ public:
    */
   virtual EcmpRoutes get_routes(int src_node, int dst_node) = 0;
   virtual std::vector<EcmpRoutes> get_routes_from_src(int src_node) = 0;
+  /**
+   * Called whenever the connection matrix changes, before any new route is
+   * requested
+   */
+  virtual void invalidate() {}
 };
 
 class MachineModel {
@@ -215,6 +230,7 @@ public:
   virtual ~MachineModel() = default;
   virtual int get_version() const = 0;
   virtual CompDevice *get_gpu(int device_id) const = 0;
+  virtual CompDevice *get_cpu(int device_id) const = 0;
   virtual MemDevice *get_gpu_fb_mem(int devicd_id) const = 0;
   virtual int get_num_gpus() const = 0;
   virtual float get_intra_node_gpu_bandwidth() const = 0;
@@ -233,6 +249,8 @@ public:
   ~SimpleMachineModel();
   int get_version() const;
   CompDevice *get_gpu(int device_id) const;
+  // CPUs are not modeled apart: every CPU is a single core with cpu_roofline
+  CompDevice *get_cpu(int device_id) const;
   MemDevice *get_gpu_fb_mem(int devicd_id) const;
   int get_num_gpus() const;
   float get_intra_node_gpu_bandwidth() const;
@@ -254,6 +272,9 @@ private:
   float inter_gpu_bandwidth;
   float inter_node_bandwidth;
   float gpu_dram_bandwidth;
+  DeviceRoofline gpu_roofline;
+  DeviceRoofline cpu_roofline;
+  CompDevice *cpu;
   std::map<int, CompDevice *> id_to_gpu;
   std::map<int, MemDevice *> id_to_gpu_fb_mem;
   std::map<int, CommDevice *> id_to_gputodram_comm_device;
@@ -327,6 +348,12 @@ private:
   float pci_bandwidth;
   float nvlink_latency;
   float nvlink_bandwidth;
+  // roofline parameters; zero if the configuration file does not give them
+  float gpu_peak_tflops = 0;
+  float gpu_half_peak_tflops = 0;
+  float gpu_mem_bandwidth = 0;
+  float cpu_peak_gflops = 0;
+  float cpu_mem_bandwidth = 0;
   size_t gpu_fb_mem_capacity;
   std::vector<CommDevice::CommDevType> intra_socket_sys_mem_to_sys_mem;
   std::vector<CommDevice::CommDevType> inter_socket_sys_mem_to_sys_mem;
@@ -415,6 +442,33 @@ public:
   int total_devs;
 };
 
+/**
+ * ECMP routing over a precomputed all-pairs routing table. Traffic is split
+ * over every shortest path by link count instead of taking a single random
+ * one, and the table is only rebuilt when the topology changes.
+ */
+class EcmpRoutingStrategy : public NetworkRoutingStrategy {
+public:
+  static constexpr size_t DEFAULT_MAX_PATHS = 64;
+  EcmpRoutingStrategy(ConnectionMatrix const &c,
+                      std::map<size_t, CommDevice *> const &devmap,
+                      int total_devs,
+                      size_t max_paths = DEFAULT_MAX_PATHS);
+  virtual EcmpRoutes get_routes(int src_node, int dst_node);
+  virtual std::vector<EcmpRoutes> get_routes_from_src(int src_node);
+  virtual void invalidate();
+  EcmpRoutingTable const &get_table();
+
+public:
+  ConnectionMatrix const &conn;
+  std::map<size_t, CommDevice *> const &devmap;
+  int total_devs;
+  size_t max_paths;
+
+private:
+  EcmpRoutingTable table;
+};
+
 /**
  * A (virtual base) class that generates network topology
  * Maybe this should be moved out of simulator
@@ -529,6 +583,8 @@ public:
   ~NetworkedMachineModel();
   int get_version() const;
   CompDevice *get_gpu(int device_id) const;
+  // CPUs are not modeled apart: every CPU is a single core with cpu_roofline
+  CompDevice *get_cpu(int device_id) const;
   MemDevice *get_gpu_fb_mem(int devicd_id) const;
   int get_num_gpus() const;
   int get_num_nodes() const {
@@ -576,6 +632,9 @@ public:
   float link_bandwidth;
   float network_latency;
   float gpu_dram_bandwidth;
+  DeviceRoofline gpu_roofline;
+  DeviceRoofline cpu_roofline;
+  CompDevice *cpu;
 
   bool pipelined;
   bool pcie_on;
@@ -645,6 +704,7 @@ public:
   bool store;
   std::string name;
   std::string get_type_str() const;
+  static std::string get_type_str(SimTaskType type);
 };
 
 class SimTaskCompare {
@@ -657,6 +717,7 @@ public:
 class TaskManager {
 public:
   TaskManager(size_t max_num_tasks);
+  ~TaskManager();
   void reset();
   SimTask *new_barrier_task();
   SimTask *new_update_task();
@@ -681,12 +742,17 @@ public:
 public:
   size_t global_task_id, max_num_tasks;
   SimTask **tasks;
+  // contiguous storage backing tasks
+  SimTask *task_pool;
 
   std::map<size_t, SimTask *> hash_to_forward_task, hash_to_backward_task;
 };
 
 using ProfilingRecordKey = std::tuple<OperatorParameters, MachineView>;
 
+class AnalyticalCostModel;
+class CostDatabase;
+
 class Simulator {
 public:
   static constexpr float MAXIMUM_TASK_RUN_TIME = 1e7;
@@ -697,8 +763,10 @@ public:
   ~Simulator(void);
   void free_all();
   void *allocate(size_t num_elements, DataType type);
-  void add_task_dependencies_with_xfer(SimTask *src_task,
-                                       SimTask *dst_task,
+  void add_task_dependencies_with_xfer(SimTaskId src_task,
+                                       int src_gpu,
+                                       SimTaskId dst_task,
+                                       int dst_gpu,
                                        size_t message_size,
                                        bool force_zero_cost = false);
   CostMetrics measure_operator_cost(Op const *op, ParallelConfig const &config);
@@ -717,6 +785,11 @@ public:
   float default_estimate_sync_cost(const ParallelTensor tensor,
                                    MachineView const &view,
                                    int num_replicate_dims);
+  std::vector<int> get_replica_group(ParallelTensorShape const &tensor_shape,
+                                     MachineView const &view,
+                                     int num_replicas) const;
+  CollectiveTopology
+      get_collective_topology(std::vector<int> const &gpus) const;
   float simulate_runtime(FFModel const *model,
                          std::map<Op const *, ParallelConfig> const &global,
                          CompMode comp_mode);
@@ -724,6 +797,7 @@ public:
                          std::map<Op const *, ParallelConfig> const &global,
                          CompMode comp_mode,
                          std::string const &export_file_name);
+  bool export_cost_database(std::string const &filename) const;
   static void
       strategy_search_task(Legion::Task const *task,
                            std::vector<Legion::PhysicalRegion> const &regions,
@@ -749,6 +823,22 @@ public:
   std::unordered_map<size_t, CostMetrics> hash_to_operator_cost;
   std::unordered_map<ProfilingRecordKey, CostMetrics>
       strict_hash_to_operator_cost;
+  EventDrivenSimulator event_simulator;
+  // Transfer paths between pairs of GPUs and the device indices of their comm
+  // devices, looked up once per pair in each simulate_runtime
+  std::vector<std::vector<SimLink>> link_paths;
+  std::vector<bool> link_path_ready;
+  std::unordered_map<CommDevice *, int> comm_device_indices;
+  CostModelType cost_model_type;
+  AnalyticalCostModel *analytical_cost_model;
+  // profiled costs, recorded when exporting or loaded for calibration
+  CostDatabase *cost_database;
+  // Guards the caches above, which the search threads share; costs are
+  // computed outside of it
+  std::mutex operator_cost_mutex;
+  // Kernels need the stream of a task thread, so the profiling cost model
+  // runs the measurements of search threads on the thread of the search task
+  TaskThreadExecutor task_thread_executor;
 
 public:
   Conv2DMeta *conv2d_meta;
@@ -768,6 +858,18 @@ public:
   int max_num_segments; // simulation could be slow if the number of segments
                         // are too large
 private:
+  /**
+   * @brief Sets up the analytical cost model and the cost database, shared by
+   * the CUDA and HIP constructors.
+   *
+   * @return True if the analytical cost model is used, in which case no
+   * kernels are run and the profiling state is left empty
+   */
+  bool init_cost_models(FFModel const *model);
+  std::vector<SimLink> const &get_link_path(int src_gpu, int dst_gpu);
+  void compute_operator_cost(Op const *op,
+                             MachineView const &view,
+                             CostMetrics &cost_metrics);
   float estimate_repartition_xfer_cost(
       int repartition_dim,
       int repartition_degree,
@@ -807,6 +909,7 @@ public:
                                    float start_time,
                                    std::map<Device *, float> &device_times,
                                    bool &finished);
+  void route_transfer_flow(SimTask *transfer_task, float start_time);
   virtual void expand_allreduce(
       SimTask *allreduce_task,
       float start_time,
@@ -822,6 +925,13 @@ public:
                       Legion::Runtime *runtime);
   bool segment_transfer;
   size_t segment_size;
+  // Share link bandwidth max-min fairly among concurrent transfers instead of
+  // serializing (segments of) transfers on each link. Not exposed in FFConfig
+  // since the graph search does not simulate whole task graphs
+  bool flow_level_network;
+  FlowNetwork flow_network;
+  std::unordered_map<CommDevice *, int> flow_link_ids;
+  std::vector<SimTask *> flow_tasks;
 
   // flatbuffers::FlatBufferBuilder builder;
 };
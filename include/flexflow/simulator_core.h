@@ -0,0 +1,167 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _FLEXFLOW_SIMULATOR_CORE_H_
+#define _FLEXFLOW_SIMULATOR_CORE_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace FlexFlow {
+
+using SimTaskId = uint32_t;
+
+/**
+ * @brief Interns task names so that tasks only carry a 32-bit id.
+ *
+ * @details Id 0 is reserved for the empty name. Names are kept across
+ * simulations since the same operators are simulated over and over during
+ * the search.
+ */
+class SimNameTable {
+public:
+  static constexpr uint32_t NO_NAME = 0;
+  SimNameTable();
+  uint32_t intern(std::string const &name);
+  std::string const &get(uint32_t id) const;
+  size_t size() const;
+
+private:
+  std::vector<std::string> names;
+  std::unordered_map<std::string, uint32_t> name_to_id;
+};
+
+/**
+ * @brief Structure-of-arrays storage of simulation tasks.
+ *
+ * @details Dependencies are staged as an edge list while the task graph is
+ * built and compacted into a CSR (edge_offsets/edge_targets) by finalize().
+ * reset() keeps the capacity of all arrays so that repeated simulations do not
+ * allocate.
+ */
+class SimTaskStore {
+public:
+  SimTaskId add_task(uint8_t type, int device, float run_time, uint32_t name);
+  void add_dependency(SimTaskId src, SimTaskId dst);
+  void finalize();
+  void reset();
+  size_t num_tasks() const;
+  size_t num_dependencies() const;
+  SimTaskId const *successors_begin(SimTaskId task) const;
+  SimTaskId const *successors_end(SimTaskId task) const;
+
+public:
+  std::vector<float> ready_time, run_time;
+  std::vector<uint8_t> type;
+  std::vector<int> device;
+  std::vector<uint32_t> name;
+  std::vector<int> counter;
+  std::vector<uint32_t> edge_offsets;
+  std::vector<SimTaskId> edge_targets;
+
+private:
+  std::vector<std::pair<SimTaskId, SimTaskId>> staged_edges;
+  std::vector<uint32_t> edge_cursor;
+  bool finalized = false;
+};
+
+/**
+ * @brief One hop of a transfer path, with the dense index of its device.
+ *
+ * @details A segment on an outbound link (NIC or UPI out) has to leave it
+ * before the previous hop takes the next segment, so that the inbound and
+ * outbound traffic of a node do not overlap.
+ */
+struct SimLink {
+  int device;
+  float latency;
+  float bandwidth;
+  bool outbound;
+};
+
+/**
+ * @brief Adds the comm tasks of a message from src to dst along path.
+ *
+ * @details The message is split into segments of segment_size bytes, at most
+ * max_num_segments of them, and every segment runs on each hop in turn. An
+ * empty path makes dst depend on src directly.
+ */
+void add_segmented_transfer(SimTaskStore &tasks,
+                            SimTaskId src,
+                            SimTaskId dst,
+                            std::vector<SimLink> const &path,
+                            size_t message_size,
+                            size_t segment_size,
+                            int max_num_segments,
+                            uint8_t comm_type,
+                            uint32_t name = SimNameTable::NO_NAME);
+
+/**
+ * @brief A monotone radix heap keyed by task ready times.
+ *
+ * @details The simulator never pushes an event earlier than the last one it
+ * popped, which lets non-negative float times be bucketed by the highest bit
+ * in which they differ from the last popped time. Push is O(1) and each
+ * element is moved at most 32 times over its lifetime.
+ */
+class SimEventQueue {
+public:
+  void push(float time, SimTaskId task);
+  std::pair<float, SimTaskId> pop();
+  bool empty() const;
+  size_t size() const;
+  void clear();
+
+private:
+  static uint32_t to_key(float time);
+  static float to_time(uint32_t key);
+  static int bucket_index(uint32_t key, uint32_t last);
+  std::array<std::vector<std::pair<uint32_t, SimTaskId>>, 33> buckets;
+  uint32_t last_key = 0;
+  size_t num_events = 0;
+};
+
+/**
+ * @brief List-scheduling simulation over a SimTaskStore.
+ *
+ * @details Tasks become ready once all of their predecessors finish and run
+ * in ready-time order, each device executing one task at a time. Devices are
+ * dense indices in [0, num_devices) that callers assign while building the
+ * task graph.
+ */
+class EventDrivenSimulator {
+public:
+  void reset();
+  float simulate(int num_devices, bool record_schedule = false);
+
+public:
+  SimNameTable names;
+  SimTaskStore tasks;
+  // filled by simulate() when record_schedule is true
+  std::vector<float> start_time, end_time;
+  std::vector<SimTaskId> schedule;
+
+private:
+  SimEventQueue queue;
+  std::vector<float> device_times;
+};
+
+}; // namespace FlexFlow
+
+#endif // _FLEXFLOW_SIMULATOR_CORE_H_
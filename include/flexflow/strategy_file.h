@@ -0,0 +1,141 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _FLEXFLOW_STRATEGY_FILE_H_
+#define _FLEXFLOW_STRATEGY_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace FlexFlow {
+
+/**
+ * @brief 64-bit FNV-1a. Unlike std::hash, its values do not depend on the
+ * build or the platform, so they can be stored in files.
+ */
+class StableHasher {
+public:
+  void update(void const *data, size_t size);
+  void update(std::string const &value);
+  // Hashes the contents of a file, or only its name if it cannot be read
+  void update_file(std::string const &filename);
+  template <typename T>
+  void update(T const &value) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "Only plain values can be hashed byte by byte");
+    update(&value, sizeof(T));
+  }
+  uint64_t digest() const;
+
+private:
+  uint64_t state = 0xcbf29ce484222325ULL;
+};
+
+/**
+ * @brief Identity of a layer that does not depend on the order in which the
+ * layers of a model were created.
+ */
+struct StrategyLayerKey {
+  int op_type;
+  uint64_t params_hash; ///< Data type, shapes and properties of the layer
+  std::string name;     ///< Without the "_<layer guid>" suffix
+  bool operator==(StrategyLayerKey const &other) const;
+};
+
+struct StrategyLayer {
+  StrategyLayerKey key;
+  // The serialized PCG refers to layers and input tensors by these guids
+  uint64_t layer_guid;
+  std::vector<uint64_t> output_guids;
+};
+
+/**
+ * @brief The result of the graph search for one model on one machine, so
+ * that later runs can skip the search.
+ *
+ * @details On disk: an 8-byte magic, the format version, the machine, the
+ * layers of the searched model, the serialized best PCG (with its
+ * substitutions applied) and its machine views, then a checksum of
+ * everything after the magic. Bump VERSION whenever this layout or the
+ * serialization of operators changes.
+ */
+struct StrategyFile {
+  static constexpr uint32_t VERSION = 1;
+  int num_nodes = 0;
+  int gpus_per_node = 0;
+  int cpus_per_node = 0;
+  int computation_mode = 0;
+  // Models created in one process are numbered, and the layer guids of the
+  // serialized PCG carry this number too; it is mapped like the guids
+  uint64_t model_id = 0;
+  std::vector<StrategyLayer> layers;
+  std::vector<char> pcg;
+};
+
+/**
+ * @brief Writes to a temporary file renamed to filename, so that concurrent
+ * readers never see a partial strategy.
+ */
+bool write_strategy_file(std::string const &filename,
+                         StrategyFile const &strategy);
+
+/**
+ * @return False, with the reason in error, if the file cannot be read, is
+ * corrupt, or has another version
+ */
+bool read_strategy_file(std::string const &filename,
+                        StrategyFile &strategy,
+                        std::string &error);
+
+/**
+ * @brief Translates the layer and tensor guids of a strategy to the ones of
+ * the model it is loaded into.
+ */
+struct StrategyGuidMap {
+  uint64_t model_id = 0;
+  std::unordered_map<uint64_t, uint64_t> layer_guids;
+  std::unordered_map<uint64_t, uint64_t> tensor_guids;
+};
+
+/**
+ * @brief Checks that a strategy was searched for the layers and the machine
+ * of model, whose pcg is ignored, and maps the guids of the strategy to the
+ * ones of model.
+ *
+ * @details Layers are matched by their StrategyLayerKey, so the check does
+ * not depend on the order in which the layers were created. Layers with the
+ * same key are matched by their guids if these are equal, or else in the
+ * order they were created in.
+ *
+ * @return An empty string if the strategy applies, or else the first
+ * difference found
+ */
+std::string validate_strategy(StrategyFile const &strategy,
+                              StrategyFile const &model,
+                              StrategyGuidMap &guid_map);
+
+/**
+ * @brief Where the search cache in cache_dir keeps the strategy for a
+ * fingerprint of the model, search options and machine.
+ */
+std::string get_cached_strategy_path(std::string const &cache_dir,
+                                     uint64_t fingerprint);
+
+}; // namespace FlexFlow
+
+#endif // _FLEXFLOW_STRATEGY_FILE_H_
@@ -18,6 +18,7 @@
 #include "flexflow/ffconst.h"
 #include "flexflow/graph.h"
 #include "flexflow/parallel_tensor.h"
+#include "flexflow/pipeline.h"
 #include "flexflow/substitution_loader.h"
 #include "flexflow/utils/recursive_logger.h"
 #include "tl/optional.hpp"
@@ -130,14 +131,15 @@ public:
 
 class GraphCompareWithMemory {
 public:
-  GraphCompareWithMemory(float factor) : run_time_cost_factor{factor} {}
+  GraphCompareWithMemory(MemoryOptimConfig const &config)
+      : mem_config{config} {}
   bool operator()(Graph *lhs, Graph *rhs) {
-    return lhs->optimal_cost_with_memory(run_time_cost_factor) >
-           rhs->optimal_cost_with_memory(run_time_cost_factor);
+    return lhs->optimal_cost_with_memory(mem_config) >
+           rhs->optimal_cost_with_memory(mem_config);
   }
 
 private:
-  float run_time_cost_factor;
+  MemoryOptimConfig mem_config;
 };
 
 class GraphXferMatch {
@@ -313,7 +315,7 @@ private:
       Node const &bottleneck,
       ParallelTensorShape const &bottleneck_output_shape);
 
-  void generate_all_pcg_xfers();
+  void generate_all_pcg_xfers(std::vector<GraphXfer *> &xfers) const;
   void load_graph_substitutions(std::vector<GraphXfer *> &xfers) const;
   Graph *construct_graph();
   void subgraph_optimize(Graph *subgraph);
@@ -322,6 +324,9 @@ private:
       base_optimize(Graph const *,
                     SimplificationSettings const &simplification_settings);
 
+  std::unique_ptr<Graph> parallel_base_optimize(
+      Graph const *, SimplificationSettings const &simplification_settings);
+
   std::unique_ptr<Graph> base_optimize_with_memory(
       Graph const *, SimplificationSettings const &simplification_settings);
 
@@ -333,6 +338,26 @@ private:
   tl::optional<Node> find_split_node(Graph const *graph,
                                      int base_optimize_threshold) const;
 
+  /**
+   * @brief One piece of the sequence split, optimized independently as in
+   * execute_sequence_split.
+   */
+  struct SequenceSegment {
+    std::unique_ptr<Graph> graph;
+    Node sink_node;
+    tl::optional<ParallelTensorShape> input_shape, output_shape;
+  };
+  void split_sequence(std::unique_ptr<Graph> graph,
+                      Node const &sink_node,
+                      tl::optional<ParallelTensorShape> const &input_shape,
+                      tl::optional<ParallelTensorShape> const &output_shape,
+                      std::vector<SequenceSegment> &segments) const;
+  bool pipeline_optimize(Graph const *graph,
+                         Node const &sink_node,
+                         size_t memory_capacity,
+                         PipelinePlan &plan,
+                         GraphOptimizeResult &result);
+
   template <typename T>
   tl::optional<T> try_get_cost_from_cache(size_t hash) const;
 
@@ -345,6 +370,9 @@ private:
 private:
   std::unordered_map<size_t, float> cached_optimized_graphs;
   std::vector<GraphXfer *> all_pcg_xfers;
+  // Each search thread matches its own copy of the xfers, which keep the
+  // state of the current match; index 0 is all_pcg_xfers
+  std::vector<std::vector<GraphXfer *>> thread_pcg_xfers;
   FFModel *model;
   FFConfig const &config;
   MemoryOptimConfig mem_config;
@@ -0,0 +1,61 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _FLEXFLOW_TASK_THREAD_EXECUTOR_H_
+#define _FLEXFLOW_TASK_THREAD_EXECUTOR_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace FlexFlow {
+
+/**
+ * @brief Runs work for helper threads on the thread of a Realm task.
+ *
+ * @details Kernels can only be launched from a Realm task thread, which has
+ * the CUDA stream of the task (see get_legion_stream). run() starts helper
+ * threads and, until all of them have returned, runs on the calling thread
+ * the work they pass to execute().
+ */
+class TaskThreadExecutor {
+public:
+  /**
+   * @brief Calls body(i) for i in [0, num_threads) on as many new threads
+   * and serves their execute() calls until they all return.
+   */
+  void run(int num_threads, std::function<void(int)> const &body);
+  /**
+   * @brief Runs work on the thread in run() and waits for it. Outside of
+   * run(), or from that thread, work is called directly.
+   */
+  void execute(std::function<void()> const &work);
+
+private:
+  struct Request {
+    std::function<void()> const *work;
+    bool done;
+  };
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool serving = false;
+  std::thread::id task_thread;
+  std::deque<Request *> requests;
+};
+
+}; // namespace FlexFlow
+
+#endif // _FLEXFLOW_TASK_THREAD_EXECUTOR_H_
@@ -178,4 +178,7 @@ ncclDataType_t ff_to_nccl_datatype(DataType type);
 
 cudaDataType_t cudnn_to_cuda_datatype(cudnnDataType_t type);
 cudnnDataType_t cuda_to_cudnn_datatype(cudaDataType_t type);
+
+// Name and compute capability of the first local GPU, or "" without GPUs
+std::string get_local_gpu_description();
 #endif
@@ -0,0 +1,219 @@
+#ifndef _FLEXFLOW_FLAT_HASH_MAP_H
+#define _FLEXFLOW_FLAT_HASH_MAP_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Open-addressing hash map with linear probing over a single array.
+ *
+ * @details Meant for small lookup tables on hot paths (e.g., the mapper):
+ * a lookup touches one contiguous run of slots instead of chasing tree or
+ * bucket pointers. Keys and values must be default constructible. Any
+ * insertion may move the entries, so pointers and iterators are only valid
+ * until the next insertion or erase.
+ */
+template <typename K, typename V, typename Hash = std::hash<K>>
+class FlatHashMap {
+public:
+  using value_type = std::pair<K, V>;
+
+  template <typename Map, typename Entry>
+  class Iterator {
+  public:
+    Iterator(Map *_map, size_t _idx) : map(_map), idx(_idx) {
+      skip_empty();
+    }
+    Entry &operator*() const {
+      return map->slots[idx];
+    }
+    Entry *operator->() const {
+      return &map->slots[idx];
+    }
+    Iterator &operator++() {
+      idx++;
+      skip_empty();
+      return *this;
+    }
+    bool operator==(Iterator const &other) const {
+      return idx == other.idx;
+    }
+    bool operator!=(Iterator const &other) const {
+      return idx != other.idx;
+    }
+
+  private:
+    void skip_empty() {
+      while (idx < map->used.size() && !map->used[idx]) {
+        idx++;
+      }
+    }
+    Map *map;
+    size_t idx;
+  };
+  using iterator = Iterator<FlatHashMap, value_type>;
+  using const_iterator = Iterator<FlatHashMap const, value_type const>;
+
+  iterator begin() {
+    return iterator(this, 0);
+  }
+  iterator end() {
+    return iterator(this, used.size());
+  }
+  const_iterator begin() const {
+    return const_iterator(this, 0);
+  }
+  const_iterator end() const {
+    return const_iterator(this, used.size());
+  }
+
+  size_t size() const {
+    return num_entries;
+  }
+  bool empty() const {
+    return num_entries == 0;
+  }
+  void clear() {
+    slots.clear();
+    used.clear();
+    num_entries = 0;
+  }
+  void reserve(size_t n) {
+    size_t capacity = MIN_CAPACITY;
+    while (capacity * MAX_LOAD_NUM < n * MAX_LOAD_DEN) {
+      capacity *= 2;
+    }
+    if (capacity > slots.size()) {
+      rehash(capacity);
+    }
+  }
+
+  iterator find(K const &key) {
+    return iterator(this, find_slot(key));
+  }
+  const_iterator find(K const &key) const {
+    return const_iterator(this, find_slot(key));
+  }
+  size_t count(K const &key) const {
+    return find_slot(key) != used.size() ? 1 : 0;
+  }
+  V &at(K const &key) {
+    size_t idx = find_slot(key);
+    assert(idx != used.size());
+    return slots[idx].second;
+  }
+  V const &at(K const &key) const {
+    size_t idx = find_slot(key);
+    assert(idx != used.size());
+    return slots[idx].second;
+  }
+  V &operator[](K const &key) {
+    return slots[insert_slot(key)].second;
+  }
+  std::pair<iterator, bool> insert(value_type const &entry) {
+    size_t old_size = num_entries;
+    size_t idx = insert_slot(entry.first);
+    bool inserted = num_entries != old_size;
+    if (inserted) {
+      slots[idx].second = entry.second;
+    }
+    return std::make_pair(iterator(this, idx), inserted);
+  }
+  size_t erase(K const &key) {
+    size_t idx = find_slot(key);
+    if (idx == used.size()) {
+      return 0;
+    }
+    // Backward shift deletion keeps every probe sequence gap-free
+    size_t mask = slots.size() - 1;
+    size_t hole = idx;
+    for (size_t next = (hole + 1) & mask; used[next];
+         next = (next + 1) & mask) {
+      size_t home = bucket(slots[next].first);
+      // Move the entry back unless its home lies in (hole, next]
+      if (((next - home) & mask) >= ((next - hole) & mask)) {
+        slots[hole] = std::move(slots[next]);
+        hole = next;
+      }
+    }
+    used[hole] = false;
+    slots[hole] = value_type();
+    num_entries--;
+    return 1;
+  }
+
+private:
+  static size_t const MIN_CAPACITY = 16;
+  // Grow past a 7/8 load factor
+  static size_t const MAX_LOAD_NUM = 7;
+  static size_t const MAX_LOAD_DEN = 8;
+
+  size_t bucket(K const &key) const {
+    // Fibonacci hashing spreads keys whose hashes only differ in the high
+    // bits (e.g., Legion handles) over the low bits used as the index
+    uint64_t h = static_cast<uint64_t>(hasher(key)) * 0x9E3779B97F4A7C15ULL;
+    return static_cast<size_t>(h >> 32) & (slots.size() - 1);
+  }
+
+  // Index of the slot holding key, or used.size() if it is absent
+  size_t find_slot(K const &key) const {
+    if (num_entries == 0) {
+      return used.size();
+    }
+    size_t mask = slots.size() - 1;
+    for (size_t idx = bucket(key); used[idx]; idx = (idx + 1) & mask) {
+      if (slots[idx].first == key) {
+        return idx;
+      }
+    }
+    return used.size();
+  }
+
+  // Index of the slot holding key, default-constructing its value if absent
+  size_t insert_slot(K const &key) {
+    size_t idx = find_slot(key);
+    if (idx != used.size()) {
+      return idx;
+    }
+    if ((num_entries + 1) * MAX_LOAD_DEN > slots.size() * MAX_LOAD_NUM) {
+      rehash(slots.empty() ? MIN_CAPACITY : 2 * slots.size());
+    }
+    size_t mask = slots.size() - 1;
+    for (idx = bucket(key); used[idx]; idx = (idx + 1) & mask) {
+    }
+    used[idx] = true;
+    slots[idx].first = key;
+    num_entries++;
+    return idx;
+  }
+
+  void rehash(size_t capacity) {
+    assert((capacity & (capacity - 1)) == 0);
+    std::vector<value_type> old_slots(capacity);
+    std::vector<bool> old_used(capacity, false);
+    old_slots.swap(slots);
+    old_used.swap(used);
+    size_t mask = capacity - 1;
+    for (size_t i = 0; i < old_slots.size(); i++) {
+      if (old_used[i]) {
+        size_t idx = bucket(old_slots[i].first);
+        while (used[idx]) {
+          idx = (idx + 1) & mask;
+        }
+        used[idx] = true;
+        slots[idx] = std::move(old_slots[i]);
+      }
+    }
+  }
+
+  std::vector<value_type> slots;
+  std::vector<bool> used;
+  size_t num_entries = 0;
+  Hash hasher;
+};
+
+#endif // _FLEXFLOW_FLAT_HASH_MAP_H
@@ -163,4 +163,7 @@ ncclDataType_t ff_to_nccl_datatype(DataType type);
 #endif
 
 void handle_unimplemented_hip_kernel(OperatorType op_type);
+
+// Name and architecture of the first local GPU, or "" without GPUs
+std::string get_local_gpu_description();
 #endif
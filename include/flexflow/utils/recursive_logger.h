@@ -2,6 +2,7 @@
 #define _FLEXFLOW_RECURSIVE_LOGGER_H
 
 #include "legion/legion_utilities.h"
+#include <atomic>
 #include <memory>
 
 #define CONCAT(a, b) CONCAT_INNER(a, b)
@@ -38,7 +39,8 @@ public:
   std::unique_ptr<DepthTag> enter_tag();
 
 private:
-  int depth = 0;
+  // Shared by the search threads, so only approximate while they run
+  std::atomic<int> depth{0};
 
   void print_prefix(Realm::LoggerMessage &) const;
 
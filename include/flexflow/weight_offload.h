@@ -0,0 +1,175 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _FLEXFLOW_WEIGHT_OFFLOAD_H_
+#define _FLEXFLOW_WEIGHT_OFFLOAD_H_
+
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace FlexFlow {
+
+/**
+ * @brief An offloaded layer as seen by the prefetch pipeline, in the order
+ * in which the layers run.
+ */
+struct OffloadLayer {
+  size_t bytes;       ///< Bytes staged on the device
+  float copy_time;    ///< ms to copy the weights from the host
+  float compute_time; ///< ms from the layer's start to the next layer's
+};
+
+struct WeightOffloadPlan {
+  int prefetch_depth = 0; ///< Layers loaded ahead of the one computing
+  int num_slots = 1;      ///< prefetch_depth + 1, at most one per layer
+  size_t slot_bytes = 0;  ///< Every slot holds the largest layer
+  float step_time = 0.0f; ///< Simulated ms per pass over the layers
+  float sync_step_time = 0.0f; ///< Simulated ms without prefetching
+};
+
+/**
+ * @brief Simulated steady-state time of one pass over layers when their
+ * weights go through a ring of num_slots slots.
+ *
+ * @details One copy engine and one compute stream. The weights of layer
+ * i + num_slots are copied to the slot of layer i once layer i is done, and a
+ * layer starts once its weights and the previous layer are. With a slot per
+ * layer, the weights stay resident and only the compute is left.
+ */
+float simulate_weight_offload(std::vector<OffloadLayer> const &layers,
+                              int num_slots);
+
+/**
+ * @brief Sizes the ring and picks the prefetch depth: the shallowest depth
+ * within 1% of the fastest one that fits in ring_bytes, or
+ * requested_depth (clamped to what fits) if it is not negative.
+ */
+WeightOffloadPlan plan_weight_offload(std::vector<OffloadLayer> const &layers,
+                                      size_t ring_bytes,
+                                      int requested_depth,
+                                      size_t alignment = 256);
+
+/**
+ * @brief Copies weights from the host to device slots behind the compute
+ * streams of the offloaded layers.
+ *
+ * @details Slots only index the synchronization state; the destinations are
+ * explicit. Streams are those of the calling tasks (e.g., a cudaStream_t).
+ */
+class WeightCopyQueue {
+public:
+  virtual ~WeightCopyQueue() = default;
+  virtual void resize(int num_slots) = 0;
+  /// Copies src to dst once every stream is done with what it released
+  virtual void copy(int slot, void *dst, void const *src, size_t bytes) = 0;
+  /// Work issued next on stream waits for the last copy to slot
+  virtual void wait(int slot, void *stream) = 0;
+  /// The work issued so far on stream no longer reads slot
+  virtual void release(int slot, void *stream) = 0;
+  /// ms taken by the last copy to slot; blocks until it is done
+  virtual float copy_time(int slot) = 0;
+  /// ms on the stream from the end of the wait on from_slot to the start of
+  /// the wait on to_slot; blocks until the latter
+  virtual float compute_time(int from_slot, int to_slot) = 0;
+};
+
+/**
+ * @brief Copies between host buffers as soon as asked, for offloading to a
+ * reserve space in system memory and for testing the engine without a GPU.
+ */
+class HostWeightCopyQueue : public WeightCopyQueue {
+public:
+  void resize(int num_slots) override;
+  void copy(int slot, void *dst, void const *src, size_t bytes) override;
+  void wait(int slot, void *stream) override;
+  void release(int slot, void *stream) override;
+  float copy_time(int slot) override;
+  float compute_time(int from_slot, int to_slot) override;
+
+private:
+  std::vector<float> copy_times;
+  std::vector<double> wait_times;
+};
+
+/**
+ * @brief Copies on a dedicated CUDA stream, synchronized with the compute
+ * streams through events. Defined in CUDA builds only.
+ */
+WeightCopyQueue *create_cuda_weight_copy_queue();
+
+/**
+ * @brief Stages the weights of offloaded layers in a ring of slots of the
+ * offload reserve space, and loads the weights of upcoming layers while the
+ * current one computes.
+ *
+ * @details The reserve space starts with the scratch space of the offloaded
+ * operators, and the ring takes the rest. Layers are told apart by the host
+ * address of their weights and are expected to run in the same order at
+ * every step. The first calibration_steps steps copy every layer right
+ * before it runs, through a single slot, and measure the copy and compute
+ * times; plan_weight_offload then sizes the ring. Afterwards, releasing
+ * layer i loads layer i + num_slots into its slot. Layers that run out of
+ * order, or are new, are copied synchronously, and new layers or more
+ * scratch space restart the calibration.
+ */
+class WeightOffloadEngine {
+public:
+  static int const calibration_steps = 2;
+
+  WeightOffloadEngine(void *reserve_space,
+                      size_t reserve_space_size,
+                      WeightCopyQueue *queue,
+                      int requested_depth);
+  /// The first bytes of the reserve space are scratch space of an operator
+  void reserve_scratch(size_t bytes);
+  /// Device copy of weight, ready for the work issued next on stream
+  void *acquire(void const *weight, size_t bytes, void *stream);
+  /// The work issued so far on stream is done with the copy of weight
+  void release(void const *weight, void *stream);
+
+  bool is_calibrating() const;
+  WeightOffloadPlan const &get_plan() const;
+  size_t get_num_copies() const;     ///< Copies issued by acquire
+  size_t get_num_prefetches() const; ///< Copies issued by release
+
+private:
+  struct Layer {
+    void const *weight;
+    size_t bytes;
+    float copy_time, compute_time;
+    int slot; ///< Slot holding (or loading) the weights, or -1
+  };
+  void restart_calibration();
+  void finish_calibration();
+  char *slot_ptr(int slot) const;
+  void load(int layer, int slot);
+
+  char *reserve_space;
+  size_t reserve_space_size, ring_offset;
+  std::unique_ptr<WeightCopyQueue> queue;
+  int requested_depth;
+  bool calibrating;
+  int calibrated_steps, last_layer, last_slot;
+  std::vector<Layer> layers;
+  std::unordered_map<void const *, int> layer_index;
+  std::vector<int> slot_owner, slot_pins;
+  WeightOffloadPlan plan;
+  size_t num_copies, num_prefetches;
+};
+
+}; // namespace FlexFlow
+
+#endif // _FLEXFLOW_WEIGHT_OFFLOAD_H_
@@ -43,6 +43,7 @@ ff_arg_to_sysarg = {
     "profiling": "--profiling",
     "inference_debugging": "--inference-debugging",
     "fusion": "--fusion",
+    "fusion_report_file": "--fusion-report",
     "disable_control_replication": "--disable-control-replication",
     # Training args
     "epochs": "--epochs",
@@ -60,6 +61,8 @@ ff_arg_to_sysarg = {
     "import_strategy": "--import-strategy",
     "export": "--export",
     "export_strategy": "--export-strategy",
+    "search_cache_dir": "--search-cache",
+    "search_threads": "--search-threads",
     "only_data_parallel": "--only-data-parallel",
     "enable_parameter_parallel": "--enable-parameter-parallel",
     "enable_attribute_parallel": "--enable-attribute-parallel",
@@ -77,17 +80,24 @@ ff_arg_to_sysarg = {
     "search_num_nodes": "--search-num-nodes",
     "search_num_workers": "--search-num-workers",
     "base_optimize_threshold": "--base-optimize-threshold",
+    "pipeline_stages": "--pipeline-stages",
+    "pipeline_micro_batches": "--pipeline-micro-batches",
+    "pipeline_schedule": "--pipeline-schedule",
     "python_data_loader_type": "--python-data-loader-type",
     "substitution_json_path": "--substitution-json",
     "perform_memory_search": "--memory-search",
+    "memory_search_algo": "--memory-search-algo",
     # Inference args
     "data_parallelism_degree": "-data-parallelism-degree",
     "tensor_parallelism_degree": "-tensor-parallelism-degree",
     "pipeline_parallelism_degree": "-pipeline-parallelism-degree",
     "offload": "-offload",
     "offload_reserve_space_size": "-offload-reserve-space-size",
+    "offload_prefetch_depth": "-offload-prefetch-depth",
     "use_4bit_quantization": "--4bit-quantization",
-    "use_8bit_quantization": "--8bit-quantization"
+    "use_8bit_quantization": "--8bit-quantization",
+    "quantization_group_size": "--quantization-group-size",
+    "use_8bit_kv_cache": "--8bit-kv-cache"
 }
 
 
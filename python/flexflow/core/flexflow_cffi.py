@@ -4208,6 +4208,10 @@ class RequestManager(object):
         return ffc().flexflow_request_manager_set_max_sequence_length(
             self.handle, max_length)
 
+    def set_kv_cache_window(self, window_size, sink_tokens):
+        return ffc().flexflow_request_manager_set_kv_cache_window(
+            self.handle, window_size, sink_tokens)
+
     def start_server(self, model):
         return ffc().flexflow_request_manager_start_background_server(
             self.handle, model.handle
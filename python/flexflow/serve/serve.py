@@ -301,6 +301,8 @@ class LLM:
         model_specific_tensor_parallelism_degree: int = None,
         model_specific_pipeline_parallelism_degree: int = None,
         ssms: list = [],
+        kv_cache_window: int = 0,
+        kv_cache_sink_tokens: int = 4,
     ):
         """Compile the LLM for inference and load the weights into memory
 
@@ -320,6 +322,10 @@ class LLM:
         :type model_specific_pipeline_parallelism_degree: int, optional
         :param ssms: The SSMs to use when operating in speculative inference mode, defaults to []
         :type ssms: list, optional
+        :param kv_cache_window: Keep only the KV cache of the most recent kv_cache_window tokens of each request, plus its first kv_cache_sink_tokens tokens, in incremental decoding; 0 keeps every token, defaults to 0
+        :type kv_cache_window: int, optional
+        :param kv_cache_sink_tokens: The number of initial tokens kept with a KV cache window, defaults to 4
+        :type kv_cache_sink_tokens: int, optional
         """
         # self.max_requests_per_batch = max_requests_per_batch
         # self.max_seq_length = max_seq_length
@@ -355,6 +361,7 @@ class LLM:
         self.rm.set_max_requests_per_batch(max_requests_per_batch)
         self.rm.set_max_tokens_per_batch(max_tokens_per_batch)
         self.rm.set_max_sequence_length(max_seq_length)
+        self.rm.set_kv_cache_window(kv_cache_window, kv_cache_sink_tokens)
 
         # Instantiate the relevant model
         self.model = self.model_class(
@@ -2597,6 +2597,15 @@ void flexflow_request_manager_set_max_sequence_length(
   DEBUG_PRINT("[RequestManager] set max_sequence_length %d", max_seq_length);
 }
 
+void flexflow_request_manager_set_kv_cache_window(
+    flexflow_request_manager_t handle_, int window_size, int sink_tokens) {
+  RequestManager *handle = FFCObjectWrapper::unwrap(handle_);
+  handle->set_kv_cache_window(window_size, sink_tokens);
+  DEBUG_PRINT("[RequestManager] set kv cache window %d, sink tokens %d",
+              window_size,
+              sink_tokens);
+}
+
 void flexflow_request_manager_register_tokenizer(
     flexflow_request_manager_t handle_,
     enum ModelType model_type,
@@ -22,6 +22,42 @@ using namespace Mapping;
 
 LegionRuntime::Logger::Category log_ff_mapper("Mapper");
 
+// The decision caches are dropped when they grow past this many entries
+static size_t const MAX_MAPPER_CACHE_ENTRIES = 1 << 16;
+// How often (in map_task calls) a mapper looks for idle instances
+static unsigned long long const INSTANCE_GC_INTERVAL = 256;
+
+bool SliceCacheKey::operator==(SliceCacheKey const &other) const {
+  return task_id == other.task_id && tag == other.tag &&
+         domain == other.domain;
+}
+
+size_t SliceCacheKeyHash::operator()(SliceCacheKey const &key) const {
+  size_t result = 0;
+  hash_combine(result, key.task_id);
+  hash_combine(result, key.tag);
+  hash_combine(result, key.domain.get_dim());
+  for (int i = 0; i < key.domain.get_dim(); i++) {
+    hash_combine(result, key.domain.lo()[i]);
+    hash_combine(result, key.domain.hi()[i]);
+  }
+  return result;
+}
+
+bool MapCacheKey::operator==(MapCacheKey const &other) const {
+  return task_id == other.task_id && target_proc == other.target_proc &&
+         region_hash == other.region_hash && numa_socket == other.numa_socket;
+}
+
+size_t MapCacheKeyHash::operator()(MapCacheKey const &key) const {
+  size_t result = 0;
+  hash_combine(result, key.task_id);
+  hash_combine(result, key.target_proc.id);
+  hash_combine(result, key.region_hash);
+  hash_combine(result, key.numa_socket);
+  return result;
+}
+
 FFShardingFunctor::FFShardingFunctor(int _gpus_per_node,
                                      int _cpus_per_node,
                                      int _num_nodes,
@@ -63,11 +99,17 @@ FFMapper::FFMapper(MapperRuntime *rt,
                    char const *_mapper_name,
                    // const std::string& strategyFile,
                    bool _enable_control_replication,
-                   bool _log_instance_creation)
+                   bool _log_instance_creation,
+                   bool _enable_mapper_cache,
+                   unsigned long long _instance_gc_idle,
+                   char const *_memory_usage_report)
     : NullMapper(rt, machine), local_processor(_local),
       node_id(_local.address_space()), mapper_name(_mapper_name),
       enable_control_replication(_enable_control_replication),
-      log_instance_creation(_log_instance_creation) {
+      log_instance_creation(_log_instance_creation),
+      enable_mapper_cache(_enable_mapper_cache),
+      instance_gc_idle(_instance_gc_idle),
+      memory_usage_report(_memory_usage_report) {
   std::vector<Machine::ProcessorMemoryAffinity> proc_mem_affinities;
   machine.get_proc_mem_affinity(proc_mem_affinities);
   Machine::ProcessorQuery proc_query(machine);
@@ -114,6 +156,7 @@ FFMapper::FFMapper(MapperRuntime *rt,
     }
   }
   total_nodes = address_space_set.size();
+  init_numa_sockets(proc_mem_affinities);
   if (enable_control_replication) {
     log_ff_mapper.print("Enabled Control Replication Optimizations.");
   }
@@ -262,7 +305,6 @@ Mapper::MapperSyncModel FFMapper::get_mapper_sync_model(void) const {
 void FFMapper::select_task_options(const MapperContext ctx,
                                    Task const &task,
                                    TaskOptions &output) {
-  unsigned long long task_hash = compute_task_hash(task);
   output.inline_task = false;
   output.stealable = false;
   output.map_locally = true;
@@ -272,7 +314,7 @@ void FFMapper::select_task_options(const MapperContext ctx,
     return;
   }
   if (task.task_id == GRAPH_OPTIMIZE_TASK_ID) {
-    output.initial_proc = all_gpus[0];
+    output.initial_proc = all_gpus.empty() ? all_cpus[0] : all_gpus[0];
     return;
   }
   if (task.task_id == NCCL_GETUNIQUEID_TASK_ID) {
@@ -280,7 +322,7 @@ void FFMapper::select_task_options(const MapperContext ctx,
     return;
   }
   if (task.task_id == UPDATE_METRICS_TASK_ID) {
-    output.initial_proc = all_cpus[0];
+    output.initial_proc = default_cpu();
     return;
   }
   if ((task.task_id == RM_PREPARE_NEXT_BATCH_TASK_ID) ||
@@ -288,7 +330,7 @@ void FFMapper::select_task_options(const MapperContext ctx,
       (task.task_id == RM_PREPARE_NEXT_BATCH_BEAM_TASK_ID) ||
       (task.task_id == RM_PREPARE_NEXT_BATCH_VERIFY_TASK_ID) ||
       (task.task_id == RM_BACKGROUND_SERVING_TASK_ID)) {
-    output.initial_proc = all_cpus[0];
+    output.initial_proc = default_cpu();
     return;
   }
   if (task.task_id == TOP_LEVEL_TASK_ID) {
@@ -308,6 +350,7 @@ void FFMapper::select_task_options(const MapperContext ctx,
   if (is_parameter_server_update_task(task.task_id) ||
       is_initializer_task(task.task_id)) {
     // For Parameter Server Update, pick a processor from config
+    unsigned long long task_hash = compute_task_hash(task);
     MappingTagID hash = task.tag;
     MachineView view;
     if (machine_views.find(hash) != machine_views.end()) {
@@ -326,8 +369,9 @@ void FFMapper::select_task_options(const MapperContext ctx,
         return;
       }
     }
-    if (cache_update_tasks.find(task_hash) != cache_update_tasks.end()) {
-      output.initial_proc = cache_update_tasks[task_hash];
+    auto cached = cache_update_tasks.find(task_hash);
+    if (cached != cache_update_tasks.end()) {
+      output.initial_proc = cached->second;
       assert(output.initial_proc.address_space() == node_id);
       return;
     }
@@ -340,7 +384,7 @@ void FFMapper::select_task_options(const MapperContext ctx,
   if ((task.task_id >= CUSTOM_CPU_TASK_ID_FIRST) &&
       (task.task_id <= CUSTOM_CPU_TASK_ID_LAST)) {
     if (!task.is_index_space) {
-      output.initial_proc = all_cpus[0];
+      output.initial_proc = default_cpu();
       return;
     }
   }
@@ -352,13 +396,13 @@ void FFMapper::select_task_options(const MapperContext ctx,
       (task.task_id == PY_DL_INT32_INDEX_LOAD_ENTIRE_CPU_TASK_ID) ||
       (task.task_id == PY_DL_INT64_INDEX_LOAD_ENTIRE_CPU_TASK_ID)) {
     if (!task.is_index_space) {
-      output.initial_proc = all_cpus[0];
+      output.initial_proc = default_cpu();
       return;
     }
   }
 
   if (task.task_id == TENSOR_EQUAL_TASK_ID) {
-    output.initial_proc = all_cpus[0];
+    output.initial_proc = default_cpu();
     return;
   }
 
@@ -378,6 +422,18 @@ void FFMapper::slice_task(const MapperContext ctx,
                           Task const &task,
                           SliceTaskInput const &input,
                           SliceTaskOutput &output) {
+  // Replay the slices of a previous launch of the same task over the same
+  // domain with the same machine view
+  bool cacheable = enable_mapper_cache && input.domain.dense() &&
+                   input.domain == task.index_domain;
+  SliceCacheKey slice_key{task.task_id, task.tag, input.domain};
+  if (cacheable) {
+    auto cached = slice_cache.find(slice_key);
+    if (cached != slice_cache.end()) {
+      output.slices = cached->second;
+      return;
+    }
+  }
   output.slices.resize(input.domain.get_volume());
   std::vector<Processor> const *devices;
   MachineView view;
@@ -404,7 +460,8 @@ void FFMapper::slice_task(const MapperContext ctx,
     assert(machine_views.find(FFConfig::DataParallelism_GPU) !=
            machine_views.end());
     view = machine_views[FFConfig::DataParallelism_GPU];
-    devices = &all_cpus;
+    // Each GPU is fed by a CPU on its own socket when the sockets are known
+    devices = numa_sockets.empty() ? &all_cpus : &gpu_worker_cpus;
   } else {
     MappingTagID hash = task.tag;
     // Make sure the task has a non-zero tag
@@ -478,6 +535,12 @@ void FFMapper::slice_task(const MapperContext ctx,
       assert(output.slices[i].proc.address_space() == node_id);
     }
   }
+  if (cacheable) {
+    if (slice_cache.size() >= MAX_MAPPER_CACHE_ENTRIES) {
+      slice_cache.clear();
+    }
+    slice_cache[slice_key] = output.slices;
+  }
 }
 
 void FFMapper::premap_task(const MapperContext ctx,
@@ -491,6 +554,34 @@ void FFMapper::map_task(const MapperContext ctx,
                         Task const &task,
                         MapTaskInput const &input,
                         MapTaskOutput &output) {
+  num_map_calls++;
+  if (instance_gc_idle > 0 && num_map_calls % INSTANCE_GC_INTERVAL == 0) {
+    release_idle_instances(ctx, Memory::NO_MEMORY, instance_gc_idle);
+  }
+  // Must epoch launches and premapped regions are rare enough to always
+  // go through the full mapping
+  bool cacheable = enable_mapper_cache && !task.must_epoch_task &&
+                   input.premapped_regions.empty();
+  // On NUMA hosts, a local CPU task stays on the socket that holds most of
+  // its data, or else on the socket of the target processor. The socket
+  // follows where the data is, so it is part of the cache key
+  int numa_socket = -1;
+  if (!numa_sockets.empty() && task.target_proc.address_space() == node_id &&
+      task.target_proc.kind() == Processor::LOC_PROC &&
+      !task.must_epoch_task) {
+    numa_socket = select_numa_socket(input);
+    if (numa_socket < 0) {
+      numa_socket = get_numa_socket(task.target_proc);
+    }
+  }
+  MapCacheKey map_key;
+  if (cacheable) {
+    map_key = {
+        task.task_id, task.target_proc, compute_region_hash(task), numa_socket};
+    if (replay_task_mapping(ctx, task, map_key, output)) {
+      return;
+    }
+  }
   std::vector<VariantID> variant_ids;
   runtime->find_valid_variants(
       ctx, task.task_id, variant_ids, task.target_proc.kind());
@@ -512,8 +603,12 @@ void FFMapper::map_task(const MapperContext ctx,
     // If we're part of a must epoch launch, our
     // target proc will be sufficient
     if (!task.must_epoch_task) {
-      output.target_procs.insert(
-          output.target_procs.end(), local_cpus.begin(), local_cpus.end());
+      if (numa_socket >= 0 && !numa_sockets[numa_socket].cpus.empty()) {
+        output.target_procs = numa_sockets[numa_socket].cpus;
+      } else {
+        output.target_procs.insert(
+            output.target_procs.end(), local_cpus.begin(), local_cpus.end());
+      }
     } else {
       output.target_procs.push_back(task.target_proc);
     }
@@ -570,9 +665,9 @@ void FFMapper::map_task(const MapperContext ctx,
         missing_fields[idx].empty()) {
       continue;
     }
-    // Select a memory for the req
-    Memory target_mem =
-        default_select_target_memory(ctx, task.target_proc, task.regions[idx]);
+    // Select a memory for the req, near the processors we picked
+    Memory target_mem = default_select_target_memory(
+        ctx, output.target_procs[0], task.regions[idx]);
     // Assert no virtual mapping for now
     assert((task.regions[idx].tag & DefaultMapper::VIRTUAL_MAP) == 0);
     // Check to see if any of the valid instances satisfy the requirement
@@ -624,6 +719,7 @@ void FFMapper::map_task(const MapperContext ctx,
                                task.regions[idx],
                                created,
                                &footprint)) {
+      log_memory_usage();
       if (log_instance_creation) {
         for (size_t idx = 0; idx < created_instances.size(); idx++) {
           log_ff_mapper.print("Instance[%zu]: memory:" IDFMT "	proc:" IDFMT
@@ -651,16 +747,66 @@ void FFMapper::map_task(const MapperContext ctx,
     } else {
       output.chosen_instances[idx].push_back(result);
     }
-    if (log_instance_creation && created) {
+    if (created) {
       // Log instance creation
       InstanceCreationLog clog;
       clog.task_name = task.get_task_name();
       clog.size = footprint;
       clog.memory = target_mem;
       clog.processor = task.target_proc;
-      created_instances.push_back(clog);
+      if (log_instance_creation) {
+        created_instances.push_back(clog);
+      }
+      track_instance(result, clog);
     }
   } // for idx
+  touch_instances(ctx, output.chosen_instances);
+  if (cacheable) {
+    if (map_cache.size() >= MAX_MAPPER_CACHE_ENTRIES) {
+      map_cache.clear();
+    }
+    CachedTaskMapping &cached = map_cache[map_key];
+    cached.chosen_variant = output.chosen_variant;
+    cached.target_procs = output.target_procs;
+    cached.chosen_instances = output.chosen_instances;
+    cached.regions.clear();
+    for (RegionRequirement const &req : task.regions) {
+      cached.regions.push_back(req.region);
+    }
+  }
+}
+
+bool FFMapper::replay_task_mapping(const MapperContext ctx,
+                                   Task const &task,
+                                   MapCacheKey const &key,
+                                   MapTaskOutput &output) {
+  auto cached = map_cache.find(key);
+  if (cached == map_cache.end() ||
+      cached->second.regions.size() != task.regions.size()) {
+    return false;
+  }
+  CachedTaskMapping const &mapping = cached->second;
+  for (size_t i = 0; i < task.regions.size(); i++) {
+    if (mapping.regions[i] != task.regions[i].region) {
+      return false;
+    }
+  }
+  output.chosen_variant = mapping.chosen_variant;
+  output.task_priority = 0;
+  output.postmap_task = false;
+  output.target_procs = mapping.target_procs;
+  output.chosen_instances = mapping.chosen_instances;
+  // The instances may have been collected since they were chosen, in which
+  // case we map the task from scratch
+  if (runtime->acquire_and_filter_instances(ctx, output.chosen_instances)) {
+    touch_instances(ctx, output.chosen_instances);
+    return true;
+  }
+  output.target_procs.clear();
+  for (std::vector<PhysicalInstance> &instances : output.chosen_instances) {
+    instances.clear();
+  }
+  return false;
 }
 
 void FFMapper::replicate_task(const MapperContext ctx,
@@ -928,6 +1074,7 @@ void FFMapper::map_inline(const MapperContext ctx,
                              inline_op.requirement,
                              created,
                              &footprint)) {
+    log_memory_usage();
     log_ff_mapper.error(
         "FlexFlow Mapper failed allocation of size %zd bytes"
         " for region requirement of inline mapping in task %s (UID %lld)"
@@ -942,6 +1089,14 @@ void FFMapper::map_inline(const MapperContext ctx,
   } else {
     output.chosen_instances.push_back(result);
   }
+  if (created) {
+    InstanceCreationLog clog;
+    clog.task_name = inline_op.parent_task->get_task_name();
+    clog.size = footprint;
+    clog.memory = target_memory;
+    clog.processor = inline_op.parent_task->current_proc;
+    track_instance(result, clog);
+  }
 }
 
 void FFMapper::select_inline_sources(const MapperContext ctx,
@@ -1274,6 +1429,15 @@ void FFMapper::permit_steal_request(const MapperContext ctx,
   return result;
 }
 
+unsigned long long FFMapper::compute_region_hash(Task const &task) {
+  // The memory of an instance also depends on the tag of its requirement
+  unsigned long long result = compute_task_hash(task);
+  for (RegionRequirement const &req : task.regions) {
+    result = result * 0x5491C27F12DB3FA5 + 353435097 + req.tag;
+  }
+  return result;
+}
+
 std::vector<Processor> const &
     FFMapper::all_procs_by_kind(Processor::Kind kind) {
   switch (kind) {
@@ -1289,6 +1453,250 @@ std::vector<Processor> const &
   return all_cpus;
 }
 
+void FFMapper::init_numa_sockets(
+    std::vector<Machine::ProcessorMemoryAffinity> const &affinities) {
+  // Every local processor belongs to the socket memory it has the best
+  // affinity to
+  FlatHashMap<Processor, Machine::ProcessorMemoryAffinity, ProcessorHash>
+      best;
+  for (Machine::ProcessorMemoryAffinity const &a : affinities) {
+    if (a.m.kind() != Memory::SOCKET_MEM || a.p.address_space() != node_id) {
+      continue;
+    }
+    auto finder = best.find(a.p);
+    if (finder == best.end() || a.bandwidth > finder->second.bandwidth) {
+      best[a.p] = a;
+    }
+  }
+  auto socket_of = [&](Memory m) {
+    auto finder = mem_numa_sockets.find(m);
+    if (finder != mem_numa_sockets.end()) {
+      return finder->second;
+    }
+    NumaSocket socket;
+    socket.memory = m;
+    numa_sockets.push_back(socket);
+    mem_numa_sockets[m] = numa_sockets.size() - 1;
+    return (int)numa_sockets.size() - 1;
+  };
+  for (Processor const &cpu : local_cpus) {
+    auto finder = best.find(cpu);
+    if (finder != best.end()) {
+      int socket = socket_of(finder->second.m);
+      numa_sockets[socket].cpus.push_back(cpu);
+      proc_numa_sockets[cpu] = socket;
+    }
+  }
+  for (Processor const &gpu : local_gpus) {
+    auto finder = best.find(gpu);
+    if (finder != best.end()) {
+      int socket = socket_of(finder->second.m);
+      proc_numa_sockets[gpu] = socket;
+      mem_numa_sockets[proc_fbmems[gpu]] = socket;
+    }
+  }
+  if (numa_sockets.empty()) {
+    return;
+  }
+  // Spread the GPUs of a socket over its CPUs
+  std::vector<size_t> next_cpu(numa_sockets.size(), 0);
+  for (size_t i = 0; i < all_gpus.size(); i++) {
+    int socket = get_numa_socket(all_gpus[i]);
+    if (socket >= 0 && !numa_sockets[socket].cpus.empty()) {
+      std::vector<Processor> const &cpus = numa_sockets[socket].cpus;
+      gpu_worker_cpus.push_back(cpus[next_cpu[socket]++ % cpus.size()]);
+    } else {
+      gpu_worker_cpus.push_back(all_cpus[i % all_cpus.size()]);
+    }
+  }
+  log_ff_mapper.print("Enabled NUMA-aware mapping over %zu sockets.",
+                      numa_sockets.size());
+}
+
+int FFMapper::get_numa_socket(Processor proc) const {
+  auto finder = proc_numa_sockets.find(proc);
+  return finder == proc_numa_sockets.end() ? -1 : finder->second;
+}
+
+int FFMapper::select_numa_socket(MapTaskInput const &input) const {
+  // The socket whose memories hold the most bytes of valid instances
+  std::vector<size_t> bytes(numa_sockets.size(), 0);
+  for (size_t idx = 0; idx < input.valid_instances.size(); idx++) {
+    for (PhysicalInstance const &instance : input.valid_instances[idx]) {
+      auto finder = mem_numa_sockets.find(instance.get_location());
+      if (finder != mem_numa_sockets.end()) {
+        bytes[finder->second] += instance.get_instance_size();
+      }
+    }
+  }
+  int best = -1;
+  for (size_t s = 0; s < numa_sockets.size(); s++) {
+    if (bytes[s] > 0 && !numa_sockets[s].cpus.empty() &&
+        (best < 0 || bytes[s] > bytes[best])) {
+      best = s;
+    }
+  }
+  return best;
+}
+
+Processor FFMapper::default_cpu() const {
+  // Single CPU tasks (e.g., batch preparation and metrics) exchange their
+  // results with the GPUs, so run them next to the first one when its
+  // socket is known
+  if (!all_gpus.empty()) {
+    int socket = get_numa_socket(all_gpus[0]);
+    if (socket >= 0 && !numa_sockets[socket].cpus.empty()) {
+      return numa_sockets[socket].cpus[0];
+    }
+  }
+  return all_cpus[0];
+}
+
+void FFMapper::track_instance(PhysicalInstance const &instance,
+                              InstanceCreationLog const &creation) {
+  InstanceLifetime &lifetime = live_instances[instance];
+  lifetime.creation = creation;
+  lifetime.last_used = num_map_calls;
+  lifetime.collectable = false;
+  InstanceMemoryUsage &usage = memory_usage[creation.memory];
+  usage.live_bytes += creation.size;
+  usage.peak_bytes = std::max(usage.peak_bytes, usage.live_bytes);
+  usage.live_instances++;
+  usage.created_instances++;
+}
+
+void FFMapper::touch_instances(
+    MapperContext ctx,
+    std::vector<std::vector<PhysicalInstance>> const &instances) {
+  // Last uses only matter to the idle policy and to instances that were
+  // released when a memory ran full
+  if (instance_gc_idle == 0 && num_collectable == 0) {
+    return;
+  }
+  for (std::vector<PhysicalInstance> const &list : instances) {
+    for (PhysicalInstance const &instance : list) {
+      auto it = live_instances.find(instance);
+      if (it == live_instances.end()) {
+        continue;
+      }
+      InstanceLifetime &lifetime = it->second;
+      lifetime.last_used = num_map_calls;
+      if (lifetime.collectable) {
+        // In use again, so keep it until it goes idle once more
+        runtime->set_garbage_collection_priority(
+            ctx, instance, LEGION_GC_NEVER_PRIORITY);
+        lifetime.collectable = false;
+        num_collectable--;
+        memory_usage[lifetime.creation.memory].collectable_bytes -=
+            lifetime.creation.size;
+      }
+    }
+  }
+}
+
+size_t FFMapper::release_idle_instances(MapperContext ctx,
+                                        Memory memory,
+                                        unsigned long long idle_calls) {
+  prune_deleted_instances();
+  size_t released = 0;
+  for (auto &it : live_instances) {
+    InstanceLifetime &lifetime = it.second;
+    if (lifetime.collectable ||
+        num_map_calls - lifetime.last_used < idle_calls) {
+      continue;
+    }
+    if (memory.exists() && lifetime.creation.memory != memory) {
+      continue;
+    }
+    // Legion only deletes it once nothing uses it and it holds no data
+    // that is still valid, or when a later allocation needs the space
+    runtime->set_garbage_collection_priority(
+        ctx, it.first, LEGION_GC_DEFAULT_PRIORITY);
+    lifetime.collectable = true;
+    num_collectable++;
+    memory_usage[lifetime.creation.memory].collectable_bytes +=
+        lifetime.creation.size;
+    released++;
+  }
+  return released;
+}
+
+void FFMapper::prune_deleted_instances() {
+  for (auto it = live_instances.begin(); it != live_instances.end();) {
+    if (it->first.exists(true /*strong_test*/)) {
+      it++;
+      continue;
+    }
+    InstanceLifetime const &lifetime = it->second;
+    InstanceMemoryUsage &usage = memory_usage[lifetime.creation.memory];
+    usage.live_bytes -= lifetime.creation.size;
+    usage.live_instances--;
+    usage.reclaimed_instances++;
+    if (lifetime.collectable) {
+      usage.collectable_bytes -= lifetime.creation.size;
+      num_collectable--;
+    }
+    it = live_instances.erase(it);
+  }
+}
+
+void FFMapper::log_memory_usage() {
+  prune_deleted_instances();
+  for (auto const &it : memory_usage) {
+    InstanceMemoryUsage const &usage = it.second;
+    log_ff_mapper.print("Memory " IDFMT " (kind %d, capacity %zu): live %zu "
+                        "bytes in %zu instances, peak %zu bytes, "
+                        "collectable %zu bytes, reclaimed %zu instances",
+                        it.first.id,
+                        it.first.kind(),
+                        it.first.capacity(),
+                        usage.live_bytes,
+                        usage.live_instances,
+                        usage.peak_bytes,
+                        usage.collectable_bytes,
+                        usage.reclaimed_instances);
+  }
+}
+
+void FFMapper::write_memory_usage_report() {
+  prune_deleted_instances();
+  if (memory_usage.empty()) {
+    return;
+  }
+  // One report per mapper, since every mapper tracks its own instances
+  char filename[1024];
+  snprintf(filename,
+           sizeof(filename),
+           "%s." IDFMT ".csv",
+           memory_usage_report,
+           local_processor.id);
+  FILE *file = fopen(filename, "w");
+  if (file == nullptr) {
+    fprintf(stderr,
+            "[Warning] could not write the memory usage report to %s\n",
+            filename);
+    return;
+  }
+  fprintf(file,
+          "memory,kind,capacity,live_bytes,peak_bytes,live_instances,"
+          "created_instances,reclaimed_instances,collectable_bytes\n");
+  for (auto const &it : memory_usage) {
+    InstanceMemoryUsage const &usage = it.second;
+    fprintf(file,
+            IDFMT ",%d,%zu,%zu,%zu,%zu,%zu,%zu,%zu\n",
+            it.first.id,
+            it.first.kind(),
+            it.first.capacity(),
+            usage.live_bytes,
+            usage.peak_bytes,
+            usage.live_instances,
+            usage.created_instances,
+            usage.reclaimed_instances,
+            usage.collectable_bytes);
+  }
+  fclose(file);
+}
+
 Memory FFMapper::default_select_target_memory(MapperContext ctx,
                                               Processor target_proc,
                                               RegionRequirement const &req) {
@@ -1302,6 +1710,14 @@ Memory FFMapper::default_select_target_memory(MapperContext ctx,
       return proc_fbmems[target_proc];
     }
   } else if (target_proc.kind() == Processor::LOC_PROC) {
+    // Data staged for GPUs stays in zero-copy memory, the rest goes to the
+    // memory of the processor's socket on NUMA hosts
+    if (req.tag != MAP_TO_ZC_MEMORY) {
+      int socket = get_numa_socket(target_proc);
+      if (socket >= 0) {
+        return numa_sockets[socket].memory;
+      }
+    }
     assert(proc_zcmems.find(target_proc) != proc_zcmems.end());
     return proc_zcmems[target_proc];
   } else if (target_proc.kind() == Processor::PY_PROC) {
@@ -1336,7 +1752,21 @@ bool FFMapper::default_make_instance(MapperContext ctx,
                                                  0 /*priority*/,
                                                  tight_region_bounds,
                                                  footprint)) {
-    return false;
+    // Hand the instances of the memory that the current mapping does not
+    // use back to the collector and try once more
+    if (release_idle_instances(ctx, target_mem, 1 /*idle_calls*/) == 0 ||
+        !runtime->find_or_create_physical_instance(ctx,
+                                                   target_mem,
+                                                   constraints,
+                                                   target_regions,
+                                                   result,
+                                                   created,
+                                                   true /*acquire*/,
+                                                   0 /*priority*/,
+                                                   tight_region_bounds,
+                                                   footprint)) {
+      return false;
+    }
   }
   if (created) {
     int priority = LEGION_GC_NEVER_PRIORITY;
@@ -1355,9 +1785,7 @@ LayoutConstraintID FFMapper::default_select_layout_constraints(
   assert(req.privilege != LEGION_REDUCE);
   std::pair<Memory::Kind, FieldSpace> constraint_key(
       target_memory.kind(), req.region.get_field_space());
-  std::map<std::pair<Memory::Kind, FieldSpace>,
-           LayoutConstraintID>::const_iterator finder =
-      layout_constraint_cache.find(constraint_key);
+  auto finder = layout_constraint_cache.find(constraint_key);
   if (finder != layout_constraint_cache.end()) {
     // If we don't need a constraint check we are already good
     if (!needs_field_constraint_check) {
@@ -1469,6 +1897,9 @@ void FFMapper::update_mappers(Machine machine,
 
   bool enable_control_replication = true;
   bool log_instance_creation = false;
+  bool enable_mapper_cache = true;
+  unsigned long long instance_gc_idle = 0;
+  char const *memory_usage_report = nullptr;
   for (int i = 1; i < argc; i++) {
     // if ((!strcmp(argv[i], "--import")) || (!strcmp(argv[i],
     // "--import-strategy"))) {
@@ -1483,6 +1914,18 @@ void FFMapper::update_mappers(Machine machine,
       log_instance_creation = true;
       continue;
     }
+    if (!strcmp(argv[i], "--disable-mapper-cache")) {
+      enable_mapper_cache = false;
+      continue;
+    }
+    if (!strcmp(argv[i], "--instance-gc-idle") && i + 1 < argc) {
+      instance_gc_idle = strtoull(argv[++i], nullptr, 10);
+      continue;
+    }
+    if (!strcmp(argv[i], "--memory-usage-report") && i + 1 < argc) {
+      memory_usage_report = argv[++i];
+      continue;
+    }
   }
 
   for (std::set<Processor>::const_iterator it = local_procs.begin();
@@ -1493,11 +1936,18 @@ void FFMapper::update_mappers(Machine machine,
                                     *it,
                                     "FlexFlow Mapper",
                                     enable_control_replication,
-                                    log_instance_creation);
+                                    log_instance_creation,
+                                    enable_mapper_cache,
+                                    instance_gc_idle,
+                                    memory_usage_report);
     runtime->replace_default_mapper(mapper, *it);
   }
 }
 
-FFMapper::~FFMapper(void) {}
+FFMapper::~FFMapper(void) {
+  if (memory_usage_report != nullptr) {
+    write_memory_usage_report();
+  }
+}
 
 }; // namespace FlexFlow
@@ -17,6 +17,7 @@
 #include "flexflow/ffconst_utils.h"
 #include "flexflow/ops/kernels/decompress_kernels.h"
 #include "flexflow/ops/kernels/inc_multihead_self_attention_kernels.h"
+#include "flexflow/rotary_embedding.h"
 #include "flexflow/utils/hip_helper.h"
 #include <hip/hip_complex.h>
 #include <hip/hip_runtime.h>
@@ -128,6 +129,7 @@ __global__ void
     apply_rotary_embedding_native(DT *input_ptr,
                                   hipFloatComplex *complex_input,
                                   BatchConfig::PerTokenInfo const *tokenInfos,
+                                  hipFloatComplex const *rotary_table,
                                   int qProjSize,
                                   int kProjSize,
                                   int num_q_heads,
@@ -159,8 +161,7 @@ __global__ void
         (real_i - head_idx * (num_tokens * proj_size / 2)) / (proj_size / 2);
     size_t pos = tokenInfos[token_idx].abs_depth_in_request;
     int pos_i = real_i % (proj_size / 2);
-    float freq = pos * (1.0 / pow(10000.0, (float)2 * pos_i / proj_size));
-    hipFloatComplex complex_pos = {cos(freq), sin(freq)};
+    hipFloatComplex complex_pos = rotary_table[pos * (proj_size / 2) + pos_i];
 
     complex_input[i] = hipCmulf(complex_input[i], complex_pos);
     input_ptr[real_part_index] = complex_input[i].x;
@@ -173,6 +174,7 @@ __global__ void
     apply_rotary_embedding_hf(DT *input_ptr,
                               hipFloatComplex *complex_input,
                               BatchConfig::PerTokenInfo const *tokenInfos,
+                              hipFloatComplex const *rotary_table,
                               int qProjSize,
                               int kProjSize,
                               int num_tokens,
@@ -207,8 +209,7 @@ __global__ void
 
     // float before_real = complex_input[i].x, before_complex =
     int pos_i = real_i % (proj_size / 2);
-    float freq = pos * (1.0 / pow(10000.0, (float)2 * pos_i / proj_size));
-    hipFloatComplex complex_pos = {cos(freq), sin(freq)};
+    hipFloatComplex complex_pos = rotary_table[pos * (proj_size / 2) + pos_i];
 
     complex_input[i] = hipCmulf(complex_input[i], complex_pos);
     input_ptr[real_part_index] = complex_input[i].x;
@@ -344,6 +345,7 @@ void compute_qkv_kernel(IncMultiHeadSelfAttentionMeta const *m,
                        output_ptr,
                        m->complex_input,
                        m->token_infos,
+                       m->rotary_table,
                        m->qProjSize,
                        m->kProjSize,
                        num_tokens,
@@ -375,10 +377,10 @@ void update_kv_cache_kernel(IncMultiHeadSelfAttentionMeta const *m,
 }
 
 template <typename DT>
-void pre_build_weight_kernel(IncMultiHeadSelfAttentionMeta const *m,
-                             GenericTensorAccessorR const weight,
-                             DataType data_type,
-                             hipStream_t stream) {
+DT const *pre_build_weight_kernel(IncMultiHeadSelfAttentionMeta const *m,
+                                  GenericTensorAccessorR const weight,
+                                  DataType data_type,
+                                  hipStream_t stream) {
   // additional processing for weight uploading
   // Note that we update weight_ptr and bias_ptr when uploading weight and
   // bias
@@ -432,6 +434,7 @@ void pre_build_weight_kernel(IncMultiHeadSelfAttentionMeta const *m,
       assert(false);
     }
   }
+  return static_cast<DT const *>(m->weight_ptr);
 }
 
 template <typename DT>
@@ -901,6 +904,14 @@ IncMultiHeadSelfAttentionMeta::IncMultiHeadSelfAttentionMeta(
   size_t size_of_dt = data_type_size(attn->data_type);
   quantization_type = _quantization_type;
   offload = _offload;
+  kv_cache_quantization_type = DT_NONE;
+  keyCacheScales = valueCacheScales = nullptr;
+  kvCacheScratch = nullptr;
+  // the HIP kernels index the caches by position
+  assert((infer_mode != INC_DECODING_MODE ||
+          !BatchConfig::kv_cache_window().enabled()) &&
+         "KV cache windows are not supported by the HIP backend");
+  kv_cache_length = BatchConfig::max_sequence_length();
 
   global_num_q_heads = _global_num_q_heads;
   global_num_kv_heads = _global_num_kv_heads;
@@ -929,6 +940,9 @@ IncMultiHeadSelfAttentionMeta::IncMultiHeadSelfAttentionMeta(
   //*has_load_weights = false;
   apply_rotary_embedding = (bool *)calloc(1, sizeof(bool));
   *apply_rotary_embedding = _apply_rotary_embedding;
+  // the rotary table is shared by the queries and the keys
+  assert(!_apply_rotary_embedding || qProjSize == kProjSize);
+  rotary_table = nullptr;
   qkv_bias = (bool *)calloc(1, sizeof(bool));
   *qkv_bias = _qkv_bias;
   scaling_query = (bool *)calloc(1, sizeof(bool));
@@ -947,6 +961,8 @@ IncMultiHeadSelfAttentionMeta::IncMultiHeadSelfAttentionMeta(
     bias_ptr = gpu_mem_allocator.allocate_reserved_untyped(biasSize);
   }
 
+  // alive until the copy of the rotary table is done
+  std::vector<float> rotary_table_host;
   // allocate memory for the seqArray and reserve space
   {
     int max_tokens_per_batch = BatchConfig::max_tokens_per_batch();
@@ -986,27 +1002,39 @@ IncMultiHeadSelfAttentionMeta::IncMultiHeadSelfAttentionMeta(
     size_t complex_size = (max_tokens_per_batch * (qProjSize * num_q_heads +
                                                    kProjSize * num_q_heads)) /
                           2;
+    // a (cos, sin) pair per position and pair of a head
+    int num_rotary_positions = infer_mode == INC_DECODING_MODE
+                                   ? BatchConfig::max_sequence_length()
+                                   : BatchConfig::max_sequence_length() +
+                                         BatchConfig::max_spec_tree_token_num();
+    size_t rotary_table_bytes =
+        *apply_rotary_embedding
+            ? rotary_table_size(num_rotary_positions, qProjSize) * sizeof(float)
+            : 0;
     size_t totalSize =
         (qkv_max_proj_size + key_cache_size + value_cache_size +
          2 * qk_prod_size + attn_heads_size) *
             size_of_dt +
         tokeninfo_size * sizeof(BatchConfig::PerTokenInfo) +
+        rotary_table_bytes +
         complex_size * sizeof(hipFloatComplex); // more components will
                                                 // be added here later
     if (offload) {
       // assert that we have enough reserved work space left
       size_t totalSharedSize =
-          infer_mode == TREE_VERIFY_MODE
-              ? totalSize -
-                    (key_cache_size + value_cache_size + qkv_max_proj_size) *
-                        size_of_dt
-              : totalSize - (key_cache_size + value_cache_size) * size_of_dt;
+          (infer_mode == TREE_VERIFY_MODE
+               ? totalSize -
+                     (key_cache_size + value_cache_size + qkv_max_proj_size) *
+                         size_of_dt
+               : totalSize - (key_cache_size + value_cache_size) * size_of_dt) -
+          rotary_table_bytes;
 
       size_t instance_size =
           size_of_dt *
-          (infer_mode == TREE_VERIFY_MODE
-               ? key_cache_size + value_cache_size + qkv_max_proj_size
-               : key_cache_size + value_cache_size);
+              (infer_mode == TREE_VERIFY_MODE
+                   ? key_cache_size + value_cache_size + qkv_max_proj_size
+                   : key_cache_size + value_cache_size) +
+          rotary_table_bytes;
 
       if (quantization_type != DT_NONE) {
         totalSharedSize += quantized_weightSize;
@@ -1034,6 +1062,19 @@ IncMultiHeadSelfAttentionMeta::IncMultiHeadSelfAttentionMeta(
                                                            size_of_dt);
     valueCache = gpu_mem_allocator.allocate_instance_untyped(value_cache_size *
                                                              size_of_dt);
+    if (rotary_table_bytes > 0) {
+      // computed once, instead of for every token of every step
+      rotary_table_host.resize(rotary_table_bytes / sizeof(float));
+      compute_rotary_table(
+          num_rotary_positions, qProjSize, rotary_table_host.data());
+      rotary_table = static_cast<hipFloatComplex *>(
+          gpu_mem_allocator.allocate_instance_untyped(rotary_table_bytes));
+      checkCUDA(hipMemcpyAsync(rotary_table,
+                               rotary_table_host.data(),
+                               rotary_table_bytes,
+                               hipMemcpyHostToDevice,
+                               stream));
+    }
 
     if (offload) {
       token_infos =
@@ -1086,16 +1127,18 @@ IncMultiHeadSelfAttentionMeta::~IncMultiHeadSelfAttentionMeta(void) {
   }
 }
 
-template void Kernels::IncMultiHeadAttention::pre_build_weight_kernel<float>(
-    IncMultiHeadSelfAttentionMeta const *m,
-    GenericTensorAccessorR const weight,
-    DataType data_type,
-    hipStream_t stream);
-
-template void Kernels::IncMultiHeadAttention::pre_build_weight_kernel<half>(
-    IncMultiHeadSelfAttentionMeta const *m,
-    GenericTensorAccessorR const weight,
-    DataType data_type,
-    hipStream_t stream);
+template float const *
+    Kernels::IncMultiHeadAttention::pre_build_weight_kernel<float>(
+        IncMultiHeadSelfAttentionMeta const *m,
+        GenericTensorAccessorR const weight,
+        DataType data_type,
+        hipStream_t stream);
+
+template half const *
+    Kernels::IncMultiHeadAttention::pre_build_weight_kernel<half>(
+        IncMultiHeadSelfAttentionMeta const *m,
+        GenericTensorAccessorR const weight,
+        DataType data_type,
+        hipStream_t stream);
 
 }; // namespace FlexFlow
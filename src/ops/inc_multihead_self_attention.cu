@@ -16,11 +16,14 @@
 #include "cuComplex.h"
 #endif
 #include "flexflow/ffconst_utils.h"
+#include "flexflow/kv_cache_quantization.h"
 #include "flexflow/ops/inc_multihead_self_attention.h"
 #include "flexflow/ops/kernels/decompress_kernels.h"
 #include "flexflow/ops/kernels/inc_multihead_self_attention_kernels.h"
 #include "flexflow/ops/kernels/inc_multihead_self_attention_utils.cuh"
+#include "flexflow/rotary_embedding.h"
 #include "flexflow/utils/cuda_helper.h"
+#include "flexflow/weight_offload.h"
 
 namespace FlexFlow {
 
@@ -37,7 +40,12 @@ namespace IncMultiHeadAttention {
 // blockDim = num_tokens/num_request * head_size
 // QKV tensor layout: |QKV| * num_new_tokens. |Q=K=V=head_size * num_heads|
 // one thread process one head_size
+// CT is the type of the KV cache: DT, or int8_t with a scale per token and
+// head in key_scales and value_scales ([request][cache_length][num_heads])
+// cache_length is the number of slots of the cache of a request; with a KV
+// cache window, the slots in use hold the sinks and the most recent tokens
 template <typename DT,
+          typename CT,
           int THREADS_PER_BLOCK,
           int Dh,
           int Dh_MAX,
@@ -45,11 +53,13 @@ template <typename DT,
           int THREADS_PER_VALUE>
 __global__ void compute_attention_kernel_generation_kernel(
     DT const *query,
-    DT const *key_cache,
-    DT const *value_cache,
+    CT const *key_cache,
+    CT const *value_cache,
+    float const *key_scales,
+    float const *value_scales,
     DT *output_ptr,
     float const scale,
-    int max_seq_length,
+    int cache_length,
     int per_head_size,
     int hidden_size,
     BatchConfig::PerRequestInfo *request_infos) {
@@ -61,6 +71,7 @@ __global__ void compute_attention_kernel_generation_kernel(
   using Out_sum = typename Vec_fp32_<V_vec>::Type;
 
   constexpr int WARPS_PER_BLOCK = THREADS_PER_BLOCK / WARP_SIZE;
+  constexpr bool QUANTIZED_CACHE = std::is_same<CT, int8_t>::value;
 
   // eg.  if head_size = 128, thread_per_key = 4, with float32 precision
   // then K_VEC_SIZE = 1,  QK_VEC_SIZE = 4
@@ -82,12 +93,19 @@ __global__ void compute_attention_kernel_generation_kernel(
 
   int const batch_config_request_id =
       request_infos[request_idx].batch_config_request_id;
+  // scales of this request and head
+  int const num_heads = hidden_size / per_head_size;
+  int const scale_offset =
+      batch_config_request_id * cache_length * num_heads + head_idx;
 
   int const first_step = 0;
 
+  // the slots in use; the generation token is the latest one, so it attends
+  // to all of them
   int const tlength =
-      request_infos[batch_config_request_id].first_token_depth_in_request +
-      request_infos[batch_config_request_id].num_tokens_in_batch;
+      min(request_infos[batch_config_request_id].first_token_depth_in_request +
+              request_infos[batch_config_request_id].num_tokens_in_batch,
+          cache_length);
 
   // shared memory objects
   extern __shared__ char smem_[];
@@ -134,8 +152,8 @@ __global__ void compute_attention_kernel_generation_kernel(
   //   // The number of keys per warp.
   constexpr int K_PER_WARP = WARP_SIZE / THREADS_PER_KEY;
 
-  DT const *k_cache_batch =
-      key_cache + batch_config_request_id * max_seq_length * hidden_size + ki;
+  CT const *k_cache_batch =
+      key_cache + batch_config_request_id * cache_length * hidden_size + ki;
 
   int ti_end =
       div_up(tlength - first_step, K_PER_WARP) * K_PER_WARP + first_step;
@@ -143,14 +161,18 @@ __global__ void compute_attention_kernel_generation_kernel(
 
   for (int ti = ko; ti < ti_end; ti += K_PER_ITER) {
     K_vec k[K_VECS_PER_THREAD];
-    int const ti_circ = ti % max_seq_length;
+    int const ti_circ = ti % cache_length;
+    float const k_scale =
+        QUANTIZED_CACHE && ti < tlength
+            ? key_scales[scale_offset + ti_circ * num_heads]
+            : 1.0f;
 #pragma unroll
     for (int ii = 0; ii < K_VECS_PER_THREAD; ++ii) {
       int jj = ii * THREADS_PER_KEY * K_VEC_SIZE;
       if (ti < tlength) {
-        k[ii] = *reinterpret_cast<K_vec const *>(k_cache_batch +
-                                                 ti_circ * hidden_size +
-                                                 head_idx * per_head_size + jj);
+        k[ii] = load_kv_cache_vec<K_vec>(k_cache_batch + ti_circ * hidden_size +
+                                             head_idx * per_head_size + jj,
+                                         k_scale);
       }
       // Compute dot product.
       // This includes a reduction across the threads in the same thread group.
@@ -237,16 +259,20 @@ __global__ void compute_attention_kernel_generation_kernel(
   zero(out);
 
   // The base pointer for the value in the cache buffer.
-  DT const *v_cache_batch =
-      value_cache + batch_config_request_id * max_seq_length * hidden_size + vi;
+  CT const *v_cache_batch =
+      value_cache + batch_config_request_id * cache_length * hidden_size + vi;
 
   if (Dh == Dh_MAX || vi < Dh) {
     for (int ti = first_step + vo; ti < tlength; ti += V_PER_ITER) {
       // Load the values from the cache.
-      int const ti_circ = ti % max_seq_length;
-
-      V_vec v = *reinterpret_cast<V_vec const *>(
-          v_cache_batch + ti_circ * hidden_size + head_idx * per_head_size);
+      int const ti_circ = ti % cache_length;
+
+      float const v_scale =
+          QUANTIZED_CACHE ? value_scales[scale_offset + ti_circ * num_heads]
+                          : 1.0f;
+      V_vec v = load_kv_cache_vec<V_vec>(
+          v_cache_batch + ti_circ * hidden_size + head_idx * per_head_size,
+          v_scale);
       float logit = qk_smem[ti - first_step];
       out = FlexFlow::fma(logit, cast_to_float(v), out);
     }
@@ -391,6 +417,7 @@ __global__ void
     apply_rotary_embedding_native(DT *input_ptr,
                                   cuFloatComplex *complex_input,
                                   BatchConfig::PerTokenInfo const *tokenInfos,
+                                  cuFloatComplex const *rotary_table,
                                   int qProjSize,
                                   int kProjSize,
                                   int num_q_heads,
@@ -426,8 +453,7 @@ __global__ void
     // complex_input[i].y;
 
     int pos_i = real_i % (proj_size / 2);
-    float freq = pos * (1.0 / pow(10000.0, (float)2 * pos_i / proj_size));
-    cuFloatComplex complex_pos = {cos(freq), sin(freq)};
+    cuFloatComplex complex_pos = rotary_table[pos * (proj_size / 2) + pos_i];
 
     complex_input[i] = cuCmulf(complex_input[i], complex_pos);
     input_ptr[real_part_index] = complex_input[i].x;
@@ -440,6 +466,7 @@ __global__ void
     apply_rotary_embedding_hf(DT *input_ptr,
                               cuFloatComplex *complex_input,
                               BatchConfig::PerTokenInfo const *tokenInfos,
+                              cuFloatComplex const *rotary_table,
                               int qProjSize,
                               int kProjSize,
                               int num_tokens,
@@ -474,8 +501,7 @@ __global__ void
 
     // float before_real = complex_input[i].x, before_complex =
     int pos_i = real_i % (proj_size / 2);
-    float freq = pos * (1.0 / pow(10000.0, (float)2 * pos_i / proj_size));
-    cuFloatComplex complex_pos = {cos(freq), sin(freq)};
+    cuFloatComplex complex_pos = rotary_table[pos * (proj_size / 2) + pos_i];
 
     complex_input[i] = cuCmulf(complex_input[i], complex_pos);
     input_ptr[real_part_index] = complex_input[i].x;
@@ -592,6 +618,7 @@ void compute_qkv_kernel(IncMultiHeadSelfAttentionMeta const *m,
                                 stream>>>(output_ptr,
                                           m->complex_input,
                                           m->token_infos,
+                                          m->rotary_table,
                                           m->qProjSize,
                                           m->kProjSize,
                                           num_tokens,
@@ -605,7 +632,25 @@ void update_kv_cache_kernel(IncMultiHeadSelfAttentionMeta const *m,
                             BatchConfig const *bc,
                             cudaStream_t stream) {
   int num_tokens = bc->num_active_tokens();
-  if (num_tokens > 0) {
+  if (num_tokens > 0 && m->kv_cache_quantization_type == DT_INT8) {
+    // a warp per token and head
+    int parallelism = num_tokens * m->num_q_heads * WARP_SIZE;
+    store_quantized_kv_cache<<<GET_BLOCKS(parallelism),
+                               min(CUDA_NUM_THREADS, parallelism),
+                               0,
+                               stream>>>(
+        static_cast<DT *>(m->devQKVProjArray),
+        static_cast<int8_t *>(m->keyCache),
+        static_cast<int8_t *>(m->valueCache),
+        m->keyCacheScales,
+        m->valueCacheScales,
+        m->token_infos,
+        m->kv_cache_window,
+        num_tokens,
+        m->kv_cache_length,
+        m->hidden_size,
+        m->qProjSize);
+  } else if (num_tokens > 0) {
     int parallelism = m->hidden_size * num_tokens;
     store_kv_cache<<<GET_BLOCKS(parallelism),
                      min(CUDA_NUM_THREADS, parallelism),
@@ -614,8 +659,9 @@ void update_kv_cache_kernel(IncMultiHeadSelfAttentionMeta const *m,
                                static_cast<DT *>(m->keyCache),
                                static_cast<DT *>(m->valueCache),
                                m->token_infos,
+                               m->kv_cache_window,
                                num_tokens,
-                               BatchConfig::max_sequence_length(),
+                               m->kv_cache_length,
                                m->hidden_size);
   }
 }
@@ -694,12 +740,20 @@ void compute_o_prod_bias(IncMultiHeadSelfAttentionMeta const *m,
 }
 
 #define LAUNCH_ATTENTION_SCORE_KERNEL(                                         \
-    DT, Dh, Dh_MAX, THDS_PER_KEY, THREADS_PER_VALUE, THDS_PER_BLOCK, stream)   \
+    DT,                                                                        \
+    CT,                                                                        \
+    Dh,                                                                        \
+    Dh_MAX,                                                                    \
+    THDS_PER_KEY,                                                              \
+    THREADS_PER_VALUE,                                                         \
+    THDS_PER_BLOCK,                                                            \
+    stream)                                                                    \
   smem_sz = smem_size_in_bytes<DT>(m->qProjSize,                               \
-                                   BatchConfig::max_sequence_length(),         \
+                                   m->kv_cache_length,                         \
                                    THREADS_PER_VALUE,                          \
                                    THDS_PER_BLOCK);                            \
   compute_attention_kernel_generation_kernel<DT,                               \
+                                             CT,                               \
                                              THDS_PER_BLOCK,                   \
                                              Dh,                               \
                                              Dh_MAX,                           \
@@ -707,20 +761,22 @@ void compute_o_prod_bias(IncMultiHeadSelfAttentionMeta const *m,
                                              THREADS_PER_VALUE>                \
       <<<grid, THDS_PER_BLOCK, smem_sz, stream>>>(                             \
           static_cast<DT *>(m->devQKVProjArray),                               \
-          static_cast<DT *>(m->keyCache),                                      \
-          static_cast<DT *>(m->valueCache),                                    \
+          static_cast<CT *>(m->keyCache),                                      \
+          static_cast<CT *>(m->valueCache),                                    \
+          m->keyCacheScales,                                                   \
+          m->valueCacheScales,                                                 \
           output_ptr,                                                          \
           scale,                                                               \
-          BatchConfig::max_sequence_length(),                                  \
+          m->kv_cache_length,                                                  \
           m->qProjSize,                                                        \
           m->hidden_size,                                                      \
           m->request_infos)
 
-template <typename DT>
-void compute_attention_kernel_generation(IncMultiHeadSelfAttentionMeta const *m,
-                                         BatchConfig const *bc,
-                                         DT *output_ptr,
-                                         cudaStream_t stream) {
+template <typename DT, typename CT>
+void launch_attention_kernel_generation(IncMultiHeadSelfAttentionMeta const *m,
+                                        BatchConfig const *bc,
+                                        DT *output_ptr,
+                                        cudaStream_t stream) {
   dim3 grid(m->num_q_heads, bc->num_generation_tokens);
   int const per_head_size = m->qProjSize;
   float scale = (*m->qk_prod_scaling) ? 1.0f / sqrt(m->kProjSize) : 1.0f;
@@ -728,32 +784,42 @@ void compute_attention_kernel_generation(IncMultiHeadSelfAttentionMeta const *m,
   if (per_head_size == 64) {
     constexpr int THREADS_PER_VALUE_64 = threads_per_value_t<DT, 64>::value;
     LAUNCH_ATTENTION_SCORE_KERNEL(
-        DT, 64, 64, 4, THREADS_PER_VALUE_64, 128, stream);
+        DT, CT, 64, 64, 4, THREADS_PER_VALUE_64, 128, stream);
   } else if (per_head_size == 128) {
     constexpr int THREADS_PER_VALUE_128 = threads_per_value_t<DT, 128>::value;
     LAUNCH_ATTENTION_SCORE_KERNEL(
-        DT, 128, 128, 4, THREADS_PER_VALUE_128, 128, stream);
+        DT, CT, 128, 128, 4, THREADS_PER_VALUE_128, 128, stream);
   } else {
     assert(false && "a unsupported head size");
   }
 }
 
 template <typename DT>
-void pre_build_weight_kernel(IncMultiHeadSelfAttentionMeta const *m,
-                             GenericTensorAccessorR const weight,
-                             DataType data_type,
-                             cudaStream_t stream) {
+void compute_attention_kernel_generation(IncMultiHeadSelfAttentionMeta const *m,
+                                         BatchConfig const *bc,
+                                         DT *output_ptr,
+                                         cudaStream_t stream) {
+  if (m->kv_cache_quantization_type == DT_INT8) {
+    launch_attention_kernel_generation<DT, int8_t>(m, bc, output_ptr, stream);
+  } else {
+    launch_attention_kernel_generation<DT, DT>(m, bc, output_ptr, stream);
+  }
+}
+
+template <typename DT>
+DT const *pre_build_weight_kernel(IncMultiHeadSelfAttentionMeta const *m,
+                                  GenericTensorAccessorR const weight,
+                                  DataType data_type,
+                                  cudaStream_t stream) {
   // additional processing for weight uploading
-  // Note that we update weight_ptr and bias_ptr when uploading weight and
-  // bias
+  // Note that we return the device copy of the weight, which the offload
+  // engine stages in the reserve space
+  WeightOffloadEngine *engine = m->handle.offload_engine;
+  assert(engine != nullptr);
   if (m->quantization_type != DT_NONE) {
-    // copy weight_ptr to quantized_weight_ptr, do compression and store in
-    // m->weight_ptr
-    cudaMemcpyAsync(m->quantized_weight_ptr,
-                    weight.get_byte_ptr(),
-                    m->quantized_weightSize,
-                    cudaMemcpyHostToDevice,
-                    stream);
+    // decompress the staged weight and store it in m->weight_ptr
+    char *quantized_weight_ptr = static_cast<char *>(
+        engine->acquire(weight.ptr, m->quantized_weightSize, stream));
 
     if (m->quantization_type == DT_INT4) {
       int parallelism = m->qProjSize * m->qSize * m->num_q_heads / 2;
@@ -761,7 +827,7 @@ void pre_build_weight_kernel(IncMultiHeadSelfAttentionMeta const *m,
                                           min(CUDA_NUM_THREADS, parallelism),
                                           0,
                                           stream>>>(
-          m->quantized_weight_ptr,
+          quantized_weight_ptr,
           static_cast<DT *>(m->weight_ptr),
           m->qProjSize,
           m->qSize,
@@ -773,29 +839,19 @@ void pre_build_weight_kernel(IncMultiHeadSelfAttentionMeta const *m,
                                           min(CUDA_NUM_THREADS, parallelism),
                                           0,
                                           stream>>>(
-          m->quantized_weight_ptr,
+          quantized_weight_ptr,
           static_cast<DT *>(m->weight_ptr),
           m->qProjSize,
           m->qSize,
           m->num_q_heads);
     }
-  } else {
-    if (data_type == DT_FLOAT) {
-      cudaMemcpyAsync(m->weight_ptr,
-                      weight.get_float_ptr(),
-                      m->weightSize,
-                      cudaMemcpyHostToDevice,
-                      stream);
-    } else if (data_type == DT_HALF) {
-      cudaMemcpyAsync(m->weight_ptr,
-                      weight.get_half_ptr(),
-                      m->weightSize,
-                      cudaMemcpyHostToDevice,
-                      stream);
-    } else {
-      assert(false);
-    }
+    // The slot of the compressed weight can take a later layer already
+    engine->release(weight.ptr, stream);
+    return static_cast<DT const *>(m->weight_ptr);
   }
+  assert(data_type == DT_FLOAT || data_type == DT_HALF);
+  return static_cast<DT const *>(
+      engine->acquire(weight.ptr, m->weightSize, stream));
 }
 
 template <typename DT>
@@ -853,8 +909,9 @@ __global__ void store_kv_cache(DT const *devQKVProjArray,
                                DT *kCache_ptr,
                                DT *vCache_ptr,
                                BatchConfig::PerTokenInfo const *tokenInfos,
+                               KVCacheWindow window,
                                int num_tokens,
-                               int max_seq_len,
+                               int cache_length,
                                int hidden_size) {
   CUDA_KERNEL_LOOP(i, num_tokens * hidden_size) {
     int token_idx = i / hidden_size;
@@ -866,16 +923,87 @@ __global__ void store_kv_cache(DT const *devQKVProjArray,
     DT kVal = devQKVProjArray[val_idx];
     DT vVal = devQKVProjArray[val_idx + hidden_size];
     int const req_id = tokenInfos[token_idx].request_index;
-    int const tok_id = tokenInfos[token_idx].abs_depth_in_request;
+    int const tok_id = window.slot(tokenInfos[token_idx].abs_depth_in_request);
 
     // key cache
-    kCache_ptr[req_id * (hidden_size * max_seq_len) + tok_id * hidden_size +
+    kCache_ptr[req_id * (hidden_size * cache_length) + tok_id * hidden_size +
                offset] = kVal;
-    vCache_ptr[req_id * (hidden_size * max_seq_len) + tok_id * hidden_size +
+    vCache_ptr[req_id * (hidden_size * cache_length) + tok_id * hidden_size +
                offset] = vVal;
   }
 }
 
+// One warp per token and head: the keys and values of the head are quantized
+// to int8 with their absolute maximum, as quantize_kv_int8 does
+template <typename DT>
+__global__ void
+    store_quantized_kv_cache(DT const *devQKVProjArray,
+                             int8_t *kCache_ptr,
+                             int8_t *vCache_ptr,
+                             float *kScales_ptr,
+                             float *vScales_ptr,
+                             BatchConfig::PerTokenInfo const *tokenInfos,
+                             KVCacheWindow window,
+                             int num_tokens,
+                             int cache_length,
+                             int hidden_size,
+                             int head_size) {
+  int const num_heads = hidden_size / head_size;
+  int const warp_idx = (blockIdx.x * blockDim.x + threadIdx.x) / WARP_SIZE;
+  int const lane = threadIdx.x % WARP_SIZE;
+  if (warp_idx >= num_tokens * num_heads) {
+    return;
+  }
+  int const token_idx = warp_idx / num_heads;
+  int const head_idx = warp_idx % num_heads;
+
+  DT const *kVals = devQKVProjArray + token_idx * QKV_WEIGHT_NUM * hidden_size +
+                    hidden_size + head_idx * head_size;
+  DT const *vVals = kVals + hidden_size;
+  float kMax = 0.0f, vMax = 0.0f;
+  for (int i = lane; i < head_size; i += WARP_SIZE) {
+    kMax = fmaxf(kMax, fabsf(static_cast<float>(kVals[i])));
+    vMax = fmaxf(vMax, fabsf(static_cast<float>(vVals[i])));
+  }
+#pragma unroll
+  for (int mask = WARP_SIZE / 2; mask >= 1; mask /= 2) {
+    kMax = fmaxf(kMax, __shfl_xor_sync(uint32_t(-1), kMax, mask));
+    vMax = fmaxf(vMax, __shfl_xor_sync(uint32_t(-1), vMax, mask));
+  }
+  float const kInvScale = kMax > 0.0f ? 127.0f / kMax : 0.0f;
+  float const vInvScale = vMax > 0.0f ? 127.0f / vMax : 0.0f;
+
+  int const req_id = tokenInfos[token_idx].request_index;
+  int const tok_id = window.slot(tokenInfos[token_idx].abs_depth_in_request);
+  size_t const slot = (size_t)req_id * cache_length + tok_id;
+  size_t const cache_offset = slot * hidden_size + head_idx * head_size;
+  for (int i = lane; i < head_size; i += WARP_SIZE) {
+    kCache_ptr[cache_offset + i] = static_cast<int8_t>(
+        __float2int_rn(static_cast<float>(kVals[i]) * kInvScale));
+    vCache_ptr[cache_offset + i] = static_cast<int8_t>(
+        __float2int_rn(static_cast<float>(vVals[i]) * vInvScale));
+  }
+  if (lane == 0) {
+    kScales_ptr[slot * num_heads + head_idx] = kMax / 127.0f;
+    vScales_ptr[slot * num_heads + head_idx] = vMax / 127.0f;
+  }
+}
+
+// Dequantizes the first num_tokens tokens of the int8 cache of a request to
+// output, in the layout of a full-precision cache
+template <typename DT>
+__global__ void dequantize_kv_cache(int8_t const *cache_ptr,
+                                    float const *scales_ptr,
+                                    DT *output_ptr,
+                                    int num_tokens,
+                                    int hidden_size,
+                                    int head_size) {
+  CUDA_KERNEL_LOOP(i, num_tokens * hidden_size) {
+    int const scale_idx = i / head_size;
+    output_ptr[i] = static_cast<DT>(cache_ptr[i] * scales_ptr[scale_idx]);
+  }
+}
+
 template <typename DT>
 __global__ void fill_entries_above_diagonal(DT *matrix,
                                             size_t num_rows,
@@ -893,6 +1021,25 @@ __global__ void fill_entries_above_diagonal(DT *matrix,
   }
 }
 
+// Masks the slots of a KV cache window that hold tokens after the query, in
+// qk prods ([num_new_tokens, num_slots, num_heads])
+template <typename DT>
+__global__ void mask_kv_cache_window(DT *matrix,
+                                     KVCacheWindow window,
+                                     int num_new_tokens,
+                                     int total_tokens,
+                                     int num_heads,
+                                     DT value) {
+  int const num_slots = window.num_slots(total_tokens);
+  CUDA_KERNEL_LOOP(i, num_heads * num_slots * num_new_tokens) {
+    int query_position = total_tokens - num_new_tokens + i % num_new_tokens;
+    int slot = (i / num_new_tokens) % num_slots;
+    if (window.position(slot, total_tokens) > query_position) {
+      matrix[i] = value;
+    }
+  }
+}
+
 template <typename DT>
 void compute_attention_kernel_prompt(IncMultiHeadSelfAttentionMeta const *m,
                                      BatchConfig const *bc,
@@ -922,10 +1069,10 @@ void compute_attention_kernel_prompt(IncMultiHeadSelfAttentionMeta const *m,
   int q_block_size = m->qProjSize;
   int kt_block_size = m->kProjSize;
   int kt_req_block_size =
-      kt_block_size * m->num_q_heads * BatchConfig::max_sequence_length();
+      kt_block_size * m->num_q_heads * m->kv_cache_length;
   int vt_block_size = m->vProjSize;
   int vt_req_block_size =
-      vt_block_size * m->num_q_heads * BatchConfig::max_sequence_length();
+      vt_block_size * m->num_q_heads * m->kv_cache_length;
   assert(m->qProjSize == m->kProjSize);
 
   for (int i = 0; i < bc->max_requests_per_batch(); i++) {
@@ -935,6 +1082,42 @@ void compute_attention_kernel_prompt(IncMultiHeadSelfAttentionMeta const *m,
     int num_new_tokens = bc->requestsInfo[i].num_tokens_in_batch;
     int total_tokens = bc->requestsInfo[i].first_token_depth_in_request +
                        bc->requestsInfo[i].num_tokens_in_batch;
+    // the keys are the slots in use of the cache of the request, which are its
+    // first tokens unless the request outgrew a KV cache window
+    int num_slots = m->kv_cache_window.num_slots(total_tokens);
+    DT const *key_cache =
+        static_cast<DT *>(m->keyCache) + i * kt_req_block_size;
+    DT const *value_cache =
+        static_cast<DT *>(m->valueCache) + i * vt_req_block_size;
+    if (m->kv_cache_quantization_type == DT_INT8) {
+      // The GEMMs read a full-precision copy of the cache of the request
+      DT *key_scratch = static_cast<DT *>(m->kvCacheScratch);
+      DT *value_scratch = key_scratch + kt_req_block_size;
+      int parallelism = num_slots * m->hidden_size;
+      size_t scales_offset = (size_t)i * m->kv_cache_length * m->num_q_heads;
+      dequantize_kv_cache<<<GET_BLOCKS(parallelism),
+                            min(CUDA_NUM_THREADS, parallelism),
+                            0,
+                            stream>>>(static_cast<int8_t *>(m->keyCache) +
+                                          i * kt_req_block_size,
+                                      m->keyCacheScales + scales_offset,
+                                      key_scratch,
+                                      num_slots,
+                                      m->hidden_size,
+                                      m->qProjSize);
+      dequantize_kv_cache<<<GET_BLOCKS(parallelism),
+                            min(CUDA_NUM_THREADS, parallelism),
+                            0,
+                            stream>>>(static_cast<int8_t *>(m->valueCache) +
+                                          i * vt_req_block_size,
+                                      m->valueCacheScales + scales_offset,
+                                      value_scratch,
+                                      num_slots,
+                                      m->hidden_size,
+                                      m->vProjSize);
+      key_cache = key_scratch;
+      value_cache = value_scratch;
+    }
     // Step 1: compute query-key product QK.T/sqrt(d_k)
     {
       // Scale by sqrt(d_k) as per the original attention paper
@@ -944,7 +1127,7 @@ void compute_attention_kernel_prompt(IncMultiHeadSelfAttentionMeta const *m,
       }
       // after transpositions
       int m_ = num_new_tokens;
-      int n = total_tokens;
+      int n = num_slots;
       int k = m->qProjSize;
       // before transpositions
       int lda = k * m->num_q_heads * QKV_WEIGHT_NUM, ldb = k * m->num_q_heads,
@@ -952,7 +1135,7 @@ void compute_attention_kernel_prompt(IncMultiHeadSelfAttentionMeta const *m,
       // N.B. strides are applied before transpose operations
       int strideA = q_block_size;
       int strideB = kt_block_size;
-      int strideC = num_new_tokens * total_tokens;
+      int strideC = num_new_tokens * num_slots;
 
       // matrix A: devQKVProjArray
       // matrix A's layout: [qProjSize, num_heads, 3, num_new_tokens]
@@ -961,12 +1144,12 @@ void compute_attention_kernel_prompt(IncMultiHeadSelfAttentionMeta const *m,
                     bc->requestsInfo[i].first_token_offset_in_batch *
                         m->qProjSize * m->num_q_heads * QKV_WEIGHT_NUM;
       // matrix B: key cache
-      // matrix B's layout: [kProjSize * num_heads, total_tokens]
+      // matrix B's layout: [kProjSize * num_heads, num_slots]
       // To get B, skip over K entries from previous requests (all heads +
       // padding)
-      DT const *B = static_cast<DT *>(m->keyCache) + i * kt_req_block_size;
+      DT const *B = key_cache;
       // matrix C: qk_prods
-      // matrix C's layout: [num_new_tokens, total_tokens, num_heads]
+      // matrix C's layout: [num_new_tokens, num_slots, num_heads]
       // To get C, skip over QK.T products from previous requests
       DT *C = static_cast<DT *>(m->qk_prods);
       checkCUDA(cublasGemmStridedBatchedEx(m->handle.blas,
@@ -995,17 +1178,17 @@ void compute_attention_kernel_prompt(IncMultiHeadSelfAttentionMeta const *m,
     }
     // Step 2: Add alibi position bias to qk production
     // matrix C: qk_prods
-    // matrix C's layout: [num_new_tokens, total_tokens, num_heads]
+    // matrix C's layout: [num_new_tokens, num_slots, num_heads]
     // To get C, skip over QK.T products from previous requests
     DT *C = static_cast<DT *>(m->qk_prods);
     if (*m->position_bias) {
-      size_t parallelism = m->num_q_heads * total_tokens * num_new_tokens;
+      size_t parallelism = m->num_q_heads * num_slots * num_new_tokens;
       apply_position_bias_qkprd<<<GET_BLOCKS(parallelism),
                                   min((size_t)CUDA_NUM_THREADS, parallelism),
                                   0,
                                   stream>>>(C,
                                             num_new_tokens,
-                                            total_tokens,
+                                            num_slots,
                                             m->num_q_heads,
                                             m->global_num_q_heads,
                                             shard_id);
@@ -1013,16 +1196,28 @@ void compute_attention_kernel_prompt(IncMultiHeadSelfAttentionMeta const *m,
 
     // Step 3: Apply causal mask. Fill all elements above diagonal in qk prods
     // with -inf to force causal attention.
-    assert(num_new_tokens <= total_tokens);
+    assert(num_new_tokens <= num_slots);
     size_t entries_above_diagonal = num_new_tokens * (num_new_tokens - 1) / 2;
-    if (entries_above_diagonal > 0) {
+    if (m->kv_cache_window.enabled() && entries_above_diagonal > 0) {
+      // the slots are not in the order of the positions
+      size_t parallelism = m->num_q_heads * num_slots * num_new_tokens;
+      mask_kv_cache_window<<<GET_BLOCKS(parallelism),
+                             min((size_t)CUDA_NUM_THREADS, parallelism),
+                             0,
+                             stream>>>(C,
+                                       m->kv_cache_window,
+                                       num_new_tokens,
+                                       total_tokens,
+                                       m->num_q_heads,
+                                       static_cast<DT>(-INFINITY));
+    } else if (entries_above_diagonal > 0) {
       size_t parallelism = m->num_q_heads * entries_above_diagonal;
       fill_entries_above_diagonal<<<GET_BLOCKS(parallelism),
                                     min((size_t)CUDA_NUM_THREADS, parallelism),
                                     0,
                                     stream>>>(C,
                                               num_new_tokens,
-                                              total_tokens,
+                                              num_slots,
                                               m->num_q_heads,
                                               entries_above_diagonal,
                                               static_cast<DT>(-INFINITY));
@@ -1040,7 +1235,7 @@ void compute_attention_kernel_prompt(IncMultiHeadSelfAttentionMeta const *m,
       // columns are the inner dimension and the images are the outermost
       // dimension.
       int n_param = m->num_q_heads;
-      int c_param = total_tokens;
+      int c_param = num_slots;
       int h_param = 1;
       int w_param = num_new_tokens;
       checkCUDNN(cudnnSetTensor4dDescriptor(m->qk_tensor,
@@ -1073,20 +1268,20 @@ void compute_attention_kernel_prompt(IncMultiHeadSelfAttentionMeta const *m,
       // after transpositions
       int m_ = m->vProjSize;
       int n = num_new_tokens;
-      int k = total_tokens;
+      int k = num_slots;
       // before transpositions
       int lda = m_ * m->num_q_heads, ldb = n, ldc = m_ * m->num_q_heads;
       // N.B. strides are applied before transpose operations
       int strideA = vt_block_size;
-      int strideB = num_new_tokens * total_tokens;
+      int strideB = num_new_tokens * num_slots;
       int strideC = m->vProjSize;
       // matrix A: value cache
-      // matrix A's layout: [vProjSize, num_heads, total_tokens]
+      // matrix A's layout: [vProjSize, num_heads, num_slots]
       // To get A, skip over V.T entries from previous requests (all heads +
       // padding)
-      DT *A = static_cast<DT *>(m->valueCache) + i * vt_req_block_size;
+      DT const *A = value_cache;
       // matrix B: qk_prods_softmax
-      // matrix B's layout: [num_new_tokens, total_tokens, num_heads]
+      // matrix B's layout: [num_new_tokens, num_slots, num_heads]
       // To get B, skip over softmax(QK.T/sqrt(d_k)) entries from previous
       // requests (all heads)
       DT *B = static_cast<DT *>(m->qk_prods_softmax);
@@ -1161,9 +1356,10 @@ void IncMultiHeadSelfAttention::inference_kernel_wrapper(
   }
 
   if (input.data_type == DT_HALF) {
-    if (m->offload) {
-      pre_build_weight_kernel<half>(m, weight, input.data_type, stream);
-    }
+    half const *weight_ptr =
+        m->offload
+            ? pre_build_weight_kernel<half>(m, weight, input.data_type, stream)
+            : weight.get_half_ptr();
     half const *bias_ptr =
         use_bias ? bias.get_half_ptr() : static_cast<half const *>(nullptr);
     Kernels::IncMultiHeadAttention::inference_kernel(
@@ -1171,14 +1367,15 @@ void IncMultiHeadSelfAttention::inference_kernel_wrapper(
         bc,
         shard_id,
         input.get_half_ptr(),
-        m->offload ? static_cast<half *>(m->weight_ptr) : weight.get_half_ptr(),
+        weight_ptr,
         output.get_half_ptr(),
         bias_ptr,
         stream);
   } else if (input.data_type == DT_FLOAT) {
-    if (m->offload) {
-      pre_build_weight_kernel<float>(m, weight, input.data_type, stream);
-    }
+    float const *weight_ptr =
+        m->offload
+            ? pre_build_weight_kernel<float>(m, weight, input.data_type, stream)
+            : weight.get_float_ptr();
     float const *bias_ptr =
         use_bias ? bias.get_float_ptr() : static_cast<float const *>(nullptr);
     Kernels::IncMultiHeadAttention::inference_kernel(
@@ -1186,14 +1383,17 @@ void IncMultiHeadSelfAttention::inference_kernel_wrapper(
         bc,
         shard_id,
         input.get_float_ptr(),
-        m->offload ? static_cast<float *>(m->weight_ptr)
-                   : weight.get_float_ptr(),
+        weight_ptr,
         output.get_float_ptr(),
         bias_ptr,
         stream);
   } else {
     assert(false && "Unspported data type");
   }
+  if (m->offload && m->quantization_type == DT_NONE) {
+    // Done with the weight staged by pre_build_weight_kernel
+    m->handle.offload_engine->release(weight.ptr, stream);
+  }
 
   if (m->profiling) {
     cudaEventRecord(t_end, stream);
@@ -1287,6 +1487,31 @@ IncMultiHeadSelfAttentionMeta::IncMultiHeadSelfAttentionMeta(
   size_t size_of_dt = data_type_size(attn->data_type);
   quantization_type = _quantization_type;
   offload = _offload;
+  // the speculative and tree-verify kernels read full-precision caches
+  kv_cache_quantization_type = infer_mode == INC_DECODING_MODE
+                                   ? handler.kv_cache_quantization_type
+                                   : DT_NONE;
+  if (handler.kv_cache_quantization_type != DT_NONE &&
+      kv_cache_quantization_type == DT_NONE) {
+    static bool warned = false;
+    if (!warned) {
+      fprintf(stderr,
+              "[Warning] quantized KV caches are only supported in "
+              "incremental decoding, keeping the caches of the speculative "
+              "and tree-verify attention in the data type of the model\n");
+      warned = true;
+    }
+  }
+  keyCacheScales = valueCacheScales = nullptr;
+  kvCacheScratch = nullptr;
+  if (infer_mode == INC_DECODING_MODE) {
+    kv_cache_window = BatchConfig::kv_cache_window();
+  }
+  kv_cache_length = kv_cache_window.cache_length(
+      BatchConfig::max_sequence_length());
+  // ALiBi biases the keys by their index in the cache
+  assert(!(kv_cache_window.enabled() && _position_bias) &&
+         "KV cache windows do not support position biases");
 
   global_num_q_heads = _global_num_q_heads;
   global_num_kv_heads = _global_num_kv_heads;
@@ -1315,6 +1540,9 @@ IncMultiHeadSelfAttentionMeta::IncMultiHeadSelfAttentionMeta(
   //*has_load_weights = false;
   apply_rotary_embedding = (bool *)calloc(1, sizeof(bool));
   *apply_rotary_embedding = _apply_rotary_embedding;
+  // the rotary table is shared by the queries and the keys
+  assert(!_apply_rotary_embedding || qProjSize == kProjSize);
+  rotary_table = nullptr;
   qkv_bias = (bool *)calloc(1, sizeof(bool));
   *qkv_bias = _qkv_bias;
   scaling_query = (bool *)calloc(1, sizeof(bool));
@@ -1327,12 +1555,17 @@ IncMultiHeadSelfAttentionMeta::IncMultiHeadSelfAttentionMeta(
   final_bias = (bool *)calloc(1, sizeof(bool));
   *final_bias = _final_bias;
 
-  // allocate weight and bias in the reserve space for cpu offloading
+  // allocate weight and bias in the reserve space for cpu offloading; the
+  // offload engine stages uncompressed weights itself
   if (offload) {
-    weight_ptr = gpu_mem_allocator.allocate_reserved_untyped(weightSize);
+    if (quantization_type != DT_NONE) {
+      weight_ptr = gpu_mem_allocator.allocate_reserved_untyped(weightSize);
+    }
     bias_ptr = gpu_mem_allocator.allocate_reserved_untyped(biasSize);
   }
 
+  // alive until the copy of the rotary table is done
+  std::vector<float> rotary_table_host;
   // allocate memory for the seqArray and reserve space
   {
     int max_tokens_per_batch = infer_mode == TREE_VERIFY_MODE
@@ -1346,10 +1579,10 @@ IncMultiHeadSelfAttentionMeta::IncMultiHeadSelfAttentionMeta(
       case INC_DECODING_MODE: {
         key_cache_size = num_q_heads * kProjSize *
                          BatchConfig::max_requests_per_batch() *
-                         BatchConfig::max_sequence_length();
+                         kv_cache_length;
         value_cache_size = num_q_heads * vProjSize *
                            BatchConfig::max_requests_per_batch() *
-                           BatchConfig::max_sequence_length();
+                           kv_cache_length;
         break;
       }
       case BEAM_SEARCH_MODE:
@@ -1368,34 +1601,58 @@ IncMultiHeadSelfAttentionMeta::IncMultiHeadSelfAttentionMeta(
       default:
         assert(false && "Unkown inference mode");
     }
+    size_t key_cache_bytes = key_cache_size * size_of_dt;
+    size_t value_cache_bytes = value_cache_size * size_of_dt;
+    // a request of the caches, dequantized for the prompt GEMMs
+    size_t kv_scratch_size = 0;
+    if (kv_cache_quantization_type != DT_NONE) {
+      size_t num_slots =
+          BatchConfig::max_requests_per_batch() * kv_cache_length;
+      key_cache_bytes = kv_cache_bytes(kv_cache_quantization_type,
+                                       attn->data_type,
+                                       num_slots,
+                                       num_q_heads,
+                                       kProjSize);
+      value_cache_bytes = kv_cache_bytes(kv_cache_quantization_type,
+                                         attn->data_type,
+                                         num_slots,
+                                         num_q_heads,
+                                         vProjSize);
+      kv_scratch_size = (key_cache_size + value_cache_size) /
+                        BatchConfig::max_requests_per_batch();
+    }
     size_t requestinfo_size = BatchConfig::max_requests_per_batch();
     // size_t tokeninfo_size = max_tokens_per_batch;
-    size_t qk_prod_size =
-        max_tokens_per_batch * BatchConfig::max_sequence_length() * num_q_heads;
+    size_t qk_prod_size = max_tokens_per_batch * kv_cache_length * num_q_heads;
     size_t attn_heads_size = max_tokens_per_batch * num_q_heads * vProjSize;
     size_t complex_size = (max_tokens_per_batch * (qProjSize * num_q_heads +
                                                    kProjSize * num_q_heads)) /
                           2;
+    // a (cos, sin) pair per position and pair of a head
+    int num_rotary_positions = infer_mode == INC_DECODING_MODE
+                                   ? BatchConfig::max_sequence_length()
+                                   : BatchConfig::max_sequence_length() +
+                                         BatchConfig::max_spec_tree_token_num();
+    size_t rotary_table_bytes =
+        *apply_rotary_embedding
+            ? rotary_table_size(num_rotary_positions, qProjSize) * sizeof(float)
+            : 0;
     size_t totalSize =
-        (qkv_max_proj_size + key_cache_size + value_cache_size +
-         2 * qk_prod_size + attn_heads_size) *
+        (qkv_max_proj_size + 2 * qk_prod_size + attn_heads_size +
+         kv_scratch_size) *
             size_of_dt +
+        key_cache_bytes + value_cache_bytes + rotary_table_bytes +
         complex_size * sizeof(cuFloatComplex); // more components will
                                                // be added here later
     if (offload) {
       // assert that we have enough reserved work space left
-      size_t totalSharedSize =
-          infer_mode == TREE_VERIFY_MODE
-              ? totalSize -
-                    (key_cache_size + value_cache_size + qkv_max_proj_size) *
-                        size_of_dt
-              : totalSize - (key_cache_size + value_cache_size) * size_of_dt;
-
       size_t instance_size =
-          size_of_dt *
           (infer_mode == TREE_VERIFY_MODE
-               ? key_cache_size + value_cache_size + qkv_max_proj_size
-               : key_cache_size + value_cache_size);
+               ? key_cache_bytes + value_cache_bytes +
+                     qkv_max_proj_size * size_of_dt
+               : key_cache_bytes + value_cache_bytes) +
+          rotary_table_bytes;
+      size_t totalSharedSize = totalSize - instance_size;
 
       if (quantization_type != DT_NONE) {
         totalSharedSize += quantized_weightSize;
@@ -1419,10 +1676,28 @@ IncMultiHeadSelfAttentionMeta::IncMultiHeadSelfAttentionMeta(
     }
 
     // use key value cache in all mode.
-    keyCache = gpu_mem_allocator.allocate_instance_untyped(key_cache_size *
-                                                           size_of_dt);
-    valueCache = gpu_mem_allocator.allocate_instance_untyped(value_cache_size *
-                                                             size_of_dt);
+    keyCache = gpu_mem_allocator.allocate_instance_untyped(key_cache_bytes);
+    valueCache = gpu_mem_allocator.allocate_instance_untyped(value_cache_bytes);
+    if (kv_cache_quantization_type != DT_NONE) {
+      // the scales follow the int8 values
+      keyCacheScales = reinterpret_cast<float *>(
+          static_cast<char *>(keyCache) + key_cache_size * sizeof(int8_t));
+      valueCacheScales = reinterpret_cast<float *>(
+          static_cast<char *>(valueCache) + value_cache_size * sizeof(int8_t));
+    }
+    if (rotary_table_bytes > 0) {
+      // computed once, instead of for every token of every step
+      rotary_table_host.resize(rotary_table_bytes / sizeof(float));
+      compute_rotary_table(
+          num_rotary_positions, qProjSize, rotary_table_host.data());
+      rotary_table = static_cast<cuFloatComplex *>(
+          gpu_mem_allocator.allocate_instance_untyped(rotary_table_bytes));
+      checkCUDA(cudaMemcpyAsync(rotary_table,
+                                rotary_table_host.data(),
+                                rotary_table_bytes,
+                                cudaMemcpyHostToDevice,
+                                stream));
+    }
 
     token_infos =
         static_cast<BatchConfig::PerTokenInfo *>(handler.batch_config_metadata);
@@ -1447,6 +1722,10 @@ IncMultiHeadSelfAttentionMeta::IncMultiHeadSelfAttentionMeta(
       complex_input =
           gpu_mem_allocator.allocate_reserved<cuFloatComplex>(complex_size);
       // offset += complex_size * sizeof(cuFloatComplex);
+      if (kv_scratch_size > 0) {
+        kvCacheScratch = gpu_mem_allocator.allocate_reserved_untyped(
+            kv_scratch_size * size_of_dt);
+      }
       // request_infos =
       //     gpu_mem_allocator.allocate_reserved<BatchConfig::PerRequestInfo>(
       //         requestinfo_size);
@@ -1462,17 +1741,17 @@ IncMultiHeadSelfAttentionMeta::IncMultiHeadSelfAttentionMeta(
                                                                size_of_dt);
       complex_input =
           gpu_mem_allocator.allocate_instance<cuFloatComplex>(complex_size);
+      if (kv_scratch_size > 0) {
+        kvCacheScratch = gpu_mem_allocator.allocate_instance_untyped(
+            kv_scratch_size * size_of_dt);
+      }
       // request_infos =
       //     gpu_mem_allocator.allocate_instance<BatchConfig::PerRequestInfo>(
       //         requestinfo_size);
     }
 
-    // allocate more size for quantization data
-    if (quantization_type != DT_NONE) {
-      assert(offload);
-      quantized_weight_ptr =
-          gpu_mem_allocator.allocate_reserved<char>(quantized_weightSize);
-    }
+    // the offload engine stages the quantization data
+    assert(quantization_type == DT_NONE || offload);
     if (!offload) {
       assert(gpu_mem_allocator.reserved_total_size ==
              gpu_mem_allocator.reserved_allocated_size);
@@ -1487,17 +1766,19 @@ IncMultiHeadSelfAttentionMeta::~IncMultiHeadSelfAttentionMeta(void) {
   }
 }
 
-template void Kernels::IncMultiHeadAttention::pre_build_weight_kernel<float>(
-    IncMultiHeadSelfAttentionMeta const *m,
-    GenericTensorAccessorR const weight,
-    DataType data_type,
-    cudaStream_t stream);
+template float const *
+    Kernels::IncMultiHeadAttention::pre_build_weight_kernel<float>(
+        IncMultiHeadSelfAttentionMeta const *m,
+        GenericTensorAccessorR const weight,
+        DataType data_type,
+        cudaStream_t stream);
 
-template void Kernels::IncMultiHeadAttention::pre_build_weight_kernel<half>(
-    IncMultiHeadSelfAttentionMeta const *m,
-    GenericTensorAccessorR const weight,
-    DataType data_type,
-    cudaStream_t stream);
+template half const *
+    Kernels::IncMultiHeadAttention::pre_build_weight_kernel<half>(
+        IncMultiHeadSelfAttentionMeta const *m,
+        GenericTensorAccessorR const weight,
+        DataType data_type,
+        cudaStream_t stream);
 
 template void Kernels::IncMultiHeadAttention::compute_o_prod_bias<float>(
     IncMultiHeadSelfAttentionMeta const *m,
@@ -69,6 +69,39 @@ __global__ void decompress_int8_general_weights(char const *input_weight_ptr,
   }
 }
 
+template <typename DT>
+__global__ void decompress_groupwise_weights(char const *input_weight_ptr,
+                                             DT *weight_ptr,
+                                             bool int4,
+                                             int in_dim,
+                                             int group_size,
+                                             int valueSize) {
+  // Every row is |values|offsets|scales|, and a thread decompresses the
+  // values of one byte
+  int values_per_byte = int4 ? 2 : 1;
+  size_t num_groups = in_dim / group_size;
+  size_t row_bytes = in_dim / values_per_byte + 2 * num_groups * sizeof(DT);
+  CUDA_KERNEL_LOOP(i, valueSize / values_per_byte) {
+    size_t idx = (size_t)i * values_per_byte;
+    size_t row = idx / in_dim, col = idx % in_dim;
+    char const *row_ptr = input_weight_ptr + row * row_bytes;
+    DT const *offsets = (DT const *)(row_ptr + in_dim / values_per_byte);
+    DT const *scales = offsets + num_groups;
+    // group_size is even, so both values of a byte are in the same group
+    size_t group = col / group_size;
+    char value = row_ptr[col / values_per_byte];
+    if (int4) {
+      weight_ptr[idx] =
+          static_cast<DT>((value >> 4) & 0xF) / scales[group] + offsets[group];
+      weight_ptr[idx + 1] =
+          static_cast<DT>(value & 0xF) / scales[group] + offsets[group];
+    } else {
+      weight_ptr[idx] =
+          static_cast<DT>(value & 0xFF) / scales[group] + offsets[group];
+    }
+  }
+}
+
 template <typename DT>
 __global__ void decompress_int4_attention_weights(char *input_weight_ptr,
                                                   DT *weight_ptr,
@@ -213,6 +246,20 @@ template __global__ void decompress_int8_general_weights<float>(
     char const *input_weight_ptr, float *weight_ptr, int in_dim, int valueSize);
 template __global__ void decompress_int8_general_weights<half>(
     char const *input_weight_ptr, half *weight_ptr, int in_dim, int valueSize);
+template __global__ void
+    decompress_groupwise_weights<float>(char const *input_weight_ptr,
+                                        float *weight_ptr,
+                                        bool int4,
+                                        int in_dim,
+                                        int group_size,
+                                        int valueSize);
+template __global__ void
+    decompress_groupwise_weights<half>(char const *input_weight_ptr,
+                                       half *weight_ptr,
+                                       bool int4,
+                                       int in_dim,
+                                       int group_size,
+                                       int valueSize);
 template __global__ void
     decompress_int4_attention_weights<float>(char *input_weight_ptr,
                                              float *weight_ptr,
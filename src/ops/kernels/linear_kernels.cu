@@ -17,6 +17,7 @@
 #include "flexflow/ops/kernels/decompress_kernels.h"
 #include "flexflow/ops/kernels/linear_kernels.h"
 #include "flexflow/utils/cuda_helper.h"
+#include "flexflow/weight_offload.h"
 
 namespace FlexFlow {
 
@@ -27,16 +28,18 @@ LinearMeta::LinearMeta(FFHandler handler,
                        int weightSize)
     : OpMeta(handler, li), weight_ptr(nullptr) {
   DataType data_type = li->data_type;
-  // allocate weight and bias in the reserve space for cpu offloading
-  if (li->offload) {
+  // For cpu offloading, the offload engine stages the weights after the
+  // reserved scratch space, and quantized weights are decompressed to the
+  // scratch space
+  if (li->offload && li->quantization_type != DT_NONE) {
     weight_ptr = gpu_mem_allocator.allocate_reserved_untyped(
         weightSize * data_type_size(data_type));
-    if (li->quantization_type != DT_NONE) {
-      quantized_weightSize = get_quantization_to_byte_size(
-          data_type, li->quantization_type, weightSize);
-      quantized_weight_ptr =
-          gpu_mem_allocator.allocate_reserved<char>(quantized_weightSize);
-    }
+    quantized_weightSize = get_quantization_to_byte_size(
+        data_type,
+        li->quantization_type,
+        weightSize,
+        li->quantization_group_size > 0 ? li->quantization_group_size
+                                        : INT4_NUM_OF_ELEMENTS_PER_GROUP);
   }
   // Allocate an all-one's vector
   gpu_mem_allocator.create_legion_instance(
@@ -275,21 +278,35 @@ void forward_kernel(LinearMeta const *m,
                     int batch_size,
                     ffStream_t stream) {
   // additional processing for uploading weights
+  // Note that we update weight_ptr to the device copy of the weight
+  void const *host_weight_ptr = weight_ptr;
+  WeightOffloadEngine *engine = m->handle.offload_engine;
   if (m->offload) {
-    // Note that we update weight_ptr when uploading weight
+    assert(engine != nullptr);
     if (m->quantization_type != DT_NONE) {
-      cudaMemcpyAsync(m->quantized_weight_ptr,
-                      weight_ptr,
-                      m->quantized_weightSize,
-                      cudaMemcpyHostToDevice,
-                      stream);
-      if (m->quantization_type == DT_INT4) {
+      char *quantized_weight_ptr = static_cast<char *>(
+          engine->acquire(host_weight_ptr, m->quantized_weightSize, stream));
+      if (m->quantization_group_size > 0) {
+        int parallelism = m->quantization_type == DT_INT4
+                              ? in_dim * out_dim / 2
+                              : in_dim * out_dim;
+        decompress_groupwise_weights<DT>
+            <<<GET_BLOCKS(parallelism),
+               min(CUDA_NUM_THREADS, parallelism),
+               0,
+               stream>>>(quantized_weight_ptr,
+                         static_cast<DT *>(m->weight_ptr),
+                         m->quantization_type == DT_INT4,
+                         in_dim,
+                         m->quantization_group_size,
+                         in_dim * out_dim);
+      } else if (m->quantization_type == DT_INT4) {
         int parallelism = in_dim * out_dim / 2;
         decompress_int4_general_weights<DT>
             <<<GET_BLOCKS(parallelism),
                min(CUDA_NUM_THREADS, parallelism),
                0,
-               stream>>>(m->quantized_weight_ptr,
+               stream>>>(quantized_weight_ptr,
                          static_cast<DT *>(m->weight_ptr),
                          in_dim,
                          in_dim * out_dim);
@@ -300,18 +317,17 @@ void forward_kernel(LinearMeta const *m,
             <<<GET_BLOCKS(parallelism),
                min(CUDA_NUM_THREADS, parallelism),
                0,
-               stream>>>(m->quantized_weight_ptr,
+               stream>>>(quantized_weight_ptr,
                          static_cast<DT *>(m->weight_ptr),
                          in_dim,
                          in_dim * out_dim);
       }
-
+      // The slot of the compressed weight can take a later layer already
+      engine->release(host_weight_ptr, stream);
+      weight_ptr = m->weight_ptr;
     } else {
-      cudaMemcpyAsync(m->weight_ptr,
-                      weight_ptr,
-                      in_dim * out_dim * sizeof(DT),
-                      cudaMemcpyHostToDevice,
-                      stream);
+      weight_ptr = engine->acquire(
+          host_weight_ptr, in_dim * out_dim * sizeof(DT), stream);
     }
   }
   checkCUDA(cublasSetStream(m->handle.blas, stream));
@@ -341,7 +357,7 @@ void forward_kernel(LinearMeta const *m,
                          batch_size,
                          in_dim,
                          &alpha,
-                         m->offload ? m->weight_ptr : weight_ptr,
+                         weight_ptr,
                          weight_type,
                          in_dim,
                          input_ptr,
@@ -353,6 +369,9 @@ void forward_kernel(LinearMeta const *m,
                          out_dim,
                          compute_type,
                          CUBLAS_GEMM_DEFAULT_TENSOR_OP));
+  if (m->offload && m->quantization_type == DT_NONE) {
+    engine->release(host_weight_ptr, stream);
+  }
   // use_bias = True
   if (bias_ptr != NULL) {
     // fuse bias and relu
@@ -4,6 +4,7 @@
 #include "flexflow/model.h"
 #include "flexflow/ops/kernels/linear_kernels.h"
 #include "flexflow/utils/hash_utils.h"
+#include "flexflow/weight_offload.h"
 #include "legion/legion_utilities.h"
 
 namespace FlexFlow {
@@ -48,6 +49,8 @@ Tensor FFModel::dense(const Tensor input,
     data_type = input->data_type;
   }
   DataType quantization_type = cpu_offload ? config.quantization_type : DT_NONE;
+  int quantization_group_size =
+      quantization_type == DT_NONE ? 0 : config.quantization_group_size;
   bool offload = cpu_offload;
   Layer *li = nullptr;
   if (data_type != input->data_type) {
@@ -84,8 +87,15 @@ Tensor FFModel::dense(const Tensor input,
   {
     int dims[2] = {input->dims[0], outDim};
     if (quantization_type != DT_NONE) {
-      dims[0] =
-          get_quantization_to_byte_size(data_type, quantization_type, dims[0]);
+      // Group-wise quantized weights keep the groups of a row together
+      assert(quantization_group_size == 0 ||
+             dims[0] % quantization_group_size == 0);
+      dims[0] = get_quantization_to_byte_size(
+          data_type,
+          quantization_type,
+          dims[0],
+          quantization_group_size > 0 ? quantization_group_size
+                                      : INT4_NUM_OF_ELEMENTS_PER_GROUP);
     }
     li->weights[KERNEL_IDX] = create_weight_legion_ordering(
         2,
@@ -112,6 +122,7 @@ Tensor FFModel::dense(const Tensor input,
   li->add_int_property("kernel_reg_type", kernel_reg_type);
   li->add_float_property("kernel_reg_lambda", kernel_reg_lambda);
   li->add_int_property("quantization_type", quantization_type);
+  li->add_int_property("quantization_group_size", quantization_group_size);
   li->add_int_property("offload", offload);
   layers.push_back(li);
   return li->outputs[0];
@@ -134,6 +145,8 @@ Op *Linear::create_operator_from_layer(
   layer->get_float_property("kernel_reg_lambda", kernel_reg_lambda);
   layer->get_int_property("quantization_type", value);
   DataType quantization_type = (DataType)value;
+  layer->get_int_property("quantization_group_size", value);
+  int quantization_group_size = value;
   layer->get_int_property("offload", value);
   bool offload = (bool)value;
   return new Linear(model,
@@ -146,6 +159,7 @@ Op *Linear::create_operator_from_layer(
                     use_bias,
                     layer->data_type,
                     quantization_type,
+                    quantization_group_size,
                     offload,
                     false /*allocate_weights*/,
                     layer->name);
@@ -169,6 +183,7 @@ Linear::Linear(FFModel &model,
              other.use_bias,
              other.data_type,
              other.quantization_type,
+             other.quantization_group_size,
              other.offload,
              allocate_weights,
              other.name) {}
@@ -188,6 +203,7 @@ Linear::Linear(FFModel &model,
              params.use_bias,
              params.data_type,
              params.quantization_type,
+             params.quantization_group_size,
              params.offload,
              allocate_weights,
              params.name) {}
@@ -202,6 +218,7 @@ Linear::Linear(FFModel &model,
                bool _use_bias,
                DataType _data_type,
                DataType _quantization_type,
+               int _quantization_group_size,
                bool _offload,
                bool allocate_weights,
                char const *name)
@@ -216,7 +233,8 @@ Linear::Linear(FFModel &model,
          _input),
       out_channels(out_dim), activation(_activation), use_bias(_use_bias),
       kernel_reg_type(_kernel_reg_type), kernel_reg_lambda(_kernel_reg_lambda),
-      quantization_type(_quantization_type), offload(_offload),
+      quantization_type(_quantization_type),
+      quantization_group_size(_quantization_group_size), offload(_offload),
       replica(ParallelTensorBase::NO_TENSOR) {
   // overwrite layer_guid
   layer_guid = _layer_guid;
@@ -252,7 +270,11 @@ Linear::Linear(FFModel &model,
     Initializer *kernel_initializer = new GlorotUniform(std::rand() /*seed*/);
     if (quantization_type != DT_NONE) {
       kernel_shape.dims[0].size = get_quantization_to_byte_size(
-          data_type, quantization_type, kernel_shape.dims[0].size);
+          data_type,
+          quantization_type,
+          kernel_shape.dims[0].size,
+          quantization_group_size > 0 ? quantization_group_size
+                                      : INT4_NUM_OF_ELEMENTS_PER_GROUP);
     }
     weights[KERNEL_IDX] = model.create_parallel_weight_legion_ordering(
         kernel_shape.num_dims,
@@ -494,6 +516,10 @@ OpMeta *Linear::init_task_with_dim(Task const *task,
 
   LinearMeta *m = new LinearMeta(
       handle, batch_size, linear, gpu_mem_allocator, in_dim * out_dim);
+  if (linear->offload && handle.offload_engine != nullptr) {
+    handle.offload_engine->reserve_scratch(
+        gpu_mem_allocator.reserved_allocated_size);
+  }
   m->activation = linear->activation;
   m->kernel_reg_type = linear->kernel_reg_type;
   m->kernel_reg_lambda = linear->kernel_reg_lambda;
@@ -504,6 +530,7 @@ OpMeta *Linear::init_task_with_dim(Task const *task,
   m->trainableInputs[0] = linear->trainableInputs[0];
   m->weight_ptr_type = m->input_type[0];
   m->quantization_type = linear->quantization_type;
+  m->quantization_group_size = linear->quantization_group_size;
   m->offload = linear->offload;
   std::strcpy(m->op_name, linear->name);
   m->layer_guid = linear->layer_guid;
@@ -1239,7 +1266,9 @@ bool operator==(LinearParams const &lhs, LinearParams const &rhs) {
          lhs.out_channels == rhs.out_channels && lhs.use_bias == rhs.use_bias &&
          lhs.data_type == rhs.data_type && lhs.activation == rhs.activation &&
          lhs.kernel_reg_type == rhs.kernel_reg_type &&
-         lhs.kernel_reg_lambda == rhs.kernel_reg_lambda;
+         lhs.kernel_reg_lambda == rhs.kernel_reg_lambda &&
+         lhs.quantization_type == rhs.quantization_type &&
+         lhs.quantization_group_size == rhs.quantization_group_size;
 }
 
 void Linear::serialize(Legion::Serializer &sez) const {
@@ -1253,6 +1282,7 @@ void Linear::serialize(Legion::Serializer &sez) const {
   sez.serialize(this->use_bias);
   sez.serialize(this->data_type);
   sez.serialize(this->quantization_type);
+  sez.serialize(this->quantization_group_size);
   sez.serialize(this->offload);
   sez.serialize(strlen(this->name));
   sez.serialize(this->name, strlen(this->name));
@@ -1272,6 +1302,7 @@ Node Linear::deserialize(FFModel &ff,
   bool use_bias;
   DataType data_type;
   DataType quantization_type;
+  int quantization_group_size;
   bool offload;
   size_t id, transformer_layer_id, deserialized_model_id;
   dez.deserialize(id);
@@ -1285,6 +1316,7 @@ Node Linear::deserialize(FFModel &ff,
   dez.deserialize(use_bias);
   dez.deserialize(data_type);
   dez.deserialize(quantization_type);
+  dez.deserialize(quantization_group_size);
   dez.deserialize(offload);
   size_t name_len;
   char name[MAX_OPNAME] = {0};
@@ -1300,6 +1332,7 @@ Node Linear::deserialize(FFModel &ff,
   params.data_type = data_type;
   params.layer_guid = layer_guid;
   params.quantization_type = quantization_type;
+  params.quantization_group_size = quantization_group_size;
   params.offload = offload;
   strcpy(params.name, name);
   return ff.get_or_create_node<Linear>(inputs[0], params);
@@ -1315,6 +1348,7 @@ LinearParams Linear::get_params() const {
   params.kernel_reg_type = this->kernel_reg_type;
   params.kernel_reg_lambda = this->kernel_reg_lambda;
   params.quantization_type = this->quantization_type;
+  params.quantization_group_size = this->quantization_group_size;
   params.offload = this->offload;
   if (this->name != nullptr) {
     strcpy(params.name, this->name);
@@ -1617,6 +1651,7 @@ size_t hash<FlexFlow::LinearParams>::operator()(
   hash_combine(key, params.kernel_reg_type);
   hash_combine(key, params.kernel_reg_lambda);
   hash_combine(key, params.quantization_type);
+  hash_combine(key, params.quantization_group_size);
   hash_combine(key, params.offload);
   return key;
 }
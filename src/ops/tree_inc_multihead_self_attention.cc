@@ -22,6 +22,7 @@
 #include "flexflow/utils/hip_helper.h"
 #endif
 #include "flexflow/utils/hash_utils.h"
+#include "flexflow/weight_offload.h"
 #include "legion/legion_utilities.h"
 
 namespace FlexFlow {
@@ -716,6 +717,10 @@ OpMeta *TreeIncMultiHeadSelfAttention::init_task(
                                             num_samples,
                                             num_q_heads,
                                             num_kv_heads);
+  if (attn->offload && handle.offload_engine != nullptr) {
+    handle.offload_engine->reserve_scratch(
+        gpu_mem_allocator.reserved_allocated_size);
+  }
   if (!attn->offload) {
     // assert that we didn't over allocate memory
     assert(gpu_mem_allocator.reserved_allocated_size ==
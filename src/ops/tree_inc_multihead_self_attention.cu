@@ -20,6 +20,7 @@
 #include "flexflow/ops/kernels/inc_multihead_self_attention_utils.cuh"
 #include "flexflow/ops/tree_inc_multihead_self_attention.h"
 #include "flexflow/utils/cuda_helper.h"
+#include "flexflow/weight_offload.h"
 
 namespace FlexFlow {
 
@@ -878,21 +879,12 @@ void inference_kernel(TreeIncMultiHeadSelfAttentionMeta *m,
                       DT *output_ptr,
                       DT const *bias_ptr,
                       cudaStream_t stream) {
-  // additional processing for weight uploading
-  if (m->handle.offload_reserve_space != nullptr) {
-    // Note that we update weight_ptr and bias_ptr when uploading weight and
-    // bias
-    cudaMemcpyAsync(m->weight_ptr,
-                    weight_ptr,
-                    m->weightSize,
-                    cudaMemcpyHostToDevice,
-                    stream);
-    weight_ptr = static_cast<DT *>(m->weight_ptr);
-    if (m->biasSize > 0) {
-      cudaMemcpyAsync(
-          m->bias_ptr, bias_ptr, m->biasSize, cudaMemcpyHostToDevice, stream);
-      bias_ptr = static_cast<DT *>(m->bias_ptr);
-    }
+  // additional processing for bias uploading; pre_build_weight_kernel has
+  // staged the weight already
+  if (m->offload && m->biasSize > 0) {
+    cudaMemcpyAsync(
+        m->bias_ptr, bias_ptr, m->biasSize, cudaMemcpyHostToDevice, stream);
+    bias_ptr = static_cast<DT *>(m->bias_ptr);
   }
 
   // copy committed tokens info to GPU for the commit_tokens kernel
@@ -973,9 +965,10 @@ void TreeIncMultiHeadSelfAttention::inference_kernel_wrapper(
   }
 
   if (input.data_type == DT_HALF) {
-    if (m->offload) {
-      pre_build_weight_kernel<half>(m, weight, input.data_type, stream);
-    }
+    half const *weight_ptr =
+        m->offload
+            ? pre_build_weight_kernel<half>(m, weight, input.data_type, stream)
+            : weight.get_half_ptr();
 
     half const *bias_ptr =
         use_bias ? bias.get_half_ptr() : static_cast<half const *>(nullptr);
@@ -984,14 +977,15 @@ void TreeIncMultiHeadSelfAttention::inference_kernel_wrapper(
         bc,
         shard_id,
         input.get_half_ptr(),
-        m->offload ? static_cast<half *>(m->weight_ptr) : weight.get_half_ptr(),
+        weight_ptr,
         output.get_half_ptr(),
         bias_ptr,
         stream);
   } else if (input.data_type == DT_FLOAT) {
-    if (m->offload) {
-      pre_build_weight_kernel<float>(m, weight, input.data_type, stream);
-    }
+    float const *weight_ptr =
+        m->offload
+            ? pre_build_weight_kernel<float>(m, weight, input.data_type, stream)
+            : weight.get_float_ptr();
     float const *bias_ptr =
         use_bias ? bias.get_float_ptr() : static_cast<float const *>(nullptr);
     Kernels::TreeIncMultiHeadAttention::inference_kernel(
@@ -999,14 +993,17 @@ void TreeIncMultiHeadSelfAttention::inference_kernel_wrapper(
         bc,
         shard_id,
         input.get_float_ptr(),
-        m->offload ? static_cast<float *>(m->weight_ptr)
-                   : weight.get_float_ptr(),
+        weight_ptr,
         output.get_float_ptr(),
         bias_ptr,
         stream);
   } else {
     assert(false && "Unspported data type");
   }
+  if (m->offload && m->quantization_type == DT_NONE) {
+    // Done with the weight staged by pre_build_weight_kernel
+    m->handle.offload_engine->release(weight.ptr, stream);
+  }
 
   if (m->profiling) {
     cudaEventRecord(t_end, stream);
@@ -0,0 +1,114 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/activation_memory_planner.h"
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <map>
+
+namespace FlexFlow {
+
+namespace {
+
+size_t align_up(size_t size, size_t alignment) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+bool overlaps(ActivationInterval const &a, ActivationInterval const &b) {
+  return a.first_use <= b.last_use && b.first_use <= a.last_use;
+}
+
+} // namespace
+
+ActivationMemoryPlan
+    plan_activation_memory(std::vector<ActivationInterval> const &intervals,
+                           size_t alignment) {
+  assert(alignment > 0);
+  ActivationMemoryPlan plan;
+  plan.offsets.resize(intervals.size(), 0);
+  int num_arenas = 0;
+  for (ActivationInterval const &it : intervals) {
+    assert(it.arena >= 0 && it.first_use <= it.last_use);
+    num_arenas = std::max(num_arenas, it.arena + 1);
+  }
+  plan.arena_sizes.resize(num_arenas, 0);
+
+  // Naive and live peaks: a sweep over the start and end of each interval
+  std::vector<size_t> naive(num_arenas, 0);
+  std::vector<std::map<int, long long>> deltas(num_arenas);
+  for (ActivationInterval const &it : intervals) {
+    size_t size = align_up(it.size, alignment);
+    naive[it.arena] += size;
+    deltas[it.arena][it.first_use] += size;
+    deltas[it.arena][it.last_use + 1] -= size;
+  }
+  for (int arena = 0; arena < num_arenas; arena++) {
+    plan.naive_peak = std::max(plan.naive_peak, naive[arena]);
+    long long live = 0;
+    for (auto const &d : deltas[arena]) {
+      live += d.second;
+      plan.live_peak = std::max(plan.live_peak, static_cast<size_t>(live));
+    }
+  }
+
+  std::vector<size_t> order(intervals.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    if (intervals[a].size != intervals[b].size) {
+      return intervals[a].size > intervals[b].size;
+    }
+    return intervals[a].first_use < intervals[b].first_use;
+  });
+  std::vector<std::vector<size_t>> placed(num_arenas);
+  for (size_t idx : order) {
+    ActivationInterval const &cur = intervals[idx];
+    size_t size = align_up(cur.size, alignment);
+    // Buffers already placed that are live at the same time, by offset
+    std::vector<size_t> conflicts;
+    for (size_t other : placed[cur.arena]) {
+      if (overlaps(cur, intervals[other])) {
+        conflicts.push_back(other);
+      }
+    }
+    std::sort(conflicts.begin(), conflicts.end(), [&](size_t a, size_t b) {
+      return plan.offsets[a] < plan.offsets[b];
+    });
+    size_t best_offset = 0, best_gap = std::numeric_limits<size_t>::max();
+    size_t end = 0;
+    bool fits_in_gap = false;
+    for (size_t other : conflicts) {
+      size_t gap_end = plan.offsets[other];
+      if (gap_end >= end + size && gap_end - end < best_gap) {
+        best_offset = end;
+        best_gap = gap_end - end;
+        fits_in_gap = true;
+      }
+      end = std::max(end, gap_end + align_up(intervals[other].size, alignment));
+    }
+    plan.offsets[idx] = fits_in_gap ? best_offset : end;
+    placed[cur.arena].push_back(idx);
+    plan.arena_sizes[cur.arena] =
+        std::max(plan.arena_sizes[cur.arena], plan.offsets[idx] + size);
+  }
+  for (size_t size : plan.arena_sizes) {
+    plan.planned_peak = std::max(plan.planned_peak, size);
+  }
+  return plan;
+}
+
+}; // namespace FlexFlow
@@ -0,0 +1,336 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/analytical_cost_model.h"
+#include "flexflow/batch_config.h"
+#include "flexflow/ffconst_utils.h"
+#include "flexflow/model.h"
+#include "flexflow/utils/hash_utils.h"
+
+namespace FlexFlow {
+
+LegionRuntime::Logger::Category log_cost_model("cost_model");
+
+AnalyticalCostModel::AnalyticalCostModel(MachineModel *_machine,
+                                         CompMode comp_mode)
+    : machine(_machine), computationMode(comp_mode), database(nullptr) {}
+
+namespace {
+
+// Data type of the values an operator computes on
+DataType compute_data_type(Op const *op) {
+  return op->numOutputs > 0 ? op->outputs[0]->data_type : op->data_type;
+}
+
+// Number of elements in the shard of a tensor owned by a single device
+size_t shard_volume(ParallelTensor const tensor) {
+  ParallelTensorShape shape = tensor->get_shape();
+  return shape.get_piece_size() / data_type_size(shape.data_type);
+}
+
+size_t shard_bytes(ParallelTensor const tensor) {
+  return tensor->get_shape().get_piece_size();
+}
+
+// Size of the innermost dimension of a tensor shard, which is the reduction
+// dimension of linear and batch matmul operators
+size_t shard_dim(ParallelTensor const tensor, int dim) {
+  ParallelDim const &d = tensor->dims[dim];
+  return d.size / d.degree;
+}
+
+// Fraction of an attention operator's heads that live on one device
+double head_fraction(Op const *op) {
+  if (op->numWeights == 0) {
+    return 1.0;
+  }
+  ParallelTensor const weight = op->weights[0];
+  size_t full = 1;
+  for (int i = 0; i < weight->num_dims; i++) {
+    if (!weight->dims[i].is_replica_dim) {
+      full *= weight->dims[i].size;
+    }
+  }
+  return (double)shard_volume(weight) / full;
+}
+
+// Rough number of FLOPs per output element of memory-bound operators
+double flops_per_element(OperatorType op_type) {
+  switch (op_type) {
+    case OP_SOFTMAX:
+      return 5.0;
+    case OP_LAYERNORM:
+    case OP_RESIDUAL_LAYERNORM:
+    case OP_ADD_BIAS_RESIDUAL_LAYERNORM:
+      return 8.0;
+    case OP_RMS_NORM:
+    case OP_RESIDUAL_RMS_NORM:
+    case OP_SIGMOID_SILU_MULTI:
+    case OP_GELU:
+      return 4.0;
+    default:
+      return 1.0;
+  }
+}
+
+} // namespace
+
+CompDevice const *
+    AnalyticalCostModel::get_device(MachineView const &view) const {
+  if (view.device_type == MachineView::GPU) {
+    return machine->get_gpu(view.start_device_id);
+  }
+  return machine->get_cpu(view.start_device_id);
+}
+
+OpWorkload AnalyticalCostModel::get_workload(Op const *op,
+                                             MachineView const &view) const {
+  OpWorkload w;
+  if (op->is_parallel_op()) {
+    // Parallel ops only move data, which is accounted for by the simulator
+    // as transfers between machine views
+    return w;
+  }
+  for (int i = 0; i < op->numInputs; i++) {
+    w.inputs_memory += shard_bytes(op->inputs[i]);
+  }
+  for (int i = 0; i < op->numOutputs; i++) {
+    w.outputs_memory += shard_bytes(op->outputs[i]);
+  }
+  for (int i = 0; i < op->numWeights; i++) {
+    w.weights_memory += shard_bytes(op->weights[i]);
+  }
+  if (op->op_type == OP_INPUT || op->op_type == OP_WEIGHT ||
+      op->op_type == OP_NOOP) {
+    w.inputs_memory = 0;
+    return w;
+  }
+  size_t output_volume = op->numOutputs > 0 ? shard_volume(op->outputs[0]) : 0;
+  tl::optional<OperatorParameters> params = get_op_parameters(op);
+  // By default, an operator reads its inputs and weights and writes its
+  // outputs once, and the backward pass touches twice as much data
+  w.forward_bytes = w.inputs_memory + w.outputs_memory + w.weights_memory;
+  w.backward_bytes = 2 * w.forward_bytes;
+  switch (op->op_type) {
+    case OP_LINEAR: {
+      double in_channels = shard_dim(op->inputs[0], 0);
+      w.forward_flops = 2.0 * output_volume * in_channels;
+      // gradients w.r.t. both the input and the kernel
+      w.backward_flops = 2.0 * w.forward_flops;
+      break;
+    }
+    case OP_BATCHMATMUL: {
+      double k = shard_dim(op->inputs[0], 0);
+      w.forward_flops = 2.0 * output_volume * k;
+      w.backward_flops = 2.0 * w.forward_flops;
+      break;
+    }
+    case OP_CONV2D: {
+      assert(params.has_value());
+      Conv2DParams const &conv = mp::get<Conv2DParams>(params.value());
+      // NCHW tensors are stored with the channel at dims[2]
+      double in_channels = shard_dim(op->inputs[0], 2) / conv.groups;
+      w.forward_flops =
+          2.0 * output_volume * in_channels * conv.kernel_h * conv.kernel_w;
+      w.backward_flops = 2.0 * w.forward_flops;
+      break;
+    }
+    case OP_POOL2D: {
+      assert(params.has_value());
+      Pool2DParams const &pool = mp::get<Pool2DParams>(params.value());
+      w.forward_flops = (double)output_volume * pool.kernel_h * pool.kernel_w;
+      w.backward_flops = w.forward_flops;
+      break;
+    }
+    case OP_MULTIHEAD_ATTENTION: {
+      assert(params.has_value());
+      MultiHeadAttentionParams const &attn =
+          mp::get<MultiHeadAttentionParams>(params.value());
+      double num_tokens =
+          shard_volume(op->inputs[0]) / (double)shard_dim(op->inputs[0], 0);
+      double seq_length = shard_dim(op->inputs[0], 1);
+      double weight_volume = w.weights_memory / data_type_size(op->data_type);
+      // QKV and output projections plus QK^T and AV
+      w.forward_flops = 2.0 * num_tokens * weight_volume +
+                        4.0 * num_tokens * seq_length * attn.kdim *
+                            attn.num_heads * head_fraction(op);
+      w.backward_flops = 2.0 * w.forward_flops;
+      break;
+    }
+    case OP_INC_MULTIHEAD_SELF_ATTENTION:
+    case OP_SPEC_INC_MULTIHEAD_SELF_ATTENTION:
+    case OP_TREE_INC_MULTIHEAD_SELF_ATTENTION: {
+      assert(params.has_value());
+      int kdim = 0, num_q_heads = 0, num_kv_heads = 0;
+      if (op->op_type == OP_INC_MULTIHEAD_SELF_ATTENTION) {
+        auto const &attn =
+            mp::get<IncMultiHeadSelfAttentionParams>(params.value());
+        kdim = attn.kdim;
+        num_q_heads = attn.num_q_heads;
+        num_kv_heads = attn.num_kv_heads;
+      } else if (op->op_type == OP_SPEC_INC_MULTIHEAD_SELF_ATTENTION) {
+        auto const &attn =
+            mp::get<SpecIncMultiHeadSelfAttentionParams>(params.value());
+        kdim = attn.kdim;
+        num_q_heads = attn.num_q_heads;
+        num_kv_heads = attn.num_kv_heads;
+      } else {
+        auto const &attn =
+            mp::get<TreeIncMultiHeadSelfAttentionParams>(params.value());
+        kdim = attn.kdim;
+        num_q_heads = attn.num_q_heads;
+        num_kv_heads = attn.num_kv_heads;
+      }
+      double num_tokens =
+          shard_volume(op->inputs[0]) / (double)shard_dim(op->inputs[0], 0);
+      double weight_volume = w.weights_memory / data_type_size(op->data_type);
+      // Assume on average half of the context is cached for every token
+      double context = BatchConfig::max_sequence_length() / 2.0;
+      double fraction = head_fraction(op);
+      w.forward_flops = 2.0 * num_tokens * weight_volume +
+                        4.0 * num_tokens * context * kdim * num_q_heads *
+                            fraction;
+      // Reading the key/value cache dominates decoding
+      w.forward_bytes += 2.0 * num_tokens * context * kdim * num_kv_heads *
+                         fraction * data_type_size(op->data_type);
+      w.backward_flops = 0;
+      w.backward_bytes = 0;
+      break;
+    }
+    case OP_EMBEDDING: {
+      // A gather reads one row per output row; the weight table itself is not
+      // streamed
+      w.forward_bytes = w.inputs_memory + 2.0 * w.outputs_memory;
+      w.backward_flops = output_volume;
+      w.backward_bytes = w.inputs_memory + 3.0 * w.outputs_memory;
+      break;
+    }
+    case OP_RESHAPE:
+    case OP_FLAT:
+    case OP_TRANSPOSE:
+    case OP_CONCAT:
+    case OP_SPLIT:
+    case OP_CAST:
+    case OP_GATHER: {
+      // pure data movement
+      break;
+    }
+    default: {
+      w.forward_flops = flops_per_element(op->op_type) * output_volume;
+      w.backward_flops = 2.0 * w.forward_flops;
+      break;
+    }
+  }
+  if (computationMode != COMP_MODE_TRAINING) {
+    w.backward_flops = 0;
+    w.backward_bytes = 0;
+  } else {
+    // gradients are as large as the tensors themselves
+    w.inputs_memory *= 2;
+    w.outputs_memory *= 2;
+    w.weights_memory *= 2;
+  }
+  return w;
+}
+
+bool AnalyticalCostModel::estimate_operator_cost(
+    Op const *op, MachineView const &view, CostMetrics &cost_metrics) const {
+  OpWorkload w = get_workload(op, view);
+  cost_metrics = CostMetrics();
+  cost_metrics.inputs_memory = w.inputs_memory;
+  cost_metrics.outputs_memory = w.outputs_memory;
+  cost_metrics.weights_memory = w.weights_memory;
+  if (database != nullptr) {
+    CostRecord record = make_record(op, view, cost_metrics);
+    CostRecord const *hit = database->find_record(
+        record.op_type, record.params_hash, record.view_hash);
+    if (hit != nullptr) {
+      cost_metrics.forward_time = hit->forward_time;
+      cost_metrics.backward_time = hit->backward_time;
+      return true;
+    }
+  }
+  CompDevice const *device = get_device(view);
+  DataType data_type = compute_data_type(op);
+  cost_metrics.forward_time =
+      device->roofline.time(w.forward_flops, w.forward_bytes, data_type);
+  cost_metrics.backward_time =
+      device->roofline.time(w.backward_flops, w.backward_bytes, data_type);
+  auto const &factor =
+      calibration_factors.find(calibration_key(op->op_type, data_type));
+  if (factor != calibration_factors.end()) {
+    cost_metrics.forward_time *= factor->second.first;
+    cost_metrics.backward_time *= factor->second.second;
+  }
+  log_cost_model.debug("[Analytical] name(%s) forward_flops(%.0lf) "
+                       "forward_bytes(%.0lf) forward_time(%.4f) "
+                       "backward_time(%.4f)",
+                       op->name,
+                       w.forward_flops,
+                       w.forward_bytes,
+                       cost_metrics.forward_time,
+                       cost_metrics.backward_time);
+  return true;
+}
+
+CostRecord AnalyticalCostModel::make_record(
+    Op const *op,
+    MachineView const &view,
+    CostMetrics const &cost_metrics) const {
+  OpWorkload w = get_workload(op, view);
+  CostRecord record;
+  record.op_type = op->op_type;
+  // Parameters do not capture input shapes, so hash them in as well
+  tl::optional<OperatorParameters> params = get_op_parameters(op);
+  record.params_hash = params.has_value()
+                           ? std::hash<OperatorParameters>{}(params.value())
+                           : op->get_untyped_params_hash();
+  for (int i = 0; i < op->numInputs; i++) {
+    hash_combine(record.params_hash, op->inputs[i]->get_shape());
+  }
+  record.view_hash = view.hash();
+  record.data_type = compute_data_type(op);
+  record.forward_flops = w.forward_flops;
+  record.backward_flops = w.backward_flops;
+  record.forward_bytes = w.forward_bytes;
+  record.backward_bytes = w.backward_bytes;
+  record.forward_time = cost_metrics.forward_time;
+  record.backward_time = cost_metrics.backward_time;
+  return record;
+}
+
+void AnalyticalCostModel::calibrate(CostDatabase const *_database) {
+  database = _database;
+  calibration_factors.clear();
+  if (database == nullptr) {
+    return;
+  }
+  // Records are assumed to come from devices that match the current machine
+  // model
+  CompDevice const *device =
+      machine->get_num_gpus() > 0 ? machine->get_gpu(0) : machine->get_cpu(0);
+  calibration_factors =
+      fit_calibration_factors(database->get_records(), device->roofline);
+  for (auto const &it : calibration_factors) {
+    log_cost_model.print(
+        "Calibrated %s data_type(%d): forward x%.3f backward x%.3f",
+        get_operator_type_name((OperatorType)(it.first / DT_NONE)).c_str(),
+        it.first % DT_NONE,
+        it.second.first,
+        it.second.second);
+  }
+}
+
+}; // namespace FlexFlow
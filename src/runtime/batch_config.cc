@@ -95,6 +95,16 @@ int BatchConfig::max_sequence_length() {
   return RequestManager::get_request_manager()->get_max_sequence_length();
 }
 
+/*static*/
+KVCacheWindow BatchConfig::kv_cache_window() {
+  return RequestManager::get_request_manager()->get_kv_cache_window();
+}
+
+/*static*/
+int BatchConfig::kv_cache_length() {
+  return kv_cache_window().cache_length(max_sequence_length());
+}
+
 int BatchConfig::max_spec_tree_token_num() {
   return RequestManager::get_request_manager()->get_max_spec_tree_token_num();
 }
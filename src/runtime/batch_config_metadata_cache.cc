@@ -0,0 +1,66 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/batch_config_metadata_cache.h"
+#include <cassert>
+#include <cstring>
+
+namespace FlexFlow {
+
+BatchConfigMetadataCache::BatchConfigMetadataCache(size_t size,
+                                                   size_t _max_merge_gap)
+    : mirror(size, 0), max_merge_gap(_max_merge_gap) {}
+
+size_t BatchConfigMetadataCache::write(size_t offset,
+                                       void const *rows,
+                                       size_t row_size,
+                                       size_t num_rows,
+                                       CopyFunc const &copy) {
+  assert(offset + row_size * num_rows <= mirror.size());
+  char const *src = static_cast<char const *>(rows);
+  char *dst = mirror.data() + offset;
+  size_t copied = 0;
+  // the pending run of changed rows is [run_start, run_end)
+  size_t run_start = 0, run_end = 0;
+  bool pending = false;
+  for (size_t row = 0; row < num_rows; row++) {
+    size_t begin = row * row_size;
+    if (std::memcmp(dst + begin, src + begin, row_size) == 0) {
+      continue;
+    }
+    if (pending && begin - run_end > max_merge_gap) {
+      copy(offset + run_start, src + run_start, run_end - run_start);
+      copied += run_end - run_start;
+      pending = false;
+    }
+    if (!pending) {
+      run_start = begin;
+      pending = true;
+    }
+    run_end = begin + row_size;
+  }
+  if (pending) {
+    copy(offset + run_start, src + run_start, run_end - run_start);
+    copied += run_end - run_start;
+  }
+  std::memcpy(dst, src, row_size * num_rows);
+  return copied;
+}
+
+size_t BatchConfigMetadataCache::get_size() const {
+  return mirror.size();
+}
+
+}; // namespace FlexFlow
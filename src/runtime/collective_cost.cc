@@ -0,0 +1,204 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/collective_cost.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+namespace FlexFlow {
+
+namespace {
+
+float const INFINITE_COST = std::numeric_limits<float>::infinity();
+
+// steps rounds of a ring over n ranks, each moving bytes / n
+float ring_rounds(
+    int n, int steps, float bytes, float bandwidth, float latency) {
+  return steps * (latency + bytes / n / bandwidth);
+}
+
+// Slowest link and per-message latency of a flat ring or tree
+float flat_bandwidth(CollectiveTopology const &t) {
+  return t.num_nodes() > 1
+             ? std::min(t.intra_node_bandwidth, t.inter_node_bandwidth)
+             : t.intra_node_bandwidth;
+}
+
+float flat_latency(CollectiveTopology const &t) {
+  return t.num_nodes() > 1 ? t.inter_node_latency : t.intra_node_latency;
+}
+
+float ring_cost(CollectiveType type, CollectiveTopology const &t, float bytes) {
+  int n = t.num_participants();
+  switch (type) {
+    case CollectiveType::ALLREDUCE:
+      return ring_rounds(
+          n, 2 * (n - 1), bytes, flat_bandwidth(t), flat_latency(t));
+    case CollectiveType::REDUCE_SCATTER:
+    case CollectiveType::ALLGATHER:
+      return ring_rounds(n, n - 1, bytes, flat_bandwidth(t), flat_latency(t));
+    default:
+      return INFINITE_COST;
+  }
+}
+
+float hierarchical_cost(CollectiveType type,
+                        CollectiveTopology const &t,
+                        float bytes) {
+  int g = t.max_gpus_per_node(), nodes = t.num_nodes();
+  // Intra-node ring on the full buffer, slowest on the busiest node
+  float intra = ring_rounds(
+      g, g - 1, bytes, t.intra_node_bandwidth, t.intra_node_latency);
+  // One inter-node ring per local rank present on every node, each on its
+  // slice of the buffer, sharing the bandwidth out of each node
+  float inter = 0.0f;
+  if (nodes > 1) {
+    int slices = t.min_gpus_per_node();
+    inter = ring_rounds(nodes,
+                        nodes - 1,
+                        bytes / slices,
+                        t.inter_node_bandwidth / slices,
+                        t.inter_node_latency);
+  }
+  switch (type) {
+    case CollectiveType::ALLREDUCE:
+      return 2 * (intra + inter);
+    case CollectiveType::REDUCE_SCATTER:
+    case CollectiveType::ALLGATHER:
+      return intra + inter;
+    default:
+      return INFINITE_COST;
+  }
+}
+
+float double_binary_tree_cost(CollectiveType type,
+                              CollectiveTopology const &t,
+                              float bytes) {
+  if (type != CollectiveType::ALLREDUCE) {
+    return INFINITE_COST;
+  }
+  // Pipelined reduce then broadcast: every link carries the buffer once in
+  // each direction, and latency grows with the depth of the trees
+  int nodes = t.num_nodes();
+  float depth = nodes > 1 ? std::ceil(std::log2(nodes)) : 0.0f;
+  float latency = depth * t.inter_node_latency +
+                  (t.max_gpus_per_node() - 1) * t.intra_node_latency;
+  return 2 * (latency + bytes / flat_bandwidth(t));
+}
+
+float direct_cost(CollectiveType type,
+                  CollectiveTopology const &t,
+                  float bytes) {
+  if (type != CollectiveType::ALLTOALL) {
+    return INFINITE_COST;
+  }
+  int n = t.num_participants();
+  float chunk = bytes / n;
+  float intra = 0.0f, inter = 0.0f;
+  for (int g : t.gpus_per_node) {
+    intra = std::max(intra, (g - 1) * chunk / t.intra_node_bandwidth);
+    if (t.num_nodes() > 1) {
+      // Everything leaving a node goes through its network interface
+      inter = std::max(inter, g * (n - g) * chunk / t.inter_node_bandwidth);
+    }
+  }
+  return flat_latency(t) + std::max(intra, inter);
+}
+
+} // namespace
+
+int CollectiveTopology::num_nodes() const {
+  return gpus_per_node.size();
+}
+
+int CollectiveTopology::num_participants() const {
+  int n = 0;
+  for (int g : gpus_per_node) {
+    n += g;
+  }
+  return n;
+}
+
+int CollectiveTopology::max_gpus_per_node() const {
+  return *std::max_element(gpus_per_node.begin(), gpus_per_node.end());
+}
+
+int CollectiveTopology::min_gpus_per_node() const {
+  return *std::min_element(gpus_per_node.begin(), gpus_per_node.end());
+}
+
+float collective_cost(CollectiveType type,
+                      CollectiveAlgorithm algorithm,
+                      CollectiveTopology const &topology,
+                      size_t bytes) {
+  assert(topology.num_nodes() > 0 && topology.min_gpus_per_node() > 0);
+  if (topology.num_participants() == 1) {
+    return 0.0f;
+  }
+  assert(topology.intra_node_bandwidth > 0.0f ||
+         topology.max_gpus_per_node() == 1);
+  assert(topology.inter_node_bandwidth > 0.0f || topology.num_nodes() == 1);
+  switch (algorithm) {
+    case CollectiveAlgorithm::RING:
+      return ring_cost(type, topology, bytes);
+    case CollectiveAlgorithm::DOUBLE_BINARY_TREE:
+      return double_binary_tree_cost(type, topology, bytes);
+    case CollectiveAlgorithm::HIERARCHICAL:
+      return hierarchical_cost(type, topology, bytes);
+    case CollectiveAlgorithm::DIRECT:
+      return direct_cost(type, topology, bytes);
+    default:
+      assert(false && "Unknown collective algorithm");
+  }
+  return INFINITE_COST;
+}
+
+CollectiveCost cheapest_collective(CollectiveType type,
+                                   CollectiveTopology const &topology,
+                                   size_t bytes) {
+  CollectiveCost best{CollectiveAlgorithm::RING, INFINITE_COST};
+  for (CollectiveAlgorithm algorithm : {CollectiveAlgorithm::RING,
+                                        CollectiveAlgorithm::DOUBLE_BINARY_TREE,
+                                        CollectiveAlgorithm::HIERARCHICAL,
+                                        CollectiveAlgorithm::DIRECT}) {
+    float time = collective_cost(type, algorithm, topology, bytes);
+    if (time < best.time) {
+      best.algorithm = algorithm;
+      best.time = time;
+    }
+  }
+  assert(best.time != INFINITE_COST);
+  return best;
+}
+
+std::string get_collective_algorithm_name(CollectiveAlgorithm algorithm) {
+  switch (algorithm) {
+    case CollectiveAlgorithm::RING:
+      return "Ring";
+    case CollectiveAlgorithm::DOUBLE_BINARY_TREE:
+      return "DoubleBinaryTree";
+    case CollectiveAlgorithm::HIERARCHICAL:
+      return "Hierarchical";
+    case CollectiveAlgorithm::DIRECT:
+      return "Direct";
+    default:
+      assert(false && "Unknown collective algorithm");
+  }
+  return "";
+}
+
+}; // namespace FlexFlow
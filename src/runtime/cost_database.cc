@@ -0,0 +1,164 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/cost_database.h"
+#include "flexflow/utils/hash_utils.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace FlexFlow {
+
+static char const *COST_DATABASE_HEADER = "# flexflow cost database v2";
+
+bool DeviceRoofline::is_valid() const {
+  return peak_flops > 0 && peak_half_flops > 0 && mem_bandwidth > 0;
+}
+
+float DeviceRoofline::time(double flops,
+                           double bytes,
+                           DataType data_type) const {
+  if (flops == 0 && bytes == 0) {
+    return 0.0f;
+  }
+  double peak = data_type == DT_HALF ? peak_half_flops : peak_flops;
+  double compute_time = flops / peak;
+  double memory_time = bytes / mem_bandwidth;
+  return (float)std::max(compute_time, memory_time) + KERNEL_LAUNCH_LATENCY;
+}
+
+size_t CostDatabase::record_key(OperatorType op_type,
+                                size_t params_hash,
+                                size_t view_hash) {
+  size_t key = 0;
+  hash_combine(key, (int)op_type);
+  hash_combine(key, params_hash);
+  hash_combine(key, view_hash);
+  return key;
+}
+
+void CostDatabase::add_record(CostRecord const &record) {
+  size_t key =
+      record_key(record.op_type, record.params_hash, record.view_hash);
+  auto const &it = key_to_record.find(key);
+  if (it != key_to_record.end()) {
+    records[it->second] = record;
+  } else {
+    key_to_record[key] = records.size();
+    records.push_back(record);
+  }
+}
+
+CostRecord const *CostDatabase::find_record(OperatorType op_type,
+                                            size_t params_hash,
+                                            size_t view_hash) const {
+  auto const &it =
+      key_to_record.find(record_key(op_type, params_hash, view_hash));
+  if (it == key_to_record.end()) {
+    return nullptr;
+  }
+  return &records[it->second];
+}
+
+std::vector<CostRecord> const &CostDatabase::get_records() const {
+  return records;
+}
+
+bool CostDatabase::load_from_file(std::string const &filename,
+                                  std::string &error) {
+  std::ifstream file(filename);
+  if (!file.good()) {
+    error = "cannot open " + filename;
+    return false;
+  }
+  std::vector<CostRecord> loaded;
+  std::string line;
+  int line_number = 0;
+  while (std::getline(file, line)) {
+    line_number++;
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::istringstream iss(line);
+    int op_type, data_type;
+    CostRecord record;
+    if (!(iss >> op_type >> record.params_hash >> record.view_hash >>
+          record.forward_flops >> record.backward_flops >>
+          record.forward_bytes >> record.backward_bytes >>
+          record.forward_time >> record.backward_time)) {
+      error = filename + ":" + std::to_string(line_number) +
+              " is not a cost record";
+      return false;
+    }
+    // v1 databases have no data type column and were profiled in FP32
+    if (!(iss >> data_type)) {
+      data_type = DT_FLOAT;
+    }
+    record.op_type = (OperatorType)op_type;
+    record.data_type = (DataType)data_type;
+    loaded.push_back(record);
+  }
+  for (CostRecord const &record : loaded) {
+    add_record(record);
+  }
+  return true;
+}
+
+bool CostDatabase::save_to_file(std::string const &filename) const {
+  std::ofstream file(filename);
+  if (!file.good()) {
+    return false;
+  }
+  file << COST_DATABASE_HEADER << std::endl;
+  file.precision(10);
+  for (CostRecord const &r : records) {
+    file << (int)r.op_type << " " << r.params_hash << " " << r.view_hash << " "
+         << r.forward_flops << " " << r.backward_flops << " "
+         << r.forward_bytes << " " << r.backward_bytes << " "
+         << r.forward_time << " " << r.backward_time << " "
+         << (int)r.data_type << std::endl;
+  }
+  return file.good();
+}
+
+int calibration_key(OperatorType op_type, DataType data_type) {
+  return (int)op_type * DT_NONE + (int)data_type;
+}
+
+std::unordered_map<int, std::pair<float, float>>
+    fit_calibration_factors(std::vector<CostRecord> const &records,
+                            DeviceRoofline const &device) {
+  std::unordered_map<int, std::pair<double, double>> measured, predicted;
+  for (CostRecord const &r : records) {
+    int key = calibration_key(r.op_type, r.data_type);
+    measured[key].first += r.forward_time;
+    measured[key].second += r.backward_time;
+    predicted[key].first +=
+        device.time(r.forward_flops, r.forward_bytes, r.data_type);
+    predicted[key].second +=
+        device.time(r.backward_flops, r.backward_bytes, r.data_type);
+  }
+  std::unordered_map<int, std::pair<float, float>> factors;
+  for (auto const &it : measured) {
+    std::pair<double, double> const &m = it.second;
+    std::pair<double, double> const &p = predicted[it.first];
+    factors[it.first] =
+        std::make_pair(p.first > 0 ? (float)(m.first / p.first) : 1.0f,
+                       p.second > 0 ? (float)(m.second / p.second) : 1.0f);
+  }
+  return factors;
+}
+
+}; // namespace FlexFlow
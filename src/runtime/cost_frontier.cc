@@ -0,0 +1,92 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/cost_frontier.h"
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <numeric>
+
+namespace FlexFlow {
+
+std::vector<size_t> prune_frontier(std::vector<FrontierPoint> const &points,
+                                   size_t max_points) {
+  assert(max_points >= 2);
+  std::vector<size_t> order(points.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) {
+    if (points[lhs].cost != points[rhs].cost) {
+      return points[lhs].cost < points[rhs].cost;
+    }
+    return points[lhs].mem < points[rhs].mem;
+  });
+  std::vector<size_t> pareto;
+  for (size_t i : order) {
+    if (points[i].cost == std::numeric_limits<float>::infinity()) {
+      continue;
+    }
+    if (pareto.empty() || points[i].mem < points[pareto.back()].mem) {
+      pareto.push_back(i);
+    }
+  }
+  if (pareto.size() <= max_points) {
+    return pareto;
+  }
+  // Keep both endpoints and, for every evenly spaced memory target in
+  // between, the fastest point that fits in it
+  size_t last = pareto.size() - 1;
+  float max_mem = points[pareto.front()].mem;
+  float min_mem = points[pareto.back()].mem;
+  std::vector<size_t> thinned = {pareto.front()};
+  size_t j = 1;
+  for (size_t k = 1; k + 1 < max_points && j < last; k++) {
+    float target = max_mem - k * (max_mem - min_mem) / (max_points - 1);
+    while (j + 1 < last && points[pareto[j]].mem > target) {
+      j++;
+    }
+    thinned.push_back(pareto[j++]);
+  }
+  thinned.push_back(pareto.back());
+  return thinned;
+}
+
+std::vector<FrontierPair>
+    combine_frontiers(std::vector<FrontierPoint> const &first,
+                      std::vector<FrontierPoint> const &second,
+                      bool disjoint_devices,
+                      size_t max_points) {
+  std::vector<FrontierPair> pairs;
+  std::vector<FrontierPoint> costs;
+  for (size_t i = 0; i < first.size(); i++) {
+    for (size_t j = 0; j < second.size(); j++) {
+      FrontierPoint const &a = first[i];
+      FrontierPoint const &b = second[j];
+      if (disjoint_devices) {
+        pairs.push_back(
+            {std::max(a.cost, b.cost), std::max(a.mem, b.mem), i, j});
+      } else {
+        pairs.push_back({a.cost + b.cost, a.mem + b.mem, i, j});
+      }
+      costs.push_back({pairs.back().cost, pairs.back().mem});
+    }
+  }
+  std::vector<FrontierPair> result;
+  for (size_t i : prune_frontier(costs, max_points)) {
+    result.push_back(pairs[i]);
+  }
+  return result;
+}
+
+}; // namespace FlexFlow
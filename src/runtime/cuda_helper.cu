@@ -609,6 +609,17 @@ cudnnDataType_t cuda_to_cudnn_datatype(cudaDataType_t type) {
   return CUDNN_DATA_FLOAT;
 }
 
+std::string get_local_gpu_description() {
+  int num_devices = 0;
+  if (cudaGetDeviceCount(&num_devices) != cudaSuccess || num_devices == 0) {
+    return "";
+  }
+  cudaDeviceProp prop;
+  checkCUDA(cudaGetDeviceProperties(&prop, 0));
+  return std::string(prop.name) + " sm_" + std::to_string(prop.major) +
+         std::to_string(prop.minor);
+}
+
 template __global__ void
     assign_kernel<half>(half *ptr, coord_t size, half value);
 template __global__ void
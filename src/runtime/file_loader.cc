@@ -15,6 +15,7 @@
 
 #include "flexflow/utils/file_loader.h"
 #include "flexflow/ffconst_utils.h"
+#include "flexflow/groupwise_quantization.h"
 #include "flexflow/inference.h"
 
 #include <vector>
@@ -650,6 +651,41 @@ void load_from_quantized_file(char *ptr,
   }
 }
 
+// Loads a weight quantized in groups along its rows (compress() of
+// compress_llama_weights.py with group_dim=1): the values, one per byte, and
+// the offsets and scales of the groups, all row-major, are laid out row by row
+void load_from_groupwise_quantized_file(char *ptr,
+                                        GroupwiseLayout const &layout,
+                                        std::string filename) {
+  size_t meta_size =
+      layout.rows * layout.groups_per_row() * layout.meta_type_size;
+  std::vector<std::string> quantized_files = {
+      filename, filename + "_offset", filename + "_scale"};
+  std::vector<size_t> quantized_sizes = {
+      layout.rows * layout.cols, meta_size, meta_size};
+  std::vector<std::vector<char>> host_arrays(quantized_files.size());
+  for (size_t i = 0; i < quantized_files.size(); i++) {
+    std::ifstream in(quantized_files[i], std::ios::in | std::ios::binary);
+    if (!in.good()) {
+      std::cout << "Could not open file: " << quantized_files[i] << std::endl;
+    }
+    assert(in.good() && "incorrect weight file path");
+    host_arrays[i].resize(quantized_sizes[i]);
+    in.read(host_arrays[i].data(), quantized_sizes[i]);
+    size_t in_get_size = in.gcount();
+    if (in_get_size != quantized_sizes[i]) {
+      std::cout << "load weight data error " << quantized_files[i] << ": "
+                << in_get_size << ", " << quantized_sizes[i] << std::endl;
+      assert(false);
+    }
+  }
+  pack_groupwise_rows(layout,
+                      reinterpret_cast<uint8_t const *>(host_arrays[0].data()),
+                      host_arrays[1].data(),
+                      host_arrays[2].data(),
+                      ptr);
+}
+
 void FileDataLoader::load_quantization_weight(FFModel *ff,
                                               Layer *l,
                                               int weight_idx) {
@@ -693,11 +729,23 @@ void FileDataLoader::load_quantization_weight(FFModel *ff,
         weight_filename += weight_idx == 0 ? "_weight" : "_bias";
       }
     }
-    load_from_quantized_file(data,
-                             volume,
-                             join_path({weights_folder, weight_filename}),
-                             weight->data_type,
-                             use_full_precision);
+    if (ff->config.quantization_group_size > 0) {
+      GroupwiseLayout layout;
+      layout.quantization_type = weight->data_type;
+      layout.meta_type_size = use_full_precision ? sizeof(float) : sizeof(half);
+      layout.rows = weight->dims[1];
+      layout.cols = l->inputs[0]->dims[0];
+      layout.group_size = ff->config.quantization_group_size;
+      assert(layout.total_bytes() == volume);
+      load_from_groupwise_quantized_file(
+          data, layout, join_path({weights_folder, weight_filename}));
+    } else {
+      load_from_quantized_file(data,
+                               volume,
+                               join_path({weights_folder, weight_filename}),
+                               weight->data_type,
+                               use_full_precision);
+    }
   }
 
   ParallelTensor weight_pt;
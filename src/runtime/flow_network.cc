@@ -0,0 +1,182 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/flow_network.h"
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+namespace FlexFlow {
+
+int FlowNetwork::add_link(float bandwidth) {
+  assert(bandwidth > 0.0f);
+  link_bandwidth.push_back(bandwidth);
+  return link_bandwidth.size() - 1;
+}
+
+size_t FlowNetwork::num_links() const {
+  return link_bandwidth.size();
+}
+
+FlowId FlowNetwork::start_flow(std::vector<int> const &links,
+                               float bytes,
+                               float start,
+                               float _delay) {
+  advance(start);
+  FlowId id = remaining.size();
+  remaining.push_back(std::max(bytes, 0.0f));
+  rate.push_back(0.0f);
+  delay.push_back(_delay);
+  for (int l : links) {
+    assert(l >= 0 && l < (int)num_links());
+    flow_links.push_back(l);
+  }
+  link_offsets.push_back(flow_links.size());
+  if (links.empty() || bytes <= 0.0f) {
+    delayed.push(std::make_pair(now + _delay, id));
+  } else {
+    active.push_back(id);
+    update_rates();
+  }
+  return id;
+}
+
+bool FlowNetwork::has_flows() const {
+  return !active.empty() || !delayed.empty();
+}
+
+float FlowNetwork::next_drain_time(size_t &index) const {
+  float best = std::numeric_limits<float>::infinity();
+  for (size_t i = 0; i < active.size(); i++) {
+    FlowId f = active[i];
+    // Rounding can leave a flow with no share on a saturated link; it waits
+    // for another flow on that link to drain. The flows frozen first always
+    // get a positive share, so some flow keeps draining
+    if (rate[f] <= 0.0f) {
+      continue;
+    }
+    float t = now + remaining[f] / rate[f];
+    if (t < best) {
+      best = t;
+      index = i;
+    }
+  }
+  return best;
+}
+
+float FlowNetwork::next_completion_time() const {
+  size_t index;
+  float t = next_drain_time(index);
+  if (!delayed.empty()) {
+    t = std::min(t, delayed.top().first);
+  }
+  return t;
+}
+
+FlowId FlowNetwork::complete_next_flow(float &time) {
+  assert(has_flows());
+  while (true) {
+    size_t index = 0;
+    float drain = next_drain_time(index);
+    if (!delayed.empty() && delayed.top().first <= drain) {
+      std::pair<float, FlowId> e = delayed.top();
+      delayed.pop();
+      advance(e.first);
+      time = e.first;
+      return e.second;
+    }
+    // The flow leaves the network and frees its bandwidth right away
+    advance(drain);
+    FlowId f = active[index];
+    remaining[f] = 0.0f;
+    rate[f] = 0.0f;
+    active[index] = active.back();
+    active.pop_back();
+    delayed.push(std::make_pair(now + delay[f], f));
+    update_rates();
+  }
+}
+
+float FlowNetwork::get_rate(FlowId flow) const {
+  assert(flow < rate.size());
+  return rate[flow];
+}
+
+void FlowNetwork::reset() {
+  now = 0.0f;
+  link_bandwidth.clear();
+  remaining.clear();
+  rate.clear();
+  delay.clear();
+  link_offsets.assign(1, 0);
+  flow_links.clear();
+  active.clear();
+  delayed = {};
+}
+
+void FlowNetwork::advance(float time) {
+  if (time <= now) {
+    return;
+  }
+  float elapsed = time - now;
+  for (FlowId f : active) {
+    remaining[f] = std::max(remaining[f] - rate[f] * elapsed, 0.0f);
+  }
+  now = time;
+}
+
+void FlowNetwork::update_rates() {
+  residual = link_bandwidth;
+  unfrozen.assign(num_links(), 0);
+  frozen.assign(active.size(), false);
+  for (FlowId f : active) {
+    for (uint32_t i = link_offsets[f]; i < link_offsets[f + 1]; i++) {
+      unfrozen[flow_links[i]]++;
+    }
+  }
+  // Progressive filling: saturate the link with the smallest fair share and
+  // freeze its flows at that share
+  size_t num_left = active.size();
+  while (num_left > 0) {
+    int bottleneck = -1;
+    float share = std::numeric_limits<float>::infinity();
+    for (size_t l = 0; l < num_links(); l++) {
+      if (unfrozen[l] > 0 && residual[l] / unfrozen[l] < share) {
+        share = residual[l] / unfrozen[l];
+        bottleneck = l;
+      }
+    }
+    assert(bottleneck >= 0);
+    share = std::max(share, 0.0f);
+    for (size_t k = 0; k < active.size(); k++) {
+      FlowId f = active[k];
+      if (frozen[k] ||
+          std::find(flow_links.begin() + link_offsets[f],
+                    flow_links.begin() + link_offsets[f + 1],
+                    bottleneck) == flow_links.begin() + link_offsets[f + 1]) {
+        continue;
+      }
+      rate[f] = share;
+      frozen[k] = true;
+      num_left--;
+      for (uint32_t i = link_offsets[f]; i < link_offsets[f + 1]; i++) {
+        residual[flow_links[i]] -= share;
+        unfrozen[flow_links[i]]--;
+      }
+    }
+  }
+}
+
+}; // namespace FlexFlow
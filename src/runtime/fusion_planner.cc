@@ -0,0 +1,215 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/fusion_planner.h"
+#include <algorithm>
+#include <cassert>
+#include <unordered_set>
+
+namespace FlexFlow {
+
+namespace {
+
+// Mirrors the bookkeeping of FusedOp so that FusedOp::add_operator never runs
+// out of room for a planned group
+struct GroupState {
+  size_t view_hash = 0;
+  bool open = false;
+  int num_operators = 0;
+  // Sums of the tensors of each operator, which index the op_* arrays
+  int input_slots = 0, weight_slots = 0, output_slots = 0;
+  // Distinct tensors, which fill the inputs, weights and outputs arrays
+  std::unordered_set<int> inputs, weights, outputs;
+  size_t mapped_bytes = 0;
+};
+
+struct Addition {
+  std::vector<int> inputs, weights, outputs;
+  size_t mapped_bytes = 0;
+};
+
+Addition get_addition(GroupState const &group,
+                      FusionNode const &node,
+                      std::vector<size_t> const &tensor_bytes) {
+  Addition add;
+  add.mapped_bytes = group.mapped_bytes;
+  for (int t : node.inputs) {
+    if (!group.inputs.count(t) && !group.outputs.count(t) &&
+        std::find(add.inputs.begin(), add.inputs.end(), t) ==
+            add.inputs.end()) {
+      add.inputs.push_back(t);
+      add.mapped_bytes += tensor_bytes[t];
+    }
+  }
+  for (int t : node.weights) {
+    if (!group.weights.count(t) && std::find(add.weights.begin(),
+                                             add.weights.end(),
+                                             t) == add.weights.end()) {
+      add.weights.push_back(t);
+    }
+  }
+  for (int t : node.outputs) {
+    if (!group.outputs.count(t) && std::find(add.outputs.begin(),
+                                             add.outputs.end(),
+                                             t) == add.outputs.end()) {
+      add.outputs.push_back(t);
+      add.mapped_bytes += tensor_bytes[t];
+    }
+  }
+  return add;
+}
+
+bool fits(GroupState const &group,
+          FusionNode const &node,
+          Addition const &add,
+          FusionCostModel const &cost_model) {
+  return group.num_operators + 1 <= cost_model.max_operators &&
+         group.input_slots + (int)node.inputs.size() <=
+             cost_model.max_tensors &&
+         group.weight_slots + (int)node.weights.size() <=
+             cost_model.max_tensors &&
+         group.output_slots + (int)node.outputs.size() <=
+             cost_model.max_tensors &&
+         (int)(group.inputs.size() + add.inputs.size()) <=
+             cost_model.max_inputs &&
+         (int)(group.weights.size() + add.weights.size()) <=
+             cost_model.max_weights &&
+         (int)(group.outputs.size() + add.outputs.size()) <=
+             cost_model.max_outputs;
+}
+
+float get_score(size_t mapped_bytes, FusionCostModel const &cost_model) {
+  if (cost_model.max_mapped_bytes == 0) {
+    return cost_model.launch_overhead;
+  }
+  return cost_model.launch_overhead *
+         (1.0f - (float)mapped_bytes / cost_model.max_mapped_bytes);
+}
+
+void add_to_group(GroupState &group,
+                  FusionNode const &node,
+                  Addition const &add) {
+  group.num_operators++;
+  group.input_slots += node.inputs.size();
+  group.weight_slots += node.weights.size();
+  group.output_slots += node.outputs.size();
+  group.inputs.insert(add.inputs.begin(), add.inputs.end());
+  group.weights.insert(add.weights.begin(), add.weights.end());
+  group.outputs.insert(add.outputs.begin(), add.outputs.end());
+  group.mapped_bytes = add.mapped_bytes;
+}
+
+} // namespace
+
+FusionPlan plan_fusion(std::vector<FusionNode> const &nodes,
+                       std::vector<size_t> const &tensor_bytes,
+                       FusionCostModel const &cost_model) {
+  FusionPlan plan;
+  plan.decisions.resize(nodes.size(), FUSION_NOT_FUSIBLE);
+  std::vector<GroupState> groups;
+  // Group of the operator that writes each tensor, or -1
+  std::vector<int> producer_group(tensor_bytes.size(), -1);
+  for (size_t n = 0; n < nodes.size(); n++) {
+    FusionNode const &node = nodes[n];
+    int best = -1;
+    float best_score = 0.0f;
+    Addition best_addition;
+    FusionDecision decision =
+        node.fusible ? FUSION_GROUP_HEAD : FUSION_NOT_FUSIBLE;
+    if (node.fusible) {
+      int start = -1;
+      for (int t : node.inputs) {
+        assert(t >= 0 && t < (int)tensor_bytes.size());
+        start = std::max(start, producer_group[t]);
+      }
+      int last = (int)groups.size() - 1;
+      std::vector<int> candidates;
+      if (start >= 0) {
+        candidates.push_back(start);
+      }
+      if (last >= 0 && last != start) {
+        candidates.push_back(last);
+      }
+      for (int g : candidates) {
+        GroupState const &group = groups[g];
+        if (!group.open) {
+          continue;
+        }
+        FusionDecision rejection = FUSION_GROUP_HEAD;
+        Addition add = get_addition(group, node, tensor_bytes);
+        float score = get_score(add.mapped_bytes, cost_model);
+        if (group.view_hash != node.view_hash) {
+          rejection = FUSION_VIEW_MISMATCH;
+        } else if (!fits(group, node, add, cost_model)) {
+          rejection = FUSION_OVER_CAPACITY;
+        } else if (score <= 0.0f) {
+          rejection = FUSION_NOT_PROFITABLE;
+        } else if (best < 0 || score > best_score) {
+          best = g;
+          best_score = score;
+          best_addition = add;
+        }
+        // Report why the first candidate was rejected
+        if (decision == FUSION_GROUP_HEAD) {
+          decision = rejection;
+        }
+      }
+    }
+    int group_id = best;
+    if (best >= 0) {
+      add_to_group(groups[best], node, best_addition);
+      plan.groups[best].push_back(n);
+      plan.saved_time += cost_model.launch_overhead;
+      decision = FUSION_FUSED;
+    } else {
+      group_id = (int)groups.size();
+      groups.emplace_back();
+      GroupState &group = groups.back();
+      group.view_hash = node.view_hash;
+      group.open = node.can_start_group;
+      add_to_group(group, node, get_addition(group, node, tensor_bytes));
+      plan.groups.push_back({(int)n});
+    }
+    plan.decisions[n] = decision;
+    for (int t : node.outputs) {
+      assert(t >= 0 && t < (int)tensor_bytes.size());
+      producer_group[t] = group_id;
+    }
+  }
+  for (GroupState const &group : groups) {
+    plan.group_mapped_bytes.push_back(group.mapped_bytes);
+  }
+  return plan;
+}
+
+char const *get_fusion_decision_name(FusionDecision decision) {
+  switch (decision) {
+    case FUSION_NOT_FUSIBLE:
+      return "not fusible";
+    case FUSION_GROUP_HEAD:
+      return "group head";
+    case FUSION_FUSED:
+      return "fused";
+    case FUSION_VIEW_MISMATCH:
+      return "view mismatch";
+    case FUSION_OVER_CAPACITY:
+      return "over capacity";
+    case FUSION_NOT_PROFITABLE:
+      return "memory pressure";
+  }
+  return "unknown";
+}
+
+}; // namespace FlexFlow
@@ -119,25 +119,11 @@ T SearchHelper::execute_sequence_split(std::unique_ptr<Graph> const &pre_graph,
       this->graph_cost<T>(post_graph.get(), bn, sink, resources, false));
 }
 
-/**
- * @brief Starting point to get sequential split time cost.
- *
- * @tparam T float or GraphCostResult (or GraphCostResultWithMemory in memory
- * optimization)
- */
-template <typename T>
-T SearchHelper::find_optimal_sequence_graph_time(
+std::vector<MachineView> SearchHelper::get_valid_bottleneck_views(
     Graph const *g,
     Node const &bn_node,
-    NodeAssignment const &source,
     NodeAssignment const &sink,
     MachineResource const &resources) const {
-  std::unique_ptr<Graph> pre_graph;
-  std::unique_ptr<Graph> post_graph;
-  std::tie(pre_graph, post_graph) = g->split_at_node(bn_node);
-
-  T optimal = this->infinity<T>();
-
   std::vector<MachineView> valid_views =
       this->get_valid_machine_views(bn_node.ptr, resources);
   // A Corner Case:
@@ -165,6 +151,30 @@ T SearchHelper::find_optimal_sequence_graph_time(
       valid_views.push_back(sink.view);
     }
   }
+  return valid_views;
+}
+
+/**
+ * @brief Starting point to get sequential split time cost.
+ *
+ * @tparam T float or GraphCostResult (or GraphCostResultWithMemory in memory
+ * optimization)
+ */
+template <typename T>
+T SearchHelper::find_optimal_sequence_graph_time(
+    Graph const *g,
+    Node const &bn_node,
+    NodeAssignment const &source,
+    NodeAssignment const &sink,
+    MachineResource const &resources) const {
+  std::unique_ptr<Graph> pre_graph;
+  std::unique_ptr<Graph> post_graph;
+  std::tie(pre_graph, post_graph) = g->split_at_node(bn_node);
+
+  T optimal = this->infinity<T>();
+
+  std::vector<MachineView> valid_views =
+      this->get_valid_bottleneck_views(g, bn_node, sink, resources);
 
   if (valid_views.empty()) {
     return optimal;
@@ -195,6 +205,7 @@ T SearchHelper::find_optimal_sequence_graph_time(
 
 void SearchHelper::clear_cache() {
   cached_graph_costs.clear();
+  cached_graph_frontiers.clear();
   cached_operator_valid_views.clear();
 }
 
@@ -277,17 +288,8 @@ NonsequenceSplit NonsequenceSplit::horizontal(int param, bool flip_graphs) {
   return s;
 }
 
-template <typename T>
-T SearchHelper::find_optimal_nonsequence_graph_time(
-    Graph const *g,
-    NodeAssignment const &source,
-    NodeAssignment const &sink,
+std::vector<NonsequenceSplit> SearchHelper::get_nonsequence_splits(
     MachineResource const &resources) const {
-  std::unique_ptr<Graph> first_graph;
-  std::unique_ptr<Graph> second_graph;
-  std::tie(first_graph, second_graph) =
-      g->split_horizontal(source.node, sink.node);
-
   std::vector<NonsequenceSplit> potential_splits;
 
   for (int i = 1; i < resources.num_nodes; i++) {
@@ -298,6 +300,22 @@ T SearchHelper::find_optimal_nonsequence_graph_time(
     potential_splits.push_back(NonsequenceSplit::horizontal(i, false));
     potential_splits.push_back(NonsequenceSplit::horizontal(i, true));
   }
+  return potential_splits;
+}
+
+template <typename T>
+T SearchHelper::find_optimal_nonsequence_graph_time(
+    Graph const *g,
+    NodeAssignment const &source,
+    NodeAssignment const &sink,
+    MachineResource const &resources) const {
+  std::unique_ptr<Graph> first_graph;
+  std::unique_ptr<Graph> second_graph;
+  std::tie(first_graph, second_graph) =
+      g->split_horizontal(source.node, sink.node);
+
+  std::vector<NonsequenceSplit> potential_splits =
+      this->get_nonsequence_splits(resources);
 
   NonsequenceSplit best_split = NonsequenceSplit::sequential();
   float best_cost = this->execute_nonsequence_split<float>(
@@ -541,6 +559,9 @@ std::vector<MachineView> SearchHelper::get_valid_machine_views(
   std::vector<MachineView> const *cached_op_views = NULL;
   std::vector<MachineView> valid_views;
 
+  // Cached views are never erased while searching, so the pointer stays valid
+  // after the lock is released
+  std::unique_lock<std::mutex> lock(this->cache_mutex);
   auto const &iter = cached_operator_valid_views.find(op->op_guid);
   if (iter != cached_operator_valid_views.end()) {
     cached_op_views = iter->second.get();
@@ -598,6 +619,7 @@ std::vector<MachineView> SearchHelper::get_valid_machine_views(
     cached_operator_valid_views[op->op_guid] = std::move(to_cache);
     cached_op_views = cached_operator_valid_views.at(op->op_guid).get();
   }
+  lock.unlock();
   if (log) {
     this->logger->info() << "Found " << cached_op_views->size()
                          << " cached op views";
@@ -1190,6 +1212,53 @@ std::ostream &operator<<(std::ostream &s, GraphCostResultWithMemory const &r) {
   return s;
 }
 
+std::vector<FrontierPoint> GraphCostFrontier::costs() const {
+  std::vector<FrontierPoint> costs;
+  for (auto const &p : points) {
+    costs.push_back({p.cost, p.mem_cost.num});
+  }
+  return costs;
+}
+
+void GraphCostFrontier::prune() {
+  std::vector<GraphCostResultWithMemory> pruned;
+  for (size_t i : prune_frontier(this->costs(), MAX_POINTS)) {
+    pruned.push_back(std::move(points[i]));
+  }
+  points = std::move(pruned);
+}
+
+void GraphCostFrontier::merge(GraphCostFrontier const &other) {
+  points.insert(points.end(), other.points.cbegin(), other.points.cend());
+  this->prune();
+}
+
+GraphCostResultWithMemory
+    GraphCostFrontier::fastest_within(float memory_limit) const {
+  for (auto const &p : points) {
+    if (p.mem_cost.num <= memory_limit) {
+      return p;
+    }
+  }
+  return GraphCostResultWithMemory::invalid();
+}
+
+GraphCostFrontier GraphCostFrontier::invalid() {
+  return {};
+}
+
+std::ostream &operator<<(std::ostream &s, GraphCostFrontier const &f) {
+  s << "GraphCostFrontier{";
+  for (size_t i = 0; i < f.points.size(); i++) {
+    if (i > 0) {
+      s << ", ";
+    }
+    s << "(" << f.points[i].cost << ", " << f.points[i].mem_cost.num << " MB)";
+  }
+  s << "}";
+  return s;
+}
+
 std::ostream &operator<<(std::ostream &s, GraphOptimizeResult const &r) {
   s << "GraphOptimizeResult{cost=" << r.cost << "}";
   return s;
@@ -1370,6 +1439,7 @@ void SearchHelper::check_matches_graph<float>(Graph const *g,
 template <>
 std::pair<bool, float>
     SearchHelper::try_get_cost_from_cache<float>(size_t hash) const {
+  std::lock_guard<std::mutex> lock(this->cache_mutex);
   if (this->cached_graph_costs.find(hash) == this->cached_graph_costs.end()) {
     return {false, std::numeric_limits<float>::infinity()};
   } else {
@@ -1393,6 +1463,7 @@ std::pair<bool, GraphCostResultWithMemory>
 template <>
 void SearchHelper::try_cache_result<float>(size_t hash,
                                            float const &value) const {
+  std::lock_guard<std::mutex> lock(this->cache_mutex);
   this->logger->debug() << "cached_graph_costs[" << hash << "] = " << value;
   this->cached_graph_costs[hash] = value;
 }
@@ -1400,6 +1471,7 @@ void SearchHelper::try_cache_result<float>(size_t hash,
 template <>
 void SearchHelper::try_cache_result<GraphCostResult>(
     size_t hash, GraphCostResult const &value) const {
+  std::lock_guard<std::mutex> lock(this->cache_mutex);
   this->logger->debug() << "cached_graph_costs[" << hash << "=" << value.cost
                         << "]";
   this->cached_graph_costs[hash] = value.cost;
@@ -1408,6 +1480,7 @@ void SearchHelper::try_cache_result<GraphCostResult>(
 template <>
 void SearchHelper::try_cache_result<GraphCostResultWithMemory>(
     size_t hash, GraphCostResultWithMemory const &value) const {
+  std::lock_guard<std::mutex> lock(this->cache_mutex);
   this->logger->debug() << "cached_graph_costs[" << hash << "="
                         << value.get_multi_obj_cost() << "]";
   this->cached_graph_costs[hash] = value.get_multi_obj_cost();
@@ -1590,6 +1663,200 @@ void SearchHelper::add_sink_node_costs<GraphCostResultWithMemory>(
       result);
 }
 
+namespace {
+
+/**
+ * @brief Combine every pair of points of two frontiers. Pieces placed on the
+ * same devices add up their memory while pieces on disjoint devices only
+ * contribute their max.
+ */
+GraphCostFrontier combine_frontiers(GraphCostFrontier const &first,
+                                    GraphCostFrontier const &second,
+                                    bool disjoint_devices) {
+  GraphCostFrontier result;
+  // Only the views of the pairs that survive pruning are merged
+  std::vector<FrontierPair> pairs =
+      FlexFlow::combine_frontiers(first.costs(),
+                                  second.costs(),
+                                  disjoint_devices,
+                                  GraphCostFrontier::MAX_POINTS);
+  for (FrontierPair const &c : pairs) {
+    GraphCostResultWithMemory p;
+    p.cost = c.cost;
+    p.mem_cost = MemoryUsage{MemoryUsageType::PER_DEVICE_MAX, c.mem};
+    p.views = first.points[c.first].views;
+    p.views.insert(second.points[c.second].views.cbegin(),
+                   second.points[c.second].views.cend());
+    result.points.push_back(std::move(p));
+  }
+  return result;
+}
+
+} // namespace
+
+template <>
+GraphCostFrontier
+    sequence_cost<GraphCostFrontier>(GraphCostFrontier const &first,
+                                     GraphCostFrontier const &second) {
+  return combine_frontiers(first, second, false /*disjoint_devices*/);
+}
+
+template <>
+GraphCostFrontier
+    parallel_cost<GraphCostFrontier>(GraphCostFrontier const &first,
+                                     GraphCostFrontier const &second) {
+  return combine_frontiers(first, second, true /*disjoint_devices*/);
+}
+
+template <>
+bool SearchHelper::is_invalid<GraphCostFrontier>(
+    GraphCostFrontier const &cost) const {
+  return cost.points.empty();
+}
+
+template <>
+void SearchHelper::check_matches_graph<GraphCostFrontier>(
+    Graph const *g, GraphCostFrontier const &r, Node const &sink) const {
+  for (auto const &p : r.points) {
+    this->check_matches_graph<GraphCostResultWithMemory>(g, p, sink);
+  }
+}
+
+template <>
+std::pair<bool, GraphCostFrontier>
+    SearchHelper::try_get_cost_from_cache<GraphCostFrontier>(
+        size_t hash) const {
+  std::lock_guard<std::mutex> lock(this->cache_mutex);
+  auto const &it = this->cached_graph_frontiers.find(hash);
+  if (it == this->cached_graph_frontiers.end()) {
+    return {false, GraphCostFrontier::invalid()};
+  }
+  return {true, it->second};
+}
+
+template <>
+void SearchHelper::try_cache_result<GraphCostFrontier>(
+    size_t hash, GraphCostFrontier const &value) const {
+  std::lock_guard<std::mutex> lock(this->cache_mutex);
+  this->logger->debug() << "cached_graph_frontiers[" << hash << "] = " << value;
+  this->cached_graph_frontiers[hash] = value;
+}
+
+template <>
+GraphCostFrontier SearchHelper::infinity<GraphCostFrontier>() const {
+  return GraphCostFrontier::invalid();
+}
+
+template <>
+GraphCostFrontier SearchHelper::empty<GraphCostFrontier>() const {
+  GraphCostFrontier result;
+  result.points.push_back(
+      {0.0f, MemoryUsage{MemoryUsageType::PER_DEVICE_MAX, 0.0f}, {}});
+  return result;
+}
+
+template <>
+void SearchHelper::add_operator_cost<GraphCostFrontier>(
+    NodeAssignment const &node,
+    float node_cost,
+    GraphCostFrontier *cost) const {
+  for (auto &p : cost->points) {
+    p.cost += node_cost;
+    p.views[node.node] = node.view;
+  }
+}
+
+template <>
+float SearchHelper::get_cost<GraphCostFrontier>(
+    GraphCostFrontier const &frontier) const {
+  if (frontier.points.empty()) {
+    return std::numeric_limits<float>::infinity();
+  }
+  return frontier.points.front().cost;
+}
+
+/**
+ * @brief Specialization of add_sink_node_costs to handle GraphCostFrontier.
+ * The per-part memory of the operator is resident on every device of its view.
+ */
+template <>
+void SearchHelper::add_sink_node_costs<GraphCostFrontier>(
+    NodeAssignment const &sink,
+    CostMetrics metrics,
+    GraphCostFrontier *result) const {
+  float run_time =
+      metrics.forward_time + metrics.backward_time + metrics.sync_time;
+  float per_device_mem_mb = metrics.total_memory_in_mb();
+  for (auto &p : result->points) {
+    p.cost += run_time;
+    p.mem_cost.num += per_device_mem_mb;
+    p.views[sink.node] = sink.view;
+  }
+}
+
+/**
+ * @brief Specialization of find_optimal_sequence_graph_time that keeps the
+ * frontiers of all bottleneck views instead of only the fastest one.
+ */
+template <>
+GraphCostFrontier
+    SearchHelper::find_optimal_sequence_graph_time<GraphCostFrontier>(
+        Graph const *g,
+        Node const &bn_node,
+        NodeAssignment const &source,
+        NodeAssignment const &sink,
+        MachineResource const &resources) const {
+  std::unique_ptr<Graph> pre_graph;
+  std::unique_ptr<Graph> post_graph;
+  std::tie(pre_graph, post_graph) = g->split_at_node(bn_node);
+
+  GraphCostFrontier optimal = this->infinity<GraphCostFrontier>();
+  for (MachineView const &bn_view :
+       this->get_valid_bottleneck_views(g, bn_node, sink, resources)) {
+    optimal.merge(this->execute_sequence_split<GraphCostFrontier>(
+        pre_graph, post_graph, source, sink, resources, {bn_node, bn_view}));
+  }
+
+  check_matches_graph<GraphCostFrontier>(g, optimal, sink.node);
+
+  return optimal;
+}
+
+/**
+ * @brief Specialization of find_optimal_nonsequence_graph_time that keeps the
+ * frontiers of all splits instead of only the fastest one.
+ */
+template <>
+GraphCostFrontier
+    SearchHelper::find_optimal_nonsequence_graph_time<GraphCostFrontier>(
+        Graph const *g,
+        NodeAssignment const &source,
+        NodeAssignment const &sink,
+        MachineResource const &resources) const {
+  std::unique_ptr<Graph> first_graph;
+  std::unique_ptr<Graph> second_graph;
+  std::tie(first_graph, second_graph) =
+      g->split_horizontal(source.node, sink.node);
+
+  GraphCostFrontier optimal =
+      this->execute_nonsequence_split<GraphCostFrontier>(
+          first_graph,
+          second_graph,
+          source,
+          sink,
+          resources,
+          NonsequenceSplit::sequential());
+  for (NonsequenceSplit const &split :
+       this->get_nonsequence_splits(resources)) {
+    optimal.merge(this->execute_nonsequence_split<GraphCostFrontier>(
+        first_graph, second_graph, source, sink, resources, split));
+  }
+
+  check_matches_graph<GraphCostFrontier>(g, optimal, sink.node);
+
+  return optimal;
+}
+
 /**
  * @brief Core function to analyze the cost of a graph.
  *
@@ -1779,6 +2046,43 @@ float Graph::optimal_cost_with_memory(float run_time_cost_factor) const {
   return combined_cost;
 }
 
+/**
+ * @brief Get a single number to rank PCGs under the given memory optimization
+ * config. With MemorySearchAlgo::CONSTRAINED this is the run time of the
+ * fastest strategy that fits the per-device memory limit.
+ */
+float Graph::optimal_cost_with_memory(
+    MemoryOptimConfig const &mem_config) const {
+  if (mem_config.mem_search_algo == MemorySearchAlgo::CONSTRAINED) {
+    return this->optimal_cost_frontier()
+        .fastest_within(mem_config.per_device_memory_limit)
+        .cost;
+  }
+  return this->optimal_cost_with_memory(mem_config.run_time_cost_factor);
+}
+
+/**
+ * @brief Get the Pareto frontier of (run time, per-device memory) strategies
+ * of a PCG over all views of its sink node.
+ */
+GraphCostFrontier Graph::optimal_cost_frontier() const {
+  Graph reduced_graph = this->reduced();
+  Node sink_node = reduced_graph.find_sink_node();
+  MachineResource resource(model->config);
+
+  GraphCostFrontier frontier = GraphCostFrontier::invalid();
+  for (MachineView const &sink_view :
+       search->get_valid_machine_views(sink_node, resource)) {
+    frontier.merge(search->graph_cost<GraphCostFrontier>(
+        &reduced_graph,
+        {Node::INVALID_NODE, MachineView::NO_VIEW},
+        {sink_node, sink_view},
+        resource,
+        true));
+  }
+  return frontier;
+}
+
 std::unordered_map<Node, MachineView> Graph::optimal_views() const {
   return this->generic_optimal_cost<GraphCostResult>().views;
 }
@@ -1918,21 +2222,38 @@ std::pair<std::unique_ptr<Graph>, std::unordered_map<Node, MachineView>>
                        .only_kind(Memory::GPU_FB_MEM)
                        .best_affinity_to(task->target_proc)
                        .first();
+  // Without a local GPU (e.g., planning with the analytical cost model on a
+  // CPU-only host), fall back to the device memory given by the user
+  size_t gpu_mem_capacity = gpu_mem.exists()
+                                ? gpu_mem.capacity()
+                                : (size_t)model->config.device_mem * 1024 * 1024;
   MachineModel *machine;
   if (model->config.machine_model_version == 0) {
     machine =
         (MachineModel *)new SimpleMachineModel(model->config.numNodes,
                                                model->config.workersPerNode,
-                                               gpu_mem.capacity());
+                                               gpu_mem_capacity);
   } else if (model->config.machine_model_version == 1 and
              !model->config.machine_model_file.empty()) {
     machine = (MachineModel *)new EnhancedMachineModel(
-        model->config.machine_model_file, gpu_mem.capacity());
+        model->config.machine_model_file, gpu_mem_capacity);
+  } else if (model->config.machine_model_version == 2) {
+    // Every node has one 12 GB/s link to a single switch; transfers between
+    // nodes follow the ECMP routes of the topology
+    int num_nodes = model->config.numNodes;
+    machine = (MachineModel *)new NetworkedMachineModel(
+        num_nodes,
+        model->config.workersPerNode,
+        1 /*num_switches*/,
+        0.0f /*network_latency*/,
+        BigSwitchNetworkTopologyGenerator(num_nodes).generate_topology(),
+        gpu_mem_capacity,
+        12 * 1024 * 1024.0f /*link_bandwidth*/);
   } else {
     assert(false &&
            "machine model creation error: currently only support "
-           "machine-model-version = 0 or 1. When machine-model-version = 1, "
-           "machine-model-file should not be empty.");
+           "machine-model-version = 0, 1 or 2. When machine-model-version = "
+           "1, machine-model-file should not be empty.");
   }
   // Assume this task is running on GPU0
   if (!cached_simulator) {
@@ -1976,9 +2297,9 @@ std::pair<std::unique_ptr<Graph>, std::unordered_map<Node, MachineView>>
       data_parallel_view.stride[0] = 1;
       data_parallel_view.start_device_id = 0;
     } else {
-      // Currently assume a 1D machine view is needed
-      assert(model->config.data_parallelism_degree == 1 ||
-             model->config.tensor_parallelism_degree == 1);
+      // Currently assume a 1D machine view is needed. Data-parallel replicas
+      // are copies of this view placed by the InferenceManager, so the
+      // operators are only partitioned by tensor parallelism
       degree = model->config.data_parallelism_degree *
                model->config.tensor_parallelism_degree;
       num_transformer_layers_per_stage =
@@ -2024,13 +2345,17 @@ std::pair<std::unique_ptr<Graph>, std::unordered_map<Node, MachineView>>
       }
     }
   } else {
+    MemoryOptimConfig mem_config{lambda.first};
+    if (model->config.memory_search_algo == MemorySearchAlgo::CONSTRAINED) {
+      mem_config = MemoryOptimConfig::constrained(model->config.device_mem);
+    }
     // Main step to optimize the PCG of an FFModel
     model->graph_optimize(model->config.search_budget,
                           model->config.only_data_parallel,
                           curr_best_graph,
                           curr_optimal_views,
                           perform_memory_search,
-                          MemoryOptimConfig{lambda.first},
+                          mem_config,
                           lambda.second);
   }
   // Return the best result of the current search
@@ -2133,7 +2458,17 @@ GraphOptimalViewSerialized
   int best_lambda_index = -1;
   int binary_search_budget = 10;
 
-  if (perform_memory_search && !is_valid_strategy(lambdas,
+  if (perform_memory_search &&
+      model_config.memory_search_algo == MemorySearchAlgo::CONSTRAINED) {
+    // The constrained search already picked the fastest strategy that fits
+    // the memory of each device; no need to search over lambdas
+    has_valid_strategy = is_valid_strategy(lambdas,
+                                           best_graph.get(),
+                                           optimal_views,
+                                           cached_simulator,
+                                           memory_threshold);
+    best_lambda_index = 0;
+  } else if (perform_memory_search && !is_valid_strategy(lambdas,
                                                   best_graph.get(),
                                                   optimal_views,
                                                   cached_simulator,
@@ -2220,6 +2555,14 @@ GraphOptimalViewSerialized
     std::cout << "\nNot doing memory search" << std::endl;
   }
 
+  if (!model_config.export_cost_database_file.empty()) {
+    if (cached_simulator->export_cost_database(
+            model_config.export_cost_database_file)) {
+      std::cout << "Exported cost database to "
+                << model_config.export_cost_database_file << std::endl;
+    }
+  }
+
   // Following lines are to serialize the optimized PCG.
   // Only need best_graph and optimal_views below.
   Serializer sez;
@@ -0,0 +1,218 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/groupwise_quantization.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace FlexFlow {
+
+namespace {
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+constexpr bool SWAR_ENABLED = false;
+#else
+constexpr bool SWAR_ENABLED = true;
+#endif
+
+constexpr uint64_t LOW_NIBBLES = 0x000F000F000F000FULL;
+
+int max_quantized_value(DataType quantization_type) {
+  assert(quantization_type == DT_INT4 || quantization_type == DT_INT8);
+  return quantization_type == DT_INT4 ? 15 : 255;
+}
+
+// Values of one row, one per byte
+void get_row_values(char const *row,
+                    GroupwiseLayout const &layout,
+                    uint8_t *values) {
+  if (layout.quantization_type == DT_INT4) {
+    unpack_int4(row, layout.cols, values);
+  } else {
+    memcpy(values, row, layout.cols);
+  }
+}
+
+} // namespace
+
+size_t GroupwiseLayout::groups_per_row() const {
+  assert(group_size > 0 && cols % group_size == 0);
+  return cols / group_size;
+}
+
+size_t GroupwiseLayout::value_bytes_per_row() const {
+  return quantization_type == DT_INT4 ? cols / 2 : cols;
+}
+
+size_t GroupwiseLayout::row_bytes() const {
+  return value_bytes_per_row() + 2 * groups_per_row() * meta_type_size;
+}
+
+size_t GroupwiseLayout::total_bytes() const {
+  return rows * row_bytes();
+}
+
+void pack_int4(uint8_t const *values, size_t num_values, char *packed) {
+  assert(num_values % 2 == 0);
+  size_t i = 0;
+  if (SWAR_ENABLED) {
+    for (; i + 8 <= num_values; i += 8) {
+      uint64_t x;
+      memcpy(&x, values + i, sizeof(x));
+      // The two nibbles of each pair meet in the low byte of its 16-bit lane,
+      // then the four lanes are compacted into four bytes
+      uint64_t lanes = ((x & LOW_NIBBLES) << 4) | ((x >> 8) & LOW_NIBBLES);
+      lanes = (lanes | (lanes >> 8)) & 0x0000FFFF0000FFFFULL;
+      lanes = (lanes | (lanes >> 16)) & 0x00000000FFFFFFFFULL;
+      uint32_t out = static_cast<uint32_t>(lanes);
+      memcpy(packed + i / 2, &out, sizeof(out));
+    }
+  }
+  for (; i < num_values; i += 2) {
+    packed[i / 2] = static_cast<char>((values[i] << 4) | (values[i + 1] & 0xF));
+  }
+}
+
+void unpack_int4(char const *packed, size_t num_values, uint8_t *values) {
+  assert(num_values % 2 == 0);
+  size_t i = 0;
+  if (SWAR_ENABLED) {
+    for (; i + 8 <= num_values; i += 8) {
+      uint32_t in;
+      memcpy(&in, packed + i / 2, sizeof(in));
+      // Spread the four bytes to 16-bit lanes, then split their nibbles
+      uint64_t lanes = in;
+      lanes = (lanes | (lanes << 16)) & 0x0000FFFF0000FFFFULL;
+      lanes = (lanes | (lanes << 8)) & 0x00FF00FF00FF00FFULL;
+      uint64_t x = ((lanes >> 4) & LOW_NIBBLES) | ((lanes & LOW_NIBBLES) << 8);
+      memcpy(values + i, &x, sizeof(x));
+    }
+  }
+  for (; i < num_values; i += 2) {
+    uint8_t byte = static_cast<uint8_t>(packed[i / 2]);
+    values[i] = byte >> 4;
+    values[i + 1] = byte & 0xF;
+  }
+}
+
+void pack_groupwise_rows(GroupwiseLayout const &layout,
+                         uint8_t const *values,
+                         char const *offsets,
+                         char const *scales,
+                         char *quantized) {
+  size_t meta_bytes = layout.groups_per_row() * layout.meta_type_size;
+  size_t value_bytes = layout.value_bytes_per_row();
+  for (size_t r = 0; r < layout.rows; r++) {
+    char *row = quantized + r * layout.row_bytes();
+    uint8_t const *row_values = values + r * layout.cols;
+    if (layout.quantization_type == DT_INT4) {
+      pack_int4(row_values, layout.cols, row);
+    } else {
+      memcpy(row, row_values, layout.cols);
+    }
+    memcpy(row + value_bytes, offsets + r * meta_bytes, meta_bytes);
+    memcpy(row + value_bytes + meta_bytes, scales + r * meta_bytes, meta_bytes);
+  }
+}
+
+void quantize_groupwise(float const *weight,
+                        GroupwiseLayout const &layout,
+                        char *quantized) {
+  assert(layout.meta_type_size == sizeof(float));
+  size_t num_groups = layout.groups_per_row();
+  int max_value = max_quantized_value(layout.quantization_type);
+  std::vector<uint8_t> values(layout.rows * layout.cols);
+  std::vector<float> offsets(layout.rows * num_groups);
+  std::vector<float> scales(layout.rows * num_groups);
+  for (size_t g = 0; g < layout.rows * num_groups; g++) {
+    float const *group = weight + g * layout.group_size;
+    auto range = std::minmax_element(group, group + layout.group_size);
+    offsets[g] = *range.first;
+    float width = *range.second - *range.first;
+    scales[g] = width > 0.0f ? max_value / width : 1.0f;
+    for (int i = 0; i < layout.group_size; i++) {
+      float q = std::round((group[i] - offsets[g]) * scales[g]);
+      values[g * layout.group_size + i] =
+          static_cast<uint8_t>(std::min(std::max(q, 0.0f), (float)max_value));
+    }
+  }
+  pack_groupwise_rows(layout,
+                      values.data(),
+                      reinterpret_cast<char const *>(offsets.data()),
+                      reinterpret_cast<char const *>(scales.data()),
+                      quantized);
+}
+
+void dequantize_groupwise(char const *quantized,
+                          GroupwiseLayout const &layout,
+                          float *weight) {
+  assert(layout.meta_type_size == sizeof(float));
+  size_t num_groups = layout.groups_per_row();
+  std::vector<uint8_t> values(layout.cols);
+  std::vector<float> offsets(num_groups), scales(num_groups);
+  for (size_t r = 0; r < layout.rows; r++) {
+    char const *row = quantized + r * layout.row_bytes();
+    get_row_values(row, layout, values.data());
+    char const *meta = row + layout.value_bytes_per_row();
+    memcpy(offsets.data(), meta, num_groups * sizeof(float));
+    memcpy(scales.data(), meta + num_groups * sizeof(float),
+           num_groups * sizeof(float));
+    for (size_t c = 0; c < layout.cols; c++) {
+      size_t g = c / layout.group_size;
+      weight[r * layout.cols + c] = values[c] / scales[g] + offsets[g];
+    }
+  }
+}
+
+void reference_dequant_gemm(char const *quantized,
+                            GroupwiseLayout const &layout,
+                            float const *input,
+                            size_t batch_size,
+                            float *output) {
+  assert(layout.meta_type_size == sizeof(float));
+  size_t num_groups = layout.groups_per_row();
+  std::vector<uint8_t> values(layout.cols);
+  std::vector<float> offsets(num_groups), scales(num_groups);
+  std::fill(output, output + batch_size * layout.rows, 0.0f);
+  for (size_t r = 0; r < layout.rows; r++) {
+    char const *row = quantized + r * layout.row_bytes();
+    get_row_values(row, layout, values.data());
+    char const *meta = row + layout.value_bytes_per_row();
+    memcpy(offsets.data(), meta, num_groups * sizeof(float));
+    memcpy(scales.data(), meta + num_groups * sizeof(float),
+           num_groups * sizeof(float));
+    for (size_t b = 0; b < batch_size; b++) {
+      float const *x = input + b * layout.cols;
+      double sum = 0.0;
+      // Within a group, sum(x * (q / scale + offset)) is
+      // sum(x * q) / scale + sum(x) * offset
+      for (size_t g = 0; g < num_groups; g++) {
+        double dot = 0.0, x_sum = 0.0;
+        for (int i = 0; i < layout.group_size; i++) {
+          size_t c = g * layout.group_size + i;
+          dot += x[c] * values[c];
+          x_sum += x[c];
+        }
+        sum += dot / scales[g] + x_sum * offsets[g];
+      }
+      output[b * layout.rows + r] = static_cast<float>(sum);
+    }
+  }
+}
+
+}; // namespace FlexFlow
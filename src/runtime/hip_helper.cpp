@@ -554,6 +554,16 @@ void handle_unimplemented_hip_kernel(OperatorType op_type) {
                            FlexFlow::get_operator_type_name(op_type));
 }
 
+std::string get_local_gpu_description() {
+  int num_devices = 0;
+  if (hipGetDeviceCount(&num_devices) != hipSuccess || num_devices == 0) {
+    return "";
+  }
+  hipDeviceProp_t prop;
+  checkCUDA(hipGetDeviceProperties(&prop, 0));
+  return std::string(prop.name) + " " + std::string(prop.gcnArchName);
+}
+
 template __global__ void
     assign_kernel<half>(half *ptr, coord_t size, half value);
 template __global__ void
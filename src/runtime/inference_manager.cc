@@ -13,6 +13,7 @@
  * limitations under the License.
  */
 
+#include "flexflow/activation_memory_planner.h"
 #include "flexflow/ffconst_utils.h"
 #include "flexflow/graph.h"
 #include "flexflow/model.h"
@@ -41,22 +42,10 @@ InferenceManager *InferenceManager::get_inference_manager() {
   return inference_manager_singleton;
 }
 
-bool parallel_tensor_list_overlaps(std::vector<ParallelTensor> const &list1,
-                                   std::vector<ParallelTensor> const &list2) {
-  for (auto const &pt1 : list1) {
-    for (auto const &pt2 : list2) {
-      if (pt1 == pt2) {
-        return true;
-      }
-    }
-  }
-  return false;
-}
-
 void InferenceManager::compile_model_and_allocate_buffer(FFModel *model) {
-  // TODO: currently assume there is a single data-parallel pipeline
-  // (i.e., data-parallel-degree == 1)
-  assert(model->config.data_parallelism_degree == 1);
+  // Each data-parallel replica runs a copy of the pipeline on its own
+  // tensor_parallelism_degree GPUs of every stage, and the j-th entry of each
+  // tensor_buffer list is the buffer of the j-th replica
   model->config.batchSize = BatchConfig::max_tokens_per_batch();
   model->compile_inference();
   Context ctx = model->config.lg_ctx;
@@ -70,8 +59,46 @@ void InferenceManager::compile_model_and_allocate_buffer(FFModel *model) {
   int degree = model->config.data_parallelism_degree *
                model->config.tensor_parallelism_degree;
 
+  // Each buffer is reused once the last operator reading its tensor has run,
+  // so find the last reader of every tensor in one pass
+  std::unordered_map<ParallelTensor, int> last_uses;
+  for (int op_idx = 0; op_idx < model->operators.size(); op_idx++) {
+    Op const *op = model->operators[op_idx];
+    for (int j = 0; j < op->numInputs; j++) {
+      last_uses[op->inputs[j]] = op_idx;
+    }
+  }
+  // Tensors whose buffers become free before each operator runs
+  std::vector<std::vector<ParallelTensor>> releases(
+      model->operators.size() + 1);
+  // Free buffers by shape and by the machine view of the first data pipeline,
+  // which identifies the pipeline stage
+  std::unordered_map<std::pair<ParallelTensorShape, MachineView>,
+                     std::vector<std::vector<ParallelTensor>>>
+      free_buffers;
+  // Buffers of previously compiled models are free for this one
+  {
+    std::unordered_set<ParallelTensor> seen;
+    for (auto const &it : tensor_buffer) {
+      if (seen.insert(it.second[0]).second) {
+        free_buffers[std::make_pair(it.second[0]->get_shape(),
+                                    it.second[0]->machine_view)]
+            .push_back(it.second);
+      }
+    }
+  }
+  // Live intervals of the outputs for the planner, with one arena per stage
+  std::vector<ActivationInterval> intervals;
+  std::unordered_map<MachineView, int> stage_arenas;
+  std::vector<size_t> allocated_bytes;
+
   for (int op_idx = 0; op_idx < model->operators.size(); op_idx++) {
     Op const *op = model->operators[op_idx];
+    for (ParallelTensor const &pt : releases[op_idx]) {
+      std::vector<ParallelTensor> const &list = tensor_buffer.at(pt);
+      free_buffers[std::make_pair(pt->get_shape(), list[0]->machine_view)]
+          .push_back(list);
+    }
     // Skip weight operators
     if (op->op_type == OP_WEIGHT) {
       continue;
@@ -103,11 +130,17 @@ void InferenceManager::compile_model_and_allocate_buffer(FFModel *model) {
         }
         layer_guid = op_with_guid->layer_guid;
       }
-      mv.start_device_id = degree * (layer_guid.transformer_layer_id /
-                                     num_transformer_layers_per_stage);
-      assert(mv == op->outputs[0]->machine_view);
+      mv.start_device_id =
+          degree * (layer_guid.transformer_layer_id /
+                    num_transformer_layers_per_stage) +
+          j * model->config.tensor_parallelism_degree;
+      // The searched strategy places the first replica
+      assert(j > 0 || mv == op->outputs[0]->machine_view);
       machine_views.push_back(mv);
     }
+    int arena = stage_arenas.emplace(machine_views[0], stage_arenas.size())
+                    .first->second;
+    allocated_bytes.resize(stage_arenas.size(), 0);
     // std::cout << "operator: " << op->name << std::endl;
     // for (int i = 0; i < op->numInputs; i++) {
     //   op->inputs[i]->print("input pt");
@@ -127,61 +160,29 @@ void InferenceManager::compile_model_and_allocate_buffer(FFModel *model) {
       std::vector<ParallelTensor> list;
       bool found_parallel_tensor = false;
       // Always enable memory reuse
-      // if (model->cpu_offload) {
-      if (true) {
-        for (auto const &pre_pt : tensor_buffer) {
-          bool used_by_future_operator = false;
-          bool used_by_current_operator = false;
-          if (pre_pt.first->get_shape() != pt_base->get_shape()) {
-            // Continue if shape mismatches
-            continue;
-          }
-          // Skip if pre_pt and pt_base are in different pipeline stages
-          // we compare their pipeline stages using the machine views
-          // of the first data pipeline
-          if (pre_pt.second[0]->machine_view != machine_views[0]) {
-            continue;
-          }
-          // Check that pt cannot be used as an input to the current operator
-          for (int j = 0; j < op->numInputs; j++) {
-            if (parallel_tensor_list_overlaps(tensor_buffer[op->inputs[j]],
-                                              pre_pt.second)) {
-              used_by_current_operator = true;
-            }
-          }
-          for (int j = 0; j < i; j++) {
-            assert(tensor_buffer.find(op->outputs[j]) != tensor_buffer.end());
-            if (parallel_tensor_list_overlaps(tensor_buffer[op->outputs[j]],
-                                              pre_pt.second)) {
-              used_by_current_operator = true;
-            }
-          }
-          // Check that pt cannot be used by any subsequent operators
-          for (int op_idx2 = op_idx; op_idx2 < model->operators.size();
-               op_idx2++) {
-            Op const *op2 = model->operators[op_idx2];
-            for (int j = 0; j < op2->numInputs; j++) {
-              if (tensor_buffer.find(op2->inputs[j]) != tensor_buffer.end()) {
-                if (parallel_tensor_list_overlaps(tensor_buffer[op2->inputs[j]],
-                                                  pre_pt.second)) {
-                  used_by_future_operator = true;
-                }
-              }
-            }
-          }
-          if (!used_by_future_operator && !used_by_current_operator) {
-            found_parallel_tensor = true;
-            list = pre_pt.second;
-          }
-        }
-        if (!found_parallel_tensor) {
-          log_offload.print(
-              "Cannot find a previous tensor for operator(%d) output_idx(%d)",
-              op_idx,
-              i);
-        }
+      auto const &free_it = free_buffers.find(
+          std::make_pair(pt_base->get_shape(), machine_views[0]));
+      if (free_it != free_buffers.end() && !free_it->second.empty()) {
+        found_parallel_tensor = true;
+        list = free_it->second.back();
+        free_it->second.pop_back();
+      } else {
+        log_offload.print(
+            "Cannot find a previous tensor for operator(%d) output_idx(%d)",
+            op_idx,
+            i);
+      }
+      int last_use = op_idx;
+      if (last_uses.find(pt_base) != last_uses.end()) {
+        last_use = last_uses.at(pt_base);
       }
+      releases[last_use + 1].push_back(pt_base);
+      intervals.push_back({pt_base->get_shape().get_piece_size(),
+                           op_idx,
+                           last_use,
+                           arena});
       if (!found_parallel_tensor) {
+        allocated_bytes[arena] += intervals.back().size;
         for (int j = 0; j < model->config.data_parallelism_degree; j++) {
           // Copy the metadata from pt_base to pt
           ParallelTensor pt = new ParallelTensorBase(*pt_base);
@@ -204,27 +205,28 @@ void InferenceManager::compile_model_and_allocate_buffer(FFModel *model) {
     }
     // std::cout << std::endl;
   }
+  {
+    ActivationMemoryPlan plan = plan_activation_memory(intervals);
+    size_t allocated_peak = 0;
+    for (size_t bytes : allocated_bytes) {
+      allocated_peak = std::max(allocated_peak, bytes);
+    }
+    log_inf_mgr.print("Activation memory per GPU of the largest stage: "
+                      "%.2lf MB without reuse, %.2lf MB allocated, %.2lf MB "
+                      "planned, %.2lf MB live at most",
+                      plan.naive_peak / 1e6,
+                      allocated_peak / 1e6,
+                      plan.planned_peak / 1e6,
+                      plan.live_peak / 1e6);
+  }
 
   // Perform fusion optimizations
   if (model->config.perform_fusion) {
     fprintf(stderr, "Applying fusion optimizations during compilation...\n");
     fprintf(
         stderr, "%zu operators before fusion...\n", model->operators.size());
-    std::vector<Op *> new_operators;
     std::vector<Op *> old_operators = model->operators;
-    while (
-        model->apply_fusion(model->operators, new_operators, &tensor_buffer)) {
-      for (size_t i = 0; i < new_operators.size(); i++) {
-        for (int idx = 0; idx < new_operators[i]->numInputs; idx++) {
-          for (size_t j = i + 1; j < new_operators.size(); j++) {
-            if (new_operators[i]->inputs[idx]->owner_op == new_operators[j]) {
-              assert(false);
-            }
-          }
-        }
-      }
-      model->operators = new_operators;
-    }
+    model->fuse_operators(&tensor_buffer);
     assert(model->check_operators_integrity(old_operators, &tensor_buffer));
     fprintf(stderr, "%zu operators after fusion...\n", model->operators.size());
   }
@@ -361,7 +363,8 @@ FutureMap InferenceManager::inference(FFModel *model,
         assert(op->numOutputs == 1);
         ParallelTensor pt = tensor_buffer[op->outputs[0]][batch_index];
         load_input_tokens_from_batch_config(model, bc, pt, model->handlers);
-        load_inference_metadata_batch_config(model, bc, model->handlers);
+        load_inference_metadata_batch_config(
+            model, bc, model->handlers, batch_index);
       }
     }
 
@@ -436,9 +439,45 @@ void InferenceManager::load_input_tokens_from_batch_config(
 }
 
 void InferenceManager::load_inference_metadata_batch_config(
-    FFModel *model, BatchConfigFuture const &bc, FFHandler *handlers) {
+    FFModel *model,
+    BatchConfigFuture const &bc,
+    FFHandler *handlers,
+    int batch_index) {
   Context ctx = model->config.lg_ctx;
   Runtime *runtime = model->config.lg_hlr;
+  if (model->config.data_parallelism_degree > 1) {
+    // Only the GPUs of this replica, stage by stage, get its batch
+    int tp_degree = model->config.tensor_parallelism_degree;
+    for (int stage = 0; stage < model->config.pipeline_parallelism_degree;
+         stage++) {
+      MachineView view;
+      view.device_type = MachineView::GPU;
+      view.ndims = 1;
+      view.dim[0] = tp_degree;
+      view.stride[0] = 1;
+      view.start_device_id =
+          (stage * model->config.data_parallelism_degree + batch_index) *
+          tp_degree;
+      IndexSpace task_is = model->get_or_create_task_is(view);
+      ArgumentMap argmap;
+      Rect<1> task_rect = runtime->get_index_space_domain(ctx, task_is);
+      for (PointInRectIterator<1> it(task_rect); it(); it++) {
+        FFHandler handler = handlers[view.get_device_id(*it)];
+        argmap.set_point(*it, TaskArgument(&handler, sizeof(FFHandler)));
+      }
+      IndexLauncher launcher(RM_LOAD_BATCH_CONFIG_TASK_ID,
+                             task_is,
+                             TaskArgument(nullptr, 0),
+                             argmap,
+                             Predicate::TRUE_PRED,
+                             false /*must*/,
+                             0 /*mapper_id*/,
+                             view.hash());
+      launcher.add_future(bc);
+      runtime->execute_index_space(ctx, launcher);
+    }
+    return;
+  }
   ArgumentMap argmap;
 
   Domain domain =
@@ -519,20 +558,16 @@ void FFModel::compile_inference() {
   Runtime *runtime = config.lg_hlr;
   config.computationMode = COMP_MODE_INFERENCE;
   create_operators_from_layers();
-  // Launch the graph optimize task
+  // Search for the best PCG, or import it
   {
-    FFModel *model = this;
-    TaskLauncher launcher(GRAPH_OPTIMIZE_TASK_ID,
-                          TaskArgument(&model, sizeof(FFModel *)));
-    Future future = runtime->execute_task(ctx, launcher);
-
-    PCG::GraphOptimalViewSerialized ret =
-        future.get_result<PCG::GraphOptimalViewSerialized>();
-    Deserializer dez(ret.data, ret.total_bytes);
+    StrategyGuidMap guid_map;
+    std::vector<char> serialized_pcg = search_or_import_strategy(guid_map);
+    Deserializer dez(serialized_pcg.data(), serialized_pcg.size());
     // Reconstruct operators
     PCG::Graph *best_graph = new PCG::Graph(this);
     std::unordered_map<PCG::Node, MachineView> optimal_views;
     deserialize_graph_optimal_view(dez, best_graph, optimal_views);
+    apply_strategy_guid_map(best_graph, guid_map);
     operators.clear();
     convert_graph_to_operators(best_graph, optimal_views);
     best_graph->print_dot();
@@ -0,0 +1,78 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/kv_cache_quantization.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace FlexFlow {
+
+size_t kv_cache_bytes(DataType cache_type,
+                      DataType data_type,
+                      size_t num_tokens,
+                      int num_heads,
+                      int head_dim) {
+  size_t num_values = num_tokens * num_heads * head_dim;
+  switch (cache_type) {
+    case DT_NONE: {
+      assert(data_type == DT_HALF || data_type == DT_FLOAT);
+      return num_values * (data_type == DT_HALF ? 2 : 4);
+    }
+    case DT_INT8:
+      return num_values * sizeof(int8_t) +
+             num_tokens * num_heads * sizeof(float);
+    default:
+      assert(false && "Unsupported KV cache type");
+  }
+  return 0;
+}
+
+void quantize_kv_int8(float const *values,
+                      int num_tokens,
+                      int num_heads,
+                      int head_dim,
+                      int8_t *quantized,
+                      float *scales) {
+  for (int i = 0; i < num_tokens * num_heads; i++) {
+    float const *head = values + (size_t)i * head_dim;
+    float max_abs = 0.0f;
+    for (int d = 0; d < head_dim; d++) {
+      max_abs = std::max(max_abs, std::fabs(head[d]));
+    }
+    float inv_scale = max_abs > 0.0f ? 127.0f / max_abs : 0.0f;
+    scales[i] = max_abs / 127.0f;
+    for (int d = 0; d < head_dim; d++) {
+      quantized[(size_t)i * head_dim + d] =
+          static_cast<int8_t>(std::nearbyint(head[d] * inv_scale));
+    }
+  }
+}
+
+void dequantize_kv_int8(int8_t const *quantized,
+                        float const *scales,
+                        int num_tokens,
+                        int num_heads,
+                        int head_dim,
+                        float *values) {
+  for (int i = 0; i < num_tokens * num_heads; i++) {
+    for (int d = 0; d < head_dim; d++) {
+      size_t idx = (size_t)i * head_dim + d;
+      values[idx] = quantized[idx] * scales[i];
+    }
+  }
+}
+
+}; // namespace FlexFlow
@@ -137,6 +137,44 @@ bool Layer::get_initializer(std::string const &key,
   }
 }
 
+uint64_t Layer::get_params_hash() const {
+  StableHasher hasher;
+  hasher.update(op_type);
+  hasher.update(data_type);
+  hasher.update(numInputs);
+  hasher.update(numWeights);
+  hasher.update(numOutputs);
+  auto hash_tensor = [&](Tensor const tensor) {
+    hasher.update(tensor->data_type);
+    hasher.update(tensor->num_dims);
+    hasher.update(tensor->dims, tensor->num_dims * sizeof(int));
+  };
+  for (int i = 0; i < numInputs; i++) {
+    hash_tensor(inputs[i]);
+  }
+  for (int i = 0; i < numOutputs; i++) {
+    hash_tensor(outputs[i]);
+  }
+  // The property maps are unordered, so hash them in key order
+  for (auto const &it : std::map<std::string, long long>(
+           int_properties.begin(), int_properties.end())) {
+    hasher.update(it.first);
+    hasher.update(it.second);
+  }
+  for (auto const &it : std::map<std::string, float>(
+           float_properties.begin(), float_properties.end())) {
+    hasher.update(it.first);
+    hasher.update(it.second);
+  }
+  for (auto const &it : std::map<std::string, std::vector<int>>(
+           int_vector_properties.begin(), int_vector_properties.end())) {
+    hasher.update(it.first);
+    hasher.update(it.second.size());
+    hasher.update(it.second.data(), it.second.size() * sizeof(int));
+  }
+  return hasher.digest();
+}
+
 void Layer::print() {}
 
 Tensor Layer::get_parameter(int index) {
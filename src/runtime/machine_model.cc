@@ -67,14 +67,22 @@ SimpleMachineModel::SimpleMachineModel(int num_nodes,
   inter_gpu_bandwidth = 20 * 1024 * 1024.0f;              /* B/ms*/
   inter_node_bandwidth = 12 * 1024 * 1024.0f / num_nodes; /* B/ms*/
   gpu_dram_bandwidth = 16 * 1024 * 1024.0f;               /* B/ms*/
+  // V100 GPUs and one core of a Xeon CPU, in FLOPs/ms and B/ms
+  gpu_roofline.peak_flops = 15.7e9f;
+  gpu_roofline.peak_half_flops = 125e9f;
+  gpu_roofline.mem_bandwidth = 900 * 1024 * 1024.0f;
+  cpu_roofline.peak_flops = 50e6f;
+  cpu_roofline.peak_half_flops = 50e6f;
+  cpu_roofline.mem_bandwidth = 10 * 1024 * 1024.0f;
+  cpu = new CompDevice("CPU", CompDevice::LOC_PROC, 0, 0, 0, cpu_roofline);
 
   // Create GPU compute device
   for (int i = 0; i < num_nodes; i++) {
     for (int j = 0; j < num_gpus_per_node; j++) {
       int device_id = i * num_gpus_per_node + j;
       std::string gpu_name = "GPU " + std::to_string(device_id);
-      id_to_gpu[device_id] =
-          new CompDevice(gpu_name, CompDevice::TOC_PROC, i, i, device_id);
+      id_to_gpu[device_id] = new CompDevice(
+          gpu_name, CompDevice::TOC_PROC, i, i, device_id, gpu_roofline);
       std::string gpu_mem_name = "GPU_FB_MEM " + std::to_string(device_id);
       id_to_gpu_fb_mem[device_id] = new MemDevice(
           gpu_mem_name, MemDevice::GPU_FB_MEM, i, i, device_id, capacity);
@@ -153,6 +161,10 @@ CompDevice *SimpleMachineModel::get_gpu(int device_id) const {
   return id_to_gpu.at(device_id);
 }
 
+CompDevice *SimpleMachineModel::get_cpu(int device_id) const {
+  return cpu;
+}
+
 MemDevice *SimpleMachineModel::get_gpu_fb_mem(int device_id) const {
   assert(id_to_gpu_fb_mem.find(device_id) != id_to_gpu_fb_mem.end());
   return id_to_gpu_fb_mem.at(device_id);
@@ -303,6 +315,21 @@ EnhancedMachineModel::EnhancedMachineModel(std::string file,
         } else if (words[0] == "nvlink_bandwidth") {
           nvlink_bandwidth = stof(words[2]);
           printf("nvlink_bandwidth = %f\n", nvlink_bandwidth);
+        } else if (words[0] == "gpu_peak_tflops") {
+          gpu_peak_tflops = stof(words[2]);
+          printf("gpu_peak_tflops = %f\n", gpu_peak_tflops);
+        } else if (words[0] == "gpu_half_peak_tflops") {
+          gpu_half_peak_tflops = stof(words[2]);
+          printf("gpu_half_peak_tflops = %f\n", gpu_half_peak_tflops);
+        } else if (words[0] == "gpu_mem_bandwidth") {
+          gpu_mem_bandwidth = stof(words[2]);
+          printf("gpu_mem_bandwidth = %f\n", gpu_mem_bandwidth);
+        } else if (words[0] == "cpu_peak_gflops") {
+          cpu_peak_gflops = stof(words[2]);
+          printf("cpu_peak_gflops = %f\n", cpu_peak_gflops);
+        } else if (words[0] == "cpu_mem_bandwidth") {
+          cpu_mem_bandwidth = stof(words[2]);
+          printf("cpu_mem_bandwidth = %f\n", cpu_mem_bandwidth);
         } else if (words[0] == "intra_socket_sys_mem_to_sys_mem") {
           printf("intra_socket_sys_mem_to_sys_mem = ");
           for (size_t i = 2; i < words.size(); i++) {
@@ -454,8 +481,18 @@ void EnhancedMachineModel::add_cpus() {
       for (int k = 0; k < num_cpus_per_socket; k++) {
         device_id = socket_id * num_cpus_per_socket + k;
         std::string cpu_name = "CPU " + std::to_string(device_id);
-        cpus[socket_id].emplace_back(new CompDevice(
-            cpu_name, CompDevice::LOC_PROC, node_id, socket_id, device_id));
+        // GFLOPS are converted to FLOPs per ms, GB/s to B/ms
+        DeviceRoofline roofline;
+        roofline.peak_flops = cpu_peak_gflops * 1e6f;
+        roofline.peak_half_flops = cpu_peak_gflops * 1e6f;
+        roofline.mem_bandwidth = cpu_mem_bandwidth * 1024 * 1024;
+        CompDevice *cpu = new CompDevice(cpu_name,
+                                         CompDevice::LOC_PROC,
+                                         node_id,
+                                         socket_id,
+                                         device_id,
+                                         roofline);
+        cpus[socket_id].emplace_back(cpu);
       }
     }
   }
@@ -482,8 +519,21 @@ void EnhancedMachineModel::add_gpus() {
       for (int k = 0; k < num_gpus_per_socket; k++) {
         device_id = socket_id * num_gpus_per_socket + k;
         std::string gpu_name = "GPU " + std::to_string(device_id);
-        gpus[socket_id].push_back(new CompDevice(
-            gpu_name, CompDevice::TOC_PROC, node_id, socket_id, device_id));
+        // TFLOPS are converted to FLOPs per ms, GB/s to B/ms; half precision
+        // runs at the single-precision peak unless the file says otherwise
+        DeviceRoofline roofline;
+        roofline.peak_flops = gpu_peak_tflops * 1e9f;
+        roofline.peak_half_flops = gpu_half_peak_tflops > 0
+                                       ? gpu_half_peak_tflops * 1e9f
+                                       : roofline.peak_flops;
+        roofline.mem_bandwidth = gpu_mem_bandwidth * 1024 * 1024;
+        CompDevice *gpu = new CompDevice(gpu_name,
+                                         CompDevice::TOC_PROC,
+                                         node_id,
+                                         socket_id,
+                                         device_id,
+                                         roofline);
+        gpus[socket_id].push_back(gpu);
         std::string gpu_mem_name = "GPU_FB_MEM " + std::to_string(device_id);
         MemDevice *gpu_mem = new MemDevice(gpu_mem_name,
                                            MemDevice::GPU_FB_MEM,
@@ -972,20 +1022,29 @@ NetworkedMachineModel::NetworkedMachineModel(int num_nodes,
                                              float link_bandwidth)
     : num_nodes(num_nodes), num_gpus_per_node(num_gpus_per_node),
       num_switches(num_switches), link_bandwidth(link_bandwidth),
-      network_latency(network_latency), conn_matrix(topology) {
+      network_latency(network_latency), pipelined(false), pcie_on(false),
+      conn_matrix(topology) {
   version = 0;
 
   num_gpus = num_nodes * num_gpus_per_node;
   inter_gpu_bandwidth = 20 * 1024 * 1024.0f; /* B/ms*/
   gpu_dram_bandwidth = 32 * 1024 * 1024.0f;
+  // V100 GPUs and one core of a Xeon CPU, in FLOPs/ms and B/ms
+  gpu_roofline.peak_flops = 15.7e9f;
+  gpu_roofline.peak_half_flops = 125e9f;
+  gpu_roofline.mem_bandwidth = 900 * 1024 * 1024.0f;
+  cpu_roofline.peak_flops = 50e6f;
+  cpu_roofline.peak_half_flops = 50e6f;
+  cpu_roofline.mem_bandwidth = 10 * 1024 * 1024.0f;
+  cpu = new CompDevice("CPU", CompDevice::LOC_PROC, 0, 0, 0, cpu_roofline);
 
   // Create GPU compute device
   for (int i = 0; i < num_nodes; i++) {
     for (int j = 0; j < num_gpus_per_node; j++) {
       int device_id = i * num_gpus_per_node + j;
       std::string gpu_name = "GPU " + std::to_string(device_id);
-      id_to_gpu[device_id] =
-          new CompDevice(gpu_name, CompDevice::TOC_PROC, i, i, device_id);
+      id_to_gpu[device_id] = new CompDevice(
+          gpu_name, CompDevice::TOC_PROC, i, i, device_id, gpu_roofline);
       std::string gpu_mem_name = "GPU_FB_MEM " + std::to_string(device_id);
       id_to_gpu_fb_mem[device_id] = new MemDevice(
           gpu_mem_name, MemDevice::GPU_FB_MEM, i, i, device_id, capacity);
@@ -1056,7 +1115,7 @@ NetworkedMachineModel::NetworkedMachineModel(int num_nodes,
     // }
   }
 
-  routing_strategy = new ShortestPathNetworkRoutingStrategy(
+  routing_strategy = new EcmpRoutingStrategy(
       conn_matrix, ids_to_nw_comm_device, total_devs);
   update_route();
 }
@@ -1070,6 +1129,7 @@ int NetworkedMachineModel::get_version() const {
 }
 
 void NetworkedMachineModel::update_route() {
+  routing_strategy->invalidate();
   // nominal network links
   int total_devs = num_nodes + num_switches;
   for (int i = 0; i < num_nodes; i++) {
@@ -1109,6 +1169,10 @@ CompDevice *NetworkedMachineModel::get_gpu(int device_id) const {
   return id_to_gpu.at(device_id);
 }
 
+CompDevice *NetworkedMachineModel::get_cpu(int device_id) const {
+  return cpu;
+}
+
 MemDevice *NetworkedMachineModel::get_gpu_fb_mem(int device_id) const {
   assert(id_to_gpu_fb_mem.find(device_id) != id_to_gpu_fb_mem.end());
   return id_to_gpu_fb_mem.at(device_id);
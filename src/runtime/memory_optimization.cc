@@ -17,6 +17,16 @@
 
 namespace FlexFlow {
 
+/*static*/
+MemoryOptimConfig
+    MemoryOptimConfig::constrained(float per_device_memory_limit) {
+  MemoryOptimConfig config;
+  config.mem_usage_type = MemoryUsageType::PER_DEVICE_MAX;
+  config.mem_search_algo = MemorySearchAlgo::CONSTRAINED;
+  config.per_device_memory_limit = per_device_memory_limit;
+  return config;
+}
+
 namespace PCG {
 
 std::string MemoryUsage::to_string() const {
@@ -19,7 +19,9 @@
 #else
 #include "flexflow/utils/hip_helper.h"
 #endif
+#include "flexflow/analytical_cost_model.h"
 #include "flexflow/ffconst_utils.h"
+#include "flexflow/fusion_planner.h"
 #include "flexflow/graph.h"
 #include "flexflow/mapper.h"
 #include "flexflow/ops/add_bias_residual_layer_norm.h"
@@ -75,6 +77,8 @@
 #include "flexflow/utils/test_utils.h"
 #include "legion/legion_utilities.h"
 #include <dirent.h>
+#include <filesystem>
+#include <fstream>
 #include <queue>
 #include <unordered_set>
 
@@ -1520,7 +1524,9 @@ FFRuntime::FFRuntime(FFConfig &config) {
     info.workSpaceSize = config.workSpaceSize;
     info.offload_reserve_space_size =
         config.cpu_offload ? config.offload_reserve_space_size : 0;
+    info.offload_prefetch_depth = config.offload_prefetch_depth;
     info.quantization_type = config.quantization_type;
+    info.kv_cache_quantization_type = config.kv_cache_quantization_type;
     info.allowTensorOpMathConversion = config.allow_tensor_op_math_conversion;
     argmap.set_point(*it, TaskArgument(&info, sizeof(FFInitInfo)));
   }
@@ -3026,6 +3032,151 @@ bool FFModel::apply_fusion(
   return false;
 }
 
+void FFModel::fuse_operators(
+    std::unordered_map<ParallelTensor, std::vector<ParallelTensor>>
+        *parallel_tensor_mapping) {
+  // Tensors that use the same regions get the same id, so that the plan
+  // deduplicates them the way FusedOp::add_operator does
+  std::map<LogicalRegion, int> region_ids;
+  std::vector<size_t> tensor_bytes;
+  auto get_tensor_id = [&](ParallelTensor const tensor, bool mapped) {
+    ParallelTensor source = tensor;
+    if (mapped && parallel_tensor_mapping != nullptr) {
+      assert(parallel_tensor_mapping->find(tensor) !=
+             parallel_tensor_mapping->end());
+      source = (*parallel_tensor_mapping)[tensor][0];
+    }
+    auto it = region_ids.emplace(source->region, (int)tensor_bytes.size());
+    if (it.second) {
+      tensor_bytes.push_back(tensor->get_shape().get_piece_size());
+    }
+    return it.first->second;
+  };
+  Memory gpu_mem = Machine::MemoryQuery(Machine::get_machine())
+                       .only_kind(Memory::GPU_FB_MEM)
+                       .first();
+  size_t gpu_mem_capacity = gpu_mem.exists() ? gpu_mem.capacity() : 0;
+  SimpleMachineModel machine(
+      config.numNodes, config.workersPerNode, gpu_mem_capacity);
+  AnalyticalCostModel analytical_cost_model(&machine, config.computationMode);
+
+  std::vector<FusionNode> nodes(operators.size());
+  for (size_t i = 0; i < operators.size(); i++) {
+    Op *op = operators[i];
+    FusionNode &node = nodes[i];
+    // Input and weight operators launch no tasks, parallel ops other than
+    // allreduce have different parallel_is in forward and backward, and the
+    // final operator is looked up by get_final_operator
+    node.fusible = op->op_type != OP_INPUT && op->op_type != OP_WEIGHT &&
+                   op->op_type != OP_FUSED &&
+                   (!op->is_parallel_op() || op->op_type == OP_ALLREDUCE) &&
+                   i + 1 < operators.size();
+    node.can_start_group = node.fusible && !op->has_inplace_output();
+    MachineView view = op->outputs[0]->machine_view;
+    node.view_hash = view.hash();
+    for (int j = 0; j < op->numInputs; j++) {
+      node.inputs.push_back(get_tensor_id(op->inputs[j], true));
+    }
+    for (int j = 0; j < op->numWeights; j++) {
+      node.weights.push_back(get_tensor_id(op->weights[j], false));
+    }
+    for (int j = 0; j < op->numOutputs; j++) {
+      node.outputs.push_back(get_tensor_id(op->outputs[j], true));
+    }
+    CostMetrics cost_metrics;
+    if (node.fusible && analytical_cost_model.estimate_operator_cost(
+                            op, view, cost_metrics)) {
+      node.run_time = cost_metrics.forward_time + cost_metrics.backward_time;
+    }
+  }
+
+  FusionCostModel cost_model;
+  // A fused task maps the regions of all its operators at once; let a group
+  // use at most a quarter of the device memory
+  cost_model.max_mapped_bytes = gpu_mem_capacity / 4;
+  cost_model.max_operators = MAX_NUM_FUSED_OPERATORS;
+  cost_model.max_tensors = MAX_NUM_FUSED_TENSORS;
+  cost_model.max_inputs = MAX_NUM_INPUTS;
+  cost_model.max_weights = MAX_NUM_WEIGHTS;
+  cost_model.max_outputs = MAX_NUM_OUTPUTS;
+  FusionPlan plan = plan_fusion(nodes, tensor_bytes, cost_model);
+
+  std::vector<Op *> new_operators;
+  std::unordered_map<Op const *, FusedOp *> fused_ops;
+  for (std::vector<int> const &group : plan.groups) {
+    Op *first = operators[group[0]];
+    if (group.size() == 1) {
+      new_operators.push_back(first);
+      continue;
+    }
+    FusedOp *fused_op = new FusedOp(*this, first);
+    for (size_t k = 1; k < group.size(); k++) {
+      bool added = fused_op->add_operator(
+          *this, operators[group[k]], parallel_tensor_mapping);
+      assert(added && "the fusion plan exceeds the capacity of FusedOp");
+    }
+    for (int idx : group) {
+      fused_ops[operators[idx]] = fused_op;
+    }
+    new_operators.push_back(fused_op);
+  }
+  // FusedOp takes ownership of the outputs of its operators, except for those
+  // that share a region with one of its outputs; consumers of the latter must
+  // read the output of the FusedOp instead
+  for (Op *op : new_operators) {
+    if (op->op_type == OP_FUSED) {
+      continue;
+    }
+    for (int idx = 0; idx < op->numInputs; idx++) {
+      auto it = fused_ops.find(op->inputs[idx]->owner_op);
+      if (it == fused_ops.end()) {
+        continue;
+      }
+      FusedOp *fused_op = it->second;
+      int found = -1;
+      for (int k = 0; k < fused_op->numOutputs; k++) {
+        if (fused_op->use_same_regions(fused_op->outputs[k],
+                                       op->inputs[idx],
+                                       parallel_tensor_mapping)) {
+          assert(found == -1);
+          found = k;
+        }
+      }
+      assert(found >= 0);
+      op->inputs[idx] = fused_op->outputs[found];
+    }
+  }
+
+  fprintf(stderr,
+          "Fusion saves %zu task launches (%.3lf ms per iteration)\n",
+          operators.size() - new_operators.size(),
+          plan.saved_time);
+  if (!config.fusion_report_file.empty()) {
+    std::ofstream report(config.fusion_report_file);
+    for (size_t g = 0; g < plan.groups.size(); g++) {
+      float run_time = 0.0f;
+      for (int idx : plan.groups[g]) {
+        run_time += nodes[idx].run_time;
+      }
+      report << "group " << g << ": " << plan.groups[g].size()
+             << " operators, " << plan.group_mapped_bytes[g] / 1e6
+             << " MB mapped, " << run_time << " ms estimated\n";
+      for (int idx : plan.groups[g]) {
+        Op const *op = operators[idx];
+        report << "  " << op->name << " ("
+               << get_operator_type_name(op->op_type) << "): "
+               << get_fusion_decision_name(plan.decisions[idx]) << "\n";
+      }
+    }
+    if (!report) {
+      fprintf(stderr,
+              "[Warning] Cannot write the fusion report to %s\n",
+              config.fusion_report_file.c_str());
+    }
+  }
+  operators = new_operators;
+}
+
 Op *FFModel::create_operator_from_layer(
     Layer *layer, std::vector<ParallelTensor> const &inputs) {
   switch (layer->op_type) {
@@ -3382,6 +3533,216 @@ void FFModel::create_operators_from_layers() {
   }
 }
 
+StrategyFile FFModel::get_strategy_file() const {
+  StrategyFile strategy;
+  strategy.num_nodes = config.numNodes;
+  strategy.gpus_per_node = config.workersPerNode;
+  strategy.cpus_per_node = config.cpusPerNode;
+  strategy.computation_mode = config.computationMode;
+  strategy.model_id = model_id;
+  for (Layer const *layer : layers) {
+    StrategyLayer record;
+    record.key.op_type = layer->op_type;
+    // Layers of different transformer blocks usually only differ by this
+    StableHasher hasher;
+    hasher.update(layer->get_params_hash());
+    hasher.update(layer->layer_guid.transformer_layer_id);
+    record.key.params_hash = hasher.digest();
+    // Layer names end with their guid, which depends on creation order
+    record.key.name = layer->name;
+    std::string suffix = "_" + std::to_string(layer->layer_guid.id);
+    if (record.key.name.size() > suffix.size() &&
+        record.key.name.compare(record.key.name.size() - suffix.size(),
+                                suffix.size(),
+                                suffix) == 0) {
+      record.key.name.resize(record.key.name.size() - suffix.size());
+    }
+    record.layer_guid = layer->layer_guid.id;
+    for (int i = 0; i < layer->numOutputs; i++) {
+      record.output_guids.push_back(layer->outputs[i]->tensor_guid);
+    }
+    strategy.layers.push_back(record);
+  }
+  return strategy;
+}
+
+/**
+ * @brief Hash of everything the graph search depends on: the layer graph,
+ * the search options and the machine model.
+ */
+uint64_t FFModel::get_search_fingerprint(StrategyFile const &strategy) const {
+  StableHasher hasher;
+  hasher.update(static_cast<uint32_t>(StrategyFile::VERSION));
+  hasher.update(strategy.num_nodes);
+  hasher.update(strategy.gpus_per_node);
+  hasher.update(strategy.cpus_per_node);
+  hasher.update(strategy.computation_mode);
+  hasher.update(strategy.model_id);
+  assert(strategy.layers.size() == layers.size());
+  for (size_t l = 0; l < layers.size(); l++) {
+    StrategyLayer const &record = strategy.layers[l];
+    hasher.update(record.key.op_type);
+    hasher.update(record.key.params_hash);
+    hasher.update(record.key.name);
+    hasher.update(record.layer_guid);
+    for (uint64_t guid : record.output_guids) {
+      hasher.update(guid);
+    }
+    // The edges of the layer graph
+    for (int i = 0; i < layers[l]->numInputs; i++) {
+      hasher.update(static_cast<uint64_t>(layers[l]->inputs[i]->tensor_guid));
+    }
+  }
+  hasher.update(config.search_budget);
+  hasher.update(config.search_alpha);
+  hasher.update(config.search_overlap_backward_update);
+  hasher.update(config.only_data_parallel);
+  hasher.update(config.enable_sample_parallel);
+  hasher.update(config.enable_parameter_parallel);
+  hasher.update(config.enable_attribute_parallel);
+  hasher.update(config.enable_propagation);
+  hasher.update(config.base_optimize_threshold);
+  hasher.update(config.data_parallelism_degree);
+  hasher.update(config.tensor_parallelism_degree);
+  hasher.update(config.pipeline_parallelism_degree);
+  hasher.update(config.pipeline_stages);
+  hasher.update(config.pipeline_micro_batches);
+  hasher.update(config.pipeline_schedule.has_value()
+                    ? static_cast<int>(config.pipeline_schedule.value())
+                    : -1);
+  hasher.update(config.search_num_nodes.value_or(-1));
+  hasher.update(config.search_num_workers.value_or(-1));
+  hasher.update(config.perform_memory_search);
+  hasher.update(config.memory_search_algo);
+  hasher.update(config.device_mem);
+  if (config.substitution_json_path.has_value()) {
+    hasher.update_file(config.substitution_json_path.value());
+  }
+  hasher.update(config.machine_model_version);
+  if (!config.machine_model_file.empty()) {
+    hasher.update_file(config.machine_model_file);
+  } else {
+    // The simple and networked machine models do not describe the GPUs,
+    // whose profiled costs the strategy depends on
+    hasher.update(get_local_gpu_description());
+  }
+  hasher.update(config.simulator_segment_size);
+  hasher.update(config.simulator_max_num_segments);
+  hasher.update(config.cost_model_type);
+  if (!config.cost_database_file.empty()) {
+    hasher.update_file(config.cost_database_file);
+  }
+  return hasher.digest();
+}
+
+/**
+ * @brief Returns the serialized best PCG and machine views for this model.
+ *
+ * @details The strategy comes from the first of these that has one searched
+ * for this model and machine: the file passed with --import-strategy, the
+ * search cache passed with --search-cache, and the graph search. A searched
+ * strategy is saved to the file passed with --export-strategy and to the
+ * search cache.
+ *
+ * @param[out] guid_map Translates the guids of the returned PCG to the ones
+ * of this model, see apply_strategy_guid_map
+ */
+std::vector<char>
+    FFModel::search_or_import_strategy(StrategyGuidMap &guid_map) {
+  StrategyFile strategy = get_strategy_file();
+  guid_map = StrategyGuidMap();
+  guid_map.model_id = model_id;
+  auto load = [&](std::string const &filename, char const *what) {
+    StrategyFile loaded;
+    std::string error;
+    if (read_strategy_file(filename, loaded, error)) {
+      error = validate_strategy(loaded, strategy, guid_map);
+    }
+    if (!error.empty()) {
+      fprintf(stderr,
+              "[Warning] Ignoring the %s in %s: %s\n",
+              what,
+              filename.c_str(),
+              error.c_str());
+      return false;
+    }
+    printf("Using the %s in %s, skipping the graph search\n",
+           what,
+           filename.c_str());
+    strategy.pcg = std::move(loaded.pcg);
+    return true;
+  };
+  if (!config.import_strategy_file.empty() &&
+      load(config.import_strategy_file, "imported strategy")) {
+    return std::move(strategy.pcg);
+  }
+  std::string cache_path;
+  if (!config.search_cache_dir.empty()) {
+    cache_path = get_cached_strategy_path(config.search_cache_dir,
+                                          get_search_fingerprint(strategy));
+    if (std::ifstream(cache_path).good() &&
+        load(cache_path, "cached strategy")) {
+      return std::move(strategy.pcg);
+    }
+  }
+  Context ctx = config.lg_ctx;
+  Runtime *runtime = config.lg_hlr;
+  FFModel *model = this;
+  TaskLauncher launcher(GRAPH_OPTIMIZE_TASK_ID,
+                        TaskArgument(&model, sizeof(FFModel *)));
+  Future future = runtime->execute_task(ctx, launcher);
+  PCG::GraphOptimalViewSerialized ret =
+      future.get_result<PCG::GraphOptimalViewSerialized>();
+  strategy.pcg.assign(ret.data, ret.data + ret.total_bytes);
+  if (!config.export_strategy_file.empty()) {
+    if (write_strategy_file(config.export_strategy_file, strategy)) {
+      printf("Exported the strategy to %s\n",
+             config.export_strategy_file.c_str());
+    } else {
+      fprintf(stderr,
+              "[Warning] Could not export the strategy to %s\n",
+              config.export_strategy_file.c_str());
+    }
+  }
+  if (!cache_path.empty()) {
+    std::error_code ec;
+    std::filesystem::create_directories(config.search_cache_dir, ec);
+    if (!write_strategy_file(cache_path, strategy)) {
+      fprintf(stderr,
+              "[Warning] Could not cache the strategy in %s\n",
+              cache_path.c_str());
+    }
+  }
+  return std::move(strategy.pcg);
+}
+
+/**
+ * @brief Gives the operators of a deserialized PCG the layer and input tensor
+ * guids of this model, which differ from the ones of an imported strategy
+ * when the layers were created in another order.
+ */
+void FFModel::apply_strategy_guid_map(PCG::Graph *graph,
+                                      StrategyGuidMap const &guid_map) const {
+  for (auto const &it : graph->inEdges) {
+    Op *op = (Op *)it.first.ptr;
+    if (op->op_type == OP_INPUT) {
+      NoOp *noop = (NoOp *)op;
+      auto const &tensor = guid_map.tensor_guids.find(noop->input_tensor_guid);
+      if (tensor != guid_map.tensor_guids.end()) {
+        noop->input_tensor_guid = tensor->second;
+      }
+    }
+    if (op->layer_guid == LayerID::NO_ID) {
+      continue;
+    }
+    auto const &layer = guid_map.layer_guids.find(op->layer_guid.id);
+    if (layer != guid_map.layer_guids.end()) {
+      op->layer_guid.id = layer->second;
+      op->layer_guid.model_id = guid_map.model_id;
+    }
+  }
+}
+
 void FFModel::compile(LossType loss_type,
                       std::vector<MetricsType> const &metrics,
                       CompMode comp_mode) {
@@ -3391,10 +3752,6 @@ void FFModel::compile(LossType loss_type,
   Context ctx = config.lg_ctx;
   Runtime *runtime = config.lg_hlr;
   config.computationMode = comp_mode;
-  // if (config.import_strategy_file.length() > 0) {
-  //   load_strategies_from_file(config.import_strategy_file,
-  //   config.strategies);
-  // }
   //  Construct operators from layers
   if (config.only_data_parallel) {
     fprintf(stderr,
@@ -3402,20 +3759,16 @@ void FFModel::compile(LossType loss_type,
             "data-parallel PCG.\n");
   }
   create_operators_from_layers();
-  // Launch the graph optimize task
+  // Search for the best PCG, or import it
   {
-    FFModel *model = this;
-    TaskLauncher launcher(GRAPH_OPTIMIZE_TASK_ID,
-                          TaskArgument(&model, sizeof(FFModel *)));
-    Future future = runtime->execute_task(ctx, launcher);
-
-    PCG::GraphOptimalViewSerialized ret =
-        future.get_result<PCG::GraphOptimalViewSerialized>();
-    Deserializer dez(ret.data, ret.total_bytes);
+    StrategyGuidMap guid_map;
+    std::vector<char> serialized_pcg = search_or_import_strategy(guid_map);
+    Deserializer dez(serialized_pcg.data(), serialized_pcg.size());
     // Reconstruct operators
     PCG::Graph *best_graph = new PCG::Graph(this);
     std::unordered_map<PCG::Node, MachineView> optimal_views;
     deserialize_graph_optimal_view(dez, best_graph, optimal_views);
+    apply_strategy_guid_map(best_graph, guid_map);
     operators.clear();
     convert_graph_to_operators(best_graph, optimal_views);
     best_graph->print_dot();
@@ -3552,20 +3905,8 @@ void FFModel::compile(LossType loss_type,
   if (config.perform_fusion) {
     fprintf(stderr, "Applying fusion optimizations during compilation...\n");
     fprintf(stderr, "%zu operators before fusion...\n", operators.size());
-    std::vector<Op *> new_operators;
     std::vector<Op *> old_operators = operators;
-    while (apply_fusion(operators, new_operators)) {
-      for (size_t i = 0; i < new_operators.size(); i++) {
-        for (int idx = 0; idx < new_operators[i]->numInputs; idx++) {
-          for (size_t j = i + 1; j < new_operators.size(); j++) {
-            if (new_operators[i]->inputs[idx]->owner_op == new_operators[j]) {
-              assert(false);
-            }
-          }
-        }
-      }
-      operators = new_operators;
-    }
+    fuse_operators();
     assert(check_operators_integrity(old_operators));
     fprintf(stderr, "%zu operators after fusion...\n", operators.size());
     for (size_t i = 0; i < operators.size(); i++) {
@@ -4114,7 +4455,10 @@ FFConfig::FFConfig() {
   computationMode = COMP_MODE_TRAINING;
   cpu_offload = DefaultConfig::cpuOffload;
   offload_reserve_space_size = DefaultConfig::offloadReserveSpaceSize;
+  offload_prefetch_depth = -1;
   quantization_type = DT_NONE;
+  quantization_group_size = 0;
+  kv_cache_quantization_type = DT_NONE;
   only_data_parallel = DefaultConfig::onlyDataParallel;
   data_parallelism_degree = 1;
   tensor_parallelism_degree = 1;
@@ -4127,6 +4471,11 @@ FFConfig::FFConfig() {
   machine_model_version = DefaultConfig::machine_model_version;
   simulator_segment_size = DefaultConfig::simulator_segment_size;
   simulator_max_num_segments = DefaultConfig::simulator_max_num_segments;
+  cost_model_type = COST_MODEL_PROFILING;
+  cost_database_file = "";
+  export_cost_database_file = "";
+  pipeline_stages = 1;
+  pipeline_micro_batches = 0;
   enable_control_replication = DefaultConfig::enable_control_replication;
   python_data_loader_type = DefaultConfig::python_data_loader_type;
   machine_model_file = "";
@@ -4135,12 +4484,16 @@ FFConfig::FFConfig() {
   export_strategy_task_graph_file = "";
   include_costs_dot_graph = false;
   export_strategy_computation_graph_file = "";
+  search_cache_dir = "";
+  fusion_report_file = "";
   dataset_path = "";
   substitution_json_path = tl::nullopt;
   syntheticInput = false;
   perform_fusion = false;
   base_optimize_threshold = DefaultConfig::base_optimize_threshold;
+  search_threads = 1;
   perform_memory_search = false;
+  memory_search_algo = MemorySearchAlgo::MULTI_OBJECTIVE;
 
   // Parse input arguments
   {
@@ -4232,6 +4585,10 @@ void FFConfig::parse_args(char **argv, int argc) {
       offload_reserve_space_size = atoll(argv[++i]) * 1024 * 1024;
       continue;
     }
+    if (!strcmp(argv[i], "-offload-prefetch-depth")) {
+      offload_prefetch_depth = atoi(argv[++i]);
+      continue;
+    }
     if ((!strcmp(argv[i], "--4bit-quantization"))) {
       quantization_type = DT_INT4;
       continue;
@@ -4240,6 +4597,22 @@ void FFConfig::parse_args(char **argv, int argc) {
       quantization_type = DT_INT8;
       continue;
     }
+    if (!strcmp(argv[i], "--quantization-group-size")) {
+      quantization_group_size = atoi(argv[++i]);
+      // Keeps the offsets and scales of each row aligned
+      if (quantization_group_size < 0 || quantization_group_size % 8 != 0) {
+        fprintf(stderr,
+                "[Error] --quantization-group-size must be 0 or a positive "
+                "multiple of 8, got %s\n",
+                argv[i]);
+        exit(1);
+      }
+      continue;
+    }
+    if (!strcmp(argv[i], "--8bit-kv-cache")) {
+      kv_cache_quantization_type = DT_INT8;
+      continue;
+    }
     if ((!strcmp(argv[i], "--only-data-parallel"))) {
       only_data_parallel = true;
       continue;
@@ -4302,6 +4675,10 @@ void FFConfig::parse_args(char **argv, int argc) {
       perform_fusion = true;
       continue;
     }
+    if (!strcmp(argv[i], "--fusion-report")) {
+      fusion_report_file = std::string(argv[++i]);
+      continue;
+    }
     if (!strcmp(argv[i], "--overlap")) {
       search_overlap_backward_update = true;
       continue;
@@ -4314,6 +4691,14 @@ void FFConfig::parse_args(char **argv, int argc) {
       include_costs_dot_graph = true;
       continue;
     }
+    if (!strcmp(argv[i], "--search-threads")) {
+      search_threads = std::max(1, atoi(argv[++i]));
+      continue;
+    }
+    if (!strcmp(argv[i], "--search-cache")) {
+      search_cache_dir = std::string(argv[++i]);
+      continue;
+    }
     if (!strcmp(argv[i], "--compgraph")) {
       export_strategy_computation_graph_file = std::string(argv[++i]);
       continue;
@@ -4334,6 +4719,51 @@ void FFConfig::parse_args(char **argv, int argc) {
       simulator_max_num_segments = atoi(argv[++i]);
       continue;
     }
+    if (!strcmp(argv[i], "--cost-model")) {
+      std::string cost_model = std::string(argv[++i]);
+      if (cost_model == "analytical") {
+        cost_model_type = COST_MODEL_ANALYTICAL;
+      } else if (cost_model == "profiling") {
+        cost_model_type = COST_MODEL_PROFILING;
+      } else {
+        fprintf(stderr,
+                "[Error] --cost-model must be 'profiling' or 'analytical', "
+                "got %s\n",
+                cost_model.c_str());
+        exit(1);
+      }
+      continue;
+    }
+    if (!strcmp(argv[i], "--cost-database")) {
+      cost_database_file = std::string(argv[++i]);
+      continue;
+    }
+    if (!strcmp(argv[i], "--export-cost-database")) {
+      export_cost_database_file = std::string(argv[++i]);
+      continue;
+    }
+    if (!strcmp(argv[i], "--pipeline-stages")) {
+      pipeline_stages = atoi(argv[++i]);
+      continue;
+    }
+    if (!strcmp(argv[i], "--pipeline-micro-batches")) {
+      pipeline_micro_batches = atoi(argv[++i]);
+      continue;
+    }
+    if (!strcmp(argv[i], "--pipeline-schedule")) {
+      std::string schedule = std::string(argv[++i]);
+      if (schedule == "gpipe") {
+        pipeline_schedule = PIPELINE_SCHEDULE_GPIPE;
+      } else if (schedule == "1f1b") {
+        pipeline_schedule = PIPELINE_SCHEDULE_1F1B;
+      } else {
+        fprintf(stderr,
+                "[Warning] Unknown pipeline schedule %s, "
+                "expected 'gpipe' or '1f1b'\n",
+                schedule.c_str());
+      }
+      continue;
+    }
     if (!strcmp(argv[i], "--enable-propagation")) {
       enable_propagation = true;
       continue;
@@ -4369,6 +4799,20 @@ void FFConfig::parse_args(char **argv, int argc) {
       perform_memory_search = true;
       continue;
     }
+    if (!strcmp(argv[i], "--memory-search-algo")) {
+      std::string algo = std::string(argv[++i]);
+      if (algo == "constrained") {
+        memory_search_algo = MemorySearchAlgo::CONSTRAINED;
+      } else if (algo == "multi-objective") {
+        memory_search_algo = MemorySearchAlgo::MULTI_OBJECTIVE;
+      } else {
+        fprintf(stderr,
+                "[Warning] Unknown memory search algorithm %s, "
+                "expected 'constrained' or 'multi-objective'\n",
+                algo.c_str());
+      }
+      continue;
+    }
   }
 }
 
@@ -6953,6 +7397,25 @@ void register_flexflow_internal_tasks(Runtime *runtime,
           registrar);
     }
   }
+  // Graph optimize task CPU, used with the analytical cost model on hosts
+  // without GPUs
+  {
+    TaskVariantRegistrar registrar(GRAPH_OPTIMIZE_TASK_ID, "Graph Optimize");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<PCG::GraphOptimalViewSerialized,
+                                        PCG::Graph::graph_optimize_task>(
+          registrar, "Graph Optimize Task CPU");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<PCG::GraphOptimalViewSerialized,
+                                     PCG::Graph::graph_optimize_task>(
+          registrar);
+    }
+  }
   // Parameter Server Prefetch task
   {
     TaskVariantRegistrar registrar(PS_PREFETCH_TASK_ID, "Weights Prefetch");
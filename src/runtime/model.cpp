@@ -13,6 +13,7 @@
  * limitations under the License.
  */
 
+#include "flexflow/batch_config_metadata_cache.h"
 #include "flexflow/model.h"
 #include "flexflow/utils/hip_helper.h"
 #include <hip/hip_runtime.h>
@@ -90,6 +91,12 @@ FFHandler
   printf("workSpaceSize (%zu MB)\n", info->workSpaceSize / 1024 / 1024);
   FFHandler handle;
   handle.workSpaceSize = info->workSpaceSize;
+  if (info->kv_cache_quantization_type != DT_NONE) {
+    fprintf(stderr,
+            "[Warning] quantized KV caches are not supported by the HIP "
+            "backend, keeping them in the data type of the model\n");
+  }
+  handle.kv_cache_quantization_type = DT_NONE;
   handle.allowTensorOpMathConversion = info->allowTensorOpMathConversion;
   checkCUDA(hipblasCreate(&handle.blas));
   if (handle.allowTensorOpMathConversion) {
@@ -155,6 +162,8 @@ FFHandler
   } else {
     handle.offload_reserve_space = nullptr;
   }
+  // Offloaded weights are copied synchronously
+  handle.offload_engine = nullptr;
   if (handle.batch_config_metadata_size > 0) {
     // allocate memory for offload reserve space
     Memory gpu_mem = Machine::MemoryQuery(Machine::get_machine())
@@ -176,8 +185,15 @@ FFHandler
         .wait();
     handle.batch_config_metadata =
         workspaceInst.pointer_untyped(0, sizeof(char));
+    // the host mirror starts zeroed too
+    checkCUDA(hipMemset(handle.batch_config_metadata,
+                        0,
+                        handle.batch_config_metadata_size));
+    handle.batch_config_metadata_cache =
+        new BatchConfigMetadataCache(handle.batch_config_metadata_size);
   } else {
     handle.batch_config_metadata = nullptr;
+    handle.batch_config_metadata_cache = nullptr;
   }
   // checkCUDA(hipMalloc(&handle.workSpace, handle.workSpaceSize));
 #ifdef FF_USE_NCCL
@@ -12,8 +12,10 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include "flexflow/batch_config_metadata_cache.h"
 #include "flexflow/model.h"
 #include "flexflow/utils/cuda_helper.h"
+#include "flexflow/weight_offload.h"
 
 namespace FlexFlow {
 // declare Legion names
@@ -88,6 +90,7 @@ FFHandler
   handle.workSpaceSize = info->workSpaceSize;
   handle.offload_reserve_space_size = info->offload_reserve_space_size;
   handle.quantization_type = info->quantization_type;
+  handle.kv_cache_quantization_type = info->kv_cache_quantization_type;
   handle.allowTensorOpMathConversion = info->allowTensorOpMathConversion;
   checkCUDA(cublasCreate(&handle.blas));
   if (handle.allowTensorOpMathConversion) {
@@ -148,8 +151,14 @@ FFHandler
         .wait();
     handle.offload_reserve_space =
         workspaceInst.pointer_untyped(0, sizeof(char));
+    handle.offload_engine =
+        new WeightOffloadEngine(handle.offload_reserve_space,
+                                handle.offload_reserve_space_size,
+                                create_cuda_weight_copy_queue(),
+                                info->offload_prefetch_depth);
   } else {
     handle.offload_reserve_space = nullptr;
+    handle.offload_engine = nullptr;
   }
   if (handle.batch_config_metadata_size > 0) {
     // allocate memory for offload reserve space
@@ -172,8 +181,15 @@ FFHandler
         .wait();
     handle.batch_config_metadata =
         workspaceInst.pointer_untyped(0, sizeof(char));
+    // the host mirror starts zeroed too
+    checkCUDA(cudaMemset(handle.batch_config_metadata,
+                         0,
+                         handle.batch_config_metadata_size));
+    handle.batch_config_metadata_cache =
+        new BatchConfigMetadataCache(handle.batch_config_metadata_size);
   } else {
     handle.batch_config_metadata = nullptr;
+    handle.batch_config_metadata_cache = nullptr;
   }
 
   // checkCUDA(cudaMalloc(&handle.workSpace, handle.workSpaceSize));
@@ -473,6 +473,53 @@ std::vector<std::pair<int, int>>
   return result;
 }
 
+EcmpRoutingStrategy::EcmpRoutingStrategy(
+    ConnectionMatrix const &c,
+    std::map<size_t, CommDevice *> const &devmap,
+    int total_devs,
+    size_t max_paths)
+    : conn(c), devmap(devmap), total_devs(total_devs), max_paths(max_paths) {}
+
+void EcmpRoutingStrategy::invalidate() {
+  // Rebuild right away: update_route queries the table from several threads
+  table.build(conn, total_devs);
+}
+
+EcmpRoutingTable const &EcmpRoutingStrategy::get_table() {
+  if (!table.is_built()) {
+    table.build(conn, total_devs);
+  }
+  return table;
+}
+
+EcmpRoutes EcmpRoutingStrategy::get_routes(int src_node, int dst_node) {
+  EcmpRoutes result;
+  float cdf = 0.0f;
+  for (auto const &path : get_table().paths(src_node, dst_node, max_paths)) {
+    Route route;
+    for (size_t i = 1; i < path.nodes.size(); i++) {
+      route.push_back(
+          devmap.at(path.nodes[i - 1] * total_devs + path.nodes[i]));
+    }
+    cdf += path.weight;
+    result.first.push_back(cdf);
+    result.second.push_back(route);
+  }
+  if (!result.first.empty()) {
+    result.first.back() = 1.0f;
+  }
+  return result;
+}
+
+std::vector<EcmpRoutes>
+    EcmpRoutingStrategy::get_routes_from_src(int src_node) {
+  std::vector<EcmpRoutes> final_result;
+  for (int i = 0; i < total_devs; i++) {
+    final_result.emplace_back(get_routes(src_node, i));
+  }
+  return final_result;
+}
+
 FlatDegConstraintNetworkTopologyGenerator::
     FlatDegConstraintNetworkTopologyGenerator(int num_nodes, int degree)
     : num_nodes(num_nodes), degree(degree) {}
@@ -0,0 +1,270 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/pipeline.h"
+#include "flexflow/simulator_core.h"
+#include <algorithm>
+#include <cassert>
+
+namespace FlexFlow {
+
+namespace {
+
+// Task types of the simulated schedule; only used for debugging
+enum PipelineTaskType : uint8_t {
+  PIPELINE_FORWARD,
+  PIPELINE_BACKWARD,
+  PIPELINE_TRANSFER,
+};
+
+size_t stage_memory(std::vector<size_t> const &weights_prefix,
+                    std::vector<size_t> const &activation_prefix,
+                    int first,
+                    int last,
+                    int in_flight,
+                    int num_micro_batches) {
+  size_t weights = weights_prefix[last + 1] - weights_prefix[first];
+  size_t activations =
+      activation_prefix[last + 1] - activation_prefix[first];
+  size_t per_micro_batch =
+      (activations + num_micro_batches - 1) / num_micro_batches;
+  return weights + in_flight * per_micro_batch;
+}
+
+} // namespace
+
+bool PipelinePlan::is_valid() const {
+  return cost != std::numeric_limits<float>::infinity();
+}
+
+int pipeline_in_flight_micro_batches(PipelineSchedule schedule,
+                                     int num_stages,
+                                     int stage,
+                                     int num_micro_batches) {
+  assert(stage >= 0 && stage < num_stages);
+  switch (schedule) {
+    case PIPELINE_SCHEDULE_GPIPE:
+      return num_micro_batches;
+    case PIPELINE_SCHEDULE_1F1B:
+      return std::min(num_micro_batches, num_stages - stage);
+    default:
+      assert(false && "Unknown pipeline schedule");
+  }
+  return num_micro_batches;
+}
+
+bool partition_pipeline_stages(std::vector<PipelineSegmentCost> const &segments,
+                               int num_stages,
+                               int num_micro_batches,
+                               PipelineSchedule schedule,
+                               size_t memory_capacity,
+                               std::vector<PipelineStage> &stages) {
+  int n = segments.size();
+  if (num_stages <= 0 || n < num_stages) {
+    return false;
+  }
+  std::vector<float> time_prefix(n + 1, 0.0f);
+  std::vector<size_t> weights_prefix(n + 1, 0), activation_prefix(n + 1, 0);
+  for (int i = 0; i < n; i++) {
+    time_prefix[i + 1] = time_prefix[i] + segments[i].forward_time +
+                         segments[i].backward_time;
+    weights_prefix[i + 1] = weights_prefix[i] + segments[i].weights_memory;
+    activation_prefix[i + 1] =
+        activation_prefix[i] + segments[i].activation_memory;
+  }
+  float const inf = std::numeric_limits<float>::infinity();
+  // best[k][j]: slowest stage when the first j segments form k stages
+  std::vector<std::vector<float>> best(num_stages + 1,
+                                       std::vector<float>(n + 1, inf));
+  std::vector<std::vector<int>> choice(num_stages + 1,
+                                       std::vector<int>(n + 1, -1));
+  best[0][0] = 0.0f;
+  for (int k = 1; k <= num_stages; k++) {
+    int in_flight = pipeline_in_flight_micro_batches(
+        schedule, num_stages, k - 1, num_micro_batches);
+    // leave at least one segment for each of the remaining stages
+    for (int j = k; j <= n - (num_stages - k); j++) {
+      for (int i = k - 1; i < j; i++) {
+        if (best[k - 1][i] == inf) {
+          continue;
+        }
+        if (stage_memory(weights_prefix,
+                         activation_prefix,
+                         i,
+                         j - 1,
+                         in_flight,
+                         num_micro_batches) > memory_capacity) {
+          continue;
+        }
+        float cost = std::max(best[k - 1][i], time_prefix[j] - time_prefix[i]);
+        if (cost < best[k][j]) {
+          best[k][j] = cost;
+          choice[k][j] = i;
+        }
+      }
+    }
+  }
+  if (best[num_stages][n] == inf) {
+    return false;
+  }
+  stages.resize(num_stages);
+  for (int k = num_stages, j = n; k > 0; k--) {
+    int i = choice[k][j];
+    stages[k - 1].first_segment = i;
+    stages[k - 1].last_segment = j - 1;
+    j = i;
+  }
+  return true;
+}
+
+float simulate_pipeline_schedule(std::vector<float> const &stage_forward,
+                                 std::vector<float> const &stage_backward,
+                                 std::vector<float> const &transfer_time,
+                                 int num_micro_batches,
+                                 PipelineSchedule schedule,
+                                 bool training) {
+  int num_stages = stage_forward.size();
+  int m = num_micro_batches;
+  assert(num_stages > 0 && m > 0);
+  assert((int)stage_backward.size() == num_stages);
+  assert((int)transfer_time.size() == num_stages - 1);
+
+  EventDrivenSimulator sim;
+  // Devices: one per stage, then one link per direction between stages
+  auto forward_link = [&](int k) { return num_stages + k; };
+  auto backward_link = [&](int k) { return 2 * num_stages - 1 + k; };
+  std::vector<std::vector<SimTaskId>> fwd(num_stages), bwd(num_stages);
+  for (int k = 0; k < num_stages; k++) {
+    for (int i = 0; i < m; i++) {
+      fwd[k].push_back(sim.tasks.add_task(
+          PIPELINE_FORWARD, k, stage_forward[k], SimNameTable::NO_NAME));
+      if (training) {
+        bwd[k].push_back(sim.tasks.add_task(
+            PIPELINE_BACKWARD, k, stage_backward[k], SimNameTable::NO_NAME));
+      }
+    }
+  }
+  // Data dependencies between stages
+  for (int k = 0; k + 1 < num_stages; k++) {
+    for (int i = 0; i < m; i++) {
+      SimTaskId send = sim.tasks.add_task(PIPELINE_TRANSFER,
+                                          forward_link(k),
+                                          transfer_time[k],
+                                          SimNameTable::NO_NAME);
+      sim.tasks.add_dependency(fwd[k][i], send);
+      sim.tasks.add_dependency(send, fwd[k + 1][i]);
+      if (training) {
+        SimTaskId send_grad = sim.tasks.add_task(PIPELINE_TRANSFER,
+                                                 backward_link(k),
+                                                 transfer_time[k],
+                                                 SimNameTable::NO_NAME);
+        sim.tasks.add_dependency(bwd[k + 1][i], send_grad);
+        sim.tasks.add_dependency(send_grad, bwd[k][i]);
+      }
+    }
+  }
+  if (training) {
+    for (int i = 0; i < m; i++) {
+      sim.tasks.add_dependency(fwd[num_stages - 1][i], bwd[num_stages - 1][i]);
+    }
+  }
+  // The schedule fixes the order of micro-batches on every stage
+  for (int k = 0; k < num_stages; k++) {
+    std::vector<SimTaskId> order;
+    if (!training) {
+      order = fwd[k];
+    } else if (schedule == PIPELINE_SCHEDULE_GPIPE) {
+      order = fwd[k];
+      order.insert(order.end(), bwd[k].begin(), bwd[k].end());
+    } else {
+      assert(schedule == PIPELINE_SCHEDULE_1F1B);
+      int warmup = std::min(num_stages - k - 1, m);
+      for (int i = 0; i < warmup; i++) {
+        order.push_back(fwd[k][i]);
+      }
+      for (int i = 0; i + warmup < m; i++) {
+        order.push_back(fwd[k][i + warmup]);
+        order.push_back(bwd[k][i]);
+      }
+      for (int i = m - warmup; i < m; i++) {
+        order.push_back(bwd[k][i]);
+      }
+    }
+    for (size_t i = 1; i < order.size(); i++) {
+      sim.tasks.add_dependency(order[i - 1], order[i]);
+    }
+  }
+  sim.tasks.finalize();
+  return sim.simulate(3 * num_stages - 2);
+}
+
+PipelinePlan plan_pipeline(std::vector<PipelineSegmentCost> const &segments,
+                           int num_stages,
+                           std::vector<int> const &micro_batch_candidates,
+                           std::vector<PipelineSchedule> const &schedules,
+                           float transfer_bandwidth,
+                           size_t memory_capacity,
+                           bool training) {
+  PipelinePlan best;
+  for (PipelineSchedule schedule : schedules) {
+    for (int m : micro_batch_candidates) {
+      std::vector<PipelineStage> stages;
+      if (!partition_pipeline_stages(
+              segments, num_stages, m, schedule, memory_capacity, stages)) {
+        continue;
+      }
+      std::vector<float> forward(num_stages, 0.0f), backward(num_stages, 0.0f);
+      std::vector<float> transfer;
+      std::vector<size_t> weights_prefix(1, 0), activation_prefix(1, 0);
+      for (PipelineSegmentCost const &s : segments) {
+        weights_prefix.push_back(weights_prefix.back() + s.weights_memory);
+        activation_prefix.push_back(activation_prefix.back() +
+                                    s.activation_memory);
+      }
+      std::vector<size_t> memory;
+      for (int k = 0; k < num_stages; k++) {
+        for (int j = stages[k].first_segment; j <= stages[k].last_segment;
+             j++) {
+          forward[k] += segments[j].forward_time / m;
+          backward[k] += segments[j].backward_time / m;
+        }
+        if (k + 1 < num_stages) {
+          size_t bytes = segments[stages[k].last_segment].boundary_bytes / m;
+          transfer.push_back(bytes / transfer_bandwidth);
+        }
+        memory.push_back(stage_memory(
+            weights_prefix,
+            activation_prefix,
+            stages[k].first_segment,
+            stages[k].last_segment,
+            pipeline_in_flight_micro_batches(schedule, num_stages, k, m),
+            m));
+      }
+      float cost = simulate_pipeline_schedule(
+          forward, backward, transfer, m, schedule, training);
+      if (cost < best.cost) {
+        best.num_stages = num_stages;
+        best.num_micro_batches = m;
+        best.schedule = schedule;
+        best.stages = stages;
+        best.stage_memory = memory;
+        best.cost = cost;
+      }
+    }
+  }
+  return best;
+}
+
+}; // namespace FlexFlow
@@ -24,8 +24,9 @@ Realm::LoggerMessage RecursiveLogger::spew() {
 }
 
 void RecursiveLogger::print_prefix(Realm::LoggerMessage &msg) const {
-  msg << this->depth << " ";
-  for (int i = 0; i < this->depth; i++) {
+  int depth = this->depth;
+  msg << depth << " ";
+  for (int i = 0; i < depth; i++) {
     msg << " ";
   }
 }
@@ -35,8 +36,8 @@ void RecursiveLogger::enter() {
 }
 
 void RecursiveLogger::leave() {
-  this->depth--;
-  assert(this->depth >= 0);
+  int depth = --this->depth;
+  assert(depth >= 0);
 }
 
 std::unique_ptr<DepthTag> RecursiveLogger::enter_tag() {
@@ -109,6 +109,16 @@ int RequestManager::get_max_sequence_length() {
   return max_sequence_length;
 }
 
+void RequestManager::set_kv_cache_window(int window_size, int sink_tokens) {
+  assert(window_size >= 0 && sink_tokens >= 0);
+  kv_cache_window.window_size = window_size;
+  kv_cache_window.sink_tokens = window_size > 0 ? sink_tokens : 0;
+}
+
+KVCacheWindow RequestManager::get_kv_cache_window() {
+  return kv_cache_window;
+}
+
 void RequestManager::push_spec_infer_tree_width(int tree_width) {
   assert(tree_width <= BeamSearchBatchConfig::MAX_BEAM_WIDTH);
   spec_infer_tree_width.emplace_back(tree_width);
@@ -338,14 +348,20 @@ size_t RequestManager::get_num_processed_requests() {
   return num_processed_requests;
 }
 
+struct PrepareNextBatchArgs {
+  RequestManager *rm;
+  int replica;
+};
+
 BatchConfigFuture
     RequestManager::prepare_next_batch(BatchConfigFuture const &old_bc,
                                        InferenceResultFuture const &result,
                                        Context ctx,
-                                       Runtime *runtime) {
-  RequestManager *rm = this;
+                                       Runtime *runtime,
+                                       int replica) {
+  PrepareNextBatchArgs args{this, replica};
   TaskLauncher launcher(RM_PREPARE_NEXT_BATCH_TASK_ID,
-                        TaskArgument(&rm, sizeof(RequestManager *)));
+                        TaskArgument(&args, sizeof(PrepareNextBatchArgs)));
   launcher.add_future(old_bc);
   launcher.add_future(result);
   return runtime->execute_task(ctx, launcher);
@@ -356,16 +372,34 @@ BatchConfig RequestManager::prepare_next_batch_task(
     std::vector<PhysicalRegion> const &regions,
     Context ctx,
     Runtime *runtime) {
-  RequestManager *rm = *((RequestManager **)task->args);
+  assert(task->arglen == sizeof(PrepareNextBatchArgs));
+  PrepareNextBatchArgs const *args = (PrepareNextBatchArgs const *)task->args;
   BatchConfig const *bc = BatchConfig::from_future(task->futures[0]);
   InferenceResult const &result =
       Future(task->futures[1]).get_result<InferenceResult>();
-  return rm->prepare_next_batch(*bc, result);
+  return args->rm->prepare_next_batch(*bc, result, args->replica);
+}
+
+bool RequestManager::should_admit(int replica) const {
+  ReplicaLoad const &load = replica_loads[replica];
+  for (int r = 0; r < (int)replica_loads.size(); r++) {
+    ReplicaLoad const &other = replica_loads[r];
+    if (r != replica &&
+        other.num_requests < BatchConfig::max_requests_per_batch() &&
+        other.num_kv_tokens < load.num_kv_tokens) {
+      return false;
+    }
+  }
+  return true;
 }
 
 BatchConfig RequestManager::prepare_next_batch(BatchConfig const &old_bc,
-                                               InferenceResult const &result) {
+                                               InferenceResult const &result,
+                                               int replica) {
   const std::lock_guard<std::mutex> lock(request_queue_mutex);
+  if ((int)replica_loads.size() <= replica) {
+    replica_loads.resize(replica + 1);
+  }
 
   // Step 1: append result from previous iteration to request's tokens
   for (int i = 0; i < old_bc.num_tokens; i++) {
@@ -509,11 +543,23 @@ BatchConfig RequestManager::prepare_next_batch(BatchConfig const &old_bc,
   }
   new_bc.num_generation_tokens = num_generation_tokens;
 
+  ReplicaLoad &load = replica_loads[replica];
+  load = ReplicaLoad();
+  for (int i = 0; i < BatchConfig::max_requests_per_batch(); i++) {
+    if (!new_bc.request_completed[i]) {
+      load.num_requests++;
+      BatchConfig::PerRequestInfo const &info = new_bc.requestsInfo[i];
+      load.num_kv_tokens +=
+          info.first_token_depth_in_request + info.num_tokens_in_batch;
+    }
+  }
+
   // Step 3: add new requests to the next batch
   for (int i = 0; i < BatchConfig::max_requests_per_batch(); i++) {
     if (new_bc.request_completed[i]) {
       if (!pending_request_queue.empty() &&
-          new_bc.num_tokens < get_max_tokens_per_batch()) {
+          new_bc.num_tokens < get_max_tokens_per_batch() &&
+          should_admit(replica)) {
         Request new_request = pending_request_queue.front();
         pending_request_queue.pop();
         // all_requests[new_request.guid] = new_request;
@@ -530,6 +576,8 @@ BatchConfig RequestManager::prepare_next_batch(BatchConfig const &old_bc,
         new_bc.requestsInfo[i].prompt_phase = true;
         num_active_req++;
         new_bc.requestsInfo[num_active_req].batch_config_request_id = i;
+        load.num_requests++;
+        load.num_kv_tokens += new_bc.requestsInfo[i].num_tokens_in_batch;
         // add profile_info for the new request
         ProfileInfo profile_info;
         profile_info.llm_decoding_steps = 1;
@@ -2371,6 +2419,10 @@ void RequestManager::background_serving_task(
 void RequestManager::serve_incr_decoding(FFModel *llm) {
   Context ctx = llm->config.lg_ctx;
   Runtime *runtime = llm->config.lg_hlr;
+  // The tokens of a batch must all be in the cache when it attends to them
+  assert((!kv_cache_window.enabled() ||
+          kv_cache_window.window_size >= get_max_tokens_per_batch()) &&
+         "the KV cache window must hold max_tokens_per_batch tokens");
   // Compile the llm
   InferenceManager *im = InferenceManager::get_inference_manager();
   im->compile_model_and_allocate_buffer(llm);
@@ -2391,37 +2443,48 @@ void RequestManager::serve_incr_decoding(FFModel *llm) {
     last_irf = Future::from_value<InferenceResult>(ir);
   }
 
-  std::queue<std::pair<BatchConfigFuture, InferenceResultFuture>>
-      batch_pipeline;
-  { batch_pipeline.push(std::make_pair(last_bcf, last_irf)); }
+  // Each data-parallel replica of the llm runs its own pipeline of batches;
+  // pending requests are assigned to a replica when one of them admits them
+  int num_replicas = llm->config.data_parallelism_degree;
+  {
+    const std::lock_guard<std::mutex> lock(request_queue_mutex);
+    replica_loads.assign(num_replicas, ReplicaLoad());
+  }
+  std::vector<std::queue<std::pair<BatchConfigFuture, InferenceResultFuture>>>
+      batch_pipelines(num_replicas);
+  for (auto &batch_pipeline : batch_pipelines) {
+    batch_pipeline.push(std::make_pair(last_bcf, last_irf));
+  }
 
   while (!is_background_server_terminated()) {
-
-    if (batch_pipeline.size() >= 4) {
-      // Block here to avoid launching too many batches
-      auto const &batch = batch_pipeline.front();
-      batch.second.get_void_result();
-    }
-    // deque finished batches
-    while (batch_pipeline.size() > 1) {
-      auto const &batch = batch_pipeline.front();
-      if (batch.second.is_ready()) {
-        batch_pipeline.pop();
-      } else {
-        break;
+    for (int replica = 0; replica < num_replicas; replica++) {
+      auto &batch_pipeline = batch_pipelines[replica];
+      if (batch_pipeline.size() >= 4) {
+        // Block here to avoid launching too many batches
+        auto const &batch = batch_pipeline.front();
+        batch.second.get_void_result();
+      }
+      // deque finished batches
+      while (batch_pipeline.size() > 1) {
+        auto const &batch = batch_pipeline.front();
+        if (batch.second.is_ready()) {
+          batch_pipeline.pop();
+        } else {
+          break;
+        }
       }
+      runtime->begin_trace(ctx, 12346 + replica /*trace_id*/);
+      auto const &next_batch = batch_pipeline.back();
+      BatchConfigFuture bcf = prepare_next_batch(
+          next_batch.first, next_batch.second, ctx, runtime, replica);
+      FutureMap fm = im->inference(llm, replica, bcf);
+      assert(fm.get_future_map_domain().get_volume() == 1);
+      InferenceResultFuture irf = fm.get_future(0);
+      batch_pipeline.push(std::make_pair(bcf, irf));
+      last_bcf = bcf;
+      last_irf = irf;
+      runtime->end_trace(ctx, 12346 + replica /*trace_id*/);
     }
-    runtime->begin_trace(ctx, 12346 /*trace_id*/);
-    auto const &next_batch = batch_pipeline.back();
-    BatchConfigFuture bcf =
-        prepare_next_batch(next_batch.first, next_batch.second, ctx, runtime);
-    FutureMap fm = im->inference(llm, 0, bcf);
-    assert(fm.get_future_map_domain().get_volume() == 1);
-    InferenceResultFuture irf = fm.get_future(0);
-    batch_pipeline.push(std::make_pair(bcf, irf));
-    last_bcf = bcf;
-    last_irf = irf;
-    runtime->end_trace(ctx, 12346 /*trace_id*/);
   }
 }
 
@@ -2429,6 +2492,12 @@ void RequestManager::serve_incr_decoding(FFModel *llm) {
 void RequestManager::serve_spec_infer(FFModel *llm) {
   Context ctx = llm->config.lg_ctx;
   Runtime *runtime = llm->config.lg_hlr;
+  // Speculative batches are built across the llm and its ssms, which only
+  // keep one set of requests
+  assert(llm->config.data_parallelism_degree == 1 &&
+         "serve_spec_infer does not support data-parallel replicas");
+  assert(!kv_cache_window.enabled() &&
+         "serve_spec_infer does not support KV cache windows");
   InferenceManager *im = InferenceManager::get_inference_manager();
   {
     // Compile the llm
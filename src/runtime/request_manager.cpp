@@ -13,6 +13,7 @@
  * limitations under the License.
  */
 
+#include "flexflow/batch_config_metadata_cache.h"
 #include "flexflow/request_manager.h"
 #include "flexflow/utils/hip_helper.h"
 #include <hip/hip_runtime.h>
@@ -71,72 +72,48 @@ void RequestManager::load_batch_config_task(
   // BatchConfig const batch_config = *((BatchConfig *)task->args);
   BatchConfig const *batch_config = BatchConfig::from_future(task->futures[0]);
 
-  // copy meta data to workSpace
+  // copy meta data to workSpace, only the rows that changed since the
+  // previous batch
   FFHandler handle = *((FFHandler const *)task->local_args);
+  BatchConfigMetadataCache *cache = handle.batch_config_metadata_cache;
+  assert(cache != nullptr);
+  char *metadata = static_cast<char *>(handle.batch_config_metadata);
+  BatchConfigMetadataCache::CopyFunc copy =
+      [&](size_t offset, void const *src, size_t size) {
+        checkCUDA(hipMemcpyAsync(
+            metadata + offset, src, size, hipMemcpyHostToDevice, stream));
+      };
   size_t total_copy_size = 0;
-  checkCUDA(hipMemcpyAsync(handle.batch_config_metadata,
-                           &(batch_config->tokensInfo),
-                           sizeof(BatchConfig::tokensInfo),
-                           hipMemcpyHostToDevice,
-                           stream));
+  // the kernels only read the tokens of the batch
+  cache->write(total_copy_size,
+               batch_config->tokensInfo,
+               batch_config->num_tokens,
+               copy);
   total_copy_size += sizeof(BatchConfig::tokensInfo);
-
-  checkCUDA(hipMemcpyAsync(static_cast<char *>(handle.batch_config_metadata) +
-                               total_copy_size,
-                           &(batch_config->requestsInfo),
-                           sizeof(BatchConfig::requestsInfo),
-                           hipMemcpyHostToDevice,
-                           stream));
+  cache->write(total_copy_size, batch_config->requestsInfo, copy);
   total_copy_size += sizeof(BatchConfig::requestsInfo);
 
   // load speculative metadata
   if (batch_config->get_mode() == BEAM_SEARCH_MODE) {
     BeamSearchBatchConfig const *beam_batch_config =
         static_cast<BeamSearchBatchConfig const *>(batch_config);
-
-    checkCUDA(hipMemcpyAsync(static_cast<char *>(handle.batch_config_metadata) +
-                                 total_copy_size,
-                             &(beam_batch_config->beamTokenInfo),
-                             sizeof(BeamSearchBatchConfig::beamTokenInfo),
-                             hipMemcpyHostToDevice,
-                             stream));
-
+    cache->write(total_copy_size, beam_batch_config->beamTokenInfo, copy);
     total_copy_size += sizeof(BeamSearchBatchConfig::beamTokenInfo);
-
-    checkCUDA(hipMemcpyAsync(static_cast<char *>(handle.batch_config_metadata) +
-                                 total_copy_size,
-                             &(beam_batch_config->beamRequestsInfo),
-                             sizeof(BeamSearchBatchConfig::beamRequestsInfo),
-                             hipMemcpyHostToDevice,
-                             stream));
+    cache->write(total_copy_size, beam_batch_config->beamRequestsInfo, copy);
     total_copy_size += sizeof(BeamSearchBatchConfig::beamRequestsInfo);
-
-    checkCUDA(hipMemcpyAsync(static_cast<char *>(handle.batch_config_metadata) +
-                                 total_copy_size,
-                             &(beam_batch_config->causalMask),
-                             sizeof(BatchConfig::causalMask),
-                             hipMemcpyHostToDevice,
-                             stream));
-
+    cache->write(total_copy_size, beam_batch_config->causalMask, copy);
     total_copy_size += sizeof(BatchConfig::causalMask);
+    cache->write(total_copy_size, batch_config->request_completed, copy);
+    total_copy_size += sizeof(BatchConfig::request_completed);
   } else if (batch_config->get_mode() == TREE_VERIFY_MODE) {
     TreeVerifyBatchConfig const *tree_batch_config =
         static_cast<TreeVerifyBatchConfig const *>(batch_config);
-
-    checkCUDA(hipMemcpyAsync(static_cast<char *>(handle.batch_config_metadata) +
-                                 total_copy_size,
-                             &(tree_batch_config->causalMask),
-                             sizeof(BatchConfig::causalMask),
-                             hipMemcpyHostToDevice,
-                             stream));
+    cache->write(total_copy_size, tree_batch_config->causalMask, copy);
     total_copy_size += sizeof(BatchConfig::causalMask);
-    checkCUDA(hipMemcpyAsync(static_cast<char *>(handle.batch_config_metadata) +
-                                 total_copy_size,
-                             &(tree_batch_config->committed_tokens),
-                             sizeof(TreeVerifyBatchConfig::committed_tokens),
-                             hipMemcpyHostToDevice,
-                             stream));
+    cache->write(total_copy_size, tree_batch_config->committed_tokens, copy);
     total_copy_size += sizeof(TreeVerifyBatchConfig::committed_tokens);
+    cache->write(total_copy_size, batch_config->request_completed, copy);
+    total_copy_size += sizeof(BatchConfig::request_completed);
   }
 
   // add a size check
@@ -13,6 +13,7 @@
  * limitations under the License.
  */
 
+#include "flexflow/batch_config_metadata_cache.h"
 #include "flexflow/request_manager.h"
 #include "flexflow/utils/cuda_helper.h"
 
@@ -78,88 +79,47 @@ void RequestManager::load_batch_config_task(
   // BatchConfig const batch_config = *((BatchConfig *)task->args);
   BatchConfig const *batch_config = BatchConfig::from_future(task->futures[0]);
 
-  // copy meta data to workSpace
+  // copy meta data to workSpace, only the rows that changed since the
+  // previous batch
   FFHandler handle = *((FFHandler const *)task->local_args);
+  BatchConfigMetadataCache *cache = handle.batch_config_metadata_cache;
+  assert(cache != nullptr);
+  char *metadata = static_cast<char *>(handle.batch_config_metadata);
+  BatchConfigMetadataCache::CopyFunc copy =
+      [&](size_t offset, void const *src, size_t size) {
+        checkCUDA(cudaMemcpyAsync(
+            metadata + offset, src, size, cudaMemcpyHostToDevice, stream));
+      };
   size_t total_copy_size = 0;
-  checkCUDA(cudaMemcpyAsync(handle.batch_config_metadata,
-                            &(batch_config->tokensInfo),
-                            sizeof(BatchConfig::tokensInfo),
-                            cudaMemcpyHostToDevice,
-                            stream));
+  // the kernels only read the tokens of the batch
+  cache->write(total_copy_size,
+               batch_config->tokensInfo,
+               batch_config->num_tokens,
+               copy);
   total_copy_size += sizeof(BatchConfig::tokensInfo);
-
-  checkCUDA(cudaMemcpyAsync(static_cast<char *>(handle.batch_config_metadata) +
-                                total_copy_size,
-                            &(batch_config->requestsInfo),
-                            sizeof(BatchConfig::requestsInfo),
-                            cudaMemcpyHostToDevice,
-                            stream));
+  cache->write(total_copy_size, batch_config->requestsInfo, copy);
   total_copy_size += sizeof(BatchConfig::requestsInfo);
 
   // load speculative metadata
   if (batch_config->get_mode() == BEAM_SEARCH_MODE) {
     BeamSearchBatchConfig const *beam_batch_config =
         static_cast<BeamSearchBatchConfig const *>(batch_config);
-
-    checkCUDA(cudaMemcpyAsync(
-        static_cast<char *>(handle.batch_config_metadata) + total_copy_size,
-        &(beam_batch_config->beamTokenInfo),
-        sizeof(BeamSearchBatchConfig::beamTokenInfo),
-        cudaMemcpyHostToDevice,
-        stream));
-
+    cache->write(total_copy_size, beam_batch_config->beamTokenInfo, copy);
     total_copy_size += sizeof(BeamSearchBatchConfig::beamTokenInfo);
-
-    checkCUDA(cudaMemcpyAsync(
-        static_cast<char *>(handle.batch_config_metadata) + total_copy_size,
-        &(beam_batch_config->beamRequestsInfo),
-        sizeof(BeamSearchBatchConfig::beamRequestsInfo),
-        cudaMemcpyHostToDevice,
-        stream));
+    cache->write(total_copy_size, beam_batch_config->beamRequestsInfo, copy);
     total_copy_size += sizeof(BeamSearchBatchConfig::beamRequestsInfo);
-
-    checkCUDA(cudaMemcpyAsync(
-        static_cast<char *>(handle.batch_config_metadata) + total_copy_size,
-        &(beam_batch_config->causalMask),
-        sizeof(BatchConfig::causalMask),
-        cudaMemcpyHostToDevice,
-        stream));
+    cache->write(total_copy_size, beam_batch_config->causalMask, copy);
     total_copy_size += sizeof(BatchConfig::causalMask);
-
-    checkCUDA(cudaMemcpyAsync(
-        static_cast<char *>(handle.batch_config_metadata) + total_copy_size,
-        &(batch_config->request_completed),
-        sizeof(BatchConfig::request_completed),
-        cudaMemcpyHostToDevice,
-        stream));
-
+    cache->write(total_copy_size, batch_config->request_completed, copy);
     total_copy_size += sizeof(BatchConfig::request_completed);
   } else if (batch_config->get_mode() == TREE_VERIFY_MODE) {
     TreeVerifyBatchConfig const *tree_batch_config =
         static_cast<TreeVerifyBatchConfig const *>(batch_config);
-
-    checkCUDA(cudaMemcpyAsync(
-        static_cast<char *>(handle.batch_config_metadata) + total_copy_size,
-        &(tree_batch_config->causalMask),
-        sizeof(BatchConfig::causalMask),
-        cudaMemcpyHostToDevice,
-        stream));
+    cache->write(total_copy_size, tree_batch_config->causalMask, copy);
     total_copy_size += sizeof(BatchConfig::causalMask);
-    checkCUDA(cudaMemcpyAsync(
-        static_cast<char *>(handle.batch_config_metadata) + total_copy_size,
-        &(tree_batch_config->committed_tokens),
-        sizeof(TreeVerifyBatchConfig::committed_tokens),
-        cudaMemcpyHostToDevice,
-        stream));
+    cache->write(total_copy_size, tree_batch_config->committed_tokens, copy);
     total_copy_size += sizeof(TreeVerifyBatchConfig::committed_tokens);
-
-    checkCUDA(cudaMemcpyAsync(
-        static_cast<char *>(handle.batch_config_metadata) + total_copy_size,
-        &(batch_config->request_completed),
-        sizeof(BatchConfig::request_completed),
-        cudaMemcpyHostToDevice,
-        stream));
-
+    cache->write(total_copy_size, batch_config->request_completed, copy);
     total_copy_size += sizeof(BatchConfig::request_completed);
   }
 
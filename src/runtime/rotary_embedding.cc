@@ -0,0 +1,58 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/rotary_embedding.h"
+#include <cassert>
+#include <cmath>
+
+namespace FlexFlow {
+
+size_t rotary_table_size(int num_positions, int proj_size) {
+  assert(proj_size % 2 == 0);
+  return (size_t)num_positions * (proj_size / 2) * 2;
+}
+
+void compute_rotary_table(int num_positions,
+                          int proj_size,
+                          float *table,
+                          double theta) {
+  assert(proj_size % 2 == 0);
+  int half = proj_size / 2;
+  for (int i = 0; i < half; i++) {
+    double inv_freq = 1.0 / std::pow(theta, 2.0 * i / proj_size);
+    for (int pos = 0; pos < num_positions; pos++) {
+      double freq = pos * inv_freq;
+      size_t idx = ((size_t)pos * half + i) * 2;
+      table[idx] = static_cast<float>(std::cos(freq));
+      table[idx + 1] = static_cast<float>(std::sin(freq));
+    }
+  }
+}
+
+void apply_rotary_table(float *head,
+                        int proj_size,
+                        int pos,
+                        float const *table) {
+  int half = proj_size / 2;
+  for (int i = 0; i < half; i++) {
+    size_t idx = ((size_t)pos * half + i) * 2;
+    float cos_freq = table[idx], sin_freq = table[idx + 1];
+    float real = head[i], imag = head[i + half];
+    head[i] = real * cos_freq - imag * sin_freq;
+    head[i + half] = real * sin_freq + imag * cos_freq;
+  }
+}
+
+}; // namespace FlexFlow
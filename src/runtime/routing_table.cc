@@ -0,0 +1,147 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/routing_table.h"
+#include <cassert>
+#include <functional>
+
+namespace FlexFlow {
+
+void EcmpRoutingTable::build(std::vector<int> const &_conn, int _total_devs) {
+  assert(_total_devs >= 0);
+  assert(_conn.size() == (size_t)_total_devs * _total_devs);
+  total_devs = _total_devs;
+  conn = _conn;
+  size_t n = total_devs;
+  // Sparse adjacency of the connection matrix
+  std::vector<uint32_t> adj_offsets(n + 1, 0);
+  std::vector<int> adj;
+  for (size_t u = 0; u < n; u++) {
+    for (size_t v = 0; v < n; v++) {
+      if (u != v && conn[u * n + v] > 0) {
+        adj.push_back(v);
+      }
+    }
+    adj_offsets[u + 1] = adj.size();
+  }
+  // One BFS per source
+  dist.assign(n * n, UNREACHABLE);
+  std::vector<int> queue(n);
+  for (size_t s = 0; s < n; s++) {
+    int *d = dist.data() + s * n;
+    size_t head = 0, tail = 0;
+    d[s] = 0;
+    queue[tail++] = s;
+    while (head < tail) {
+      int u = queue[head++];
+      for (uint32_t i = adj_offsets[u]; i < adj_offsets[u + 1]; i++) {
+        if (d[adj[i]] == UNREACHABLE) {
+          d[adj[i]] = d[u] + 1;
+          queue[tail++] = adj[i];
+        }
+      }
+    }
+  }
+  // Every neighbor one hop closer to the destination is a next hop
+  hop_offsets.assign(n * n + 1, 0);
+  hops.clear();
+  for (size_t s = 0; s < n; s++) {
+    for (size_t t = 0; t < n; t++) {
+      int d = dist[s * n + t];
+      if (d > 0) {
+        for (uint32_t i = adj_offsets[s]; i < adj_offsets[s + 1]; i++) {
+          if (dist[adj[i] * n + t] == d - 1) {
+            hops.push_back(adj[i]);
+          }
+        }
+      }
+      hop_offsets[s * n + t + 1] = hops.size();
+    }
+  }
+  built = true;
+}
+
+void EcmpRoutingTable::clear() {
+  total_devs = 0;
+  built = false;
+  conn.clear();
+  dist.clear();
+  hop_offsets.clear();
+  hops.clear();
+}
+
+bool EcmpRoutingTable::is_built() const {
+  return built;
+}
+
+int EcmpRoutingTable::num_devices() const {
+  return total_devs;
+}
+
+int EcmpRoutingTable::distance(int src, int dst) const {
+  assert(built);
+  assert(src >= 0 && src < total_devs && dst >= 0 && dst < total_devs);
+  return dist[src * total_devs + dst];
+}
+
+int const *EcmpRoutingTable::next_hops_begin(int src, int dst) const {
+  assert(built);
+  return hops.data() + hop_offsets[src * total_devs + dst];
+}
+
+int const *EcmpRoutingTable::next_hops_end(int src, int dst) const {
+  assert(built);
+  return hops.data() + hop_offsets[src * total_devs + dst + 1];
+}
+
+std::vector<EcmpRoutingTable::Path>
+    EcmpRoutingTable::paths(int src, int dst, size_t max_paths) const {
+  assert(max_paths > 0);
+  std::vector<Path> result;
+  if (src == dst || distance(src, dst) == UNREACHABLE) {
+    return result;
+  }
+  std::vector<int> prefix(1, src);
+  std::function<void(int, float)> expand = [&](int cur, float weight) {
+    if (cur == dst) {
+      result.push_back({prefix, weight});
+      return;
+    }
+    int links = 0;
+    for (int const *h = next_hops_begin(cur, dst);
+         h != next_hops_end(cur, dst);
+         h++) {
+      links += conn[cur * total_devs + *h];
+    }
+    for (int const *h = next_hops_begin(cur, dst);
+         h != next_hops_end(cur, dst) && result.size() < max_paths;
+         h++) {
+      prefix.push_back(*h);
+      expand(*h, weight * conn[cur * total_devs + *h] / links);
+      prefix.pop_back();
+    }
+  };
+  expand(src, 1.0f);
+  float total = 0.0f;
+  for (Path const &p : result) {
+    total += p.weight;
+  }
+  for (Path &p : result) {
+    p.weight /= total;
+  }
+  return result;
+}
+
+}; // namespace FlexFlow
@@ -14,6 +14,7 @@
  */
 
 #include "flexflow/simulator.h"
+#include "flexflow/analytical_cost_model.h"
 #include "flexflow/ffconst_utils.h"
 #include "flexflow/model.h"
 #include "flexflow/parallel_ops/combine.h"
@@ -145,9 +146,10 @@ CompDevice::CompDevice(std::string const &name,
                        CompDevType comp_type,
                        int node_id,
                        int socket_id,
-                       int device_id)
+                       int device_id,
+                       DeviceRoofline const &roofline)
     : Device(name, Device::DEVICE_COMP, node_id, socket_id, device_id),
-      comp_type(comp_type) {}
+      comp_type(comp_type), roofline(roofline) {}
 
 MemDevice::MemDevice(std::string const &name,
                      MemDevType mem_type,
@@ -197,16 +199,21 @@ Route NominalCommDevice::expand_to_physical() const {
   }
 
   assert(routes.first.size() > 0 || device_id / nnode == device_id % nnode);
+  if (routes.second.empty()) {
+    return Route();
+  }
+  // Single-path approximation: every transfer takes the heaviest route (the
+  // first one on ties) instead of being split across the ECMP routes. This
+  // keeps the pick deterministic and free of state, so it is safe to call
+  // from the concurrent search threads
   size_t pick = 0;
-  double choice = std_uniform(gen);
-  for (size_t i = 0; i < routes.first.size(); i++) {
-    if (choice > routes.first[i]) {
-      break;
+  for (size_t i = 1; i < routes.first.size(); i++) {
+    if (routes.first[i] - routes.first[i - 1] >
+        routes.first[pick] - (pick > 0 ? routes.first[pick - 1] : 0.0f)) {
+      pick = i;
     }
-    pick = i;
   }
-  Route ret = Route(routes.second[pick].begin(), routes.second[pick].end());
-  return ret;
+  return routes.second[pick];
 }
 
 void NominalCommDevice::set_physical_paths(EcmpRoutes const &rs) {
@@ -235,6 +242,10 @@ void SimTask::add_next_task(SimTask *task) {
 }
 
 std::string SimTask::get_type_str() const {
+  return get_type_str(type);
+}
+
+std::string SimTask::get_type_str(SimTaskType type) {
   switch (type) {
     case TASK_FORWARD:
       return "Forward";
@@ -252,13 +263,19 @@ std::string SimTask::get_type_str() const {
 }
 
 TaskManager::TaskManager(size_t _max_num_tasks)
-    : max_num_tasks(_max_num_tasks) {
+    : global_task_id(0), max_num_tasks(_max_num_tasks) {
+  task_pool = new SimTask[max_num_tasks];
   tasks = (SimTask **)malloc(sizeof(SimTask *) * max_num_tasks);
   for (size_t i = 0; i < max_num_tasks; i++) {
-    tasks[i] = new SimTask();
+    tasks[i] = &task_pool[i];
   }
 }
 
+TaskManager::~TaskManager() {
+  free(tasks);
+  delete[] task_pool;
+}
+
 void TaskManager::reset() {
   global_task_id = 0;
   hash_to_forward_task.clear();
@@ -364,100 +381,62 @@ void *Simulator::allocate(size_t num_elements, DataType type) {
   return ret_ptr;
 }
 
-void Simulator::add_task_dependencies_with_xfer(SimTask *src_task,
-                                                SimTask *dst_task,
-                                                size_t message_size,
-                                                bool zero_cost) {
-  std::vector<CommDevice *> path =
-      machine->get_comm_path(src_task->mem, dst_task->mem);
-  // print the communication path
-  // printf("Message: %zu B\nPath from %s to %s is: ", message_size,
-  // src_task->mem->name.c_str(), dst_task->mem->name.c_str()); for (size_t i =
-  // 0; i < path.size(); i++) {
-  //   printf("%s ", path[i]->name.c_str());
-  // }
-  // printf("\n");
-
-  if (path.empty() || zero_cost) {
-    log_xfer_sim.spew("Simulated xfer cost from %s to %s: 0ms",
-                      src_task->name.c_str(),
-                      dst_task->name.c_str());
-    src_task->add_next_task(dst_task);
-    return;
-  }
-  assert(message_size > 0);
-  std::vector<std::vector<SimTask *>> all_tasks;
-  // Limit the max number of segments per message
-  int seg_size = segment_size;
-  int num_segment = message_size / seg_size;
-  if (message_size % seg_size != 0) {
-    num_segment += 1;
-  }
-  if (num_segment > max_num_segments) {
-    num_segment = max_num_segments;
-    seg_size = message_size / num_segment;
-  }
-  // optional optimization: can reduce the simulation time, but could also
-  // impact the accuracy of the simulation (a communication can be occupied by a
-  // message for long time without be used by other concurrent communication
-  //   if (path.size() == 1) {
-  //     num_segment = 1;
-  //     seg_size = message_size;
-  //   }
-  // Create all the comm tasks
-  // Divide messages into segments
-  for (size_t i = 0; i < path.size(); i++) {
-    all_tasks.push_back({});
-    for (int j = 0; j < num_segment; j++) {
-      int cur_seg_size = seg_size;
-      if (j == num_segment - 1) {
-        cur_seg_size = message_size - (num_segment - 1) * seg_size;
-      }
-      std::string name = "seg " + std::to_string(j) + " from " +
-                         src_task->name + " to " + dst_task->name;
-      SimTask *cur_task =
-          task_manager->new_comm_task(name, path[i], cur_seg_size);
-      all_tasks[i].push_back(cur_task);
-      if (j == 0) {
-        log_xfer_sim.debug("Simulated xfer cost from %s to %s: %fms (%d)",
-                           src_task->name.c_str(),
-                           dst_task->name.c_str(),
-                           cur_task->run_time,
-                           cur_seg_size);
-      }
+std::vector<SimLink> const &Simulator::get_link_path(int src_gpu,
+                                                    int dst_gpu) {
+  size_t idx = (size_t)src_gpu * machine->get_num_gpus() + dst_gpu;
+  if (!link_path_ready[idx]) {
+    std::vector<CommDevice *> path =
+        machine->get_comm_path(machine->get_gpu_fb_mem(src_gpu),
+                               machine->get_gpu_fb_mem(dst_gpu));
+    for (CommDevice *comm : path) {
+      // Comm devices are numbered after the GPUs
+      auto const &it = comm_device_indices.insert(std::make_pair(
+          comm, machine->get_num_gpus() + (int)comm_device_indices.size()));
+      bool outbound = comm->comm_type == CommDevice::NIC_OUT_COMM ||
+                      comm->comm_type == CommDevice::UPI_OUT_COMM;
+      link_paths[idx].push_back(
+          {it.first->second, comm->latency, comm->bandwidth, outbound});
     }
+    link_path_ready[idx] = true;
   }
+  return link_paths[idx];
+}
 
-  // Add dependencies among the comm tasks
-  for (size_t i = 0; i < path.size(); i++) {
-    for (int j = 0; j < num_segment; j++) {
-      if (i == 0) {
-        src_task->add_next_task(all_tasks[i][j]);
-      }
-      if (i == path.size() - 1) {
-        all_tasks[i][j]->add_next_task(dst_task);
-      }
-      if (i > 0) {
-        all_tasks[i - 1][j]->add_next_task(all_tasks[i][j]);
-      }
-    }
+void Simulator::add_task_dependencies_with_xfer(SimTaskId src_task,
+                                                int src_gpu,
+                                                SimTaskId dst_task,
+                                                int dst_gpu,
+                                                size_t message_size,
+                                                bool force_zero_cost) {
+  SimTaskStore &tasks = event_simulator.tasks;
+  if (force_zero_cost) {
+    tasks.add_dependency(src_task, dst_task);
+    return;
   }
-
-  // Add special dependencies for upi_ins, upi_outs, nic_ins, and nic_outs to
-  // prevent communication overlap between upi_ins and upi_outs, and between
-  // nic_ins and nic_outs.
-  if (num_segment > 1 and path.size() >= 2) {
-    for (size_t i = 0; i < path.size(); i++) {
-      for (int j = 0; j < num_segment - 1; j++) {
-        if (((CommDevice *)all_tasks[i][j]->device)->comm_type ==
-                CommDevice::NIC_OUT_COMM or
-            ((CommDevice *)all_tasks[i][j]->device)->comm_type ==
-                CommDevice::UPI_OUT_COMM) {
-          all_tasks[i][j]->add_next_task(all_tasks[i - 1][j + 1]);
-        }
-      }
-    }
+  std::vector<SimLink> const &path = get_link_path(src_gpu, dst_gpu);
+  log_xfer_sim.spew(
+      "Simulated xfer from gpu %d to gpu %d: %zu B over %zu links",
+      src_gpu,
+      dst_gpu,
+      message_size,
+      path.size());
+  // Tasks are only named when the task graph is exported
+  uint32_t name = SimNameTable::NO_NAME;
+  if (tasks.name[src_task] != SimNameTable::NO_NAME ||
+      tasks.name[dst_task] != SimNameTable::NO_NAME) {
+    name = event_simulator.names.intern(
+        "from " + event_simulator.names.get(tasks.name[src_task]) + " to " +
+        event_simulator.names.get(tasks.name[dst_task]));
   }
+  add_segmented_transfer(tasks,
+                         src_task,
+                         dst_task,
+                         path,
+                         message_size,
+                         segment_size,
+                         max_num_segments,
+                         SimTask::TASK_COMM,
+                         name);
 }
 
 [[noreturn]] void handle_measure_operator_cost_unimplemented(Op const *op) {
@@ -516,23 +495,100 @@ ParallelConfig Op::view_to_pc(MachineView const &view) const {
   return config;
 }
 
+bool Simulator::init_cost_models(FFModel const *model) {
+  if (cost_model_type == COST_MODEL_ANALYTICAL) {
+    CompDevice const *gpu = machine->get_gpu(0);
+    CompDevice const *cpu = machine->get_cpu(0);
+    if (!gpu->roofline.is_valid() || !cpu->roofline.is_valid()) {
+      fprintf(stderr,
+              "[Error] --cost-model analytical needs the gpu_peak_tflops, "
+              "gpu_mem_bandwidth, cpu_peak_gflops and cpu_mem_bandwidth of "
+              "the machine in --machine-model-file\n");
+      exit(1);
+    }
+  }
+  analytical_cost_model = new AnalyticalCostModel(machine, computationMode);
+  if (!model->config.export_cost_database_file.empty()) {
+    cost_database = new CostDatabase();
+  } else if (!model->config.cost_database_file.empty()) {
+    cost_database = new CostDatabase();
+    std::string error;
+    if (cost_database->load_from_file(model->config.cost_database_file,
+                                      error)) {
+      log_sim.print("Loaded %zu cost records from %s",
+                    cost_database->get_records().size(),
+                    model->config.cost_database_file.c_str());
+      analytical_cost_model->calibrate(cost_database);
+    } else {
+      log_sim.error("Cannot load the cost database: %s", error.c_str());
+    }
+  }
+  if (cost_model_type != COST_MODEL_ANALYTICAL) {
+    return false;
+  }
+  // No kernels are run, so skip the workspace and profiling state
+  simulatorInst = Realm::RegionInstance::NO_INST;
+  base_ptr = nullptr;
+  capacity = 0;
+  conv2d_meta = nullptr;
+  pool2d_meta = nullptr;
+  ele_unary_meta = nullptr;
+  batch_matmul_meta = nullptr;
+  concat_meta = nullptr;
+  transpose_meta = nullptr;
+  return true;
+}
+
+void Simulator::compute_operator_cost(Op const *op,
+                                      MachineView const &mv,
+                                      CostMetrics &cost_metrics) {
+  if (cost_model_type == COST_MODEL_ANALYTICAL) {
+    assert(analytical_cost_model != nullptr);
+    analytical_cost_model->estimate_operator_cost(op, mv, cost_metrics);
+    return;
+  }
+  task_thread_executor.execute([&] {
+    bool is_implemented = op->measure_operator_cost(this, mv, cost_metrics);
+    if (!is_implemented) {
+      handle_measure_operator_cost_unimplemented(op);
+    }
+    if (cost_database != nullptr && analytical_cost_model != nullptr) {
+      cost_database->add_record(
+          analytical_cost_model->make_record(op, mv, cost_metrics));
+    }
+  });
+}
+
+bool Simulator::export_cost_database(std::string const &filename) const {
+  if (cost_database == nullptr) {
+    return false;
+  }
+  return cost_database->save_to_file(filename);
+}
+
 CostMetrics Simulator::measure_operator_cost(Op const *op,
                                              MachineView const &mv) {
+  // The lock only guards the caches: costs are computed without it, so that
+  // search threads estimate concurrently and only queue up for profiling on
+  // the task thread. Two threads missing the same key both compute it and
+  // the first insert wins.
   tl::optional<OperatorParameters> retrieved_params = get_op_parameters(op);
   if (retrieved_params.has_value()) {
     OperatorParameters params = retrieved_params.value();
     ProfilingRecordKey key{params, mv};
-    if (this->strict_hash_to_operator_cost.find(key) ==
-        this->strict_hash_to_operator_cost.end()) {
-      CostMetrics cost_metrics{};
-      bool is_implemented = op->measure_operator_cost(this, mv, cost_metrics);
-      if (!is_implemented) {
-        handle_measure_operator_cost_unimplemented(op);
+    {
+      std::lock_guard<std::mutex> lock(this->operator_cost_mutex);
+      auto const &iter = this->strict_hash_to_operator_cost.find(key);
+      if (iter != this->strict_hash_to_operator_cost.end()) {
+        return iter->second;
       }
-      op->estimate_sync_cost(this, mv, cost_metrics);
-      this->strict_hash_to_operator_cost[key] = cost_metrics;
     }
-    return this->strict_hash_to_operator_cost.at(key);
+    CostMetrics cost_metrics{};
+    compute_operator_cost(op, mv, cost_metrics);
+    op->estimate_sync_cost(this, mv, cost_metrics);
+    std::lock_guard<std::mutex> lock(this->operator_cost_mutex);
+    return this->strict_hash_to_operator_cost.emplace(key, cost_metrics)
+        .first->second;
   }
 
   size_t hash = 17 * 31 + op->get_untyped_params_hash();
@@ -541,21 +597,19 @@ CostMetrics Simulator::measure_operator_cost(Op const *op,
   for (int i = 0; i < mv.ndims; i++) {
     hash = hash * 31 + std::hash<int>()(mv.dim[i]);
   }
-  std::unordered_map<size_t, CostMetrics>::const_iterator iter =
-      hash_to_operator_cost.find(hash);
-
-  if (iter == hash_to_operator_cost.end()) {
-    CostMetrics cost_metrics{};
-    bool is_implemented = op->measure_operator_cost(this, mv, cost_metrics);
-    if (!is_implemented) {
-      handle_measure_operator_cost_unimplemented(op);
+  {
+    std::lock_guard<std::mutex> lock(this->operator_cost_mutex);
+    std::unordered_map<size_t, CostMetrics>::const_iterator iter =
+        hash_to_operator_cost.find(hash);
+    if (iter != hash_to_operator_cost.end()) {
+      return iter->second;
     }
-    op->estimate_sync_cost(this, mv, cost_metrics);
-    hash_to_operator_cost[hash] = cost_metrics;
-    return cost_metrics;
-  } else {
-    return iter->second;
   }
+  CostMetrics cost_metrics{};
+  compute_operator_cost(op, mv, cost_metrics);
+  op->estimate_sync_cost(this, mv, cost_metrics);
+  std::lock_guard<std::mutex> lock(this->operator_cost_mutex);
+  return hash_to_operator_cost.emplace(hash, cost_metrics).first->second;
 }
 
 float Simulator::estimate_repartition_xfer_cost(
@@ -774,24 +828,81 @@ float Simulator::default_estimate_sync_cost(
     // No replications
     return 0.0f;
   } else {
-    bool inter_node_sync = false;
-    tl::optional<int> node = tl::nullopt;
-    for (Domain::DomainPointIterator it(view.get_domain()); it; it++) {
-      int my_device = view.get_device_id(*it);
-      int my_node = machine->get_gpu(my_device)->node_id;
-      if (node == tl::nullopt) {
-        node = my_node;
-      }
-      if (my_node != node.value()) {
-        inter_node_sync = true;
-        break;
-      }
+    // All-reduce the gradients among the replicas with the cheapest
+    // algorithm for where they are placed. Every piece has its own group of
+    // replicas; the group of the first piece stands for all of them
+    CollectiveCost cost = cheapest_collective(
+        CollectiveType::ALLREDUCE,
+        this->get_collective_topology(
+            get_replica_group(tensor_shape, view, num_replicas)),
+        tensor_shape.get_piece_size());
+    return cost.time;
+  }
+}
+
+/**
+ * @brief Devices of a view holding the replicas of the first piece of a
+ * tensor.
+ *
+ * @details These are the devices whose view coordinates are 0 on every
+ * dimension that does not replicate the tensor. Shapes built ad hoc may not
+ * map their replica dimensions to the view, in which case the first
+ * num_replicas devices of the view are taken.
+ */
+std::vector<int>
+    Simulator::get_replica_group(ParallelTensorShape const &tensor_shape,
+                                 MachineView const &view,
+                                 int num_replicas) const {
+  std::vector<bool> replica_dim(view.ndims, false);
+  int group_size = 1;
+  for (int i = 0; i < tensor_shape.num_dims; i++) {
+    ParallelDim const &dim = tensor_shape.dims[i];
+    if (dim.is_replica_dim && dim.parallel_idx >= 0 &&
+        dim.parallel_idx < view.ndims &&
+        view.dim[dim.parallel_idx] == dim.degree &&
+        !replica_dim[dim.parallel_idx]) {
+      replica_dim[dim.parallel_idx] = true;
+      group_size *= dim.degree;
+    }
+  }
+  std::vector<int> devices = view.device_ids();
+  if (group_size != num_replicas) {
+    devices.resize(std::min((int)devices.size(), num_replicas));
+    return devices;
+  }
+  std::vector<int> group;
+  for (Domain::DomainPointIterator it(view.get_domain()); it; it++) {
+    bool first_piece = true;
+    for (int d = 0; d < view.ndims; d++) {
+      first_piece &= replica_dim[d] || (*it)[d] == 0;
+    }
+    if (first_piece) {
+      group.push_back(view.get_device_id(*it));
     }
-    float bandwidth = inter_node_sync
-                          ? this->machine->get_inter_node_gpu_bandwidth()
-                          : this->machine->get_intra_node_gpu_bandwidth();
-    return 2 * tensor_shape.get_piece_size() / bandwidth;
   }
+  return group;
+}
+
+/**
+ * @brief Topology of a collective among the given GPUs, counting the
+ * participants on each node they are placed on.
+ */
+CollectiveTopology
+    Simulator::get_collective_topology(std::vector<int> const &gpus) const {
+  std::map<int, int> gpus_per_node;
+  for (int gpu : gpus) {
+    gpus_per_node[machine->get_gpu(gpu)->node_id]++;
+  }
+  CollectiveTopology topology;
+  topology.gpus_per_node.clear();
+  for (auto const &it : gpus_per_node) {
+    topology.gpus_per_node.push_back(it.second);
+  }
+  topology.intra_node_bandwidth = machine->get_intra_node_gpu_bandwidth();
+  topology.inter_node_bandwidth = machine->get_inter_node_gpu_bandwidth();
+  topology.intra_node_latency = machine->get_intra_node_gpu_latency();
+  topology.inter_node_latency = machine->get_inter_node_gpu_latency();
+  return topology;
 }
 
 float Simulator::simulate_runtime(
@@ -807,24 +918,45 @@ float Simulator::simulate_runtime(
     CompMode comp_mode,
     std::string const &export_file_name) {
   // printf("%s\n", machine->to_string().c_str());
-  task_manager->reset();
-  // Step 1: register forward and backward tasks
+  // Tasks go straight into the event-driven core. A compute, barrier or update
+  // task on GPU d runs on device d, and comm devices are numbered after the
+  // GPUs as transfer paths are looked up.
+  bool export_taskgraph = (export_file_name != "");
+  int num_gpus = machine->get_num_gpus();
+  event_simulator.reset();
+  SimTaskStore &tasks = event_simulator.tasks;
+  link_paths.resize((size_t)num_gpus * num_gpus);
+  for (std::vector<SimLink> &path : link_paths) {
+    path.clear();
+  }
+  link_path_ready.assign((size_t)num_gpus * num_gpus, false);
+  comm_device_indices.clear();
+  // Step 1: register forward and backward tasks. The tasks of part j of an op
+  // start at first_task[op] + j * stride, forward before backward.
+  int stride = comp_mode == COMP_MODE_TRAINING ? 2 : 1;
+  std::unordered_map<Op const *, SimTaskId> first_task;
+  auto forward_task = [&](Op const *op, int idx) {
+    return first_task.at(op) + idx * stride;
+  };
+  auto backward_task = [&](Op const *op, int idx) {
+    return first_task.at(op) + idx * stride + 1;
+  };
   for (Op *op : model->operators) {
     ParallelConfig config = global.find(op)->second;
     CostMetrics cost_metrics = measure_operator_cost(op, config);
     float forward_time = cost_metrics.forward_time;
     float backward_time = cost_metrics.backward_time;
+    // Names are only needed for the exported task graph
+    uint32_t name = export_taskgraph ? event_simulator.names.intern(op->name)
+                                     : SimNameTable::NO_NAME;
+    first_task[op] = tasks.num_tasks();
     for (int j = 0; j < config.num_parts(); j++) {
-      SimTask *task1 = task_manager->new_forward_task(op, j);
-      task1->device = machine->get_gpu(config.device_ids[j]);
-      task1->mem = machine->get_gpu_fb_mem(config.device_ids[j]);
-      task1->run_time = forward_time;
+      SimTaskId task1 = tasks.add_task(
+          SimTask::TASK_FORWARD, config.device_ids[j], forward_time, name);
       if (comp_mode == COMP_MODE_TRAINING) {
-        SimTask *task2 = task_manager->new_backward_task(op, j);
-        task2->device = machine->get_gpu(config.device_ids[j]);
-        task2->mem = machine->get_gpu_fb_mem(config.device_ids[j]);
-        task2->run_time = backward_time;
-        task1->add_next_task(task2);
+        SimTaskId task2 = tasks.add_task(
+            SimTask::TASK_BACKWARD, config.device_ids[j], backward_time, name);
+        tasks.add_dependency(task1, task2);
       }
     }
   }
@@ -846,39 +978,31 @@ float Simulator::simulate_runtime(
               pre_op->get_output_tensor_shape(pre_config, t->owner_idx, srcId);
           bool force_zero_cost = pre_op->op_type == OP_INPUT;
           if (dstR.intersection(srcR).get_volume() > 0) {
-            // Forward dependency
-            {
-              SimTask *dstT = task_manager->get_forward_task(op, dstId);
-              SimTask *srcT = task_manager->get_forward_task(pre_op, srcId);
-              size_t xfer_size =
-                  dstR.intersection(srcR).get_volume() * element_size;
-              if (dstId == 0 && srcId == 0) {
-                log_sim.debug("fwd xfer from %s to %s: %zu",
-                              srcT->name.c_str(),
-                              dstT->name.c_str(),
-                              xfer_size);
-              }
-              add_task_dependencies_with_xfer(
-                  srcT, dstT, xfer_size, force_zero_cost);
-              // add_task_dependencies_with_xfer(srcT, dstT,
-              // dstR.intersection(srcR).get_volume() * element_size);
+            size_t xfer_size =
+                dstR.intersection(srcR).get_volume() * element_size;
+            int dst_gpu = config.device_ids[dstId];
+            int src_gpu = pre_config.device_ids[srcId];
+            if (dstId == 0 && srcId == 0) {
+              log_sim.debug("xfer from %s to %s: %zu",
+                            pre_op->name,
+                            op->name,
+                            xfer_size);
             }
+            // Forward dependency
+            add_task_dependencies_with_xfer(forward_task(pre_op, srcId),
+                                            src_gpu,
+                                            forward_task(op, dstId),
+                                            dst_gpu,
+                                            xfer_size,
+                                            force_zero_cost);
             // Backward dependency
             if (comp_mode == COMP_MODE_TRAINING) {
-              SimTask *dstT = task_manager->get_backward_task(op, dstId);
-              SimTask *srcT = task_manager->get_backward_task(pre_op, srcId);
-              size_t xfer_size =
-                  dstR.intersection(srcR).get_volume() * element_size;
-              if (dstId == 0 && srcId == 0) {
-                log_sim.debug("bwd xfer from %s to %s: %zu",
-                              dstT->name.c_str(),
-                              srcT->name.c_str(),
-                              xfer_size);
-              }
-              add_task_dependencies_with_xfer(
-                  dstT, srcT, xfer_size, force_zero_cost);
-              // add_task_dependencies_with_xfer(dstT, srcT,
-              // dstR.intersection(srcR).get_volume() * element_size);
+              add_task_dependencies_with_xfer(backward_task(op, dstId),
+                                              dst_gpu,
+                                              backward_task(pre_op, srcId),
+                                              src_gpu,
+                                              xfer_size,
+                                              force_zero_cost);
             }
           }
         }
@@ -890,13 +1014,10 @@ float Simulator::simulate_runtime(
 #else
   // Step 2.5: add finals tasks for each compute device to capture the returning
   // comm tasks from parameter servers
-  std::vector<SimTask *> finals;
-  for (int d = 0; d < machine->get_num_gpus(); d++) {
-    SimTask *t = task_manager->new_barrier_task();
-    t->device = machine->get_gpu(d);
-    t->mem = machine->get_gpu_fb_mem(d);
-    t->run_time = 0;
-    finals.push_back(t);
+  std::vector<SimTaskId> finals;
+  for (int d = 0; d < num_gpus; d++) {
+    finals.push_back(
+        tasks.add_task(SimTask::TASK_BARRIER, d, 0, SimNameTable::NO_NAME));
   }
 
   if (model->config.search_overlap_backward_update &&
@@ -914,11 +1035,13 @@ float Simulator::simulate_runtime(
             synched.insert(firstId);
             Domain firstR = op->get_weight_tensor_shape(pc, j, firstId);
             // Add a compute task for parameter update
-            SimTask *updateT = task_manager->new_update_task();
-            updateT->device = machine->get_gpu(pc.device_ids[firstId]);
-            updateT->mem = machine->get_gpu_fb_mem(pc.device_ids[firstId]);
             // TODO add parameter synchronization time
-            updateT->run_time = 0.0f; // Assume update task takes no time
+            int update_gpu = pc.device_ids[firstId];
+            SimTaskId updateT =
+                tasks.add_task(SimTask::TASK_UPDATE,
+                               update_gpu,
+                               0.0f, // Assume update task takes no time
+                               SimNameTable::NO_NAME);
             for (int nextId = firstId + 1; nextId < pc.num_parts(); nextId++) {
               Domain nextR = op->get_weight_tensor_shape(pc, j, nextId);
               if (firstR.intersection(nextR).get_volume() > 0) {
@@ -927,14 +1050,21 @@ float Simulator::simulate_runtime(
                 assert(firstR == nextR);
                 assert(synched.find(nextId) == synched.end());
                 synched.insert(nextId);
+                int back_gpu = pc.device_ids[nextId];
                 // Add comm. tasks from backT to updateT
-                SimTask *backT = task_manager->get_backward_task(op, nextId);
-                add_task_dependencies_with_xfer(
-                    backT, updateT, firstR.get_volume() * element_size);
+                add_task_dependencies_with_xfer(backward_task(op, nextId),
+                                                back_gpu,
+                                                updateT,
+                                                update_gpu,
+                                                firstR.get_volume() *
+                                                    element_size);
                 // Add comm. tasks from updateT to finalT
-                SimTask *finalT = finals[backT->device->device_id];
-                add_task_dependencies_with_xfer(
-                    updateT, finalT, firstR.get_volume() * element_size);
+                add_task_dependencies_with_xfer(updateT,
+                                                update_gpu,
+                                                finals[back_gpu],
+                                                back_gpu,
+                                                firstR.get_volume() *
+                                                    element_size);
               }
             }
           }
@@ -944,20 +1074,16 @@ float Simulator::simulate_runtime(
   } else if (comp_mode == COMP_MODE_TRAINING) {
     // Step 3b: Bulk Synchronous Model
     // Add a per-device barrier before weight update
-    std::vector<SimTask *> barriers;
-    for (int d = 0; d < machine->get_num_gpus(); d++) {
-      SimTask *t = task_manager->new_barrier_task();
-      t->device = machine->get_gpu(d);
-      t->mem = machine->get_gpu_fb_mem(d);
-      t->run_time = 0;
-      barriers.push_back(t);
+    std::vector<SimTaskId> barriers;
+    for (int d = 0; d < num_gpus; d++) {
+      barriers.push_back(
+          tasks.add_task(SimTask::TASK_BARRIER, d, 0, SimNameTable::NO_NAME));
     }
     for (size_t l = 0; l < model->operators.size(); l++) {
       Op *op = model->operators[l];
       ParallelConfig pc = global.find(op)->second;
       for (int j = 0; j < pc.num_parts(); j++) {
-        SimTask *backT = task_manager->get_backward_task(op, j);
-        backT->add_next_task(barriers[backT->device->device_id]);
+        tasks.add_dependency(backward_task(op, j), barriers[pc.device_ids[j]]);
       }
     }
     for (size_t l = 0; l < model->operators.size(); l++) {
@@ -972,11 +1098,13 @@ float Simulator::simulate_runtime(
             synched.insert(firstId);
             Domain firstR = op->get_weight_tensor_shape(pc, j, firstId);
             // Add a compute task for parameter update
-            SimTask *updateT = task_manager->new_update_task();
-            updateT->device = machine->get_gpu(pc.device_ids[firstId]);
-            updateT->mem = machine->get_gpu_fb_mem(pc.device_ids[firstId]);
-            updateT->run_time = 0.0f; // Assume update task takes no time
-            barriers[updateT->device->device_id]->add_next_task(updateT);
+            int update_gpu = pc.device_ids[firstId];
+            SimTaskId updateT =
+                tasks.add_task(SimTask::TASK_UPDATE,
+                               update_gpu,
+                               0.0f, // Assume update task takes no time
+                               SimNameTable::NO_NAME);
+            tasks.add_dependency(barriers[update_gpu], updateT);
             for (int nextId = firstId + 1; nextId < pc.num_parts(); nextId++) {
               Domain nextR = op->get_weight_tensor_shape(pc, j, nextId);
               if (firstR.intersection(nextR).get_volume() > 0) {
@@ -985,16 +1113,21 @@ float Simulator::simulate_runtime(
                 assert(firstR == nextR);
                 assert(synched.find(nextId) == synched.end());
                 synched.insert(nextId);
-                SimTask *backT = task_manager->get_backward_task(op, nextId);
-                assert(backT->device->device_id == pc.device_ids[nextId]);
-                SimTask *barrierT = barriers[backT->device->device_id];
+                int back_gpu = pc.device_ids[nextId];
                 // Add comm. tasks from barrierT to updateT
-                add_task_dependencies_with_xfer(
-                    barrierT, updateT, firstR.get_volume() * element_size);
+                add_task_dependencies_with_xfer(barriers[back_gpu],
+                                                back_gpu,
+                                                updateT,
+                                                update_gpu,
+                                                firstR.get_volume() *
+                                                    element_size);
                 // Add comm. tasks from updateT to finalT
-                SimTask *finalT = finals[backT->device->device_id];
-                add_task_dependencies_with_xfer(
-                    updateT, finalT, firstR.get_volume() * element_size);
+                add_task_dependencies_with_xfer(updateT,
+                                                update_gpu,
+                                                finals[back_gpu],
+                                                back_gpu,
+                                                firstR.get_volume() *
+                                                    element_size);
               }
             }
           }
@@ -1005,73 +1138,36 @@ float Simulator::simulate_runtime(
     assert(comp_mode == COMP_MODE_INFERENCE);
   }
 #endif
-  // Step 4: add ready tasks into ready_queue
-  std::priority_queue<SimTask *, std::vector<SimTask *>, SimTaskCompare>
-      ready_queue;
-  for (size_t i = 0; i < task_manager->global_task_id; i++) {
-    if (task_manager->tasks[i]->counter == 0) {
-      ready_queue.push(task_manager->tasks[i]);
-    }
-  }
-  // Step 5: perform simulation
-  float sim_time = 0.0f;
-  std::map<Device *, float> device_times;
-  size_t idx = 0;
-  DotFile<SimTask *> taskGraph;
-  bool export_taskgraph = (export_file_name != "");
+  tasks.finalize();
+  // Step 4: perform simulation
+  float sim_time = event_simulator.simulate(
+      num_gpus + (int)comm_device_indices.size(), export_taskgraph);
   if (export_taskgraph) {
+    DotFile<SimTaskId> taskGraph;
     taskGraph.set_filename(export_file_name);
-  }
-  while (!ready_queue.empty()) {
-    // Find the task with the earliest start time
-    SimTask *cur_task = ready_queue.top();
-    ready_queue.pop();
-    float ready_time = 0;
-    if (device_times.find(cur_task->device) != device_times.end()) {
-      ready_time = device_times[cur_task->device];
-    }
-    float start_time = std::max(ready_time, cur_task->ready_time);
-    float end_time = start_time + cur_task->run_time;
-    device_times[cur_task->device] = end_time;
-    if (export_taskgraph) {
+    for (SimTaskId id : event_simulator.schedule) {
       std::map<std::string, std::string> nodeAttrs;
       std::ostringstream label;
       label << "\"{ ";
-      if (!(cur_task->name).empty()) {
-        label << cur_task->name << " | ";
+      if (tasks.name[id] != SimNameTable::NO_NAME) {
+        label << event_simulator.names.get(tasks.name[id]) << " | ";
       }
-      label << cur_task->get_type_str() << " | ";
-      label << "{ " << start_time << " | " << end_time << " }";
+      label << SimTask::get_type_str((SimTask::SimTaskType)tasks.type[id])
+            << " | ";
+      label << "{ " << event_simulator.start_time[id] << " | "
+            << event_simulator.end_time[id] << " }";
       label << " }\"";
       nodeAttrs["label"] = label.str();
       nodeAttrs["shape"] = "record";
-      taskGraph.add_node(cur_task, nodeAttrs);
-    }
-    // printf("task[%lu] type(%d) run_time(%.4lf) ready_time(%.4lf)
-    // start_time(%.4lf) device(%s)\n",
-    //       idx, cur_task->type, cur_task->run_time, ready_time, start_time,
-    //       (cur_task->device->name).c_str());
-    if (end_time > sim_time) {
-      sim_time = end_time;
-    }
-    for (size_t i = 0; i < cur_task->next_tasks.size(); i++) {
-      SimTask *next = cur_task->next_tasks[i];
-      if (export_taskgraph) {
-        taskGraph.add_edge(cur_task, next);
-      }
-      next->ready_time = std::max(next->ready_time, end_time);
-      next->counter--;
-      if (next->counter == 0) {
-        ready_queue.push(next);
+      taskGraph.add_node(id, nodeAttrs);
+      for (SimTaskId const *next = tasks.successors_begin(id);
+           next != tasks.successors_end(id);
+           next++) {
+        taskGraph.add_edge(id, *next);
       }
     }
-    idx++;
-  }
-  if (export_taskgraph) {
     taskGraph.close();
   }
-  // Assert all tasks were processed
-  assert(idx == task_manager->global_task_id);
 #ifdef FF_USE_NCCL
   if (comp_mode == COMP_MODE_TRAINING) {
     std::unordered_set<Op const *> possible_syncs(model->operators.begin(),
@@ -1230,6 +1326,16 @@ float Simulator::simulate_runtime(
   return sim_time + memory_penalty;
 }
 
+LogicalTaskgraphBasedSimulator::LogicalTaskgraphBasedSimulator(
+    FFModel const *model,
+    FFHandler handler,
+    Memory memory,
+    MachineModel *machine)
+    : Simulator(model, handler, memory, machine),
+      segment_transfer(model->config.simulator_max_num_segments > 1),
+      segment_size(model->config.simulator_segment_size),
+      flow_level_network(false) {}
+
 float LogicalTaskgraphBasedSimulator::simulate_runtime(
     FFModel const *model,
     std::map<Op const *, ParallelConfig> const &global,
@@ -1363,7 +1469,32 @@ float LogicalTaskgraphBasedSimulator::simulate_runtime(
   std::map<Device *, float> device_times;
   // map<Device*, SimTask*> device_schedule;
   size_t idx = 0;
-  while (!ready_queue.empty()) {
+  flow_network.reset();
+  flow_link_ids.clear();
+  flow_tasks.clear();
+  while (!ready_queue.empty() || flow_network.has_flows()) {
+    // Finish the transfers that complete before the next task is ready
+    if (flow_network.has_flows() &&
+        (ready_queue.empty() || flow_network.next_completion_time() <=
+                                    ready_queue.top()->ready_time)) {
+      float end_time;
+      SimTask *cur_task = flow_tasks[flow_network.complete_next_flow(end_time)];
+      cur_task->run_time = end_time - cur_task->ready_time;
+      if (end_time > sim_time) {
+        sim_time = end_time;
+      }
+      for (SimTask *next : cur_task->next_tasks) {
+        if (end_time > next->ready_time) {
+          next->ready_time = end_time;
+        }
+        next->counter--;
+        if (next->counter == 0) {
+          ready_queue.push(next);
+        }
+      }
+      idx++;
+      continue;
+    }
     // Find the task with the earliest start time
     SimTask *cur_task = ready_queue.top();
     ready_queue.pop();
@@ -1374,7 +1505,11 @@ float LogicalTaskgraphBasedSimulator::simulate_runtime(
     }
     float start_time = std::max(ready_time, cur_task->ready_time);
     if (cur_task->type == SimTask::TASK_NOMINAL_COMM) {
-      if (!segment_transfer) {
+      if (flow_level_network) {
+        // Completes once the flow network drains it
+        route_transfer_flow(cur_task, start_time);
+        continue;
+      } else if (!segment_transfer) {
         end_time = route_transfer(cur_task, start_time, device_times);
       } else {
         bool finished;
@@ -1669,6 +1804,53 @@ float LogicalTaskgraphBasedSimulator::route_transfer_seg(
   return final_finish_time;
 }
 
+/**
+ * @brief Latency of one hop: links between nodes take the inter-node
+ * latency, links within a node the intra-node one.
+ */
+static float get_hop_latency(MachineModel const *machine, CommDevice const *d) {
+  switch (d->comm_type) {
+    case CommDevice::NIC_IN_COMM:
+    case CommDevice::NIC_OUT_COMM:
+    case CommDevice::NW_COMM:
+    case CommDevice::NW_NOMINAL:
+      return machine->get_inter_node_gpu_latency();
+    default:
+      return machine->get_intra_node_gpu_latency();
+  }
+}
+
+/**
+ * @brief Start a transfer on the flow-level network model. It shares every
+ * link of its route with the other transfers in flight and completes after
+ * the latency of each hop once all its bytes are sent.
+ */
+void LogicalTaskgraphBasedSimulator::route_transfer_flow(
+    SimTask *transfer_task, float start_time) {
+  std::vector<CommDevice *> route =
+      static_cast<NominalCommDevice *>(transfer_task->device)
+          ->expand_to_physical();
+  std::vector<int> links;
+  float latency = 0.0f;
+  for (CommDevice *d : route) {
+    latency += get_hop_latency(machine, d);
+    auto const &it = flow_link_ids.find(d);
+    if (it == flow_link_ids.end()) {
+      int link = flow_network.add_link(d->bandwidth);
+      flow_link_ids[d] = link;
+      links.push_back(link);
+    } else {
+      links.push_back(it->second);
+    }
+  }
+  FlowId flow = flow_network.start_flow(
+      links, transfer_task->xfer_size, start_time, latency);
+  assert(flow == flow_tasks.size());
+  flow_tasks.push_back(transfer_task);
+  // the run time is only known once the flow completes
+  transfer_task->ready_time = start_time;
+}
+
 void LogicalTaskgraphBasedSimulator::expand_allreduce(
     SimTask *allreduce_task,
     float start_time,
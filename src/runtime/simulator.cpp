@@ -14,6 +14,7 @@
  */
 
 #include "flexflow/simulator.h"
+#include "flexflow/analytical_cost_model.h"
 #include "flexflow/model.h"
 #include "flexflow/ops/batch_norm.h"
 #include "flexflow/ops/element_unary.h"
@@ -57,7 +58,18 @@ Simulator::Simulator(FFModel const *model,
                      Memory _memory,
                      MachineModel *machine)
     : memory(_memory), handler(_handler), offset(0), warmup_times(5),
-      repeat_times(10), computationMode(model->config.computationMode) {
+      repeat_times(10), computationMode(model->config.computationMode),
+      cost_model_type(model->config.cost_model_type),
+      analytical_cost_model(nullptr), cost_database(nullptr) {
+  this->machine = machine;
+  segment_size = model->config.simulator_segment_size;
+  max_num_segments = model->config.simulator_max_num_segments;
+  // Initialize task manager
+  size_t max_num_tasks = 1024 * 1024;
+  task_manager = new TaskManager(max_num_tasks);
+  if (init_cost_models(model)) {
+    return;
+  }
   // Allocate simulator memory
   Rect1 bounds(Point1(0), Point1(0));
   std::vector<size_t> field_sizes;
@@ -78,8 +90,6 @@ Simulator::Simulator(FFModel const *model,
   checkCUDA(hipblasSetStream(handler.blas, stream));
   checkCUDNN(miopenSetStream(handler.dnn, stream));
 
-  size_t max_num_tasks = 1024 * 1024;
-
   checkCUDA(hipEventCreate(&start_event));
   checkCUDA(hipEventCreate(&end_event));
   conv2d_meta = new Conv2DMeta(handler);
@@ -93,15 +103,15 @@ Simulator::Simulator(FFModel const *model,
   concat_meta = new ConcatMeta(handler);
   // dropout_meta = new DropoutMeta(handler);
   transpose_meta = new TransposeMeta(handler);
-  this->machine = machine;
-  segment_size = model->config.simulator_segment_size;
-  max_num_segments = model->config.simulator_max_num_segments;
-  // Initialize task manager
-  task_manager = new TaskManager(max_num_tasks);
 }
 
 Simulator::~Simulator(void) {
-  simulatorInst.destroy();
+  if (cost_model_type != COST_MODEL_ANALYTICAL) {
+    simulatorInst.destroy();
+  }
+  delete task_manager;
+  delete analytical_cost_model;
+  delete cost_database;
 }
 
 __host__ void
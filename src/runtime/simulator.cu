@@ -13,6 +13,7 @@
  * limitations under the License.
  */
 
+#include "flexflow/analytical_cost_model.h"
 #include "flexflow/model.h"
 #include "flexflow/ops/batch_norm.h"
 #include "flexflow/ops/element_unary.h"
@@ -56,7 +57,18 @@ Simulator::Simulator(FFModel const *model,
                      Memory _memory,
                      MachineModel *machine)
     : memory(_memory), handler(_handler), offset(0), warmup_times(5),
-      repeat_times(10), computationMode(model->config.computationMode) {
+      repeat_times(10), computationMode(model->config.computationMode),
+      cost_model_type(model->config.cost_model_type),
+      analytical_cost_model(nullptr), cost_database(nullptr) {
+  this->machine = machine;
+  segment_size = model->config.simulator_segment_size;
+  max_num_segments = model->config.simulator_max_num_segments;
+  // Initialize task manager
+  size_t max_num_tasks = 1024 * 1024;
+  task_manager = new TaskManager(max_num_tasks);
+  if (init_cost_models(model)) {
+    return;
+  }
   // Allocate simulator memory
   Rect1 bounds(Point1(0), Point1(0));
   std::vector<size_t> field_sizes;
@@ -77,8 +89,6 @@ Simulator::Simulator(FFModel const *model,
   checkCUDA(cublasSetStream(handler.blas, stream));
   checkCUDNN(cudnnSetStream(handler.dnn, stream));
 
-  size_t max_num_tasks = 1024 * 1024;
-
   cudaEventCreate(&start_event);
   cudaEventCreate(&end_event);
   conv2d_meta = new Conv2DMeta(handler);
@@ -92,24 +102,23 @@ Simulator::Simulator(FFModel const *model,
   concat_meta = new ConcatMeta(handler);
   // dropout_meta = new DropoutMeta(handler);
   transpose_meta = new TransposeMeta(handler);
-  this->machine = machine;
-  segment_size = model->config.simulator_segment_size;
-  max_num_segments = model->config.simulator_max_num_segments;
-  // Initialize task manager
-  task_manager = new TaskManager(max_num_tasks);
 }
 
 Simulator::~Simulator(void) {
-  simulatorInst.destroy();
-  cudaEventDestroy(start_event);
-  cudaEventDestroy(end_event);
-  delete conv2d_meta;
-  delete pool2d_meta;
-  delete ele_unary_meta;
-  delete batch_matmul_meta;
-  delete concat_meta;
-  delete transpose_meta;
+  if (cost_model_type != COST_MODEL_ANALYTICAL) {
+    simulatorInst.destroy();
+    cudaEventDestroy(start_event);
+    cudaEventDestroy(end_event);
+    delete conv2d_meta;
+    delete pool2d_meta;
+    delete ele_unary_meta;
+    delete batch_matmul_meta;
+    delete concat_meta;
+    delete transpose_meta;
+  }
   delete task_manager;
+  delete analytical_cost_model;
+  delete cost_database;
 }
 
 __host__ void
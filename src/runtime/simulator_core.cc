@@ -0,0 +1,292 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/simulator_core.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace FlexFlow {
+
+SimNameTable::SimNameTable() {
+  names.push_back("");
+  name_to_id[""] = NO_NAME;
+}
+
+uint32_t SimNameTable::intern(std::string const &name) {
+  auto const &it = name_to_id.find(name);
+  if (it != name_to_id.end()) {
+    return it->second;
+  }
+  uint32_t id = names.size();
+  names.push_back(name);
+  name_to_id[name] = id;
+  return id;
+}
+
+std::string const &SimNameTable::get(uint32_t id) const {
+  assert(id < names.size());
+  return names[id];
+}
+
+size_t SimNameTable::size() const {
+  return names.size();
+}
+
+SimTaskId SimTaskStore::add_task(uint8_t _type,
+                                 int _device,
+                                 float _run_time,
+                                 uint32_t _name) {
+  assert(!finalized);
+  SimTaskId id = ready_time.size();
+  ready_time.push_back(0.0f);
+  run_time.push_back(_run_time);
+  type.push_back(_type);
+  device.push_back(_device);
+  name.push_back(_name);
+  counter.push_back(0);
+  return id;
+}
+
+void SimTaskStore::add_dependency(SimTaskId src, SimTaskId dst) {
+  assert(!finalized);
+  assert(src < num_tasks() && dst < num_tasks());
+  staged_edges.push_back(std::make_pair(src, dst));
+  counter[dst]++;
+}
+
+void SimTaskStore::finalize() {
+  assert(!finalized);
+  // Counting sort of the staged edges by source task; successors keep the
+  // order in which the dependencies were added
+  edge_offsets.assign(num_tasks() + 1, 0);
+  for (auto const &e : staged_edges) {
+    edge_offsets[e.first + 1]++;
+  }
+  for (size_t i = 0; i < num_tasks(); i++) {
+    edge_offsets[i + 1] += edge_offsets[i];
+  }
+  edge_targets.resize(staged_edges.size());
+  edge_cursor.assign(edge_offsets.begin(), edge_offsets.end() - 1);
+  for (auto const &e : staged_edges) {
+    edge_targets[edge_cursor[e.first]++] = e.second;
+  }
+  staged_edges.clear();
+  finalized = true;
+}
+
+void SimTaskStore::reset() {
+  ready_time.clear();
+  run_time.clear();
+  type.clear();
+  device.clear();
+  name.clear();
+  counter.clear();
+  edge_offsets.clear();
+  edge_targets.clear();
+  staged_edges.clear();
+  finalized = false;
+}
+
+size_t SimTaskStore::num_tasks() const {
+  return ready_time.size();
+}
+
+size_t SimTaskStore::num_dependencies() const {
+  return finalized ? edge_targets.size() : staged_edges.size();
+}
+
+SimTaskId const *SimTaskStore::successors_begin(SimTaskId task) const {
+  assert(finalized);
+  return edge_targets.data() + edge_offsets[task];
+}
+
+SimTaskId const *SimTaskStore::successors_end(SimTaskId task) const {
+  assert(finalized);
+  return edge_targets.data() + edge_offsets[task + 1];
+}
+
+void add_segmented_transfer(SimTaskStore &tasks,
+                            SimTaskId src,
+                            SimTaskId dst,
+                            std::vector<SimLink> const &path,
+                            size_t message_size,
+                            size_t segment_size,
+                            int max_num_segments,
+                            uint8_t comm_type,
+                            uint32_t name) {
+  if (path.empty()) {
+    tasks.add_dependency(src, dst);
+    return;
+  }
+  assert(message_size > 0 && segment_size > 0 && max_num_segments > 0);
+  size_t seg_size = segment_size;
+  size_t num_segments = (message_size + seg_size - 1) / seg_size;
+  if (num_segments > (size_t)max_num_segments) {
+    num_segments = max_num_segments;
+    seg_size = message_size / num_segments;
+  }
+  // Segment j on hop i is task first + i * num_segments + j
+  SimTaskId first = tasks.num_tasks();
+  for (SimLink const &link : path) {
+    for (size_t j = 0; j < num_segments; j++) {
+      size_t cur_seg_size = j == num_segments - 1
+                                ? message_size - (num_segments - 1) * seg_size
+                                : seg_size;
+      tasks.add_task(comm_type,
+                     link.device,
+                     link.latency + cur_seg_size / link.bandwidth,
+                     name);
+    }
+  }
+  for (size_t i = 0; i < path.size(); i++) {
+    for (size_t j = 0; j < num_segments; j++) {
+      SimTaskId cur = first + i * num_segments + j;
+      if (i == 0) {
+        tasks.add_dependency(src, cur);
+      } else {
+        tasks.add_dependency(cur - num_segments, cur);
+        if (path[i].outbound && j + 1 < num_segments) {
+          tasks.add_dependency(cur, cur - num_segments + 1);
+        }
+      }
+      if (i == path.size() - 1) {
+        tasks.add_dependency(cur, dst);
+      }
+    }
+  }
+}
+
+uint32_t SimEventQueue::to_key(float time) {
+  // The bit patterns of non-negative IEEE floats are ordered like the floats
+  assert(time >= 0.0f);
+  uint32_t key;
+  std::memcpy(&key, &time, sizeof(key));
+  return key;
+}
+
+float SimEventQueue::to_time(uint32_t key) {
+  float time;
+  std::memcpy(&time, &key, sizeof(time));
+  return time;
+}
+
+int SimEventQueue::bucket_index(uint32_t key, uint32_t last) {
+  uint32_t diff = key ^ last;
+  return diff == 0 ? 0 : 32 - __builtin_clz(diff);
+}
+
+void SimEventQueue::push(float time, SimTaskId task) {
+  uint32_t key = to_key(time + 0.0f); // normalize -0.0f
+  assert(key >= last_key && "events must be pushed in monotone order");
+  buckets[bucket_index(key, last_key)].push_back(std::make_pair(key, task));
+  num_events++;
+}
+
+std::pair<float, SimTaskId> SimEventQueue::pop() {
+  assert(num_events > 0);
+  if (buckets[0].empty()) {
+    int i = 1;
+    while (buckets[i].empty()) {
+      i++;
+    }
+    // Move the smallest key forward and redistribute the bucket; every
+    // element lands in a strictly lower bucket
+    uint32_t min_key = buckets[i][0].first;
+    for (auto const &e : buckets[i]) {
+      min_key = std::min(min_key, e.first);
+    }
+    last_key = min_key;
+    for (auto const &e : buckets[i]) {
+      buckets[bucket_index(e.first, last_key)].push_back(e);
+    }
+    buckets[i].clear();
+  }
+  std::pair<uint32_t, SimTaskId> e = buckets[0].back();
+  buckets[0].pop_back();
+  num_events--;
+  return std::make_pair(to_time(e.first), e.second);
+}
+
+bool SimEventQueue::empty() const {
+  return num_events == 0;
+}
+
+size_t SimEventQueue::size() const {
+  return num_events;
+}
+
+void SimEventQueue::clear() {
+  for (auto &bucket : buckets) {
+    bucket.clear();
+  }
+  last_key = 0;
+  num_events = 0;
+}
+
+void EventDrivenSimulator::reset() {
+  tasks.reset();
+  queue.clear();
+  start_time.clear();
+  end_time.clear();
+  schedule.clear();
+}
+
+float EventDrivenSimulator::simulate(int num_devices, bool record_schedule) {
+  size_t num_tasks = tasks.num_tasks();
+  device_times.assign(num_devices, 0.0f);
+  if (record_schedule) {
+    start_time.assign(num_tasks, 0.0f);
+    end_time.assign(num_tasks, 0.0f);
+    schedule.clear();
+    schedule.reserve(num_tasks);
+  }
+  queue.clear();
+  for (SimTaskId i = 0; i < num_tasks; i++) {
+    if (tasks.counter[i] == 0) {
+      queue.push(tasks.ready_time[i], i);
+    }
+  }
+  float sim_time = 0.0f;
+  size_t num_processed = 0;
+  while (!queue.empty()) {
+    SimTaskId cur = queue.pop().second;
+    int device = tasks.device[cur];
+    assert(device >= 0 && device < num_devices);
+    float start = std::max(device_times[device], tasks.ready_time[cur]);
+    float end = start + tasks.run_time[cur];
+    device_times[device] = end;
+    if (record_schedule) {
+      start_time[cur] = start;
+      end_time[cur] = end;
+      schedule.push_back(cur);
+    }
+    sim_time = std::max(sim_time, end);
+    for (SimTaskId const *next = tasks.successors_begin(cur);
+         next != tasks.successors_end(cur);
+         next++) {
+      tasks.ready_time[*next] = std::max(tasks.ready_time[*next], end);
+      if (--tasks.counter[*next] == 0) {
+        queue.push(tasks.ready_time[*next], *next);
+      }
+    }
+    num_processed++;
+  }
+  // A cycle in the task graph would leave tasks unprocessed
+  assert(num_processed == num_tasks);
+  return sim_time;
+}
+
+}; // namespace FlexFlow
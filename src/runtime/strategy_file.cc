@@ -0,0 +1,311 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/strategy_file.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <tuple>
+#include <unistd.h>
+
+namespace FlexFlow {
+
+namespace {
+
+char const MAGIC[8] = {'F', 'F', 'S', 'T', 'R', 'A', 'T', '\n'};
+
+class Writer {
+public:
+  template <typename T>
+  void put(T const &value) {
+    put_bytes(&value, sizeof(T));
+  }
+  void put_bytes(void const *data, size_t size) {
+    char const *bytes = static_cast<char const *>(data);
+    buffer.insert(buffer.end(), bytes, bytes + size);
+  }
+  std::vector<char> buffer;
+};
+
+class Reader {
+public:
+  Reader(char const *_data, size_t _size) : data(_data), size(_size) {}
+  template <typename T>
+  bool get(T &value) {
+    return get_bytes(&value, sizeof(T));
+  }
+  bool get_bytes(void *out, size_t bytes) {
+    if (bytes > size - offset) {
+      return false;
+    }
+    memcpy(out, data + offset, bytes);
+    offset += bytes;
+    return true;
+  }
+  // Checks a count read from the file before allocating for it
+  bool fits(uint64_t count, size_t element_size) const {
+    return count <= (size - offset) / element_size;
+  }
+
+private:
+  char const *data;
+  size_t size;
+  size_t offset = 0;
+};
+
+bool read_string(Reader &reader, std::string &value) {
+  uint64_t length;
+  if (!reader.get(length) || !reader.fits(length, 1)) {
+    return false;
+  }
+  value.resize(length);
+  return reader.get_bytes(&value[0], length);
+}
+
+std::string describe(StrategyLayerKey const &key) {
+  return key.name + " (op type " + std::to_string(key.op_type) + ")";
+}
+
+} // namespace
+
+void StableHasher::update(void const *data, size_t size) {
+  unsigned char const *bytes = static_cast<unsigned char const *>(data);
+  for (size_t i = 0; i < size; i++) {
+    state ^= bytes[i];
+    state *= 0x100000001b3ULL;
+  }
+}
+
+void StableHasher::update(std::string const &value) {
+  update(static_cast<uint64_t>(value.size()));
+  update(value.data(), value.size());
+}
+
+void StableHasher::update_file(std::string const &filename) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file) {
+    update(filename);
+    return;
+  }
+  char buffer[4096];
+  while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
+    update(buffer, static_cast<size_t>(file.gcount()));
+  }
+}
+
+uint64_t StableHasher::digest() const {
+  return state;
+}
+
+bool StrategyLayerKey::operator==(StrategyLayerKey const &other) const {
+  return op_type == other.op_type && params_hash == other.params_hash &&
+         name == other.name;
+}
+
+bool write_strategy_file(std::string const &filename,
+                         StrategyFile const &strategy) {
+  Writer writer;
+  uint32_t version = StrategyFile::VERSION;
+  writer.put(version);
+  writer.put(strategy.num_nodes);
+  writer.put(strategy.gpus_per_node);
+  writer.put(strategy.cpus_per_node);
+  writer.put(strategy.computation_mode);
+  writer.put(strategy.model_id);
+  writer.put(static_cast<uint64_t>(strategy.layers.size()));
+  for (StrategyLayer const &layer : strategy.layers) {
+    writer.put(layer.key.op_type);
+    writer.put(layer.key.params_hash);
+    writer.put(static_cast<uint64_t>(layer.key.name.size()));
+    writer.put_bytes(layer.key.name.data(), layer.key.name.size());
+    writer.put(layer.layer_guid);
+    writer.put(static_cast<uint64_t>(layer.output_guids.size()));
+    for (uint64_t guid : layer.output_guids) {
+      writer.put(guid);
+    }
+  }
+  writer.put(static_cast<uint64_t>(strategy.pcg.size()));
+  writer.put_bytes(strategy.pcg.data(), strategy.pcg.size());
+  StableHasher checksum;
+  checksum.update(writer.buffer.data(), writer.buffer.size());
+  writer.put(checksum.digest());
+
+  std::string tmp_filename = filename + ".tmp." + std::to_string(getpid());
+  {
+    std::ofstream file(tmp_filename, std::ios::binary | std::ios::trunc);
+    file.write(MAGIC, sizeof(MAGIC));
+    file.write(writer.buffer.data(), writer.buffer.size());
+    if (!file.flush()) {
+      std::remove(tmp_filename.c_str());
+      return false;
+    }
+  }
+  if (std::rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+    std::remove(tmp_filename.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool read_strategy_file(std::string const &filename,
+                        StrategyFile &strategy,
+                        std::string &error) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file) {
+    error = "cannot open " + filename;
+    return false;
+  }
+  std::vector<char> contents((std::istreambuf_iterator<char>(file)),
+                             std::istreambuf_iterator<char>());
+  uint64_t stored_checksum;
+  if (contents.size() < sizeof(MAGIC) + sizeof(stored_checksum) ||
+      memcmp(contents.data(), MAGIC, sizeof(MAGIC)) != 0) {
+    error = filename + " is not a FlexFlow strategy file";
+    return false;
+  }
+  char const *body = contents.data() + sizeof(MAGIC);
+  size_t body_size =
+      contents.size() - sizeof(MAGIC) - sizeof(stored_checksum);
+  Reader reader(body, body_size);
+  uint32_t version = 0;
+  if (!reader.get(version) || version != StrategyFile::VERSION) {
+    error = filename + " has strategy format version " +
+            std::to_string(version) + ", expected " +
+            std::to_string(StrategyFile::VERSION);
+    return false;
+  }
+  memcpy(&stored_checksum, body + body_size, sizeof(stored_checksum));
+  StableHasher checksum;
+  checksum.update(body, body_size);
+  if (checksum.digest() != stored_checksum) {
+    error = filename + " is corrupt (checksum mismatch)";
+    return false;
+  }
+
+  StrategyFile result;
+  uint64_t num_layers, pcg_size;
+  bool ok = reader.get(result.num_nodes) &&
+            reader.get(result.gpus_per_node) &&
+            reader.get(result.cpus_per_node) &&
+            reader.get(result.computation_mode) &&
+            reader.get(result.model_id) && reader.get(num_layers) &&
+            reader.fits(num_layers, sizeof(uint64_t));
+  for (uint64_t i = 0; ok && i < num_layers; i++) {
+    StrategyLayer layer;
+    uint64_t num_outputs;
+    ok = reader.get(layer.key.op_type) && reader.get(layer.key.params_hash) &&
+         read_string(reader, layer.key.name) && reader.get(layer.layer_guid) &&
+         reader.get(num_outputs) && reader.fits(num_outputs, sizeof(uint64_t));
+    if (ok) {
+      layer.output_guids.resize(num_outputs);
+      for (uint64_t &guid : layer.output_guids) {
+        ok = ok && reader.get(guid);
+      }
+      result.layers.push_back(std::move(layer));
+    }
+  }
+  ok = ok && reader.get(pcg_size) && reader.fits(pcg_size, 1);
+  if (ok) {
+    result.pcg.resize(pcg_size);
+    ok = reader.get_bytes(result.pcg.data(), pcg_size);
+  }
+  if (!ok) {
+    error = filename + " is truncated";
+    return false;
+  }
+  strategy = std::move(result);
+  return true;
+}
+
+std::string validate_strategy(StrategyFile const &strategy,
+                              StrategyFile const &model,
+                              StrategyGuidMap &guid_map) {
+  if (strategy.num_nodes != model.num_nodes ||
+      strategy.gpus_per_node != model.gpus_per_node ||
+      strategy.cpus_per_node != model.cpus_per_node) {
+    return "the strategy was searched for " +
+           std::to_string(strategy.num_nodes) + " nodes with " +
+           std::to_string(strategy.gpus_per_node) + " GPUs and " +
+           std::to_string(strategy.cpus_per_node) + " CPUs each, not " +
+           std::to_string(model.num_nodes) + " nodes with " +
+           std::to_string(model.gpus_per_node) + " GPUs and " +
+           std::to_string(model.cpus_per_node) + " CPUs each";
+  }
+  if (strategy.computation_mode != model.computation_mode) {
+    return "the strategy was searched for another computation mode";
+  }
+  // Candidates are kept in the order the layers were created in
+  std::map<std::tuple<int, uint64_t, std::string>, std::vector<size_t>>
+      unmatched;
+  for (size_t i = 0; i < strategy.layers.size(); i++) {
+    StrategyLayerKey const &key = strategy.layers[i].key;
+    unmatched[std::make_tuple(key.op_type, key.params_hash, key.name)]
+        .push_back(i);
+  }
+  StrategyGuidMap result;
+  result.model_id = model.model_id;
+  for (StrategyLayer const &layer : model.layers) {
+    auto it = unmatched.find(std::make_tuple(
+        layer.key.op_type, layer.key.params_hash, layer.key.name));
+    if (it == unmatched.end() || it->second.empty()) {
+      return "layer " + describe(layer.key) +
+             " of the model is not in the strategy";
+    }
+    std::vector<size_t> &candidates = it->second;
+    auto match = std::find_if(
+        candidates.begin(), candidates.end(), [&](size_t idx) {
+          StrategyLayer const &stored = strategy.layers[idx];
+          return stored.layer_guid == layer.layer_guid &&
+                 stored.output_guids == layer.output_guids;
+        });
+    if (match == candidates.end()) {
+      match = candidates.begin();
+    }
+    StrategyLayer const &stored = strategy.layers[*match];
+    if (stored.output_guids.size() != layer.output_guids.size()) {
+      return "layer " + describe(layer.key) + " has " +
+             std::to_string(layer.output_guids.size()) + " outputs, not " +
+             std::to_string(stored.output_guids.size());
+    }
+    result.layer_guids[stored.layer_guid] = layer.layer_guid;
+    for (size_t i = 0; i < layer.output_guids.size(); i++) {
+      result.tensor_guids[stored.output_guids[i]] = layer.output_guids[i];
+    }
+    candidates.erase(match);
+  }
+  for (auto const &it : unmatched) {
+    if (!it.second.empty()) {
+      return "layer " + describe(strategy.layers[it.second.back()].key) +
+             " of the strategy is not in the model";
+    }
+  }
+  guid_map = std::move(result);
+  return "";
+}
+
+std::string get_cached_strategy_path(std::string const &cache_dir,
+                                     uint64_t fingerprint) {
+  char name[32];
+  snprintf(name,
+           sizeof(name),
+           "%016llx.strategy",
+           static_cast<unsigned long long>(fingerprint));
+  return cache_dir + "/" + name;
+}
+
+}; // namespace FlexFlow
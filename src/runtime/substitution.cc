@@ -48,7 +48,9 @@
 #include "flexflow/parallel_ops/replicate.h"
 #include "flexflow/utils/dot/dot_file.h"
 #include <chrono>
+#include <condition_variable>
 #include <iomanip>
+#include <mutex>
 
 namespace FlexFlow::PCG {
 
@@ -1731,7 +1733,7 @@ std::vector<GraphXfer *> create_xfers(FFModel *model,
 GraphSearchHelper::GraphSearchHelper(FFModel *model)
     : model(model), config(model->config), mem_config(1.0) {
   this->logger = std::unique_ptr<RecursiveLogger>(new RecursiveLogger("gs"));
-  generate_all_pcg_xfers();
+  generate_all_pcg_xfers(this->all_pcg_xfers);
 }
 
 void GraphSearchHelper::clear_cache() {
@@ -1743,7 +1745,8 @@ void GraphSearchHelper::load_graph_substitutions(
   xfers = all_pcg_xfers;
 }
 
-void GraphSearchHelper::generate_all_pcg_xfers() {
+void GraphSearchHelper::generate_all_pcg_xfers(
+    std::vector<GraphXfer *> &xfers) const {
   std::vector<int> all_parallel_degrees, single_node_parallel_degrees;
   auto const &config = this->model->config;
   int workersPerNode =
@@ -1773,19 +1776,19 @@ void GraphSearchHelper::generate_all_pcg_xfers() {
   }
 
   for (auto const &it : single_node_parallel_degrees) {
-    all_pcg_xfers.push_back(create_replicate_linear_combine(
+    xfers.push_back(create_replicate_linear_combine(
         this->model, 3, it, AC_MODE_RELU, false));
-    all_pcg_xfers.push_back(create_replicate_linear_combine(
+    xfers.push_back(create_replicate_linear_combine(
         this->model, 3, it, AC_MODE_SIGMOID, false));
-    all_pcg_xfers.push_back(create_replicate_linear_combine(
+    xfers.push_back(create_replicate_linear_combine(
         this->model, 3, it, AC_MODE_NONE, false));
     if (16 % it == 0) {
-      all_pcg_xfers.push_back(
+      xfers.push_back(
           create_replicate_attention_reduce(this->model, 16 /*num_heads*/, it));
     }
   }
   for (auto const &it : all_parallel_degrees) {
-    all_pcg_xfers.push_back(
+    xfers.push_back(
         create_partition_attention_combine(this->model, 16 /*num_heads*/, it));
   }
 
@@ -1799,66 +1802,63 @@ void GraphSearchHelper::generate_all_pcg_xfers() {
     sl::RuleCollection rule_collection = sl::load_rule_collection_from_path(
         config.substitution_json_path.value());
     for (int degree : considered_parallel_degrees) {
-      std::vector<GraphXfer *> xfers =
+      std::vector<GraphXfer *> rule_xfers =
           create_xfers(this->model, rule_collection, degree);
-      all_pcg_xfers.insert(all_pcg_xfers.end(), xfers.begin(), xfers.end());
+      xfers.insert(xfers.end(), rule_xfers.begin(), rule_xfers.end());
     }
   } else {
     // Manual substitutions
     for (int num_dims = 3; num_dims <= 4; num_dims++) {
-      all_pcg_xfers.push_back(
-          create_linear_relu_merge(this->model, num_dims, true));
-      all_pcg_xfers.push_back(
-          create_linear_relu_merge(this->model, num_dims, false));
+      xfers.push_back(create_linear_relu_merge(this->model, num_dims, true));
+      xfers.push_back(create_linear_relu_merge(this->model, num_dims, false));
     }
     for (int const degree : all_parallel_degrees) {
-      create_mapping_xfers<Conv2D>(this->model, degree, all_pcg_xfers);
-      create_mapping_xfers<Pool2D>(this->model, degree, all_pcg_xfers);
-      create_mapping_xfers<Flat>(this->model, degree, all_pcg_xfers);
+      create_mapping_xfers<Conv2D>(this->model, degree, xfers);
+      create_mapping_xfers<Pool2D>(this->model, degree, xfers);
+      create_mapping_xfers<Flat>(this->model, degree, xfers);
     }
     for (auto const &it : all_parallel_degrees) {
       // rewrites for the inception model
       for (int i = 3; i <= 6; i++) {
-        all_pcg_xfers.push_back(create_combine_inception(
+        xfers.push_back(create_combine_inception(
             this->model, i - 1 /*num_convs*/, 5 /*num_dims*/, it));
-        all_pcg_xfers.push_back(create_combine_concat(
+        xfers.push_back(create_combine_concat(
             this->model, i /*num_inputs*/, 5 /*num_dims*/, it));
       }
-      // all_pcg_xfers.push_back(create_partition_conv2d_combine(this->model,
+      // xfers.push_back(create_partition_conv2d_combine(this->model,
       // 5/*num_dims*/, it));
-      all_pcg_xfers.push_back(create_partition_linear_combine(
+      xfers.push_back(create_partition_linear_combine(
           this->model, 3 /*num_dims*/, it, AC_MODE_RELU, false));
-      all_pcg_xfers.push_back(create_partition_linear_combine(
+      xfers.push_back(create_partition_linear_combine(
           this->model, 3 /*num_dims*/, it, AC_MODE_SIGMOID, false));
-      all_pcg_xfers.push_back(create_partition_linear_combine(
+      xfers.push_back(create_partition_linear_combine(
           this->model, 3 /*num_dims*/, it, AC_MODE_NONE, false));
-      all_pcg_xfers.push_back(create_partition_linear_combine(
+      xfers.push_back(create_partition_linear_combine(
           this->model, 4 /*num_dims*/, it, AC_MODE_RELU, false));
-      all_pcg_xfers.push_back(create_partition_linear_combine(
+      xfers.push_back(create_partition_linear_combine(
           this->model, 4 /*num_dims*/, it, AC_MODE_SIGMOID, false));
-      all_pcg_xfers.push_back(create_partition_linear_combine(
+      xfers.push_back(create_partition_linear_combine(
           this->model, 4 /*num_dims*/, it, AC_MODE_NONE, false));
-      all_pcg_xfers.push_back(create_partition_add_combine(
+      xfers.push_back(create_partition_add_combine(
           this->model, 1 /*parallel_dims*/, it /*num_parts*/));
-      all_pcg_xfers.push_back(create_partition_add_combine(
+      xfers.push_back(create_partition_add_combine(
           this->model, 2 /*parallel_dims*/, it /*num_parts*/));
-      all_pcg_xfers.push_back(create_partition_add_combine(
+      xfers.push_back(create_partition_add_combine(
           this->model, 3 /*parallel_dims*/, it /*num_parts*/));
-      all_pcg_xfers.push_back(create_partition_add_combine(
+      xfers.push_back(create_partition_add_combine(
           this->model, 4 /*parallel_dims*/, it /*num_parts*/));
-      all_pcg_xfers.push_back(create_partition_relu_combine(
+      xfers.push_back(create_partition_relu_combine(
           this->model, 3 /*parallel_dims*/, it /*num_parts*/));
-      all_pcg_xfers.push_back(create_partition_relu_combine(
+      xfers.push_back(create_partition_relu_combine(
           this->model, 4 /*parallel_dims*/, it /*num_parts*/));
-      all_pcg_xfers.push_back(
-          create_partition_softmax_combine(this->model,
-                                           0 /*softmax_dim*/,
-                                           1 /*parallel_dims*/,
-                                           it /*num_parts*/));
+      xfers.push_back(create_partition_softmax_combine(this->model,
+                                                       0 /*softmax_dim*/,
+                                                       1 /*parallel_dims*/,
+                                                       it /*num_parts*/));
       for (int num_combines = 1; num_combines < 5; num_combines++) {
-        all_pcg_xfers.push_back(leading_relu_branch_combine(
+        xfers.push_back(leading_relu_branch_combine(
             this->model, 3 /*parallel_dim*/, it /*num_parts*/, num_combines));
-        all_pcg_xfers.push_back(leading_relu_branch_partition(
+        xfers.push_back(leading_relu_branch_partition(
             this->model, 3 /*parallel_dim*/, it /*num_parts*/, num_combines));
       }
       {
@@ -1869,18 +1869,16 @@ void GraphSearchHelper::generate_all_pcg_xfers() {
           }
         }
         for (auto const &it2 : concat_num_inputs) {
-          all_pcg_xfers.push_back(
-              create_partition_concat_combine(this->model,
-                                              it2 /*num_inputs*/,
-                                              0 /*concat_dim*/,
-                                              1 /*parallel_dims*/,
-                                              it /*num_parts*/));
-          all_pcg_xfers.push_back(
-              create_partition_concat_combine(this->model,
-                                              it2 /*num_inputs*/,
-                                              2 /*concat_dim*/,
-                                              3 /*parallel_dims*/,
-                                              it /*num_parts*/));
+          xfers.push_back(create_partition_concat_combine(this->model,
+                                                          it2 /*num_inputs*/,
+                                                          0 /*concat_dim*/,
+                                                          1 /*parallel_dims*/,
+                                                          it /*num_parts*/));
+          xfers.push_back(create_partition_concat_combine(this->model,
+                                                          it2 /*num_inputs*/,
+                                                          2 /*concat_dim*/,
+                                                          3 /*parallel_dims*/,
+                                                          it /*num_parts*/));
         }
       }
     }
@@ -1941,6 +1939,12 @@ void GraphSearchHelper::graph_optimize(
   this->logger->debug() << "Total cache size: "
                         << this->cached_optimized_graphs.size();
   std::cout << "Optimal cost: " << optimal.cost << std::endl;
+  if (this->config.pipeline_stages != 1) {
+    fprintf(stderr,
+            "[Warning] Pipeline stages are only searched when no strategy "
+            "fits in memory, ignoring --pipeline-stages without "
+            "--memory-search\n");
+  }
   SimplificationSettings settings;
   settings.fuse_parallel_ops = true;
   settings.remove_noops = true;
@@ -1964,6 +1968,257 @@ void GraphSearchHelper::graph_optimize(
   optimal_views = real_optimal_views;
 }
 
+/**
+ * @brief Split a graph into the ordered chain of segments obtained by
+ * repeatedly splitting at the bottlenecks found by find_split_node.
+ */
+void GraphSearchHelper::split_sequence(
+    std::unique_ptr<Graph> graph,
+    Node const &sink_node,
+    tl::optional<ParallelTensorShape> const &input_shape,
+    tl::optional<ParallelTensorShape> const &output_shape,
+    std::vector<SequenceSegment> &segments) const {
+  tl::optional<Node> bottleneck =
+      this->find_split_node(graph.get(), this->config.base_optimize_threshold);
+  if (!bottleneck.has_value()) {
+    segments.push_back(SequenceSegment{
+        std::move(graph), sink_node, input_shape, output_shape});
+    return;
+  }
+  std::unique_ptr<Graph> pre_graph, post_graph;
+  std::tie(pre_graph, post_graph) = graph->split_at_node(bottleneck.value());
+  // Keep the boundary tensor in its default shape; the stages are optimized
+  // on disjoint devices so the boundary needs a transfer anyway
+  ParallelTensorShape boundary_shape =
+      bottleneck.value().ptr->outputs[0]->get_shape();
+  this->split_sequence(std::move(pre_graph),
+                       bottleneck.value(),
+                       input_shape,
+                       boundary_shape,
+                       segments);
+  this->split_sequence(
+      std::move(post_graph), sink_node, boundary_shape, output_shape, segments);
+}
+
+/**
+ * @brief Search pipeline-parallel strategies.
+ *
+ * @details The segments of the sequence split are optimized on the resources
+ * of a single stage, assigned to contiguous stages by a memory-aware balancing
+ * DP and costed under a 1F1B or GPipe schedule (see pipeline.h). Stages
+ * either span whole nodes or, on a single node, an equal share of its GPUs.
+ * Iterations are not split into micro-batches at runtime, so plans are costed
+ * with a single micro-batch, i.e. with the stages running one after another.
+ * Such a plan is never faster than using every device for every operator, but
+ * each device only holds the weights of its own stage.
+ *
+ * @param[in] memory_capacity Per-device memory every stage has to fit in
+ * @param[out] plan The fastest pipeline plan that fits
+ * @param[out] result The stitched graph with the views of every stage moved to
+ * the devices of that stage
+ * @return true if some plan fits in memory_capacity
+ */
+bool GraphSearchHelper::pipeline_optimize(Graph const *graph,
+                                          Node const &sink_node,
+                                          size_t memory_capacity,
+                                          PipelinePlan &plan,
+                                          GraphOptimizeResult &result) {
+  TAG_ENTER(this->logger);
+  std::vector<SequenceSegment> segments;
+  this->split_sequence(std::unique_ptr<Graph>(new Graph(*graph)),
+                       sink_node,
+                       tl::nullopt,
+                       tl::nullopt,
+                       segments);
+  this->logger->debug() << "Pipeline search over " << segments.size()
+                        << " segments";
+
+  // Segments are optimized on the resources of one stage. The graph search
+  // caches are keyed without the resources, so they are flushed whenever the
+  // machine size changes, and the full machine is restored however this
+  // function returns.
+  struct MachineSizeGuard {
+    FFModel *model;
+    int const num_nodes, gpus_per_node;
+    bool resized = false;
+    void resize(int stage_nodes, int stage_gpus_per_node) {
+      this->model->config.numNodes = stage_nodes;
+      this->model->config.workersPerNode = stage_gpus_per_node;
+      this->model->clear_graph_search_cache();
+      this->resized = true;
+    }
+    ~MachineSizeGuard() {
+      if (this->resized) {
+        this->resize(this->num_nodes, this->gpus_per_node);
+      }
+    }
+  } machine_size{this->model,
+                 this->model->config.numNodes,
+                 this->model->config.workersPerNode};
+  int const num_nodes = machine_size.num_nodes;
+  int const gpus_per_node = machine_size.gpus_per_node;
+  std::vector<int> stage_candidates;
+  if (this->config.pipeline_stages > 1) {
+    stage_candidates.push_back(this->config.pipeline_stages);
+  } else {
+    for (int s = 2; s <= (int)segments.size(); s++) {
+      stage_candidates.push_back(s);
+    }
+  }
+  // The runtime runs every iteration as a single batch, so the stages are
+  // costed sequentially (one micro-batch) until it can split iterations
+  std::vector<int> micro_batch_candidates = {1};
+  if (this->config.pipeline_micro_batches > 1) {
+    fprintf(stderr,
+            "[Warning] Micro-batched pipeline execution is not supported, "
+            "costing %d micro-batches as 1\n",
+            this->config.pipeline_micro_batches);
+  }
+  std::vector<PipelineSchedule> schedules;
+  if (this->config.pipeline_schedule.has_value()) {
+    schedules.push_back(this->config.pipeline_schedule.value());
+  } else {
+    schedules = {PIPELINE_SCHEDULE_1F1B, PIPELINE_SCHEDULE_GPIPE};
+  }
+  bool training = this->config.computationMode == COMP_MODE_TRAINING;
+  MachineModel *machine = this->model->simulator->machine;
+
+  float best_cost = std::numeric_limits<float>::infinity();
+  std::vector<GraphOptimizeResult> best_results;
+  int best_stage_gpus = 0;
+  for (int num_stages : stage_candidates) {
+    int stage_nodes, stage_gpus_per_node;
+    float bandwidth;
+    if (num_nodes % num_stages == 0) {
+      stage_nodes = num_nodes / num_stages;
+      stage_gpus_per_node = gpus_per_node;
+      bandwidth = machine->get_inter_node_gpu_bandwidth();
+    } else if (num_nodes == 1 && gpus_per_node % num_stages == 0) {
+      stage_nodes = 1;
+      stage_gpus_per_node = gpus_per_node / num_stages;
+      bandwidth = machine->get_intra_node_gpu_bandwidth();
+    } else {
+      if (this->config.pipeline_stages > 1) {
+        fprintf(stderr,
+                "[Warning] Cannot split %d nodes with %d GPUs each into %d "
+                "pipeline stages\n",
+                num_nodes,
+                gpus_per_node,
+                num_stages);
+      }
+      continue;
+    }
+    if (num_stages > (int)segments.size()) {
+      fprintf(stderr,
+              "[Warning] The graph only has %zu sequence segments, cannot "
+              "build %d pipeline stages\n",
+              segments.size(),
+              num_stages);
+      continue;
+    }
+
+    machine_size.resize(stage_nodes, stage_gpus_per_node);
+    std::vector<GraphOptimizeResult> segment_results;
+    std::vector<PipelineSegmentCost> segment_costs;
+    for (SequenceSegment const &segment : segments) {
+      GraphOptimizeResult r =
+          this->generic_sequence_optimize<GraphOptimizeResult>(
+              segment.graph.get(),
+              segment.sink_node,
+              segment.output_shape,
+              segment.input_shape);
+      if (!r.graph.has_value()) {
+        break;
+      }
+      PipelineSegmentCost cost;
+      for (auto const &kv : r.views) {
+        CostMetrics metrics =
+            this->model->simulator->measure_operator_cost(kv.first.ptr,
+                                                          kv.second);
+        cost.forward_time += metrics.forward_time;
+        cost.backward_time += metrics.backward_time + metrics.sync_time;
+        cost.weights_memory += metrics.weights_memory;
+        cost.activation_memory += metrics.outputs_memory;
+      }
+      // Keep the intra-segment transfers of the search cost by scaling the
+      // operator times to the optimized cost of the segment
+      float op_time = cost.forward_time + (training ? cost.backward_time : 0);
+      if (op_time > 0) {
+        cost.forward_time *= r.cost / op_time;
+        cost.backward_time *= r.cost / op_time;
+      }
+      if (segment.output_shape.has_value()) {
+        cost.boundary_bytes = segment.output_shape.value().get_piece_size();
+      }
+      segment_results.push_back(r);
+      segment_costs.push_back(cost);
+    }
+    if (segment_results.size() != segments.size()) {
+      continue;
+    }
+
+    PipelinePlan current = plan_pipeline(segment_costs,
+                                         num_stages,
+                                         micro_batch_candidates,
+                                         schedules,
+                                         bandwidth,
+                                         memory_capacity,
+                                         training);
+    this->logger->debug() << "Pipeline with " << num_stages
+                          << " stages has cost: " << current.cost;
+    if (current.is_valid() && current.cost < best_cost) {
+      best_cost = current.cost;
+      plan = current;
+      best_results = segment_results;
+      best_stage_gpus = stage_nodes * stage_gpus_per_node;
+    }
+  }
+  if (best_results.empty()) {
+    return false;
+  }
+
+  // Move each stage onto its own devices and stitch the segments together
+  for (int k = 0; k < plan.num_stages; k++) {
+    for (int i = plan.stages[k].first_segment; i <= plan.stages[k].last_segment;
+         i++) {
+      for (auto &kv : best_results[i].views) {
+        if (kv.second.device_type == MachineView::GPU) {
+          kv.second.start_device_id += k * best_stage_gpus;
+        }
+      }
+      if (i == 0) {
+        result = best_results[i];
+      } else {
+        result = sequence_cost<GraphOptimizeResult>(result, best_results[i]);
+      }
+    }
+  }
+  result.cost = plan.cost;
+  return true;
+}
+
+/**
+ * @brief Largest memory (in MB) that the operators placed on any one device
+ * take under the given views.
+ */
+static float
+    max_per_device_memory(Simulator *simulator,
+                          std::unordered_map<Node, MachineView> const &views) {
+  std::unordered_map<int, float> device_to_mem;
+  for (auto const &kv : views) {
+    CostMetrics op_cost =
+        simulator->measure_operator_cost(kv.first.ptr, kv.second);
+    for (int d : kv.second.device_ids()) {
+      device_to_mem[d] += op_cost.total_memory_in_mb();
+    }
+  }
+  float max_mem = 0.0f;
+  for (auto const &kv : device_to_mem) {
+    max_mem = std::max(max_mem, kv.second);
+  }
+  return max_mem;
+}
+
 /**
  * @brief Experimental DP algorithm to optimize PCG with the consideration of
  * memory usage. This is to avoid polluting the current Unity search algorithm
@@ -2036,8 +2291,81 @@ void GraphSearchHelper::graph_optimize_with_memory(
   best_graph->simplify(settings);
 
   // Get the real optimal machine views.
-  std::unordered_map<Node, MachineView> duplicated_optimal_views =
-      best_graph->optimal_views();
+  std::unordered_map<Node, MachineView> duplicated_optimal_views;
+  bool fits_in_memory = true;
+  float memory_limit = this->model->config.device_mem;
+  if (this->mem_config.mem_search_algo == MemorySearchAlgo::CONSTRAINED) {
+    memory_limit = this->mem_config.per_device_memory_limit;
+    // Pick the fastest strategy of the whole graph that fits on every device
+    GraphCostFrontier frontier = best_graph->optimal_cost_frontier();
+    this->logger->debug() << "Frontier of the optimized graph: " << frontier;
+    GraphCostResultWithMemory fastest =
+        frontier.fastest_within(this->mem_config.per_device_memory_limit);
+    if (fastest.cost == std::numeric_limits<float>::infinity()) {
+      fprintf(stderr,
+              "[Warning] No strategy fits in %.1f MB per device, using the "
+              "one with the least memory\n",
+              this->mem_config.per_device_memory_limit);
+      fits_in_memory = false;
+      assert(!frontier.points.empty());
+      fastest = frontier.points.back();
+    }
+    search_result.run_time_cost = fastest.cost;
+    search_result.max_per_device_mem_all_deivces = fastest.mem_cost.num;
+    duplicated_optimal_views = fastest.views;
+  } else {
+    duplicated_optimal_views = best_graph->optimal_views();
+    // Only the last lambda of the multi-objective search, which minimizes
+    // memory alone, falls back to pipelining
+    if (this->mem_config.run_time_cost_factor == 0 &&
+        this->config.pipeline_stages != 1) {
+      fits_in_memory =
+          max_per_device_memory(this->model->simulator,
+                                duplicated_optimal_views) < memory_limit;
+    }
+  }
+
+  // Pipelining is costed with a single micro-batch, so it never beats the
+  // strategies above on run time. It is the fallback for models that do not
+  // fit in memory otherwise, since each stage only holds its own weights.
+  std::unordered_map<Node, MachineView> printed_views = optimal.views;
+  PipelinePlan plan;
+  GraphOptimizeResult pipelined;
+  if (!fits_in_memory && this->config.pipeline_stages != 1 &&
+      this->pipeline_optimize(graph,
+                              sink_node,
+                              (size_t)(memory_limit * 1024 * 1024),
+                              plan,
+                              pipelined)) {
+    std::cout << "Optimal pipeline cost: " << plan.cost << " ("
+              << plan.num_stages << " stages, "
+              << (plan.schedule == PIPELINE_SCHEDULE_GPIPE ? "GPipe" : "1F1B")
+              << ")" << std::endl;
+    size_t max_stage_memory = 0;
+    for (int k = 0; k < plan.num_stages; k++) {
+      std::cout << "  stage " << k << ": segments ["
+                << plan.stages[k].first_segment << ", "
+                << plan.stages[k].last_segment << "], "
+                << plan.stage_memory[k] / (1024 * 1024) << " MB" << std::endl;
+      max_stage_memory = std::max(max_stage_memory, plan.stage_memory[k]);
+    }
+    search_result.run_time_cost = plan.cost;
+    search_result.max_per_device_mem_all_deivces =
+        (float)max_stage_memory / (1024 * 1024);
+    // Rewriting parallel ops or re-deriving the views would pull the stages
+    // back onto the same devices, so only the placeholders are removed
+    best_graph = std::unique_ptr<Graph>(new Graph(pipelined.graph.value()));
+    SimplificationSettings pipeline_settings;
+    pipeline_settings.remove_noops = true;
+    best_graph->simplify(pipeline_settings);
+    duplicated_optimal_views.clear();
+    for (auto const &kv : pipelined.views) {
+      if (best_graph->inEdges.find(kv.first) != best_graph->inEdges.end()) {
+        duplicated_optimal_views.insert(kv);
+      }
+    }
+    printed_views = pipelined.views;
+  }
   std::unordered_map<Node, Node> deduplication_map =
       best_graph->deduplicate_input_nodes();
   std::unordered_map<Node, MachineView> real_optimal_views;
@@ -2049,7 +2377,7 @@ void GraphSearchHelper::graph_optimize_with_memory(
     }
   }
   std::cout << "Dot graph of searched strategy:" << std::endl;
-  best_graph->print_strategy_computation_graph(optimal.views);
+  best_graph->print_strategy_computation_graph(printed_views);
   std::cout << std::endl;
 
   optimal_views = real_optimal_views;
@@ -2249,6 +2577,9 @@ tl::optional<Node>
 std::unique_ptr<Graph> GraphSearchHelper::base_optimize(
     Graph const *r_graph,
     SimplificationSettings const &simplification_settings) {
+  if (this->config.search_threads > 1) {
+    return this->parallel_base_optimize(r_graph, simplification_settings);
+  }
   // Construct graph substitutions
   TAG_ENTER(this->logger);
 
@@ -2330,6 +2661,149 @@ std::unique_ptr<Graph> GraphSearchHelper::base_optimize(
   return std::unique_ptr<Graph>(best_graph);
 }
 
+/**
+ * @brief base_optimize with the candidates expanded by config.search_threads
+ * threads.
+ *
+ * @details The threads share the queue of candidates, the hashes of the
+ * graphs seen so far, the budget and the best graph, so each of them prunes
+ * with the best cost found by any of them. A thread pops the cheapest
+ * candidate, matches its own copy of the xfers against it without holding
+ * the lock, and then merges the new graphs into the shared queue. The cost
+ * of graphs is shared through the caches of SearchHelper and Simulator.
+ * Since the threads race for candidates, the order of exploration (and, when
+ * the budget runs out, the result) can differ between runs.
+ *
+ * @param r_graph Graph to be optimized
+ * @param simplification_settings Settings to simplify the PCG
+ * @return std::unique_ptr<Graph> Optimized PCG
+ */
+std::unique_ptr<Graph> GraphSearchHelper::parallel_base_optimize(
+    Graph const *r_graph,
+    SimplificationSettings const &simplification_settings) {
+  TAG_ENTER(this->logger);
+  int const num_threads = this->config.search_threads;
+  this->logger->debug() << "Optimizing base graph with " << num_threads
+                        << " threads, starting cost: "
+                        << r_graph->optimal_cost();
+
+  if (this->thread_pcg_xfers.empty()) {
+    this->thread_pcg_xfers.push_back(this->all_pcg_xfers);
+  }
+  while ((int)this->thread_pcg_xfers.size() < num_threads) {
+    this->thread_pcg_xfers.emplace_back();
+    this->generate_all_pcg_xfers(this->thread_pcg_xfers.back());
+  }
+
+  // Candidates carry their cost, so that the queue does not recompute it
+  using Candidate = std::pair<float, Graph *>;
+  auto more_costly = [](Candidate const &lhs, Candidate const &rhs) {
+    return lhs.first > rhs.first;
+  };
+  std::priority_queue<Candidate, std::vector<Candidate>, decltype(more_costly)>
+      candidates(more_costly);
+  std::unordered_set<size_t> hashmap;
+  Graph *graph = new Graph(*r_graph);
+  Graph *best_graph = new Graph(*graph);
+  float best_cost = best_graph->optimal_cost();
+  candidates.push({best_cost, graph});
+  hashmap.insert(graph->hash());
+  float const alpha = this->model->config.search_alpha;
+  int const budget = this->model->config.search_budget;
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  int num_popped = 0, num_busy = 0;
+  auto out_of_budget = [&] { return budget != -1 && num_popped >= budget; };
+  auto search = [&](std::vector<GraphXfer *> &xfers) {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      // An empty queue only ends the search once no thread can refill it
+      cv.wait(lock, [&] {
+        return !candidates.empty() || num_busy == 0 || out_of_budget();
+      });
+      if (candidates.empty() || out_of_budget()) {
+        break;
+      }
+      Candidate cur = candidates.top();
+      candidates.pop();
+      num_popped++;
+      if (cur.first < best_cost) {
+        // Other threads may delete best_graph, so cur stays with this one
+        delete best_graph;
+        best_graph = new Graph(*cur.second);
+        best_cost = cur.first;
+      } else if (cur.first > best_cost * alpha) {
+        delete cur.second;
+        continue;
+      }
+      log_xfers.info(
+          "[%d] cur_cost(%.4lf) best_cost(%.4lf) candidates.size(%zu)",
+          num_popped,
+          cur.first,
+          best_cost,
+          candidates.size());
+      float const threshold = best_cost * alpha;
+      num_busy++;
+      lock.unlock();
+
+      std::priority_queue<Graph *, std::vector<Graph *>, GraphCompare> found;
+      std::unordered_set<size_t> found_hashes;
+      for (GraphXfer *xfer : xfers) {
+        int num_matches_found = 0, num_matches_rejected = 0;
+        xfer->run(0,
+                  cur.second,
+                  found,
+                  found_hashes,
+                  threshold,
+                  1000,
+                  simplification_settings,
+                  num_matches_found,
+                  num_matches_rejected);
+        log_xfers.debug() << "Rejected [ " << num_matches_rejected << " / "
+                          << num_matches_found << " ] matches of "
+                          << xfer->get_name();
+      }
+      delete cur.second;
+      std::vector<std::pair<size_t, Candidate>> new_candidates;
+      while (!found.empty()) {
+        Graph *new_graph = found.top();
+        found.pop();
+        new_candidates.push_back(
+            {new_graph->hash(), {new_graph->optimal_cost(), new_graph}});
+      }
+
+      lock.lock();
+      for (auto const &it : new_candidates) {
+        // The best cost may have dropped since the xfers were run
+        if (it.second.first < best_cost * alpha &&
+            hashmap.insert(it.first).second) {
+          candidates.push(it.second);
+        } else {
+          delete it.second.second;
+        }
+      }
+      num_busy--;
+      cv.notify_all();
+    }
+    cv.notify_all();
+  };
+
+  // All searches run on helper threads, which cannot launch kernels: the
+  // task thread runs the operator measurements of the profiling cost model
+  // for them, and would hold up every other thread's measurements if it
+  // searched as well.
+  this->model->simulator->task_thread_executor.run(
+      num_threads, [&](int i) { search(this->thread_pcg_xfers[i]); });
+  while (!candidates.empty()) {
+    delete candidates.top().second;
+    candidates.pop();
+  }
+
+  this->logger->debug() << "Optimized cost: " << best_cost;
+  return std::unique_ptr<Graph>(best_graph);
+}
+
 /**
  * @brief Experimental. Base case of Unity's DP search algorithm with
  * memory consideration.
@@ -2349,8 +2823,7 @@ std::unique_ptr<Graph> GraphSearchHelper::base_optimize_with_memory(
     // r_graph->print_dot();
   }
   this->logger->debug() << "Starting cost: "
-                        << r_graph->optimal_cost_with_memory(
-                               mem_config.run_time_cost_factor);
+                        << r_graph->optimal_cost_with_memory(mem_config);
 
   // Construct graph substitutions
   std::vector<GraphXfer *> xfers;
@@ -2358,7 +2831,7 @@ std::unique_ptr<Graph> GraphSearchHelper::base_optimize_with_memory(
 
   // Prepare for the search
   std::priority_queue<Graph *, std::vector<Graph *>, GraphCompareWithMemory>
-      candidates(GraphCompareWithMemory{mem_config.run_time_cost_factor});
+      candidates(GraphCompareWithMemory{mem_config});
   std::unordered_set<size_t> hashmap;
 
   Graph *graph = new Graph(*r_graph);
@@ -2366,8 +2839,7 @@ std::unique_ptr<Graph> GraphSearchHelper::base_optimize_with_memory(
   hashmap.insert(graph->hash());
 
   Graph *best_graph = new Graph(*graph);
-  float best_cost =
-      best_graph->optimal_cost_with_memory(mem_config.run_time_cost_factor);
+  float best_cost = best_graph->optimal_cost_with_memory(mem_config);
 
   int counter = 0;
   float const alpha = this->model->config.search_alpha;
@@ -2388,21 +2860,20 @@ std::unique_ptr<Graph> GraphSearchHelper::base_optimize_with_memory(
 
     Graph *cur_graph = candidates.top();
     candidates.pop();
-    if (cur_graph->optimal_cost_with_memory(mem_config.run_time_cost_factor) <
-        best_graph->optimal_cost_with_memory(mem_config.run_time_cost_factor)) {
+    if (cur_graph->optimal_cost_with_memory(mem_config) <
+        best_graph->optimal_cost_with_memory(mem_config)) {
       delete best_graph;
       best_graph = cur_graph;
-      best_cost =
-          cur_graph->optimal_cost_with_memory(mem_config.run_time_cost_factor);
-    } else if (cur_graph->optimal_cost_with_memory(
-                   mem_config.run_time_cost_factor) > best_cost * alpha) {
+      best_cost = cur_graph->optimal_cost_with_memory(mem_config);
+    } else if (cur_graph->optimal_cost_with_memory(mem_config) >
+               best_cost * alpha) {
       continue;
     }
 
     log_xfers.info(
         "[%d] cur_cost(%.4lf) best_cost(%.4lf) candidates.size(%zu)",
         counter,
-        cur_graph->optimal_cost_with_memory(mem_config.run_time_cost_factor),
+        cur_graph->optimal_cost_with_memory(mem_config),
         best_cost,
         candidates.size());
 
@@ -2431,7 +2902,7 @@ std::unique_ptr<Graph> GraphSearchHelper::base_optimize_with_memory(
 
   this->logger->debug()
       << "Optimized cost at the end of base_optimize_with_memory: "
-      << best_graph->optimal_cost_with_memory(mem_config.run_time_cost_factor);
+      << best_graph->optimal_cost_with_memory(mem_config);
 
   return std::unique_ptr<Graph>(best_graph);
 }
@@ -2497,7 +2968,10 @@ GraphOptimizeResultWithMemory
   GraphOptimizeResultWithMemory result;
   result.graph = *optimized;
   GraphCostResultWithMemory gcr =
-      optimized->generic_optimal_cost<GraphCostResultWithMemory>();
+      mem_config.mem_search_algo == MemorySearchAlgo::CONSTRAINED
+          ? optimized->optimal_cost_frontier().fastest_within(
+                mem_config.per_device_memory_limit)
+          : optimized->generic_optimal_cost<GraphCostResultWithMemory>();
   result.cost = gcr.cost;
   result.views = gcr.views;
   result.mem_cost = gcr.mem_cost;
@@ -0,0 +1,71 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/task_thread_executor.h"
+#include <cassert>
+#include <vector>
+
+namespace FlexFlow {
+
+void TaskThreadExecutor::run(int num_threads,
+                             std::function<void(int)> const &body) {
+  std::unique_lock<std::mutex> lock(mutex);
+  assert(!serving && "TaskThreadExecutor::run is not reentrant");
+  serving = true;
+  task_thread = std::this_thread::get_id();
+  int running = num_threads;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_threads; i++) {
+    threads.emplace_back([&, i] {
+      body(i);
+      std::lock_guard<std::mutex> guard(mutex);
+      running--;
+      cv.notify_all();
+    });
+  }
+  while (true) {
+    cv.wait(lock, [&] { return !requests.empty() || running == 0; });
+    if (requests.empty()) {
+      break;
+    }
+    Request *request = requests.front();
+    requests.pop_front();
+    lock.unlock();
+    (*request->work)();
+    lock.lock();
+    request->done = true;
+    cv.notify_all();
+  }
+  serving = false;
+  lock.unlock();
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+}
+
+void TaskThreadExecutor::execute(std::function<void()> const &work) {
+  std::unique_lock<std::mutex> lock(mutex);
+  if (!serving || std::this_thread::get_id() == task_thread) {
+    lock.unlock();
+    work();
+    return;
+  }
+  Request request{&work, false};
+  requests.push_back(&request);
+  cv.notify_all();
+  cv.wait(lock, [&] { return request.done; });
+}
+
+}; // namespace FlexFlow
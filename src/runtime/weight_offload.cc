@@ -0,0 +1,299 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/weight_offload.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace FlexFlow {
+
+namespace {
+
+size_t align_up(size_t size, size_t alignment) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+double now_ms() {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+} // namespace
+
+float simulate_weight_offload(std::vector<OffloadLayer> const &layers,
+                              int num_slots) {
+  int num_layers = layers.size();
+  assert(num_layers > 0 && num_slots > 0);
+  if (num_slots >= num_layers) {
+    float time = 0.0f;
+    for (OffloadLayer const &layer : layers) {
+      time += layer.compute_time;
+    }
+    return time;
+  }
+  // Two passes from an empty ring; the second one is the steady state
+  std::vector<double> compute_end(2 * num_layers);
+  double copy_end = 0.0;
+  for (int i = 0; i < 2 * num_layers; i++) {
+    OffloadLayer const &layer = layers[i % num_layers];
+    double copy_start = copy_end;
+    if (i >= num_slots) {
+      copy_start = std::max(copy_start, compute_end[i - num_slots]);
+    }
+    copy_end = copy_start + layer.copy_time;
+    double start = i > 0 ? std::max(copy_end, compute_end[i - 1]) : copy_end;
+    compute_end[i] = start + layer.compute_time;
+  }
+  return compute_end[2 * num_layers - 1] - compute_end[num_layers - 1];
+}
+
+WeightOffloadPlan plan_weight_offload(std::vector<OffloadLayer> const &layers,
+                                      size_t ring_bytes,
+                                      int requested_depth,
+                                      size_t alignment) {
+  assert(!layers.empty() && alignment > 0);
+  WeightOffloadPlan plan;
+  for (OffloadLayer const &layer : layers) {
+    plan.slot_bytes =
+        std::max(plan.slot_bytes, align_up(layer.bytes, alignment));
+  }
+  assert(plan.slot_bytes > 0);
+  int max_slots = std::min(ring_bytes / plan.slot_bytes, layers.size());
+  assert(max_slots > 0);
+  if (requested_depth >= 0) {
+    plan.num_slots = std::min(requested_depth + 1, max_slots);
+  } else {
+    std::vector<float> times(max_slots + 1);
+    float best = simulate_weight_offload(layers, 1);
+    for (int num_slots = 1; num_slots <= max_slots; num_slots++) {
+      times[num_slots] = simulate_weight_offload(layers, num_slots);
+      best = std::min(best, times[num_slots]);
+    }
+    plan.num_slots = 1;
+    while (times[plan.num_slots] > best * 1.01f) {
+      plan.num_slots++;
+    }
+  }
+  plan.prefetch_depth = plan.num_slots - 1;
+  plan.step_time = simulate_weight_offload(layers, plan.num_slots);
+  plan.sync_step_time = simulate_weight_offload(layers, 1);
+  return plan;
+}
+
+void HostWeightCopyQueue::resize(int num_slots) {
+  copy_times.assign(num_slots, 0.0f);
+  wait_times.assign(num_slots, 0.0);
+}
+
+void HostWeightCopyQueue::copy(int slot,
+                               void *dst,
+                               void const *src,
+                               size_t bytes) {
+  double start = now_ms();
+  memcpy(dst, src, bytes);
+  copy_times.at(slot) = static_cast<float>(now_ms() - start);
+}
+
+// Host copies are done when copy returns, so there is no stream to order
+void HostWeightCopyQueue::wait(int slot, void * /*stream*/) {
+  wait_times.at(slot) = now_ms();
+}
+
+void HostWeightCopyQueue::release(int /*slot*/, void * /*stream*/) {}
+
+float HostWeightCopyQueue::copy_time(int slot) {
+  return copy_times.at(slot);
+}
+
+float HostWeightCopyQueue::compute_time(int from_slot, int to_slot) {
+  return static_cast<float>(wait_times.at(to_slot) - wait_times.at(from_slot));
+}
+
+WeightOffloadEngine::WeightOffloadEngine(void *_reserve_space,
+                                         size_t _reserve_space_size,
+                                         WeightCopyQueue *_queue,
+                                         int _requested_depth)
+    : reserve_space(static_cast<char *>(_reserve_space)),
+      reserve_space_size(_reserve_space_size), ring_offset(0), queue(_queue),
+      requested_depth(_requested_depth), num_copies(0), num_prefetches(0) {
+  restart_calibration();
+}
+
+void WeightOffloadEngine::reserve_scratch(size_t bytes) {
+  size_t offset = align_up(bytes, 256);
+  if (offset > ring_offset) {
+    ring_offset = offset;
+    if (!layers.empty()) {
+      // The ring moves
+      restart_calibration();
+    }
+  }
+}
+
+void *WeightOffloadEngine::acquire(void const *weight,
+                                   size_t bytes,
+                                   void *stream) {
+  int idx;
+  auto const &it = layer_index.find(weight);
+  if (it == layer_index.end()) {
+    idx = layers.size();
+    layer_index[weight] = idx;
+    layers.push_back({weight, bytes, -1.0f, -1.0f, -1});
+    if (!calibrating) {
+      restart_calibration();
+    }
+  } else {
+    idx = it->second;
+    assert(layers[idx].bytes == bytes);
+    if (idx == 0 && calibrating && ++calibrated_steps == calibration_steps) {
+      finish_calibration();
+    }
+  }
+  Layer &layer = layers[idx];
+  if (calibrating) {
+    // Alternate between two sets of events, to time the previous layer
+    int slot = (last_slot + 1) % 2;
+    if (ring_offset + bytes > reserve_space_size) {
+      fprintf(stderr,
+              "[Error] the offload reserve space (%zu MB) cannot hold the "
+              "scratch space (%zu MB) and the weights of one layer (%zu MB)\n",
+              reserve_space_size >> 20,
+              ring_offset >> 20,
+              bytes >> 20);
+      assert(false);
+    }
+    load(idx, slot);
+    num_copies++;
+    queue->wait(slot, stream);
+    float copy_time = queue->copy_time(slot);
+    if (layer.copy_time < 0.0f || copy_time < layer.copy_time) {
+      layer.copy_time = copy_time;
+    }
+    if (last_layer >= 0) {
+      // The min over the calibration steps favors decoding over prefilling,
+      // whose longer compute hides more of the copies
+      float compute_time = queue->compute_time(last_slot, slot);
+      Layer &last = layers[last_layer];
+      if (last.compute_time < 0.0f || compute_time < last.compute_time) {
+        last.compute_time = compute_time;
+      }
+    }
+  } else if (layer.slot < 0) {
+    // Evicted by a layer that ran out of order: load it after the last slot
+    load(idx, (last_slot + 1) % plan.num_slots);
+    num_copies++;
+    queue->wait(layer.slot, stream);
+  } else {
+    queue->wait(layer.slot, stream);
+  }
+  last_layer = idx;
+  last_slot = layer.slot;
+  return slot_ptr(layer.slot);
+}
+
+void WeightOffloadEngine::release(void const *weight, void *stream) {
+  auto const &it = layer_index.find(weight);
+  assert(it != layer_index.end());
+  int idx = it->second;
+  int slot = layers[idx].slot;
+  assert(slot >= 0);
+  queue->release(slot, stream);
+  if (calibrating) {
+    return;
+  }
+  // The ring holds the num_slots layers from this one; the freed slot gets
+  // the next one
+  int next = (idx + plan.num_slots) % layers.size();
+  if (layers[next].slot < 0) {
+    load(next, slot);
+    num_prefetches++;
+  }
+}
+
+bool WeightOffloadEngine::is_calibrating() const {
+  return calibrating;
+}
+
+WeightOffloadPlan const &WeightOffloadEngine::get_plan() const {
+  return plan;
+}
+
+size_t WeightOffloadEngine::get_num_copies() const {
+  return num_copies;
+}
+
+size_t WeightOffloadEngine::get_num_prefetches() const {
+  return num_prefetches;
+}
+
+void WeightOffloadEngine::restart_calibration() {
+  calibrating = true;
+  calibrated_steps = 0;
+  last_layer = -1;
+  last_slot = 1;
+  queue->resize(2);
+  slot_owner.assign(2, -1);
+  for (Layer &layer : layers) {
+    layer.slot = -1;
+  }
+}
+
+void WeightOffloadEngine::finish_calibration() {
+  std::vector<OffloadLayer> offload_layers;
+  for (Layer const &layer : layers) {
+    offload_layers.push_back({layer.bytes,
+                              std::max(layer.copy_time, 0.0f),
+                              std::max(layer.compute_time, 0.0f)});
+  }
+  plan = plan_weight_offload(
+      offload_layers, reserve_space_size - ring_offset, requested_depth);
+  printf("Weight offloading: %zu layers, prefetch depth %d (%d slots of %zu "
+         "MB), %.2f ms per step (%.2f ms without prefetching)\n",
+         layers.size(),
+         plan.prefetch_depth,
+         plan.num_slots,
+         plan.slot_bytes >> 20,
+         plan.step_time,
+         plan.sync_step_time);
+  calibrating = false;
+  last_layer = -1;
+  last_slot = plan.num_slots - 1;
+  queue->resize(plan.num_slots);
+  slot_owner.assign(plan.num_slots, -1);
+  for (Layer &layer : layers) {
+    layer.slot = -1;
+  }
+}
+
+char *WeightOffloadEngine::slot_ptr(int slot) const {
+  // All calibration copies go to the start of the ring
+  size_t offset = calibrating ? 0 : slot * plan.slot_bytes;
+  return reserve_space + ring_offset + offset;
+}
+
+void WeightOffloadEngine::load(int idx, int slot) {
+  if (slot_owner[slot] >= 0) {
+    layers[slot_owner[slot]].slot = -1;
+  }
+  slot_owner[slot] = idx;
+  layers[idx].slot = slot;
+  queue->copy(slot, slot_ptr(slot), layers[idx].weight, layers[idx].bytes);
+}
+
+}; // namespace FlexFlow
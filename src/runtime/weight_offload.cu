@@ -0,0 +1,95 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/utils/cuda_helper.h"
+#include "flexflow/weight_offload.h"
+
+namespace FlexFlow {
+
+namespace {
+
+class CudaWeightCopyQueue : public WeightCopyQueue {
+public:
+  CudaWeightCopyQueue() {
+    checkCUDA(cudaStreamCreateWithFlags(&copy_stream, cudaStreamNonBlocking));
+  }
+  ~CudaWeightCopyQueue() {
+    destroy_events();
+    checkCUDA(cudaStreamDestroy(copy_stream));
+  }
+  void resize(int num_slots) override {
+    destroy_events();
+    for (auto *events : {&copy_start, &loaded, &ready, &started}) {
+      events->resize(num_slots);
+      for (cudaEvent_t &event : *events) {
+        checkCUDA(cudaEventCreate(&event));
+      }
+    }
+  }
+  void copy(int slot, void *dst, void const *src, size_t bytes) override {
+    checkCUDA(cudaEventRecord(copy_start[slot], copy_stream));
+    checkCUDA(cudaMemcpyAsync(
+        dst, src, bytes, cudaMemcpyHostToDevice, copy_stream));
+    checkCUDA(cudaEventRecord(loaded[slot], copy_stream));
+  }
+  void wait(int slot, void *stream) override {
+    cudaStream_t compute_stream = static_cast<cudaStream_t>(stream);
+    checkCUDA(cudaEventRecord(ready[slot], compute_stream));
+    checkCUDA(cudaStreamWaitEvent(compute_stream, loaded[slot], 0));
+    checkCUDA(cudaEventRecord(started[slot], compute_stream));
+  }
+  void release(int slot, void *stream) override {
+    // Later copies, to any slot, wait for what stream has issued so far
+    cudaEvent_t released;
+    checkCUDA(cudaEventCreateWithFlags(&released, cudaEventDisableTiming));
+    checkCUDA(cudaEventRecord(released, static_cast<cudaStream_t>(stream)));
+    checkCUDA(cudaStreamWaitEvent(copy_stream, released, 0));
+    checkCUDA(cudaEventDestroy(released));
+  }
+  float copy_time(int slot) override {
+    float ms = 0.0f;
+    checkCUDA(cudaEventSynchronize(loaded[slot]));
+    checkCUDA(cudaEventElapsedTime(&ms, copy_start[slot], loaded[slot]));
+    return ms;
+  }
+  float compute_time(int from_slot, int to_slot) override {
+    float ms = 0.0f;
+    checkCUDA(cudaEventSynchronize(ready[to_slot]));
+    checkCUDA(cudaEventElapsedTime(&ms, started[from_slot], ready[to_slot]));
+    return ms;
+  }
+
+private:
+  void destroy_events() {
+    for (auto *events : {&copy_start, &loaded, &ready, &started}) {
+      for (cudaEvent_t &event : *events) {
+        checkCUDA(cudaEventDestroy(event));
+      }
+      events->clear();
+    }
+  }
+
+  cudaStream_t copy_stream;
+  // Per slot: around the last copy to it, and around the last wait for it
+  std::vector<cudaEvent_t> copy_start, loaded, ready, started;
+};
+
+} // namespace
+
+WeightCopyQueue *create_cuda_weight_copy_queue() {
+  return new CudaWeightCopyQueue();
+}
+
+}; // namespace FlexFlow
@@ -0,0 +1,69 @@
+#include "flexflow/activation_memory_planner.h"
+#include "gtest/gtest.h"
+
+using namespace FlexFlow;
+
+namespace {
+
+void expect_no_overlap(std::vector<ActivationInterval> const &intervals,
+                       ActivationMemoryPlan const &plan) {
+  for (size_t i = 0; i < intervals.size(); i++) {
+    ActivationInterval const &a = intervals[i];
+    EXPECT_LE(plan.offsets[i] + a.size, plan.arena_sizes[a.arena]);
+    for (size_t j = i + 1; j < intervals.size(); j++) {
+      ActivationInterval const &b = intervals[j];
+      if (a.arena != b.arena || a.last_use < b.first_use ||
+          b.last_use < a.first_use) {
+        continue;
+      }
+      EXPECT_TRUE(plan.offsets[i] + a.size <= plan.offsets[j] ||
+                  plan.offsets[j] + b.size <= plan.offsets[i])
+          << "buffers " << i << " and " << j << " overlap";
+    }
+  }
+}
+
+} // namespace
+
+TEST(activation_memory_planner, chain_reuses_storage_across_shapes) {
+  // A chain of operators: each output is only read by the next operator
+  std::vector<ActivationInterval> intervals = {
+      {1024, 0, 1, 0}, {4096, 1, 2, 0}, {1024, 2, 3, 0}, {2048, 3, 4, 0}};
+  ActivationMemoryPlan plan = plan_activation_memory(intervals);
+  expect_no_overlap(intervals, plan);
+  EXPECT_EQ(plan.naive_peak, 8192);
+  EXPECT_EQ(plan.live_peak, 5120);
+  EXPECT_EQ(plan.planned_peak, 5120);
+}
+
+TEST(activation_memory_planner, fills_gaps_and_aligns) {
+  // The third buffer fits in the storage the first one releases, below the
+  // second one that stays live
+  std::vector<ActivationInterval> intervals = {
+      {1000, 0, 1, 0}, {1000, 0, 3, 0}, {300, 2, 3, 0}, {200, 2, 3, 0}};
+  ActivationMemoryPlan plan = plan_activation_memory(intervals, 256);
+  expect_no_overlap(intervals, plan);
+  for (size_t offset : plan.offsets) {
+    EXPECT_EQ(offset % 256, 0);
+  }
+  EXPECT_EQ(plan.offsets[1] + plan.offsets[0], 1024);
+  EXPECT_LT(plan.offsets[2], 1024);
+  EXPECT_LT(plan.offsets[3], 1024);
+  EXPECT_EQ(plan.planned_peak, 2048);
+  EXPECT_EQ(plan.naive_peak, 2048 + 512 + 256);
+}
+
+TEST(activation_memory_planner, arenas_do_not_share) {
+  std::vector<ActivationInterval> intervals = {{512, 0, 0, 0},
+                                               {512, 1, 1, 0},
+                                               {512, 0, 0, 1},
+                                               {256, 1, 1, 1},
+                                               {256, 1, 1, 1}};
+  ActivationMemoryPlan plan = plan_activation_memory(intervals, 1);
+  expect_no_overlap(intervals, plan);
+  ASSERT_EQ(plan.arena_sizes.size(), 2);
+  EXPECT_EQ(plan.arena_sizes[0], 512);
+  EXPECT_EQ(plan.arena_sizes[1], 512);
+  EXPECT_EQ(plan.naive_peak, 1024);
+  EXPECT_EQ(plan.planned_peak, 512);
+}
@@ -0,0 +1,102 @@
+#include "flexflow/batch_config_metadata_cache.h"
+#include "gtest/gtest.h"
+#include <cstring>
+#include <utility>
+#include <vector>
+
+using namespace FlexFlow;
+
+namespace {
+
+struct Row {
+  int token_id, depth, request_index;
+};
+
+// A host buffer standing for the device one, and the copies made to it
+struct Device {
+  std::vector<char> buffer;
+  std::vector<std::pair<size_t, size_t>> copies;
+
+  explicit Device(size_t size) : buffer(size, 0) {}
+
+  BatchConfigMetadataCache::CopyFunc copy_func() {
+    return [this](size_t offset, void const *src, size_t size) {
+      std::memcpy(buffer.data() + offset, src, size);
+      copies.emplace_back(offset, size);
+    };
+  }
+};
+
+} // namespace
+
+TEST(batch_config_metadata_cache, copies_changed_rows_only) {
+  size_t num_rows = 1024, size = num_rows * sizeof(Row);
+  BatchConfigMetadataCache cache(size, 0);
+  Device device(size);
+  BatchConfigMetadataCache::CopyFunc copy = device.copy_func();
+  std::vector<Row> rows(num_rows, Row{0, 0, 0});
+  // Zeroed rows are already there
+  EXPECT_EQ(cache.write(0, rows.data(), sizeof(Row), num_rows, copy), 0u);
+  // The next batch changes three tokens
+  rows[3] = Row{42, 10, 0};
+  rows[4] = Row{7, 20, 1};
+  rows[900] = Row{9, 1, 2};
+  size_t copied = cache.write(0, rows.data(), sizeof(Row), num_rows, copy);
+  EXPECT_EQ(copied, 3 * sizeof(Row));
+  ASSERT_EQ(device.copies.size(), 2u);
+  EXPECT_EQ(device.copies[0],
+            std::make_pair(3 * sizeof(Row), 2 * sizeof(Row)));
+  EXPECT_EQ(device.copies[1], std::make_pair(900 * sizeof(Row), sizeof(Row)));
+  EXPECT_EQ(std::memcmp(device.buffer.data(), rows.data(), size), 0);
+  // Nothing changed
+  device.copies.clear();
+  EXPECT_EQ(cache.write(0, rows.data(), sizeof(Row), num_rows, copy), 0u);
+  EXPECT_TRUE(device.copies.empty());
+}
+
+TEST(batch_config_metadata_cache, merges_nearby_runs) {
+  size_t num_rows = 64, size = 2 * num_rows * sizeof(Row);
+  BatchConfigMetadataCache cache(size, 4 * sizeof(Row));
+  Device device(size);
+  BatchConfigMetadataCache::CopyFunc copy = device.copy_func();
+  std::vector<Row> rows(num_rows, Row{0, 0, 0});
+  rows[1].depth = rows[4].depth = rows[20].depth = 1;
+  // A region at an offset in the buffer
+  size_t offset = num_rows * sizeof(Row);
+  size_t copied =
+      cache.write(offset, rows.data(), sizeof(Row), num_rows, copy);
+  // Rows 1 to 4 in a copy, row 20 in another
+  EXPECT_EQ(copied, 5 * sizeof(Row));
+  ASSERT_EQ(device.copies.size(), 2u);
+  EXPECT_EQ(device.copies[0],
+            std::make_pair(offset + sizeof(Row), 4 * sizeof(Row)));
+  EXPECT_EQ(device.copies[1],
+            std::make_pair(offset + 20 * sizeof(Row), sizeof(Row)));
+  EXPECT_EQ(std::memcmp(device.buffer.data() + offset,
+                        rows.data(),
+                        num_rows * sizeof(Row)),
+            0);
+  // A completed request goes back to zero, and is copied
+  device.copies.clear();
+  rows[20].depth = 0;
+  EXPECT_EQ(cache.write(offset, rows.data(), sizeof(Row), num_rows, copy),
+            sizeof(Row));
+  EXPECT_EQ(device.buffer[offset + 20 * sizeof(Row) + sizeof(int)], 0);
+}
+
+TEST(batch_config_metadata_cache, writes_arrays) {
+  Row tokens[16] = {};
+  bool completed[8] = {};
+  size_t size = sizeof(tokens) + sizeof(completed);
+  BatchConfigMetadataCache cache(size);
+  Device device(size);
+  BatchConfigMetadataCache::CopyFunc copy = device.copy_func();
+  // Rows past the tokens of the batch are left alone
+  tokens[2].token_id = tokens[9].token_id = 5;
+  EXPECT_EQ(cache.write(0, tokens, 4, copy), sizeof(Row));
+  completed[7] = true;
+  EXPECT_EQ(cache.write(sizeof(tokens), completed, copy), sizeof(bool));
+  EXPECT_EQ(device.buffer[2 * sizeof(Row)], 5);
+  EXPECT_EQ(device.buffer[9 * sizeof(Row)], 0);
+  EXPECT_EQ(device.buffer[size - 1], 1);
+}
@@ -0,0 +1,71 @@
+#include "flexflow/collective_cost.h"
+#include "gtest/gtest.h"
+
+using namespace FlexFlow;
+
+namespace {
+
+CollectiveTopology make_topology(int num_nodes, int gpus_per_node) {
+  CollectiveTopology t;
+  t.gpus_per_node.assign(num_nodes, gpus_per_node);
+  t.intra_node_bandwidth = 100.0f;
+  t.inter_node_bandwidth = 10.0f;
+  t.intra_node_latency = 0.001f;
+  t.inter_node_latency = 0.01f;
+  return t;
+}
+
+} // namespace
+
+TEST(collective_cost, single_node) {
+  CollectiveTopology t = make_topology(1, 8);
+  // 2 * (n - 1) rounds of 1/n of the buffer
+  EXPECT_FLOAT_EQ(collective_cost(CollectiveType::ALLREDUCE,
+                                  CollectiveAlgorithm::RING,
+                                  t,
+                                  800000),
+                  14 * (0.001f + 1000.0f));
+  EXPECT_EQ(cheapest_collective(CollectiveType::ALLREDUCE, t, 800000).algorithm,
+            CollectiveAlgorithm::RING);
+  EXPECT_EQ(collective_cost(CollectiveType::ALLREDUCE,
+                            CollectiveAlgorithm::RING,
+                            make_topology(1, 1),
+                            800000),
+            0.0f);
+}
+
+TEST(collective_cost, multi_node) {
+  // NVLink islands behind slower NICs favor the hierarchical all-reduce
+  CollectiveTopology t = make_topology(4, 8);
+  EXPECT_EQ(
+      cheapest_collective(CollectiveType::ALLREDUCE, t, 1000000).algorithm,
+      CollectiveAlgorithm::HIERARCHICAL);
+  EXPECT_EQ(
+      cheapest_collective(CollectiveType::REDUCE_SCATTER, t, 1000000).algorithm,
+      CollectiveAlgorithm::HIERARCHICAL);
+  EXPECT_EQ(cheapest_collective(CollectiveType::ALLTOALL, t, 1000000).algorithm,
+            CollectiveAlgorithm::DIRECT);
+  // Small messages over many nodes are latency bound, where trees win
+  t = make_topology(64, 1);
+  EXPECT_EQ(cheapest_collective(CollectiveType::ALLREDUCE, t, 1).algorithm,
+            CollectiveAlgorithm::DOUBLE_BINARY_TREE);
+}
+
+TEST(collective_cost, uneven_nodes) {
+  // Four participants on one node and one on another
+  CollectiveTopology t = make_topology(2, 1);
+  t.gpus_per_node = {4, 1};
+  EXPECT_EQ(t.num_participants(), 5);
+  EXPECT_FLOAT_EQ(collective_cost(CollectiveType::ALLREDUCE,
+                                  CollectiveAlgorithm::RING,
+                                  t,
+                                  1000),
+                  8 * (0.01f + 20.0f));
+  // A ring of 4 inside the busy node, then a single ring across the nodes on
+  // the full buffer
+  EXPECT_FLOAT_EQ(collective_cost(CollectiveType::ALLREDUCE,
+                                  CollectiveAlgorithm::HIERARCHICAL,
+                                  t,
+                                  1000),
+                  2 * (3 * (0.001f + 2.5f) + (0.01f + 50.0f)));
+}
@@ -0,0 +1,137 @@
+#include "flexflow/cost_database.h"
+#include "gtest/gtest.h"
+#include <cstdio>
+#include <fstream>
+
+using namespace FlexFlow;
+
+namespace {
+
+DeviceRoofline make_gpu() {
+  DeviceRoofline gpu;
+  gpu.peak_flops = 1e9f;
+  gpu.peak_half_flops = 8e9f;
+  gpu.mem_bandwidth = 1e6f;
+  return gpu;
+}
+
+CostRecord make_record(OperatorType op_type,
+                       size_t params_hash,
+                       DataType data_type,
+                       double forward_flops,
+                       float forward_time) {
+  CostRecord record;
+  record.op_type = op_type;
+  record.params_hash = params_hash;
+  record.view_hash = 7;
+  record.data_type = data_type;
+  record.forward_flops = forward_flops;
+  record.backward_flops = 2 * forward_flops;
+  record.forward_bytes = 0;
+  record.backward_bytes = 0;
+  record.forward_time = forward_time;
+  record.backward_time = 2 * forward_time;
+  return record;
+}
+
+} // namespace
+
+TEST(cost_database, roofline_time) {
+  DeviceRoofline gpu = make_gpu();
+  float const latency = DeviceRoofline::KERNEL_LAUNCH_LATENCY;
+  EXPECT_FLOAT_EQ(gpu.time(0, 0, DT_FLOAT), 0.0f);
+  // Compute-bound: 2e9 FLOPs at 1e9 FLOPs/ms
+  EXPECT_FLOAT_EQ(gpu.time(2e9, 1e3, DT_FLOAT), 2.0f + latency);
+  // Half precision uses its own peak
+  EXPECT_FLOAT_EQ(gpu.time(2e9, 1e3, DT_HALF), 0.25f + latency);
+  // Memory-bound: 3e6 B at 1e6 B/ms
+  EXPECT_FLOAT_EQ(gpu.time(1e3, 3e6, DT_FLOAT), 3.0f + latency);
+  EXPECT_TRUE(gpu.is_valid());
+  EXPECT_FALSE(DeviceRoofline().is_valid());
+}
+
+TEST(cost_database, calibration_per_data_type) {
+  DeviceRoofline gpu = make_gpu();
+  float const latency = DeviceRoofline::KERNEL_LAUNCH_LATENCY;
+  std::vector<CostRecord> records;
+  // Linear runs at half of the FP32 roofline over two records
+  records.push_back(
+      make_record(OP_LINEAR, 1, DT_FLOAT, 1e9, 2 * (1 + latency)));
+  records.push_back(
+      make_record(OP_LINEAR, 2, DT_FLOAT, 3e9, 2 * (3 + latency)));
+  // and at a quarter of the FP16 roofline
+  records.push_back(
+      make_record(OP_LINEAR, 3, DT_HALF, 8e9, 4 * (1 + latency)));
+  records.push_back(make_record(OP_SOFTMAX, 4, DT_FLOAT, 1e9, 1 + latency));
+  std::unordered_map<int, std::pair<float, float>> factors =
+      fit_calibration_factors(records, gpu);
+  ASSERT_EQ(factors.size(), 3);
+  EXPECT_FLOAT_EQ(factors.at(calibration_key(OP_LINEAR, DT_FLOAT)).first,
+                  2.0f);
+  EXPECT_FLOAT_EQ(factors.at(calibration_key(OP_LINEAR, DT_HALF)).first,
+                  4.0f);
+  EXPECT_FLOAT_EQ(factors.at(calibration_key(OP_SOFTMAX, DT_FLOAT)).first,
+                  1.0f);
+  // Backward records take twice the time for twice the FLOPs, less one
+  // kernel launch
+  EXPECT_NEAR(factors.at(calibration_key(OP_SOFTMAX, DT_FLOAT)).second,
+              (2 + 2 * latency) / (2 + latency),
+              1e-6);
+}
+
+TEST(cost_database, save_and_load) {
+  std::string filename = "test_cost_database.txt";
+  CostDatabase database;
+  database.add_record(make_record(OP_LINEAR, 1, DT_HALF, 1e9, 1.5f));
+  database.add_record(make_record(OP_SOFTMAX, 2, DT_FLOAT, 1e6, 0.25f));
+  // A record of the same operator and view replaces the previous one
+  database.add_record(make_record(OP_LINEAR, 1, DT_HALF, 1e9, 1.25f));
+  ASSERT_EQ(database.get_records().size(), 2);
+  ASSERT_TRUE(database.save_to_file(filename));
+
+  CostDatabase loaded;
+  std::string error;
+  ASSERT_TRUE(loaded.load_from_file(filename, error)) << error;
+  ASSERT_EQ(loaded.get_records().size(), 2);
+  CostRecord const *linear = loaded.find_record(OP_LINEAR, 1, 7);
+  ASSERT_NE(linear, nullptr);
+  EXPECT_EQ(linear->data_type, DT_HALF);
+  EXPECT_FLOAT_EQ(linear->forward_time, 1.25f);
+  EXPECT_DOUBLE_EQ(linear->backward_flops, 2e9);
+  EXPECT_EQ(loaded.find_record(OP_LINEAR, 1, 8), nullptr);
+  std::remove(filename.c_str());
+}
+
+TEST(cost_database, loads_v1_files_as_float) {
+  std::string filename = "test_cost_database_v1.txt";
+  {
+    std::ofstream file(filename);
+    file << "# flexflow cost database v1\n"
+         << (int)OP_LINEAR << " 11 7 1000 2000 10 20 0.5 1\n";
+  }
+  CostDatabase database;
+  std::string error;
+  ASSERT_TRUE(database.load_from_file(filename, error)) << error;
+  CostRecord const *record = database.find_record(OP_LINEAR, 11, 7);
+  ASSERT_NE(record, nullptr);
+  EXPECT_EQ(record->data_type, DT_FLOAT);
+  EXPECT_FLOAT_EQ(record->backward_time, 1.0f);
+  std::remove(filename.c_str());
+}
+
+TEST(cost_database, rejects_malformed_files) {
+  std::string filename = "test_cost_database_bad.txt";
+  {
+    std::ofstream file(filename);
+    file << "# flexflow cost database v2\n"
+         << (int)OP_LINEAR << " 11 7 1000 2000 10 20 0.5 1 0\n"
+         << "not a record\n";
+  }
+  CostDatabase database;
+  std::string error;
+  EXPECT_FALSE(database.load_from_file(filename, error));
+  EXPECT_NE(error.find(":3"), std::string::npos);
+  EXPECT_TRUE(database.get_records().empty());
+  EXPECT_FALSE(database.load_from_file("missing_cost_database.txt", error));
+  std::remove(filename.c_str());
+}
@@ -0,0 +1,68 @@
+#include "flexflow/cost_frontier.h"
+#include "gtest/gtest.h"
+#include <limits>
+
+using namespace FlexFlow;
+
+TEST(cost_frontier, prune_drops_dominated_points) {
+  float const inf = std::numeric_limits<float>::infinity();
+  std::vector<FrontierPoint> points = {
+      {3.0f, 10.0f}, {1.0f, 40.0f}, {2.0f, 50.0f}, {inf, 1.0f}, {2.0f, 20.0f}};
+  std::vector<size_t> kept = prune_frontier(points, 16);
+  // {2, 50} is slower and larger than {1, 40}; infinite costs are invalid
+  EXPECT_EQ(kept, (std::vector<size_t>{1, 4, 0}));
+}
+
+TEST(cost_frontier, prune_thins_keeping_endpoints) {
+  // 90 fast points crowded within 9 MB and a sparse tail of 10 small ones
+  std::vector<FrontierPoint> points;
+  for (int i = 0; i < 100; i++) {
+    points.push_back({(float)i, i < 90 ? 200.0f - i * 0.1f : 100.0f - i});
+  }
+  std::vector<size_t> kept = prune_frontier(points, 16);
+  ASSERT_LE(kept.size(), 16);
+  EXPECT_EQ(kept.front(), 0);
+  EXPECT_EQ(kept.back(), 99);
+  for (size_t i = 1; i < kept.size(); i++) {
+    EXPECT_GT(points[kept[i]].cost, points[kept[i - 1]].cost);
+    EXPECT_LT(points[kept[i]].mem, points[kept[i - 1]].mem);
+  }
+  // Thinning follows memory, so the sparse tail is covered
+  int small = 0;
+  for (size_t i : kept) {
+    small += points[i].mem < 100.0f;
+  }
+  EXPECT_GE(small, 8);
+}
+
+TEST(cost_frontier, combine_sequence) {
+  std::vector<FrontierPoint> first = {{1.0f, 30.0f}, {2.0f, 10.0f}};
+  std::vector<FrontierPoint> second = {{1.0f, 20.0f}, {4.0f, 5.0f}};
+  std::vector<FrontierPair> pairs =
+      combine_frontiers(first, second, false /*disjoint_devices*/, 16);
+  // (1 + 4, 30 + 5) is dominated by (2 + 1, 10 + 20)
+  ASSERT_EQ(pairs.size(), 3);
+  EXPECT_FLOAT_EQ(pairs[0].cost, 2.0f);
+  EXPECT_FLOAT_EQ(pairs[0].mem, 50.0f);
+  EXPECT_EQ(pairs[1].first, 1);
+  EXPECT_EQ(pairs[1].second, 0);
+  EXPECT_FLOAT_EQ(pairs[2].cost, 6.0f);
+  EXPECT_FLOAT_EQ(pairs[2].mem, 15.0f);
+}
+
+TEST(cost_frontier, combine_parallel) {
+  std::vector<FrontierPoint> first = {{1.0f, 30.0f}, {2.0f, 10.0f}};
+  std::vector<FrontierPoint> second = {{1.0f, 20.0f}, {4.0f, 5.0f}};
+  std::vector<FrontierPair> pairs =
+      combine_frontiers(first, second, true /*disjoint_devices*/, 16);
+  // Disjoint devices take the max of both run times and memories
+  ASSERT_EQ(pairs.size(), 3);
+  EXPECT_FLOAT_EQ(pairs[0].cost, 1.0f);
+  EXPECT_FLOAT_EQ(pairs[0].mem, 30.0f);
+  EXPECT_FLOAT_EQ(pairs[1].cost, 2.0f);
+  EXPECT_FLOAT_EQ(pairs[1].mem, 20.0f);
+  EXPECT_FLOAT_EQ(pairs[2].cost, 4.0f);
+  EXPECT_FLOAT_EQ(pairs[2].mem, 10.0f);
+  EXPECT_EQ(pairs[2].first, 1);
+  EXPECT_EQ(pairs[2].second, 1);
+}
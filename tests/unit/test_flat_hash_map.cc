@@ -0,0 +1,70 @@
+#include "flexflow/utils/flat_hash_map.h"
+#include "gtest/gtest.h"
+#include <random>
+#include <unordered_map>
+
+TEST(flat_hash_map, basic) {
+  FlatHashMap<int, int> m;
+  EXPECT_TRUE(m.empty());
+  EXPECT_EQ(m.find(1), m.end());
+  m[1] = 10;
+  m[2] = 20;
+  EXPECT_TRUE(m.insert(std::make_pair(3, 30)).second);
+  EXPECT_FALSE(m.insert(std::make_pair(3, 31)).second);
+  EXPECT_EQ(m.size(), 3);
+  EXPECT_EQ(m.at(3), 30);
+  EXPECT_EQ(m.find(2)->second, 20);
+  EXPECT_EQ(m.count(4), 0);
+  EXPECT_EQ(m.erase(2), 1);
+  EXPECT_EQ(m.erase(2), 0);
+  EXPECT_EQ(m.find(2), m.end());
+  int sum = 0;
+  for (auto const &e : m) {
+    sum += e.second;
+  }
+  EXPECT_EQ(sum, 40);
+  m.clear();
+  EXPECT_EQ(m.size(), 0);
+  EXPECT_EQ(m.begin(), m.end());
+}
+
+// Keys that all land in the same bucket exercise probing and erase
+struct ConstantHash {
+  size_t operator()(int) const {
+    return 7;
+  }
+};
+
+TEST(flat_hash_map, collisions) {
+  FlatHashMap<int, int, ConstantHash> m;
+  for (int i = 0; i < 40; i++) {
+    m[i] = i;
+  }
+  for (int i = 0; i < 40; i += 3) {
+    EXPECT_EQ(m.erase(i), 1);
+  }
+  for (int i = 0; i < 40; i++) {
+    EXPECT_EQ(m.count(i), i % 3 == 0 ? 0 : 1);
+  }
+}
+
+TEST(flat_hash_map, matches_unordered_map) {
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<int> key(0, 500), op(0, 3);
+  FlatHashMap<int, int> m;
+  std::unordered_map<int, int> ref;
+  for (int i = 0; i < 20000; i++) {
+    int k = key(gen);
+    if (op(gen) == 0) {
+      EXPECT_EQ(m.erase(k), ref.erase(k));
+    } else {
+      m[k] = i;
+      ref[k] = i;
+    }
+  }
+  EXPECT_EQ(m.size(), ref.size());
+  for (auto const &e : ref) {
+    ASSERT_NE(m.find(e.first), m.end());
+    EXPECT_EQ(m.at(e.first), e.second);
+  }
+}
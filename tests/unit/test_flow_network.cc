@@ -0,0 +1,40 @@
+#include "flexflow/flow_network.h"
+#include "gtest/gtest.h"
+
+using namespace FlexFlow;
+
+TEST(flow_network, max_min_fair_sharing) {
+  FlowNetwork network;
+  int a = network.add_link(10.0f);
+  int b = network.add_link(4.0f);
+  FlowId f1 = network.start_flow({a}, 100.0f, 0.0f);
+  FlowId f2 = network.start_flow({a, b}, 100.0f, 0.0f);
+  FlowId f3 = network.start_flow({b}, 100.0f, 0.0f, 1.0f /*delay*/);
+  // Link b is the bottleneck of f2 and f3; f1 takes what is left of a
+  EXPECT_FLOAT_EQ(network.get_rate(f1), 8.0f);
+  EXPECT_FLOAT_EQ(network.get_rate(f2), 2.0f);
+  EXPECT_FLOAT_EQ(network.get_rate(f3), 2.0f);
+  EXPECT_FLOAT_EQ(network.next_completion_time(), 12.5f);
+
+  float time;
+  EXPECT_EQ(network.complete_next_flow(time), f1);
+  EXPECT_FLOAT_EQ(time, 12.5f);
+  EXPECT_EQ(network.complete_next_flow(time), f2);
+  EXPECT_FLOAT_EQ(time, 50.0f);
+  // f3 drains at the same time but reports after its delay
+  EXPECT_EQ(network.complete_next_flow(time), f3);
+  EXPECT_FLOAT_EQ(time, 51.0f);
+  EXPECT_FALSE(network.has_flows());
+
+  // A late arrival takes half of the link from then on
+  network.reset();
+  a = network.add_link(10.0f);
+  f1 = network.start_flow({a}, 100.0f, 0.0f);
+  f2 = network.start_flow({a}, 40.0f, 5.0f);
+  EXPECT_FLOAT_EQ(network.get_rate(f1), 5.0f);
+  EXPECT_EQ(network.complete_next_flow(time), f2);
+  EXPECT_FLOAT_EQ(time, 13.0f);
+  // and gives it back once it is done
+  EXPECT_EQ(network.complete_next_flow(time), f1);
+  EXPECT_FLOAT_EQ(time, 14.0f);
+}
@@ -0,0 +1,105 @@
+#include "flexflow/fusion_planner.h"
+#include "gtest/gtest.h"
+
+using namespace FlexFlow;
+
+namespace {
+
+FusionNode make_node(std::vector<int> const &inputs,
+                     std::vector<int> const &outputs,
+                     size_t view_hash = 1) {
+  FusionNode node;
+  node.fusible = true;
+  node.can_start_group = true;
+  node.view_hash = view_hash;
+  node.inputs = inputs;
+  node.outputs = outputs;
+  return node;
+}
+
+FusionCostModel make_cost_model() {
+  FusionCostModel cost_model;
+  cost_model.max_operators = 64;
+  cost_model.max_tensors = 64;
+  cost_model.max_inputs = 64;
+  cost_model.max_weights = 64;
+  cost_model.max_outputs = 64;
+  return cost_model;
+}
+
+} // namespace
+
+TEST(fusion_planner, fuses_a_chain_per_view) {
+  // input -> a -> b on view 1, then c -> d on view 2
+  FusionNode input;
+  input.outputs = {0};
+  std::vector<FusionNode> nodes = {input,
+                                   make_node({0}, {1}),
+                                   make_node({1}, {2}),
+                                   make_node({2}, {3}, 2),
+                                   make_node({3}, {4}, 2)};
+  FusionPlan plan =
+      plan_fusion(nodes, std::vector<size_t>(5, 100), make_cost_model());
+  ASSERT_EQ(plan.groups.size(), 3);
+  EXPECT_EQ(plan.groups[1], std::vector<int>({1, 2}));
+  EXPECT_EQ(plan.groups[2], std::vector<int>({3, 4}));
+  EXPECT_EQ(plan.decisions[0], FUSION_NOT_FUSIBLE);
+  EXPECT_EQ(plan.decisions[1], FUSION_GROUP_HEAD);
+  EXPECT_EQ(plan.decisions[3], FUSION_VIEW_MISMATCH);
+  EXPECT_EQ(plan.decisions[4], FUSION_FUSED);
+  EXPECT_FLOAT_EQ(plan.saved_time, 2 * make_cost_model().launch_overhead);
+  // a reads the input and writes tensor 1, which b reads from the group
+  EXPECT_EQ(plan.group_mapped_bytes[1], 300);
+}
+
+TEST(fusion_planner, respects_capacity_and_in_place_heads) {
+  std::vector<FusionNode> nodes;
+  for (int i = 0; i < 5; i++) {
+    nodes.push_back(make_node({i}, {i + 1}));
+  }
+  // An in-place operator can end a group but cannot start one
+  nodes[0].can_start_group = false;
+  FusionCostModel cost_model = make_cost_model();
+  cost_model.max_operators = 2;
+  FusionPlan plan = plan_fusion(nodes, std::vector<size_t>(6, 1), cost_model);
+  ASSERT_EQ(plan.groups.size(), 3);
+  EXPECT_EQ(plan.groups[0], std::vector<int>({0}));
+  EXPECT_EQ(plan.groups[1], std::vector<int>({1, 2}));
+  EXPECT_EQ(plan.groups[2], std::vector<int>({3, 4}));
+  EXPECT_EQ(plan.decisions[3], FUSION_OVER_CAPACITY);
+}
+
+TEST(fusion_planner, memory_pressure_splits_groups) {
+  std::vector<FusionNode> nodes;
+  for (int i = 0; i < 4; i++) {
+    nodes.push_back(make_node({i}, {i + 1}));
+  }
+  FusionCostModel cost_model = make_cost_model();
+  cost_model.max_mapped_bytes = 350;
+  FusionPlan plan =
+      plan_fusion(nodes, std::vector<size_t>(5, 100), cost_model);
+  // A group of two operators maps 300 bytes; a third would map 400
+  ASSERT_EQ(plan.groups.size(), 2);
+  EXPECT_EQ(plan.groups[0], std::vector<int>({0, 1}));
+  EXPECT_EQ(plan.decisions[2], FUSION_NOT_PROFITABLE);
+  for (size_t bytes : plan.group_mapped_bytes) {
+    EXPECT_LT(bytes, cost_model.max_mapped_bytes);
+  }
+}
+
+TEST(fusion_planner, joins_the_producer_group) {
+  // b is independent of a and c on another view, and d reads a and c
+  std::vector<FusionNode> nodes = {make_node({0}, {1}),
+                                   make_node({0}, {2}, 2),
+                                   make_node({1}, {3}),
+                                   make_node({2, 3}, {4})};
+  FusionPlan plan =
+      plan_fusion(nodes, std::vector<size_t>(5, 1), make_cost_model());
+  ASSERT_EQ(plan.groups.size(), 3);
+  // c follows its producer a past the group of b
+  EXPECT_EQ(plan.groups[0], std::vector<int>({0, 2}));
+  EXPECT_EQ(plan.groups[1], std::vector<int>({1}));
+  // d must come after both a and b, so it starts a group after b's
+  EXPECT_EQ(plan.groups[2], std::vector<int>({3}));
+  EXPECT_EQ(plan.decisions[3], FUSION_VIEW_MISMATCH);
+}
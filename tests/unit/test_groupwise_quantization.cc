@@ -0,0 +1,106 @@
+#include "flexflow/groupwise_quantization.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace FlexFlow;
+
+namespace {
+
+GroupwiseLayout make_layout(DataType quantization_type,
+                            size_t rows,
+                            size_t cols,
+                            int group_size) {
+  GroupwiseLayout layout;
+  layout.quantization_type = quantization_type;
+  layout.meta_type_size = sizeof(float);
+  layout.rows = rows;
+  layout.cols = cols;
+  layout.group_size = group_size;
+  return layout;
+}
+
+std::vector<float> random_values(size_t num_values, unsigned seed) {
+  std::mt19937 gen(seed);
+  std::normal_distribution<float> dist(0.0f, 1.0f);
+  std::vector<float> values(num_values);
+  for (float &v : values) {
+    v = dist(gen);
+  }
+  return values;
+}
+
+} // namespace
+
+TEST(groupwise_quantization, int4_pack_round_trip) {
+  // Long enough for the eight-at-a-time path and an odd number of pairs
+  std::vector<uint8_t> values(38);
+  for (size_t i = 0; i < values.size(); i++) {
+    values[i] = (i * 7 + 3) % 16;
+  }
+  std::vector<char> packed(values.size() / 2);
+  pack_int4(values.data(), values.size(), packed.data());
+  EXPECT_EQ(static_cast<uint8_t>(packed[0]), (values[0] << 4) | values[1]);
+  EXPECT_EQ(static_cast<uint8_t>(packed[18]), (values[36] << 4) | values[37]);
+  std::vector<uint8_t> unpacked(values.size());
+  unpack_int4(packed.data(), values.size(), unpacked.data());
+  EXPECT_EQ(unpacked, values);
+}
+
+TEST(groupwise_quantization, layout_sizes) {
+  GroupwiseLayout int4 = make_layout(DT_INT4, 4, 256, 128);
+  EXPECT_EQ(int4.groups_per_row(), 2);
+  EXPECT_EQ(int4.row_bytes(), 128 + 2 * 2 * sizeof(float));
+  EXPECT_EQ(int4.total_bytes(), 4 * int4.row_bytes());
+  GroupwiseLayout int8 = make_layout(DT_INT8, 4, 256, 64);
+  EXPECT_EQ(int8.row_bytes(), 256 + 2 * 4 * sizeof(float));
+}
+
+TEST(groupwise_quantization, dequantization_error_is_bounded) {
+  for (DataType type : {DT_INT4, DT_INT8}) {
+    GroupwiseLayout layout = make_layout(type, 8, 256, 128);
+    std::vector<float> weight = random_values(layout.rows * layout.cols, 1);
+    std::vector<char> quantized(layout.total_bytes());
+    quantize_groupwise(weight.data(), layout, quantized.data());
+    std::vector<float> dequantized(weight.size());
+    dequantize_groupwise(quantized.data(), layout, dequantized.data());
+    float levels = type == DT_INT4 ? 15.0f : 255.0f;
+    for (size_t g = 0; g < weight.size() / layout.group_size; g++) {
+      auto first = weight.begin() + g * layout.group_size;
+      auto range = std::minmax_element(first, first + layout.group_size);
+      // Half a quantization step, plus rounding
+      float tolerance = (*range.second - *range.first) / levels / 2 + 1e-5f;
+      for (int i = 0; i < layout.group_size; i++) {
+        size_t idx = g * layout.group_size + i;
+        EXPECT_NEAR(dequantized[idx], weight[idx], tolerance);
+      }
+    }
+  }
+}
+
+TEST(groupwise_quantization, dequant_gemm_matches_dense_gemm) {
+  GroupwiseLayout layout = make_layout(DT_INT4, 16, 384, 128);
+  std::vector<float> weight = random_values(layout.rows * layout.cols, 2);
+  std::vector<char> quantized(layout.total_bytes());
+  quantize_groupwise(weight.data(), layout, quantized.data());
+  std::vector<float> dequantized(weight.size());
+  dequantize_groupwise(quantized.data(), layout, dequantized.data());
+
+  size_t batch_size = 3;
+  std::vector<float> input = random_values(batch_size * layout.cols, 3);
+  std::vector<float> output(batch_size * layout.rows);
+  reference_dequant_gemm(
+      quantized.data(), layout, input.data(), batch_size, output.data());
+  for (size_t b = 0; b < batch_size; b++) {
+    for (size_t r = 0; r < layout.rows; r++) {
+      double expected = 0.0;
+      for (size_t c = 0; c < layout.cols; c++) {
+        expected +=
+            input[b * layout.cols + c] * dequantized[r * layout.cols + c];
+      }
+      EXPECT_NEAR(output[b * layout.rows + r], expected, 1e-3);
+    }
+  }
+}
@@ -0,0 +1,167 @@
+#include "flexflow/kv_cache_quantization.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace FlexFlow;
+
+namespace {
+
+std::vector<float> random_values(size_t num_values, unsigned seed) {
+  std::mt19937 gen(seed);
+  std::normal_distribution<float> dist(0.0f, 1.0f);
+  std::vector<float> values(num_values);
+  for (float &v : values) {
+    v = dist(gen);
+  }
+  return values;
+}
+
+std::vector<float> round_trip(std::vector<float> const &values,
+                              int num_tokens,
+                              int num_heads,
+                              int head_dim) {
+  std::vector<int8_t> quantized(values.size());
+  std::vector<float> scales(num_tokens * num_heads);
+  quantize_kv_int8(values.data(),
+                   num_tokens,
+                   num_heads,
+                   head_dim,
+                   quantized.data(),
+                   scales.data());
+  std::vector<float> dequantized(values.size());
+  dequantize_kv_int8(quantized.data(),
+                     scales.data(),
+                     num_tokens,
+                     num_heads,
+                     head_dim,
+                     dequantized.data());
+  return dequantized;
+}
+
+// Causal grouped-query attention of the num_queries newest of num_tokens
+// cached tokens; query and output are [num_queries][num_q_heads][head_dim],
+// the caches [num_tokens][num_kv_heads][head_dim]
+std::vector<float> attention(std::vector<float> const &query,
+                             std::vector<float> const &key_cache,
+                             std::vector<float> const &value_cache,
+                             int num_queries,
+                             int num_tokens,
+                             int num_q_heads,
+                             int num_kv_heads,
+                             int head_dim) {
+  float scale = 1.0f / std::sqrt(static_cast<float>(head_dim));
+  std::vector<float> output(query.size(), 0.0f);
+  for (int i = 0; i < num_queries; i++) {
+    int num_keys = num_tokens - num_queries + i + 1;
+    for (int h = 0; h < num_q_heads; h++) {
+      int kv_head = h / (num_q_heads / num_kv_heads);
+      float const *q = query.data() + (i * num_q_heads + h) * head_dim;
+      std::vector<float> scores(num_keys);
+      for (int t = 0; t < num_keys; t++) {
+        float const *k =
+            key_cache.data() + (t * num_kv_heads + kv_head) * head_dim;
+        scores[t] = 0.0f;
+        for (int d = 0; d < head_dim; d++) {
+          scores[t] += q[d] * k[d] * scale;
+        }
+      }
+      float max_score = *std::max_element(scores.begin(), scores.end());
+      float sum = 0.0f;
+      for (float &s : scores) {
+        s = std::exp(s - max_score);
+        sum += s;
+      }
+      float *o = output.data() + (i * num_q_heads + h) * head_dim;
+      for (int t = 0; t < num_keys; t++) {
+        float const *v =
+            value_cache.data() + (t * num_kv_heads + kv_head) * head_dim;
+        for (int d = 0; d < head_dim; d++) {
+          o[d] += scores[t] / sum * v[d];
+        }
+      }
+    }
+  }
+  return output;
+}
+
+} // namespace
+
+TEST(kv_cache_quantization, cache_bytes) {
+  EXPECT_EQ(kv_cache_bytes(DT_NONE, DT_HALF, 10, 4, 128), 10u * 4 * 128 * 2);
+  EXPECT_EQ(kv_cache_bytes(DT_NONE, DT_FLOAT, 10, 4, 128), 10u * 4 * 128 * 4);
+  // A byte per value and a float per token and head: about half of half
+  EXPECT_EQ(kv_cache_bytes(DT_INT8, DT_HALF, 10, 4, 128),
+            10u * 4 * 128 + 10 * 4 * sizeof(float));
+}
+
+TEST(kv_cache_quantization, round_trip_error_per_head) {
+  int num_tokens = 5, num_heads = 3, head_dim = 64;
+  std::vector<float> values =
+      random_values(num_tokens * num_heads * head_dim, 1);
+  // An outlier only costs precision to its own token and head
+  values[head_dim + 7] = 100.0f;
+  // and an all-zero head stays exact
+  for (int d = 0; d < head_dim; d++) {
+    values[2 * head_dim + d] = 0.0f;
+  }
+  std::vector<float> dequantized =
+      round_trip(values, num_tokens, num_heads, head_dim);
+  for (int i = 0; i < num_tokens * num_heads; i++) {
+    float max_abs = 0.0f;
+    for (int d = 0; d < head_dim; d++) {
+      max_abs = std::max(max_abs, std::fabs(values[i * head_dim + d]));
+    }
+    float tolerance = 0.5f * max_abs / 127.0f + 1e-6f;
+    for (int d = 0; d < head_dim; d++) {
+      EXPECT_NEAR(dequantized[i * head_dim + d],
+                  values[i * head_dim + d],
+                  tolerance);
+    }
+    if (i != 1) {
+      EXPECT_LT(tolerance, 0.05f);
+    }
+  }
+  EXPECT_FLOAT_EQ(dequantized[head_dim + 7], 100.0f);
+}
+
+TEST(kv_cache_quantization, attention_matches_unquantized_cache) {
+  // Grouped-query attention of a prompt and of a decoding step
+  int num_q_heads = 8, num_kv_heads = 2, head_dim = 128, num_tokens = 37;
+  std::vector<float> keys =
+      random_values(num_tokens * num_kv_heads * head_dim, 2);
+  std::vector<float> values =
+      random_values(num_tokens * num_kv_heads * head_dim, 3);
+  std::vector<float> quantized_keys =
+      round_trip(keys, num_tokens, num_kv_heads, head_dim);
+  std::vector<float> quantized_values =
+      round_trip(values, num_tokens, num_kv_heads, head_dim);
+  for (int num_queries : {num_tokens, 1}) {
+    std::vector<float> query =
+        random_values(num_queries * num_q_heads * head_dim, 4);
+    std::vector<float> expected = attention(query,
+                                            keys,
+                                            values,
+                                            num_queries,
+                                            num_tokens,
+                                            num_q_heads,
+                                            num_kv_heads,
+                                            head_dim);
+    std::vector<float> output = attention(query,
+                                          quantized_keys,
+                                          quantized_values,
+                                          num_queries,
+                                          num_tokens,
+                                          num_q_heads,
+                                          num_kv_heads,
+                                          head_dim);
+    double error = 0.0, norm = 0.0;
+    for (size_t i = 0; i < output.size(); i++) {
+      error += (output[i] - expected[i]) * (output[i] - expected[i]);
+      norm += expected[i] * expected[i];
+    }
+    EXPECT_LT(std::sqrt(error / norm), 0.01);
+  }
+}
@@ -0,0 +1,150 @@
+#include "flexflow/kv_cache_window.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <set>
+#include <vector>
+
+using namespace FlexFlow;
+
+namespace {
+
+std::vector<float> random_values(size_t num_values, unsigned seed) {
+  std::mt19937 gen(seed);
+  std::normal_distribution<float> dist(0.0f, 1.0f);
+  std::vector<float> values(num_values);
+  for (float &v : values) {
+    v = dist(gen);
+  }
+  return values;
+}
+
+KVCacheWindow make_window(int sink_tokens, int window_size) {
+  KVCacheWindow window;
+  window.sink_tokens = sink_tokens;
+  window.window_size = window_size;
+  return window;
+}
+
+// Grouped-query attention of one decoding query ([num_q_heads][head_dim])
+// over num_keys cached tokens ([num_keys][num_kv_heads][head_dim]), which
+// softmax weighs the same in any order
+std::vector<float> decode_attention(float const *query,
+                                    float const *key_cache,
+                                    float const *value_cache,
+                                    int num_keys,
+                                    int num_q_heads,
+                                    int num_kv_heads,
+                                    int head_dim) {
+  float scale = 1.0f / std::sqrt(static_cast<float>(head_dim));
+  std::vector<float> output(num_q_heads * head_dim, 0.0f);
+  for (int h = 0; h < num_q_heads; h++) {
+    int kv_head = h / (num_q_heads / num_kv_heads);
+    std::vector<float> weights(num_keys);
+    for (int t = 0; t < num_keys; t++) {
+      float const *k = key_cache + (t * num_kv_heads + kv_head) * head_dim;
+      weights[t] = 0.0f;
+      for (int d = 0; d < head_dim; d++) {
+        weights[t] += query[h * head_dim + d] * k[d] * scale;
+      }
+    }
+    float max_weight = *std::max_element(weights.begin(), weights.end());
+    float sum = 0.0f;
+    for (float &w : weights) {
+      w = std::exp(w - max_weight);
+      sum += w;
+    }
+    for (int t = 0; t < num_keys; t++) {
+      float const *v = value_cache + (t * num_kv_heads + kv_head) * head_dim;
+      for (int d = 0; d < head_dim; d++) {
+        output[h * head_dim + d] += weights[t] / sum * v[d];
+      }
+    }
+  }
+  return output;
+}
+
+} // namespace
+
+TEST(kv_cache_window, disabled_keeps_every_token) {
+  KVCacheWindow window;
+  EXPECT_FALSE(window.enabled());
+  EXPECT_EQ(window.cache_length(512), 512);
+  EXPECT_EQ(window.slot(300), 300);
+  EXPECT_EQ(window.num_slots(300), 300);
+  EXPECT_EQ(window.position(17, 300), 17);
+}
+
+TEST(kv_cache_window, slots_hold_sinks_and_recent_tokens) {
+  KVCacheWindow window = make_window(4, 6);
+  EXPECT_EQ(window.cache_length(512), 10);
+  for (int num_tokens = 1; num_tokens < 40; num_tokens++) {
+    int num_slots = window.num_slots(num_tokens);
+    EXPECT_EQ(num_slots, std::min(num_tokens, 10));
+    // The slots in use hold the sinks and the most recent tokens, each once
+    std::set<int> positions;
+    for (int slot = 0; slot < num_slots; slot++) {
+      int position = window.position(slot, num_tokens);
+      EXPECT_EQ(window.slot(position), slot);
+      EXPECT_LT(position, num_tokens);
+      EXPECT_TRUE(position < 4 || position >= num_tokens - 6);
+      positions.insert(position);
+    }
+    EXPECT_EQ(positions.size(), num_slots);
+  }
+}
+
+TEST(kv_cache_window, decoding_attends_to_sinks_and_window) {
+  int sink_tokens = 2, window_size = 5, num_tokens = 23;
+  int num_q_heads = 4, num_kv_heads = 2, head_dim = 16;
+  int token_size = num_kv_heads * head_dim;
+  KVCacheWindow window = make_window(sink_tokens, window_size);
+  std::vector<float> keys = random_values(num_tokens * token_size, 1);
+  std::vector<float> values = random_values(num_tokens * token_size, 2);
+  std::vector<float> queries =
+      random_values(num_tokens * num_q_heads * head_dim, 3);
+  int cache_length = window.cache_length(num_tokens);
+  std::vector<float> key_cache(cache_length * token_size);
+  std::vector<float> value_cache(cache_length * token_size);
+  for (int pos = 0; pos < num_tokens; pos++) {
+    // Store the token in its slot, and attend to the slots in use
+    int slot = window.slot(pos);
+    std::copy(keys.begin() + pos * token_size,
+              keys.begin() + (pos + 1) * token_size,
+              key_cache.begin() + slot * token_size);
+    std::copy(values.begin() + pos * token_size,
+              values.begin() + (pos + 1) * token_size,
+              value_cache.begin() + slot * token_size);
+    float const *query = queries.data() + pos * num_q_heads * head_dim;
+    std::vector<float> output = decode_attention(query,
+                                                 key_cache.data(),
+                                                 value_cache.data(),
+                                                 window.num_slots(pos + 1),
+                                                 num_q_heads,
+                                                 num_kv_heads,
+                                                 head_dim);
+    // Reference: the sinks and the window, in order
+    std::vector<float> ref_keys, ref_values;
+    for (int p = 0; p <= pos; p++) {
+      if (p < sink_tokens || p > pos - window_size) {
+        ref_keys.insert(ref_keys.end(),
+                        keys.begin() + p * token_size,
+                        keys.begin() + (p + 1) * token_size);
+        ref_values.insert(ref_values.end(),
+                          values.begin() + p * token_size,
+                          values.begin() + (p + 1) * token_size);
+      }
+    }
+    std::vector<float> expected = decode_attention(query,
+                                                   ref_keys.data(),
+                                                   ref_values.data(),
+                                                   ref_keys.size() / token_size,
+                                                   num_q_heads,
+                                                   num_kv_heads,
+                                                   head_dim);
+    for (size_t i = 0; i < output.size(); i++) {
+      EXPECT_NEAR(output[i], expected[i], 1e-5f);
+    }
+  }
+}
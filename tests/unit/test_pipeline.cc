@@ -0,0 +1,71 @@
+#include "flexflow/pipeline.h"
+#include "gtest/gtest.h"
+
+using namespace FlexFlow;
+
+TEST(pipeline, schedule_makespan) {
+  // Balanced stages without transfer costs: (m + S - 1) * (fwd + bwd)
+  std::vector<float> fwd(4, 1.0f), bwd(4, 2.0f), transfer(3, 0.0f);
+  EXPECT_FLOAT_EQ(simulate_pipeline_schedule(
+                      fwd, bwd, transfer, 8, PIPELINE_SCHEDULE_1F1B, true),
+                  33.0f);
+  EXPECT_FLOAT_EQ(simulate_pipeline_schedule(
+                      fwd, bwd, transfer, 8, PIPELINE_SCHEDULE_GPIPE, true),
+                  33.0f);
+  // Inference only runs the forward passes
+  EXPECT_FLOAT_EQ(simulate_pipeline_schedule(
+                      fwd, bwd, transfer, 8, PIPELINE_SCHEDULE_1F1B, false),
+                  11.0f);
+}
+
+TEST(pipeline, single_micro_batch_is_sequential) {
+  // Without micro-batches the stages cannot overlap: every forward, transfer
+  // and backward runs one after another
+  std::vector<float> fwd = {1.0f, 2.0f, 3.0f}, bwd = {2.0f, 4.0f, 6.0f};
+  std::vector<float> transfer(2, 0.5f);
+  EXPECT_FLOAT_EQ(simulate_pipeline_schedule(
+                      fwd, bwd, transfer, 1, PIPELINE_SCHEDULE_1F1B, true),
+                  20.0f);
+  EXPECT_FLOAT_EQ(simulate_pipeline_schedule(
+                      fwd, bwd, transfer, 1, PIPELINE_SCHEDULE_GPIPE, false),
+                  7.0f);
+}
+
+TEST(pipeline, memory_aware_partition) {
+  std::vector<PipelineSegmentCost> segments(8);
+  for (int i = 0; i < 8; i++) {
+    segments[i].forward_time = 1.0f + i % 3;
+    segments[i].backward_time = 2.0f * segments[i].forward_time;
+    segments[i].weights_memory = 100;
+    segments[i].activation_memory = 800;
+  }
+  std::vector<PipelineStage> stages;
+  ASSERT_TRUE(partition_pipeline_stages(
+      segments, 4, 8, PIPELINE_SCHEDULE_1F1B, SIZE_MAX, stages));
+  ASSERT_EQ(stages.size(), 4);
+  EXPECT_EQ(stages.front().first_segment, 0);
+  EXPECT_EQ(stages.back().last_segment, 7);
+  for (size_t k = 1; k < stages.size(); k++) {
+    EXPECT_EQ(stages[k].first_segment, stages[k - 1].last_segment + 1);
+  }
+  // GPipe keeps all micro-batches alive on every stage while 1F1B only keeps
+  // num_stages - stage of them
+  EXPECT_FALSE(partition_pipeline_stages(
+      segments, 4, 8, PIPELINE_SCHEDULE_GPIPE, 1000, stages));
+  EXPECT_TRUE(partition_pipeline_stages(
+      segments, 4, 8, PIPELINE_SCHEDULE_1F1B, 1000, stages));
+
+  PipelinePlan plan = plan_pipeline(segments,
+                                    4,
+                                    {1, 2, 4, 8},
+                                    {PIPELINE_SCHEDULE_GPIPE,
+                                     PIPELINE_SCHEDULE_1F1B},
+                                    1e6f,
+                                    1000,
+                                    true);
+  ASSERT_TRUE(plan.is_valid());
+  EXPECT_EQ(plan.schedule, PIPELINE_SCHEDULE_1F1B);
+  for (size_t memory : plan.stage_memory) {
+    EXPECT_LE(memory, 1000);
+  }
+}
@@ -0,0 +1,68 @@
+#include "flexflow/rotary_embedding.h"
+#include "gtest/gtest.h"
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace FlexFlow;
+
+namespace {
+
+std::vector<float> random_values(size_t num_values, unsigned seed) {
+  std::mt19937 gen(seed);
+  std::normal_distribution<float> dist(0.0f, 1.0f);
+  std::vector<float> values(num_values);
+  for (float &v : values) {
+    v = dist(gen);
+  }
+  return values;
+}
+
+float dot(std::vector<float> const &a, std::vector<float> const &b) {
+  float result = 0.0f;
+  for (size_t i = 0; i < a.size(); i++) {
+    result += a[i] * b[i];
+  }
+  return result;
+}
+
+} // namespace
+
+TEST(rotary_embedding, table_matches_direct_computation) {
+  int num_positions = 2048, proj_size = 128;
+  std::vector<float> table(rotary_table_size(num_positions, proj_size));
+  EXPECT_EQ(table.size(), 2048u * 128);
+  compute_rotary_table(num_positions, proj_size, table.data());
+  for (int pos : {0, 1, 17, 2047}) {
+    for (int i : {0, 1, 31, 63}) {
+      double freq = pos * std::pow(10000.0, -2.0 * i / proj_size);
+      size_t idx = ((size_t)pos * (proj_size / 2) + i) * 2;
+      EXPECT_NEAR(table[idx], std::cos(freq), 1e-6);
+      EXPECT_NEAR(table[idx + 1], std::sin(freq), 1e-6);
+    }
+  }
+}
+
+TEST(rotary_embedding, scores_depend_on_relative_position) {
+  int num_positions = 512, proj_size = 64;
+  std::vector<float> table(rotary_table_size(num_positions, proj_size));
+  compute_rotary_table(num_positions, proj_size, table.data());
+  std::vector<float> query = random_values(proj_size, 1);
+  std::vector<float> key = random_values(proj_size, 2);
+  auto score = [&](int query_pos, int key_pos) {
+    std::vector<float> q = query, k = key;
+    apply_rotary_table(q.data(), proj_size, query_pos, table.data());
+    apply_rotary_table(k.data(), proj_size, key_pos, table.data());
+    return dot(q, k);
+  };
+  // Position 0 is the identity, and rotations keep the norm
+  EXPECT_FLOAT_EQ(score(0, 0), dot(query, key));
+  std::vector<float> rotated = query;
+  apply_rotary_table(rotated.data(), proj_size, 300, table.data());
+  EXPECT_NEAR(dot(rotated, rotated), dot(query, query), 1e-3f);
+  for (int distance : {0, 1, 5, 100}) {
+    float expected = score(distance, 0);
+    EXPECT_NEAR(score(distance + 7, 7), expected, 1e-3f);
+    EXPECT_NEAR(score(distance + 400, 400), expected, 1e-3f);
+  }
+}
@@ -0,0 +1,47 @@
+#include "flexflow/routing_table.h"
+#include "gtest/gtest.h"
+
+using namespace FlexFlow;
+
+TEST(routing_table, ecmp_paths) {
+  // Hosts 0 and 1 hang off leaves 2 and 3, which both connect to spines 4
+  // and 5; leaf 2 has two parallel links to spine 4
+  int n = 6;
+  std::vector<int> conn(n * n, 0);
+  auto link = [&](int u, int v, int count) {
+    conn[u * n + v] = count;
+    conn[v * n + u] = count;
+  };
+  link(0, 2, 1);
+  link(1, 3, 1);
+  link(2, 4, 2);
+  link(2, 5, 1);
+  link(3, 4, 1);
+  link(3, 5, 1);
+  EcmpRoutingTable table;
+  table.build(conn, n);
+
+  EXPECT_EQ(table.distance(0, 1), 4);
+  EXPECT_EQ(table.distance(2, 3), 2);
+  EXPECT_EQ(table.distance(0, 0), 0);
+  std::vector<int> hops(table.next_hops_begin(2, 1), table.next_hops_end(2, 1));
+  EXPECT_EQ(hops, std::vector<int>({4, 5}));
+
+  auto paths = table.paths(0, 1, 64);
+  ASSERT_EQ(paths.size(), 2);
+  EXPECT_EQ(paths[0].nodes, std::vector<int>({0, 2, 4, 3, 1}));
+  EXPECT_EQ(paths[1].nodes, std::vector<int>({0, 2, 5, 3, 1}));
+  EXPECT_FLOAT_EQ(paths[0].weight, 2.0f / 3.0f);
+  EXPECT_FLOAT_EQ(paths[1].weight, 1.0f / 3.0f);
+
+  // Keeping only the first path renormalizes its weight
+  paths = table.paths(0, 1, 1);
+  ASSERT_EQ(paths.size(), 1);
+  EXPECT_FLOAT_EQ(paths[0].weight, 1.0f);
+
+  // Removing a host link makes it unreachable after a rebuild
+  link(1, 3, 0);
+  table.build(conn, n);
+  EXPECT_EQ(table.distance(0, 1), EcmpRoutingTable::UNREACHABLE);
+  EXPECT_TRUE(table.paths(0, 1, 64).empty());
+}
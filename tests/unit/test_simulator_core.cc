@@ -0,0 +1,81 @@
+#include "flexflow/simulator_core.h"
+#include "gtest/gtest.h"
+#include <queue>
+#include <random>
+
+using namespace FlexFlow;
+
+TEST(sim_event_queue, matches_priority_queue) {
+  SimEventQueue queue;
+  std::priority_queue<float, std::vector<float>, std::greater<float>> expected;
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> delay(0.0f, 10.0f);
+  float now = 0.0f;
+  for (int i = 0; i < 10000; i++) {
+    if (expected.empty() || gen() % 2 == 0) {
+      float time = now + delay(gen);
+      queue.push(time, i);
+      expected.push(time);
+    } else {
+      float time = queue.pop().first;
+      EXPECT_EQ(time, expected.top());
+      expected.pop();
+      now = time;
+    }
+  }
+  EXPECT_EQ(queue.size(), expected.size());
+}
+
+TEST(event_driven_simulator, basic) {
+  EventDrivenSimulator sim;
+  // Simulate twice to make sure reset() keeps the interned names
+  for (int i = 0; i < 2; i++) {
+    sim.reset();
+    SimTaskId a = sim.tasks.add_task(0, 0, 1.0f, sim.names.intern("a"));
+    SimTaskId b = sim.tasks.add_task(0, 1, 2.0f, sim.names.intern("b"));
+    SimTaskId c = sim.tasks.add_task(0, 0, 3.0f, sim.names.intern("c"));
+    SimTaskId d = sim.tasks.add_task(0, 1, 0.5f, sim.names.intern("a"));
+    sim.tasks.add_dependency(a, b);
+    sim.tasks.add_dependency(a, c);
+    sim.tasks.add_dependency(b, c);
+    sim.tasks.finalize();
+    EXPECT_EQ(sim.tasks.num_dependencies(), 3);
+    EXPECT_EQ(sim.tasks.successors_end(a) - sim.tasks.successors_begin(a), 2);
+
+    // d runs on device 1 while a runs, so it does not delay b
+    EXPECT_FLOAT_EQ(sim.simulate(2, true), 6.0f);
+    EXPECT_EQ(sim.schedule.size(), 4);
+    EXPECT_FLOAT_EQ(sim.start_time[c], 3.0f);
+    EXPECT_EQ(sim.tasks.name[d], sim.tasks.name[a]);
+  }
+  EXPECT_EQ(sim.names.size(), 4);
+}
+
+TEST(event_driven_simulator, segmented_transfer) {
+  EventDrivenSimulator sim;
+  std::vector<SimLink> path = {{1, 0.0f, 1.0f, false}, {2, 0.0f, 1.0f, false}};
+  // Two segments of 2 B pipeline through the two links
+  for (bool outbound : {false, true}) {
+    path[1].outbound = outbound;
+    sim.reset();
+    SimTaskId src = sim.tasks.add_task(0, 0, 1.0f, SimNameTable::NO_NAME);
+    SimTaskId dst = sim.tasks.add_task(0, 3, 1.0f, SimNameTable::NO_NAME);
+    add_segmented_transfer(sim.tasks, src, dst, path, 4, 2, 8, 1);
+    EXPECT_EQ(sim.tasks.num_tasks(), 6);
+    sim.tasks.finalize();
+    // An outbound second hop holds the next segment on the first hop until
+    // the current one has left
+    EXPECT_FLOAT_EQ(sim.simulate(4), outbound ? 10.0f : 8.0f);
+  }
+  // The segment count is capped, with the remainder in the last segment
+  sim.reset();
+  SimTaskId src = sim.tasks.add_task(0, 0, 0.0f, SimNameTable::NO_NAME);
+  SimTaskId dst = sim.tasks.add_task(0, 0, 0.0f, SimNameTable::NO_NAME);
+  add_segmented_transfer(sim.tasks, src, dst, {path[0]}, 5, 1, 2, 1);
+  ASSERT_EQ(sim.tasks.num_tasks(), 4);
+  EXPECT_FLOAT_EQ(sim.tasks.run_time[2], 2.0f);
+  EXPECT_FLOAT_EQ(sim.tasks.run_time[3], 3.0f);
+  // An empty path is a plain dependency
+  add_segmented_transfer(sim.tasks, src, dst, {}, 5, 1, 2, 1);
+  EXPECT_EQ(sim.tasks.num_dependencies(), 5);
+}
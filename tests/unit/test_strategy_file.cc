@@ -0,0 +1,177 @@
+#include "flexflow/strategy_file.h"
+#include "gtest/gtest.h"
+#include <cstdio>
+#include <fstream>
+
+using namespace FlexFlow;
+
+namespace {
+
+StrategyLayer make_layer(int op_type,
+                         std::string const &name,
+                         uint64_t layer_guid,
+                         uint64_t output_guid) {
+  StrategyLayer layer;
+  layer.key.op_type = op_type;
+  layer.key.params_hash = 1000 + op_type;
+  layer.key.name = name;
+  layer.layer_guid = layer_guid;
+  layer.output_guids.push_back(output_guid);
+  return layer;
+}
+
+StrategyFile make_strategy() {
+  StrategyFile strategy;
+  strategy.num_nodes = 2;
+  strategy.gpus_per_node = 4;
+  strategy.cpus_per_node = 8;
+  strategy.computation_mode = 1;
+  strategy.model_id = 3;
+  strategy.layers.push_back(make_layer(1, "input", 1000000, 2000000));
+  strategy.layers.push_back(make_layer(2, "dense", 1000001, 2000001));
+  strategy.layers.push_back(make_layer(2, "dense", 1000002, 2000002));
+  strategy.pcg = {'p', 'c', 'g', '\0', 'x'};
+  return strategy;
+}
+
+} // namespace
+
+TEST(strategy_file, round_trip) {
+  std::string filename = "test_strategy_file.bin";
+  StrategyFile strategy = make_strategy();
+  ASSERT_TRUE(write_strategy_file(filename, strategy));
+  StrategyFile loaded;
+  std::string error;
+  ASSERT_TRUE(read_strategy_file(filename, loaded, error)) << error;
+  EXPECT_EQ(loaded.num_nodes, 2);
+  EXPECT_EQ(loaded.gpus_per_node, 4);
+  EXPECT_EQ(loaded.cpus_per_node, 8);
+  EXPECT_EQ(loaded.computation_mode, 1);
+  EXPECT_EQ(loaded.model_id, 3);
+  ASSERT_EQ(loaded.layers.size(), 3);
+  EXPECT_TRUE(loaded.layers[2].key == strategy.layers[2].key);
+  EXPECT_EQ(loaded.layers[2].layer_guid, 1000002);
+  EXPECT_EQ(loaded.layers[2].output_guids, strategy.layers[2].output_guids);
+  EXPECT_EQ(loaded.pcg, strategy.pcg);
+  StrategyGuidMap guid_map;
+  EXPECT_EQ(validate_strategy(loaded, strategy, guid_map), "");
+  std::remove(filename.c_str());
+}
+
+TEST(strategy_file, rejects_corrupt_files) {
+  std::string filename = "test_strategy_file_corrupt.bin";
+  ASSERT_TRUE(write_strategy_file(filename, make_strategy()));
+  StrategyFile loaded;
+  std::string error;
+  {
+    // Flip a byte of the PCG
+    std::fstream file(filename,
+                      std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(-10, std::ios::end);
+    file.put('?');
+  }
+  EXPECT_FALSE(read_strategy_file(filename, loaded, error));
+  EXPECT_NE(error.find("checksum"), std::string::npos);
+  {
+    // Another version
+    std::fstream file(filename,
+                      std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(8);
+    file.put(char(StrategyFile::VERSION + 1));
+  }
+  EXPECT_FALSE(read_strategy_file(filename, loaded, error));
+  EXPECT_NE(error.find("version"), std::string::npos);
+  std::remove(filename.c_str());
+  EXPECT_FALSE(read_strategy_file(filename, loaded, error));
+}
+
+TEST(strategy_file, validate_against_model) {
+  StrategyFile strategy = make_strategy();
+  StrategyGuidMap guid_map;
+  // The order of the layers does not matter
+  StrategyFile model = strategy;
+  model.pcg.clear();
+  std::swap(model.layers[0], model.layers[2]);
+  EXPECT_EQ(validate_strategy(strategy, model, guid_map), "");
+  // Nor does it for layers with the same key, as long as the guids match
+  std::swap(model.layers[0], model.layers[1]);
+  EXPECT_EQ(validate_strategy(strategy, model, guid_map), "");
+  EXPECT_EQ(guid_map.layer_guids.at(1000001), 1000001);
+  EXPECT_EQ(guid_map.layer_guids.at(1000002), 1000002);
+
+  model = strategy;
+  model.gpus_per_node = 8;
+  EXPECT_NE(validate_strategy(strategy, model, guid_map), "");
+
+  model = strategy;
+  model.layers[1].key.params_hash++;
+  EXPECT_NE(validate_strategy(strategy, model, guid_map)
+                .find("not in the strategy"),
+            std::string::npos);
+
+  model = strategy;
+  model.layers.pop_back();
+  EXPECT_NE(
+      validate_strategy(strategy, model, guid_map).find("not in the model"),
+      std::string::npos);
+
+  model = strategy;
+  model.layers[2].output_guids.push_back(2000003);
+  EXPECT_NE(validate_strategy(strategy, model, guid_map).find("outputs"),
+            std::string::npos);
+}
+
+TEST(strategy_file, maps_guids_of_another_construction_order) {
+  StrategyFile strategy = make_strategy();
+  strategy.layers.push_back(make_layer(3, "softmax", 1000003, 2000003));
+  // The same model built by another process, which created its tensors and
+  // layers in another order: softmax first, then input and both dense
+  StrategyFile model;
+  model.num_nodes = 2;
+  model.gpus_per_node = 4;
+  model.cpus_per_node = 8;
+  model.computation_mode = 1;
+  model.model_id = 0;
+  model.layers.push_back(make_layer(3, "softmax", 5000010, 6000010));
+  model.layers.push_back(make_layer(1, "input", 5000011, 6000011));
+  model.layers.push_back(make_layer(2, "dense", 5000012, 6000012));
+  model.layers.push_back(make_layer(2, "dense", 5000013, 6000013));
+  StrategyGuidMap guid_map;
+  ASSERT_EQ(validate_strategy(strategy, model, guid_map), "");
+  EXPECT_EQ(guid_map.model_id, 0);
+  ASSERT_EQ(guid_map.layer_guids.size(), 4);
+  EXPECT_EQ(guid_map.layer_guids.at(1000003), 5000010);
+  EXPECT_EQ(guid_map.layer_guids.at(1000000), 5000011);
+  // Layers with the same key are matched in the order they were created in
+  EXPECT_EQ(guid_map.layer_guids.at(1000001), 5000012);
+  EXPECT_EQ(guid_map.layer_guids.at(1000002), 5000013);
+  ASSERT_EQ(guid_map.tensor_guids.size(), 4);
+  EXPECT_EQ(guid_map.tensor_guids.at(2000000), 6000011);
+  EXPECT_EQ(guid_map.tensor_guids.at(2000003), 6000010);
+
+  // A failed validation leaves the map alone
+  model.layers.pop_back();
+  EXPECT_NE(validate_strategy(strategy, model, guid_map), "");
+  EXPECT_EQ(guid_map.layer_guids.size(), 4);
+}
+
+TEST(strategy_file, cache_paths_and_file_hashes) {
+  EXPECT_EQ(get_cached_strategy_path("cache", 0x1234),
+            "cache/0000000000001234.strategy");
+  std::string filename = "test_strategy_file_hash.txt";
+  StableHasher before, after, missing;
+  {
+    std::ofstream file(filename);
+    file << "machine model";
+  }
+  before.update_file(filename);
+  {
+    std::ofstream file(filename, std::ios::app);
+    file << " v2";
+  }
+  after.update_file(filename);
+  EXPECT_NE(before.digest(), after.digest());
+  std::remove(filename.c_str());
+  missing.update_file(filename);
+  EXPECT_NE(missing.digest(), after.digest());
+}
@@ -0,0 +1,74 @@
+#include "flexflow/task_thread_executor.h"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <map>
+#include <mutex>
+
+using namespace FlexFlow;
+
+namespace {
+
+// Stands for the simulator with the profiling cost model: measuring an
+// operator launches kernels, which only the task thread can do, and costs
+// are cached for all search threads
+class FakeProfiler {
+public:
+  FakeProfiler(TaskThreadExecutor &_executor)
+      : executor(_executor), task_thread(std::this_thread::get_id()) {}
+  float measure(int op) {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    auto const &it = cache.find(op);
+    if (it != cache.end()) {
+      return it->second;
+    }
+    float cost = 0.0f;
+    executor.execute([&] {
+      // get_legion_stream asserts on threads without a task stream
+      EXPECT_EQ(std::this_thread::get_id(), task_thread);
+      num_profiled++;
+      cost = 1.0f + op;
+    });
+    cache[op] = cost;
+    return cost;
+  }
+
+  TaskThreadExecutor &executor;
+  std::thread::id task_thread;
+  std::mutex cache_mutex;
+  std::map<int, float> cache;
+  std::atomic<int> num_profiled{0};
+};
+
+} // namespace
+
+TEST(task_thread_executor, parallel_search_profiles_on_task_thread) {
+  TaskThreadExecutor executor;
+  FakeProfiler profiler(executor);
+  int const num_threads = 4, num_ops = 64;
+  std::atomic<int> next_candidate{0};
+  std::vector<float> best(num_threads, 1e9f);
+  executor.run(num_threads, [&](int thread) {
+    // Threads race for candidates whose operators overlap, so they hit both
+    // cached and missing costs
+    for (int c = next_candidate++; c < 256; c = next_candidate++) {
+      float cost = profiler.measure(c % num_ops) +
+                   profiler.measure((c * 7 + 3) % num_ops);
+      best[thread] = std::min(best[thread], cost);
+    }
+  });
+  EXPECT_EQ(profiler.num_profiled, num_ops);
+  float overall = *std::min_element(best.begin(), best.end());
+  EXPECT_FLOAT_EQ(overall, 1.0f + 1.0f + 3.0f);
+}
+
+TEST(task_thread_executor, runs_work_directly_outside_of_run) {
+  TaskThreadExecutor executor;
+  std::thread::id caller;
+  executor.execute([&] { caller = std::this_thread::get_id(); });
+  EXPECT_EQ(caller, std::this_thread::get_id());
+  std::thread other([&] {
+    executor.execute([&] { caller = std::this_thread::get_id(); });
+    EXPECT_EQ(caller, std::this_thread::get_id());
+  });
+  other.join();
+}
@@ -0,0 +1,136 @@
+#include "flexflow/weight_offload.h"
+#include "gtest/gtest.h"
+#include <cstring>
+#include <vector>
+
+using namespace FlexFlow;
+
+namespace {
+
+// Host copies with fixed timings, so that the plan is deterministic
+class TimedHostQueue : public HostWeightCopyQueue {
+public:
+  TimedHostQueue(float _copy_time, float _compute_time)
+      : copy_ms(_copy_time), compute_ms(_compute_time) {}
+  float copy_time(int /*slot*/) override {
+    return copy_ms;
+  }
+  float compute_time(int /*from_slot*/, int /*to_slot*/) override {
+    return compute_ms;
+  }
+
+private:
+  float copy_ms, compute_ms;
+};
+
+std::vector<OffloadLayer> uniform_layers(int num_layers,
+                                         float copy_time,
+                                         float compute_time) {
+  return std::vector<OffloadLayer>(num_layers,
+                                   {1 << 20, copy_time, compute_time});
+}
+
+} // namespace
+
+TEST(weight_offload, simulated_pipeline) {
+  std::vector<OffloadLayer> layers = uniform_layers(8, 2.0f, 1.0f);
+  // No prefetching: every copy and every layer in turn
+  EXPECT_FLOAT_EQ(simulate_weight_offload(layers, 1), 24.0f);
+  // Copy-bound once a layer is loaded ahead
+  EXPECT_FLOAT_EQ(simulate_weight_offload(layers, 2), 16.0f);
+  EXPECT_FLOAT_EQ(simulate_weight_offload(layers, 4), 16.0f);
+  // Resident weights
+  EXPECT_FLOAT_EQ(simulate_weight_offload(layers, 8), 8.0f);
+  // Compute-bound
+  layers = uniform_layers(8, 1.0f, 2.0f);
+  EXPECT_FLOAT_EQ(simulate_weight_offload(layers, 2), 16.0f);
+}
+
+TEST(weight_offload, plan_picks_shallowest_fast_depth) {
+  std::vector<OffloadLayer> layers = uniform_layers(8, 1.0f, 2.0f);
+  layers[3].bytes = 3 << 20;
+  // A deeper ring does not help once the copies are hidden
+  WeightOffloadPlan plan = plan_weight_offload(layers, 64 << 20, -1);
+  EXPECT_EQ(plan.prefetch_depth, 1);
+  EXPECT_EQ(plan.slot_bytes, 3u << 20);
+  EXPECT_FLOAT_EQ(plan.step_time, 16.0f);
+  EXPECT_FLOAT_EQ(plan.sync_step_time, 24.0f);
+  // A copy much slower than its layer: the other layers' slack hides it only
+  // with enough layers loaded ahead
+  layers = uniform_layers(8, 0.5f, 2.0f);
+  layers[5].copy_time = 6.0f;
+  plan = plan_weight_offload(layers, 64 << 20, -1);
+  EXPECT_EQ(plan.prefetch_depth, 3);
+  EXPECT_FLOAT_EQ(plan.step_time, 16.0f);
+  // Clamped to the ring
+  plan = plan_weight_offload(layers, 5 << 20, 6);
+  EXPECT_EQ(plan.num_slots, 5);
+  plan = plan_weight_offload(layers, 64 << 20, 0);
+  EXPECT_EQ(plan.num_slots, 1);
+}
+
+TEST(weight_offload, engine_prefetches_through_ring) {
+  int num_layers = 6;
+  size_t bytes = 1000;
+  std::vector<std::vector<char>> weights(num_layers, std::vector<char>(bytes));
+  for (int i = 0; i < num_layers; i++) {
+    memset(weights[i].data(), 'a' + i, bytes);
+  }
+  size_t scratch = 300;
+  std::vector<char> reserve(4096);
+  WeightOffloadEngine engine(
+      reserve.data(), reserve.size(), new TimedHostQueue(2.0f, 1.0f), 4);
+  engine.reserve_scratch(scratch);
+  int num_steps = 5;
+  for (int step = 0; step < num_steps; step++) {
+    for (int i = 0; i < num_layers; i++) {
+      char *staged = static_cast<char *>(
+          engine.acquire(weights[i].data(), bytes, nullptr));
+      // After the scratch space, inside the reserve space
+      EXPECT_GE(staged, reserve.data() + scratch);
+      EXPECT_LE(staged + bytes, reserve.data() + reserve.size());
+      EXPECT_EQ(memcmp(staged, weights[i].data(), bytes), 0);
+      engine.release(weights[i].data(), nullptr);
+    }
+    // The plan is made when the step after the calibration starts
+    EXPECT_EQ(engine.is_calibrating(), step < engine.calibration_steps);
+  }
+  // Depth 4 is clamped to the three slots of 1024 bytes that fit after the
+  // 512 bytes of scratch space
+  WeightOffloadPlan const &plan = engine.get_plan();
+  EXPECT_EQ(plan.num_slots, 3);
+  EXPECT_EQ(plan.slot_bytes, 1024u);
+  // Calibration copies every layer; then only the first slots miss, and
+  // every release loads a layer ahead
+  size_t calibration_copies = engine.calibration_steps * num_layers;
+  EXPECT_EQ(engine.get_num_copies(), calibration_copies + plan.num_slots);
+  EXPECT_EQ(engine.get_num_prefetches(),
+            (num_steps - engine.calibration_steps) * num_layers);
+
+  // A new layer restarts the calibration, and is still served
+  std::vector<char> extra(bytes, 'z');
+  char *staged =
+      static_cast<char *>(engine.acquire(extra.data(), bytes, nullptr));
+  EXPECT_TRUE(engine.is_calibrating());
+  EXPECT_EQ(memcmp(staged, extra.data(), bytes), 0);
+  engine.release(extra.data(), nullptr);
+}
+
+TEST(weight_offload, engine_keeps_small_models_resident) {
+  int num_layers = 3;
+  size_t bytes = 256;
+  std::vector<std::vector<char>> weights(num_layers, std::vector<char>(bytes));
+  std::vector<char> reserve(4096);
+  WeightOffloadEngine engine(
+      reserve.data(), reserve.size(), new TimedHostQueue(2.0f, 1.0f), -1);
+  for (int step = 0; step < 4; step++) {
+    for (int i = 0; i < num_layers; i++) {
+      engine.acquire(weights[i].data(), bytes, nullptr);
+      engine.release(weights[i].data(), nullptr);
+    }
+  }
+  EXPECT_EQ(engine.get_plan().num_slots, num_layers);
+  EXPECT_EQ(engine.get_num_copies(),
+            (engine.calibration_steps + 1) * num_layers);
+  EXPECT_EQ(engine.get_num_prefetches(), 0u);
+}
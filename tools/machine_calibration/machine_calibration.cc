@@ -0,0 +1,828 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Probes the local host and writes a machine model file in the format of
+ * machine_config_example, to be used with --machine-model-version 1
+ * --machine-model-file.
+ *
+ * Measured on this host:
+ *   - sockets (NUMA nodes with CPUs), cores per socket, and NVIDIA GPUs
+ *   - membus: single-thread memcpy bandwidth and shared-memory ping-pong
+ *     latency between two cores of a socket
+ *   - upi: the same across sockets, when there is more than one
+ *   - nic: TCP over loopback, only a stand-in until numbers measured across
+ *     nodes are merged in
+ *   - cpu_peak_gflops: FMA throughput of one core
+ *   - cpu_mem_bandwidth: STREAM triad bandwidth of a socket, per core
+ * The PCI-e and NVLink entries keep the values of machine_config_example
+ * unless they are merged in from a file measured on a GPU node (e.g., with
+ * the Memspeed benchmark in legion/test/realm).
+ *
+ * Merging a file measured on another node type keeps its structure (counts
+ * and paths) and combines the numbers conservatively, i.e., the lower
+ * bandwidth and peak and the higher latency, since the machine model has a
+ * single node type.
+ *
+ * Usage: machine_calibration [-o file] [--num-nodes n] [--merge file]...
+ *                            [--set key=value]... [--no-probe]
+ *                            [--array-mb mb] [--iters n]
+ */
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// EnhancedMachineModel scales bandwidths in the file by 1024 * 1024 to get
+// bytes per ms
+double const BYTES_PER_MS_PER_UNIT = 1024.0 * 1024.0;
+
+double elapsed_ms(Clock::time_point start, Clock::time_point end) {
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+/*
+ * Host topology
+ */
+
+struct HostTopology {
+  std::vector<std::vector<int>> socket_cpus;
+  int num_gpus = 0;
+};
+
+std::vector<std::string> list_dir(std::string const &path,
+                                  std::string const &prefix) {
+  std::vector<std::string> names;
+  DIR *dir = opendir(path.c_str());
+  if (dir == nullptr) {
+    return names;
+  }
+  while (struct dirent *e = readdir(dir)) {
+    std::string name = e->d_name;
+    if (name.compare(0, prefix.size(), prefix) == 0 && name != "." &&
+        name != "..") {
+      names.push_back(name);
+    }
+  }
+  closedir(dir);
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+// Parses a kernel cpulist such as "0-9,20-29"
+std::vector<int> parse_cpulist(std::string const &list) {
+  std::vector<int> cpus;
+  std::istringstream iss(list);
+  std::string range;
+  while (std::getline(iss, range, ',')) {
+    if (range.empty() || range == "\n") {
+      continue;
+    }
+    size_t dash = range.find('-');
+    int lo = atoi(range.substr(0, dash).c_str());
+    int hi = dash == std::string::npos ? lo
+                                       : atoi(range.substr(dash + 1).c_str());
+    for (int c = lo; c <= hi; c++) {
+      cpus.push_back(c);
+    }
+  }
+  return cpus;
+}
+
+HostTopology probe_topology() {
+  HostTopology topo;
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  bool has_mask = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+  auto usable = [&](int cpu) {
+    return !has_mask || (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed));
+  };
+  // NUMA nodes with CPUs, skipping memory-only nodes
+  std::string node_root = "/sys/devices/system/node";
+  for (std::string const &node : list_dir(node_root, "node")) {
+    std::ifstream f(node_root + "/" + node + "/cpulist");
+    std::string list;
+    std::getline(f, list);
+    std::vector<int> cpus;
+    for (int c : parse_cpulist(list)) {
+      if (usable(c)) {
+        cpus.push_back(c);
+      }
+    }
+    if (!cpus.empty()) {
+      topo.socket_cpus.push_back(cpus);
+    }
+  }
+  // Fall back to physical packages, then to a single socket
+  if (topo.socket_cpus.empty()) {
+    std::string cpu_root = "/sys/devices/system/cpu";
+    std::map<int, std::vector<int>> packages;
+    for (std::string const &name : list_dir(cpu_root, "cpu")) {
+      if (name.size() < 4 || !isdigit(name[3])) {
+        continue;
+      }
+      int cpu = atoi(name.c_str() + 3);
+      std::ifstream f(cpu_root + "/" + name +
+                      "/topology/physical_package_id");
+      int package = 0;
+      if (f >> package && usable(cpu)) {
+        packages[package].push_back(cpu);
+      }
+    }
+    for (auto &p : packages) {
+      std::sort(p.second.begin(), p.second.end());
+      topo.socket_cpus.push_back(p.second);
+    }
+  }
+  if (topo.socket_cpus.empty()) {
+    std::vector<int> cpus;
+    int n = std::max(1u, std::thread::hardware_concurrency());
+    for (int c = 0; c < n; c++) {
+      cpus.push_back(c);
+    }
+    topo.socket_cpus.push_back(cpus);
+  }
+  topo.num_gpus = list_dir("/proc/driver/nvidia/gpus", "").size();
+  return topo;
+}
+
+/*
+ * Probes
+ */
+
+void pin_to_cpu(int cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+    fprintf(stderr, "[Warning] could not pin a probe thread to CPU %d\n", cpu);
+  }
+}
+
+class Barrier {
+public:
+  explicit Barrier(int _count) : count(_count) {}
+  void wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    int gen = generation;
+    if (++waiting == count) {
+      generation++;
+      waiting = 0;
+      cv.notify_all();
+    } else {
+      cv.wait(lock, [&] { return gen != generation; });
+    }
+  }
+
+private:
+  std::mutex mutex;
+  std::condition_variable cv;
+  int count, waiting = 0, generation = 0;
+};
+
+// Keeps the compiler from dropping the probe kernels
+volatile double sink;
+
+// STREAM triad on every core of a socket, each core on its own first-touched
+// slice. Returns the aggregate bandwidth in bytes per ms (best iteration).
+double stream_triad(std::vector<int> const &cpus,
+                    size_t array_bytes,
+                    int iters) {
+  int n = cpus.size();
+  size_t len = std::max<size_t>(array_bytes / sizeof(double) / n, 1024);
+  Barrier barrier(n);
+  double best_ms = 0.0;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < n; t++) {
+    threads.emplace_back([&, t] {
+      pin_to_cpu(cpus[t]);
+      std::vector<double> a(len, 0.0), b(len, 1.0), c(len, 2.0);
+      double const scalar = 3.0;
+      for (int it = 0; it < iters; it++) {
+        barrier.wait();
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i < len; i++) {
+          a[i] = b[i] + scalar * c[i];
+        }
+        barrier.wait();
+        if (t == 0) {
+          double ms = elapsed_ms(start, Clock::now());
+          best_ms = it == 0 ? ms : std::min(best_ms, ms);
+        }
+      }
+      if (t == 0) {
+        sink = a[len / 2];
+      }
+    });
+  }
+  for (std::thread &t : threads) {
+    t.join();
+  }
+  return 3.0 * sizeof(double) * len * n / best_ms;
+}
+
+// memcpy from a buffer first touched on src_cpu by a thread on dst_cpu.
+// Returns bytes per ms (best iteration).
+double copy_bandwidth(int src_cpu, int dst_cpu, size_t bytes, int iters) {
+  std::vector<char> src;
+  std::thread owner([&] {
+    pin_to_cpu(src_cpu);
+    src.assign(bytes, 1);
+  });
+  owner.join();
+  double best_ms = 0.0;
+  std::thread copier([&] {
+    pin_to_cpu(dst_cpu);
+    std::vector<char> dst(bytes, 0);
+    for (int it = 0; it < iters; it++) {
+      Clock::time_point start = Clock::now();
+      memcpy(dst.data(), src.data(), bytes);
+      double ms = elapsed_ms(start, Clock::now());
+      best_ms = it == 0 ? ms : std::min(best_ms, ms);
+    }
+    sink = dst[bytes / 2];
+  });
+  copier.join();
+  return bytes / best_ms;
+}
+
+// One-way latency in ms of a shared-memory ping-pong between two cores
+double pingpong_latency(int cpu_a, int cpu_b, int round_trips) {
+  alignas(64) std::atomic<int> flag{0};
+  std::thread pong([&] {
+    pin_to_cpu(cpu_b);
+    for (int i = 0; i < round_trips; i++) {
+      while (flag.load(std::memory_order_acquire) != 2 * i + 1) {
+      }
+      flag.store(2 * i + 2, std::memory_order_release);
+    }
+  });
+  double ms = 0.0;
+  std::thread ping([&] {
+    pin_to_cpu(cpu_a);
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < round_trips; i++) {
+      flag.store(2 * i + 1, std::memory_order_release);
+      while (flag.load(std::memory_order_acquire) != 2 * i + 2) {
+      }
+    }
+    ms = elapsed_ms(start, Clock::now());
+  });
+  ping.join();
+  pong.join();
+  return ms / round_trips / 2;
+}
+
+// FMA throughput of one core in GFLOPS. Enough independent accumulators to
+// fill the FMA pipelines of AVX-512 hosts.
+double peak_gflops(int cpu, long iters) {
+  double gflops = 0.0;
+  std::thread t([&] {
+    pin_to_cpu(cpu);
+    int const LANES = 128;
+    alignas(64) float acc[LANES];
+    for (int j = 0; j < LANES; j++) {
+      acc[j] = 1.0f + j * 1e-3f;
+    }
+    float const mul = 0.999999f, add = 1e-6f;
+    Clock::time_point start = Clock::now();
+    for (long i = 0; i < iters; i++) {
+      for (int j = 0; j < LANES; j++) {
+        acc[j] = acc[j] * mul + add;
+      }
+    }
+    double ms = elapsed_ms(start, Clock::now());
+    double sum = 0.0;
+    for (int j = 0; j < LANES; j++) {
+      sum += acc[j];
+    }
+    sink = sum;
+    gflops = 2.0 * LANES * iters / ms / 1e6;
+  });
+  t.join();
+  return gflops;
+}
+
+struct LoopbackResult {
+  bool ok = false;
+  double latency = 0.0;   // one-way, in ms
+  double bandwidth = 0.0; // in bytes per ms
+};
+
+bool read_fully(int fd, char *buf, size_t bytes) {
+  while (bytes > 0) {
+    ssize_t r = recv(fd, buf, bytes, 0);
+    if (r <= 0) {
+      return false;
+    }
+    buf += r;
+    bytes -= r;
+  }
+  return true;
+}
+
+bool write_fully(int fd, char const *buf, size_t bytes) {
+  while (bytes > 0) {
+    ssize_t r = send(fd, buf, bytes, 0);
+    if (r <= 0) {
+      return false;
+    }
+    buf += r;
+    bytes -= r;
+  }
+  return true;
+}
+
+// TCP over 127.0.0.1: a one-byte ping-pong, then a bulk transfer
+// acknowledged by the receiver
+LoopbackResult probe_loopback(size_t bytes, int round_trips) {
+  LoopbackResult result;
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  if (listener < 0) {
+    return result;
+  }
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  socklen_t addr_len = sizeof(addr);
+  if (bind(listener, (sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(listener, 1) != 0 ||
+      getsockname(listener, (sockaddr *)&addr, &addr_len) != 0) {
+    close(listener);
+    return result;
+  }
+  size_t const CHUNK = 1 << 20;
+  int one = 1;
+  bool server_ok = false;
+  std::thread server([&] {
+    int fd = accept(listener, nullptr, nullptr);
+    if (fd < 0) {
+      return;
+    }
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    std::vector<char> buf(CHUNK);
+    bool ok = true;
+    for (int i = 0; ok && i < round_trips; i++) {
+      ok = read_fully(fd, buf.data(), 1) && write_fully(fd, buf.data(), 1);
+    }
+    for (size_t left = bytes; ok && left > 0;) {
+      size_t n = std::min(left, CHUNK);
+      ok = read_fully(fd, buf.data(), n);
+      left -= n;
+    }
+    server_ok = ok && write_fully(fd, buf.data(), 1);
+    close(fd);
+  });
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  bool ok = fd >= 0 && connect(fd, (sockaddr *)&addr, sizeof(addr)) == 0;
+  if (ok) {
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    std::vector<char> buf(CHUNK, 1);
+    Clock::time_point start = Clock::now();
+    for (int i = 0; ok && i < round_trips; i++) {
+      ok = write_fully(fd, buf.data(), 1) && read_fully(fd, buf.data(), 1);
+    }
+    result.latency = elapsed_ms(start, Clock::now()) / round_trips / 2;
+    start = Clock::now();
+    for (size_t left = bytes; ok && left > 0;) {
+      size_t n = std::min(left, CHUNK);
+      ok = write_fully(fd, buf.data(), n);
+      left -= n;
+    }
+    ok = ok && read_fully(fd, buf.data(), 1);
+    result.bandwidth = bytes / elapsed_ms(start, Clock::now());
+  }
+  if (fd >= 0) {
+    // Unblocks the server if the client failed half way
+    shutdown(fd, SHUT_RDWR);
+  } else {
+    shutdown(listener, SHUT_RDWR);
+  }
+  server.join();
+  if (fd >= 0) {
+    close(fd);
+  }
+  close(listener);
+  result.ok = ok && server_ok;
+  return result;
+}
+
+/*
+ * Machine model files
+ */
+
+struct Entry {
+  std::string value;
+  std::string note; ///< Where the value comes from
+  bool measured;    ///< False for placeholders from machine_config_example
+};
+
+using MachineFile = std::map<std::string, Entry>;
+
+// Notes of the entries that are not measurements of the host
+std::string const NOT_MEASURED = "not measured, from machine_config_example";
+std::string const LOOPBACK =
+    "TCP over loopback, merge in numbers measured across nodes";
+
+struct Section {
+  std::string name;
+  std::string comment;
+  std::vector<std::string> keys;
+  bool always_emit; ///< The parser has no defaults for these keys
+};
+
+std::vector<Section> const SECTIONS = {
+    {"comp_device",
+     "Compute devices are created evenly based on the following settings.",
+     {"num_nodes",
+      "num_sockets_per_node",
+      "num_cpus_per_socket",
+      "num_gpus_per_socket"},
+     true},
+    {"comm_device",
+     "Latency in ms and bandwidth in GB/s of the links between memories.",
+     {"membus_latency",
+      "membus_bandwidth",
+      "upi_latency",
+      "upi_bandwidth",
+      "nic_latency",
+      "nic_bandwidth",
+      "nic_persocket",
+      "pci_latency",
+      "pci_bandwidth",
+      "nvlink_latency",
+      "nvlink_bandwidth"},
+     true},
+    {"roofline",
+     "Peak throughput for --cost-model analytical, per GPU and per core.",
+     {"gpu_peak_tflops",
+      "gpu_half_peak_tflops",
+      "gpu_mem_bandwidth",
+      "cpu_peak_gflops",
+      "cpu_mem_bandwidth"},
+     false},
+    {"paths",
+     "Communication devices crossed between memories.",
+     {"intra_socket_sys_mem_to_sys_mem",
+      "inter_socket_sys_mem_to_sys_mem",
+      "inter_node_sys_mem_to_sys_mem",
+      "intra_socket_gpu_fb_mem_to_gpu_fb_mem",
+      "inter_socket_gpu_fb_mem_to_gpu_fb_mem",
+      "inter_node_gpu_fb_mem_to_gpu_fb_mem",
+      "intra_socket_sys_mem_to_gpu_fb_mem",
+      "inter_socket_sys_mem_to_gpu_fb_mem",
+      "inter_node_sys_mem_to_gpu_fb_mem",
+      "intra_socket_gpu_fb_mem_to_sys_mem",
+      "inter_socket_gpu_fb_mem_to_sys_mem",
+      "inter_node_gpu_fb_mem_to_sys_mem"},
+     true},
+};
+
+bool ends_with(std::string const &s, std::string const &suffix) {
+  return s.size() >= suffix.size() &&
+         s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// The values of machine_config_example
+MachineFile placeholders() {
+  std::vector<std::pair<std::string, std::string>> const defaults = {
+      {"num_nodes", "1"},
+      {"num_sockets_per_node", "1"},
+      {"num_cpus_per_socket", "1"},
+      {"num_gpus_per_socket", "0"},
+      {"membus_latency", "0.00003"},
+      {"membus_bandwidth", "4.26623"},
+      {"upi_latency", "0.0004"},
+      {"upi_bandwidth", "10.14039"},
+      {"nic_latency", "0.000507"},
+      {"nic_bandwidth", "10.9448431"},
+      {"nic_persocket", "0"},
+      {"pci_latency", "0.001"},
+      {"pci_bandwidth", "12.578468749999999"},
+      {"nvlink_latency", "0.001"},
+      {"nvlink_bandwidth", "18.52"},
+      {"intra_socket_sys_mem_to_sys_mem", "membus"},
+      {"inter_socket_sys_mem_to_sys_mem", "upi"},
+      {"inter_node_sys_mem_to_sys_mem", "nic"},
+      {"intra_socket_gpu_fb_mem_to_gpu_fb_mem", "nvlink"},
+      {"inter_socket_gpu_fb_mem_to_gpu_fb_mem", "nvlink"},
+      {"inter_node_gpu_fb_mem_to_gpu_fb_mem", "pci_to_host nic pci_to_dev"},
+      {"intra_socket_sys_mem_to_gpu_fb_mem", "membus pci_to_dev"},
+      {"inter_socket_sys_mem_to_gpu_fb_mem", "upi pci_to_dev"},
+      {"inter_node_sys_mem_to_gpu_fb_mem", "nic pci_to_dev"},
+      {"intra_socket_gpu_fb_mem_to_sys_mem", "pci_to_host"},
+      {"inter_socket_gpu_fb_mem_to_sys_mem", "pci_to_host upi"},
+      {"inter_node_gpu_fb_mem_to_sys_mem", "pci_to_host nic membus"},
+  };
+  MachineFile file;
+  for (auto const &d : defaults) {
+    bool is_link = ends_with(d.first, "_latency") ||
+                   ends_with(d.first, "_bandwidth");
+    file[d.first] = {d.second, is_link ? NOT_MEASURED : "", false};
+  }
+  return file;
+}
+
+bool is_known_key(std::string const &key) {
+  for (Section const &s : SECTIONS) {
+    if (std::find(s.keys.begin(), s.keys.end(), key) != s.keys.end()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::string format_number(double v) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.6g", v);
+  return buf;
+}
+
+void set_measured(MachineFile &file,
+                  std::string const &key,
+                  double value,
+                  std::string const &note) {
+  file[key] = {format_number(value), note, true};
+}
+
+// Combines a value measured on another node type into file. Latencies keep
+// the maximum, bandwidths and peaks the minimum, and everything else (counts
+// and paths) is taken from the other node type.
+void merge_entry(MachineFile &file,
+                 std::string const &key,
+                 std::string const &value,
+                 std::string const &origin,
+                 bool measured) {
+  auto it = file.find(key);
+  if (!measured) {
+    // Only fills in what is not known at all
+    if (it == file.end()) {
+      file[key] = {value, "from " + origin, false};
+    }
+    return;
+  }
+  bool is_latency = ends_with(key, "_latency");
+  bool is_throughput = ends_with(key, "_bandwidth") ||
+                       ends_with(key, "_tflops") || ends_with(key, "_gflops");
+  if (it == file.end() || !it->second.measured ||
+      !(is_latency || is_throughput)) {
+    file[key] = {value, "from " + origin, true};
+    return;
+  }
+  char *end = nullptr;
+  double theirs = strtod(value.c_str(), &end);
+  if (end == value.c_str()) {
+    fprintf(stderr,
+            "[Warning] ignoring non-numeric %s = %s in %s\n",
+            key.c_str(),
+            value.c_str(),
+            origin.c_str());
+    return;
+  }
+  double mine = strtod(it->second.value.c_str(), nullptr);
+  if (is_latency ? theirs > mine : theirs < mine) {
+    it->second = {value, "from " + origin + " (slower than " +
+                             it->second.value + ")",
+                  true};
+  }
+}
+
+// Reads key = value lines the way EnhancedMachineModel does. Entries this
+// tool wrote without measuring them are recognized by their note.
+bool merge_file(MachineFile &file, std::string const &path) {
+  std::ifstream in(path);
+  if (!in) {
+    fprintf(stderr, "[Error] could not open machine model file %s\n",
+            path.c_str());
+    return false;
+  }
+  std::string line, note;
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == '#') {
+      note = line;
+      continue;
+    }
+    bool measured = note != "# " + NOT_MEASURED && note != "# " + LOOPBACK;
+    note.clear();
+    std::istringstream iss(line);
+    std::vector<std::string> words{std::istream_iterator<std::string>{iss},
+                                   std::istream_iterator<std::string>{}};
+    if (words.size() < 3 || words[1] != "=") {
+      continue;
+    }
+    std::string value = words[2];
+    for (size_t i = 3; i < words.size(); i++) {
+      value += " " + words[i];
+    }
+    if (!is_known_key(words[0])) {
+      fprintf(stderr,
+              "[Warning] ignoring unknown key %s in %s\n",
+              words[0].c_str(),
+              path.c_str());
+      continue;
+    }
+    merge_entry(file, words[0], value, path, measured);
+  }
+  return true;
+}
+
+void write_file(MachineFile const &file, FILE *out) {
+  char host[256] = "unknown";
+  gethostname(host, sizeof(host) - 1);
+  fprintf(out, "# Generated by machine_calibration on %s\n", host);
+  for (Section const &s : SECTIONS) {
+    fprintf(out, "\n# %s:\n# %s\n", s.name.c_str(), s.comment.c_str());
+    for (std::string const &key : s.keys) {
+      auto it = file.find(key);
+      if (it == file.end() || (!s.always_emit && !it->second.measured)) {
+        continue;
+      }
+      if (!it->second.note.empty()) {
+        fprintf(out, "# %s\n", it->second.note.c_str());
+      }
+      fprintf(out, "%s = %s\n", key.c_str(), it->second.value.c_str());
+    }
+  }
+}
+
+void probe_host(MachineFile &file, size_t array_bytes, int iters) {
+  HostTopology topo = probe_topology();
+  int num_sockets = topo.socket_cpus.size();
+  int cpus_per_socket = topo.socket_cpus[0].size();
+  for (std::vector<int> const &cpus : topo.socket_cpus) {
+    cpus_per_socket = std::min(cpus_per_socket, (int)cpus.size());
+  }
+  std::vector<int> const &socket0 = topo.socket_cpus[0];
+  fprintf(stderr,
+          "sockets(%d) cpus_per_socket(%d) gpus(%d)\n",
+          num_sockets,
+          cpus_per_socket,
+          topo.num_gpus);
+  set_measured(file, "num_sockets_per_node", num_sockets, "");
+  set_measured(file, "num_cpus_per_socket", cpus_per_socket, "");
+  set_measured(file,
+               "num_gpus_per_socket",
+               topo.num_gpus / num_sockets,
+               "NVIDIA GPUs found by the driver");
+
+  int const round_trips = 100000;
+  if (socket0.size() > 1) {
+    set_measured(file,
+                 "membus_latency",
+                 pingpong_latency(socket0[0], socket0[1], round_trips),
+                 "shared-memory ping-pong within a socket");
+  }
+  set_measured(
+      file,
+      "membus_bandwidth",
+      copy_bandwidth(socket0[0], socket0[0], array_bytes, iters) /
+          BYTES_PER_MS_PER_UNIT,
+      "single-thread memcpy within a socket");
+  if (num_sockets > 1) {
+    int remote = topo.socket_cpus[1][0];
+    set_measured(file,
+                 "upi_latency",
+                 pingpong_latency(socket0[0], remote, round_trips),
+                 "shared-memory ping-pong across sockets");
+    set_measured(file,
+                 "upi_bandwidth",
+                 copy_bandwidth(remote, socket0[0], array_bytes, iters) /
+                     BYTES_PER_MS_PER_UNIT,
+                 "single-thread memcpy across sockets");
+  }
+
+  LoopbackResult loopback = probe_loopback(4 * array_bytes, round_trips / 10);
+  if (loopback.ok) {
+    // Not a measurement of the NIC, so merged numbers replace it
+    file["nic_latency"] = {format_number(loopback.latency), LOOPBACK, false};
+    file["nic_bandwidth"] = {
+        format_number(loopback.bandwidth / BYTES_PER_MS_PER_UNIT),
+        LOOPBACK,
+        false};
+  } else {
+    fprintf(stderr, "[Warning] loopback probe failed: %s\n", strerror(errno));
+  }
+
+  set_measured(file,
+               "cpu_peak_gflops",
+               peak_gflops(socket0[0], 20000000),
+               "FMA throughput of one core");
+  set_measured(file,
+               "cpu_mem_bandwidth",
+               stream_triad(socket0, array_bytes, iters) / socket0.size() /
+                   BYTES_PER_MS_PER_UNIT,
+               "STREAM triad of a full socket, per core");
+}
+
+void usage(char const *prog) {
+  fprintf(stderr,
+          "Usage: %s [-o file] [--num-nodes n] [--merge file]...\n"
+          "          [--set key=value]... [--no-probe] [--array-mb mb] "
+          "[--iters n]\n",
+          prog);
+}
+
+int main(int argc, char **argv) {
+  std::string output;
+  int num_nodes = 0;
+  bool probe = true;
+  size_t array_mb = 256;
+  int iters = 5;
+  std::vector<std::string> merges;
+  std::vector<std::pair<std::string, std::string>> sets;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+      output = argv[++i];
+    } else if (!strcmp(argv[i], "--num-nodes") && i + 1 < argc) {
+      num_nodes = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--merge") && i + 1 < argc) {
+      merges.push_back(argv[++i]);
+    } else if (!strcmp(argv[i], "--set") && i + 1 < argc) {
+      std::string kv = argv[++i];
+      size_t eq = kv.find('=');
+      if (eq == std::string::npos || !is_known_key(kv.substr(0, eq))) {
+        fprintf(stderr, "[Error] invalid --set %s\n", kv.c_str());
+        return 1;
+      }
+      sets.push_back(std::make_pair(kv.substr(0, eq), kv.substr(eq + 1)));
+    } else if (!strcmp(argv[i], "--no-probe")) {
+      probe = false;
+    } else if (!strcmp(argv[i], "--array-mb") && i + 1 < argc) {
+      array_mb = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--iters") && i + 1 < argc) {
+      iters = atoi(argv[++i]);
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (num_nodes < 0 || array_mb < 1 || iters < 1) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  MachineFile file = placeholders();
+  if (probe) {
+    probe_host(file, array_mb << 20, iters);
+  }
+  for (std::string const &path : merges) {
+    if (!merge_file(file, path)) {
+      return 1;
+    }
+  }
+  if (num_nodes > 0) {
+    set_measured(file, "num_nodes", num_nodes, "");
+  }
+  for (auto const &kv : sets) {
+    file[kv.first] = {kv.second, "set on the command line", true};
+  }
+
+  FILE *out = output.empty() ? stdout : fopen(output.c_str(), "w");
+  if (out == nullptr) {
+    fprintf(stderr, "[Error] could not open %s\n", output.c_str());
+    return 1;
+  }
+  write_file(file, out);
+  if (out != stdout) {
+    fclose(out);
+  }
+  return 0;
+}
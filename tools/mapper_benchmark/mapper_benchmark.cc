@@ -0,0 +1,134 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Measures how many mapper calls FFMapper sustains on a launch pattern like
+ * that of incremental decoding: every step launches one index task per layer
+ * over all GPUs, on the same regions as the previous step. Each launch costs
+ * one slice_task call plus one map_task call per GPU. The empty tasks make
+ * the numbers an upper bound on mapping and launch overhead.
+ *
+ * Usage: mapper_benchmark -ll:gpu <n> [--layers n] [--steps n]
+ *                         [--disable-mapper-cache]
+ */
+
+#include "flexflow/mapper.h"
+#include "flexflow/model.h"
+#include <chrono>
+
+using namespace Legion;
+using namespace FlexFlow;
+
+LegionRuntime::Logger::Category log_app("mapper_benchmark");
+
+TaskID const EMPTY_TASK_ID = CUSTOM_GPU_TASK_ID_FIRST;
+
+void empty_task(Task const *task,
+                std::vector<PhysicalRegion> const &regions,
+                Context ctx,
+                Runtime *runtime) {}
+
+void FlexFlow::top_level_task(Task const *task,
+                              std::vector<PhysicalRegion> const &regions,
+                              Context ctx,
+                              Runtime *runtime) {
+  int num_layers = 32, num_steps = 100;
+  InputArgs const &command_args = Runtime::get_input_args();
+  for (int i = 1; i < command_args.argc; i++) {
+    if (!strcmp(command_args.argv[i], "--layers")) {
+      num_layers = atoi(command_args.argv[++i]);
+    } else if (!strcmp(command_args.argv[i], "--steps")) {
+      num_steps = atoi(command_args.argv[++i]);
+    }
+  }
+  int num_gpus = Machine::ProcessorQuery(Machine::get_machine())
+                     .only_kind(Processor::TOC_PROC)
+                     .count();
+  assert(num_gpus > 0);
+
+  // One region per layer, split evenly over the GPUs
+  Rect<1> launch_rect(0, num_gpus - 1);
+  IndexSpace launch_is = runtime->create_index_space(ctx, launch_rect);
+  IndexSpace is =
+      runtime->create_index_space(ctx, Rect<1>(0, 1024 * num_gpus - 1));
+  FieldSpace fs = runtime->create_field_space(ctx);
+  {
+    FieldAllocator allocator = runtime->create_field_allocator(ctx, fs);
+    allocator.allocate_field(sizeof(float), FID_DATA);
+  }
+  IndexPartition ip = runtime->create_equal_partition(ctx, is, launch_is);
+  std::vector<LogicalRegion> layer_regions;
+  std::vector<LogicalPartition> layer_partitions;
+  for (int l = 0; l < num_layers; l++) {
+    LogicalRegion lr = runtime->create_logical_region(ctx, is, fs);
+    layer_regions.push_back(lr);
+    layer_partitions.push_back(runtime->get_logical_partition(ctx, lr, ip));
+  }
+
+  auto run_step = [&]() {
+    for (int l = 0; l < num_layers; l++) {
+      IndexLauncher launcher(EMPTY_TASK_ID,
+                             launch_is,
+                             TaskArgument(NULL, 0),
+                             ArgumentMap(),
+                             Predicate::TRUE_PRED,
+                             false /*must*/,
+                             0 /*mapper_id*/,
+                             FFConfig::DataParallelism_GPU /*tag*/);
+      launcher.add_region_requirement(RegionRequirement(layer_partitions[l],
+                                                        0 /*projection id*/,
+                                                        READ_WRITE,
+                                                        EXCLUSIVE,
+                                                        layer_regions[l]));
+      launcher.add_field(0, FID_DATA);
+      runtime->execute_index_space(ctx, launcher);
+    }
+  };
+  // The first step creates the instances
+  run_step();
+  runtime->issue_execution_fence(ctx).get_void_result();
+
+  auto start = std::chrono::steady_clock::now();
+  for (int s = 0; s < num_steps; s++) {
+    run_step();
+  }
+  runtime->issue_execution_fence(ctx).get_void_result();
+  double secs = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+
+  double launches = (double)num_steps * num_layers;
+  log_app.print(
+      "gpus(%d) layers(%d) steps(%d)", num_gpus, num_layers, num_steps);
+  log_app.print("%.1lf launches/s, %.1lf mapper calls/s, %.3lf ms/step",
+                launches / secs,
+                launches * (1 + num_gpus) / secs,
+                1e3 * secs / num_steps);
+
+  for (LogicalRegion const &lr : layer_regions) {
+    runtime->destroy_logical_region(ctx, lr);
+  }
+  runtime->destroy_field_space(ctx, fs);
+  runtime->destroy_index_space(ctx, is);
+  runtime->destroy_index_space(ctx, launch_is);
+}
+
+void FlexFlow::register_custom_tasks() {
+  TaskVariantRegistrar registrar(EMPTY_TASK_ID, "Mapper Benchmark Empty");
+  registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+  registrar.set_leaf();
+  Runtime::preregister_task_variant<empty_task>(registrar,
+                                                "Mapper Benchmark Empty");
+}
@@ -0,0 +1,321 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Times task graph construction plus simulation of a synthetic layered model,
+ * built the way Simulator::simulate_runtime builds it: every layer runs one
+ * forward task per GPU and sends a message to the next GPU through its
+ * outbound NIC and the inbound NIC of the peer, split into segments.
+ *
+ * - legacy: SimTasks in a TaskManager, simulated with the
+ *   std::priority_queue loop of LogicalTaskgraphBasedSimulator
+ * - lowered: SimTasks in a TaskManager, copied into the event-driven core
+ * - direct: tasks added straight into the event-driven core
+ *
+ * Usage: simulator_benchmark [num_layers] [num_gpus] [max_num_segments] [iters]
+ */
+
+#include "flexflow/simulator.h"
+#include "flexflow/simulator_core.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+
+using namespace FlexFlow;
+
+size_t const SEGMENT_SIZE = 64 * 1024;
+
+struct SyntheticModel {
+  int num_layers, num_gpus, max_num_segments;
+  std::vector<std::string> layer_names;
+  // indexed by layer * num_gpus + gpu
+  std::vector<float> compute_times;
+  std::vector<size_t> message_sizes;
+};
+
+struct SyntheticMachine {
+  std::vector<std::unique_ptr<CompDevice>> gpus;
+  std::vector<std::unique_ptr<CommDevice>> nic_outs, nic_ins;
+  // path from each GPU to the next one
+  std::vector<std::vector<CommDevice *>> paths;
+  std::vector<std::vector<SimLink>> link_paths;
+};
+
+SyntheticModel
+    build_model(int num_layers, int num_gpus, int max_num_segments, int seed) {
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<float> compute(0.05f, 2.0f);
+  std::uniform_int_distribution<size_t> message(
+      SEGMENT_SIZE, max_num_segments * SEGMENT_SIZE);
+  SyntheticModel m;
+  m.num_layers = num_layers;
+  m.num_gpus = num_gpus;
+  m.max_num_segments = max_num_segments;
+  for (int l = 0; l < num_layers; l++) {
+    m.layer_names.push_back("layer_" + std::to_string(l));
+    for (int d = 0; d < num_gpus; d++) {
+      m.compute_times.push_back(compute(gen));
+      m.message_sizes.push_back(message(gen));
+    }
+  }
+  return m;
+}
+
+SyntheticMachine build_machine(int num_gpus) {
+  SyntheticMachine machine;
+  for (int d = 0; d < num_gpus; d++) {
+    std::string name = std::to_string(d);
+    machine.gpus.emplace_back(
+        new CompDevice("gpu" + name, CompDevice::TOC_PROC, d, 0, d, {}));
+    machine.nic_outs.emplace_back(new CommDevice(
+        "nic_out" + name, CommDevice::NIC_OUT_COMM, d, 0, d, 0.001f, 1e7f));
+    machine.nic_ins.emplace_back(new CommDevice(
+        "nic_in" + name, CommDevice::NIC_IN_COMM, d, 0, d, 0.001f, 1e7f));
+  }
+  for (int d = 0; d < num_gpus; d++) {
+    int peer = (d + 1) % num_gpus;
+    machine.paths.push_back(
+        {machine.nic_outs[d].get(), machine.nic_ins[peer].get()});
+    // Device indices as simulate_runtime assigns them: GPUs first
+    machine.link_paths.push_back(
+        {{num_gpus + d, 0.001f, 1e7f, true},
+         {2 * num_gpus + peer, 0.001f, 1e7f, false}});
+  }
+  return machine;
+}
+
+// The segmentation of the former Simulator::add_task_dependencies_with_xfer
+void add_legacy_xfer(TaskManager &task_manager,
+                     SimTask *src_task,
+                     SimTask *dst_task,
+                     std::vector<CommDevice *> const &path,
+                     size_t message_size,
+                     int max_num_segments) {
+  size_t seg_size = SEGMENT_SIZE;
+  int num_segment = (message_size + seg_size - 1) / seg_size;
+  if (num_segment > max_num_segments) {
+    num_segment = max_num_segments;
+    seg_size = message_size / num_segment;
+  }
+  std::vector<std::vector<SimTask *>> all_tasks(path.size());
+  for (size_t i = 0; i < path.size(); i++) {
+    for (int j = 0; j < num_segment; j++) {
+      size_t cur_seg_size = j == num_segment - 1
+                                ? message_size - (num_segment - 1) * seg_size
+                                : seg_size;
+      std::string name = "seg " + std::to_string(j) + " from " +
+                         src_task->name + " to " + dst_task->name;
+      all_tasks[i].push_back(
+          task_manager.new_comm_task(name, path[i], cur_seg_size));
+    }
+  }
+  for (size_t i = 0; i < path.size(); i++) {
+    for (int j = 0; j < num_segment; j++) {
+      if (i == 0) {
+        src_task->add_next_task(all_tasks[i][j]);
+      } else {
+        all_tasks[i - 1][j]->add_next_task(all_tasks[i][j]);
+        if (path[i]->comm_type == CommDevice::NIC_OUT_COMM &&
+            j + 1 < num_segment) {
+          all_tasks[i][j]->add_next_task(all_tasks[i - 1][j + 1]);
+        }
+      }
+      if (i == path.size() - 1) {
+        all_tasks[i][j]->add_next_task(dst_task);
+      }
+    }
+  }
+}
+
+void build_task_manager(SyntheticModel const &m,
+                        SyntheticMachine const &machine,
+                        TaskManager &task_manager) {
+  task_manager.reset();
+  std::vector<SimTask *> compute;
+  for (int l = 0; l < m.num_layers; l++) {
+    for (int d = 0; d < m.num_gpus; d++) {
+      SimTask *task = task_manager.new_task();
+      task->type = SimTask::TASK_FORWARD;
+      task->device = machine.gpus[d].get();
+      task->run_time = m.compute_times[l * m.num_gpus + d];
+      task->name = m.layer_names[l];
+      compute.push_back(task);
+    }
+  }
+  for (int l = 1; l < m.num_layers; l++) {
+    for (int d = 0; d < m.num_gpus; d++) {
+      SimTask *src = compute[(l - 1) * m.num_gpus + d];
+      int peer = (d + 1) % m.num_gpus;
+      src->add_next_task(compute[l * m.num_gpus + d]);
+      add_legacy_xfer(task_manager,
+                      src,
+                      compute[l * m.num_gpus + peer],
+                      machine.paths[d],
+                      m.message_sizes[l * m.num_gpus + d],
+                      m.max_num_segments);
+    }
+  }
+}
+
+float run_legacy(SyntheticModel const &m,
+                 SyntheticMachine const &machine,
+                 TaskManager &task_manager) {
+  build_task_manager(m, machine, task_manager);
+  std::priority_queue<SimTask *, std::vector<SimTask *>, SimTaskCompare>
+      ready_queue;
+  for (size_t i = 0; i < task_manager.global_task_id; i++) {
+    if (task_manager.tasks[i]->counter == 0) {
+      ready_queue.push(task_manager.tasks[i]);
+    }
+  }
+  float sim_time = 0.0f;
+  std::map<Device *, float> device_times;
+  while (!ready_queue.empty()) {
+    SimTask *cur_task = ready_queue.top();
+    ready_queue.pop();
+    float ready_time = 0;
+    if (device_times.find(cur_task->device) != device_times.end()) {
+      ready_time = device_times[cur_task->device];
+    }
+    float start_time = std::max(ready_time, cur_task->ready_time);
+    float end_time = start_time + cur_task->run_time;
+    device_times[cur_task->device] = end_time;
+    sim_time = std::max(sim_time, end_time);
+    for (SimTask *next : cur_task->next_tasks) {
+      next->ready_time = std::max(next->ready_time, end_time);
+      if (--next->counter == 0) {
+        ready_queue.push(next);
+      }
+    }
+  }
+  return sim_time;
+}
+
+float run_lowered(SyntheticModel const &m,
+                  SyntheticMachine const &machine,
+                  TaskManager &task_manager,
+                  EventDrivenSimulator &sim) {
+  build_task_manager(m, machine, task_manager);
+  sim.reset();
+  std::unordered_map<Device *, int> device_to_index;
+  for (size_t i = 0; i < task_manager.global_task_id; i++) {
+    SimTask *task = task_manager.tasks[i];
+    auto const &it = device_to_index.insert(
+        std::make_pair(task->device, (int)device_to_index.size()));
+    sim.tasks.add_task(
+        task->type, it.first->second, task->run_time, SimNameTable::NO_NAME);
+  }
+  for (size_t i = 0; i < task_manager.global_task_id; i++) {
+    for (SimTask const *next : task_manager.tasks[i]->next_tasks) {
+      sim.tasks.add_dependency(i, next - task_manager.task_pool);
+    }
+  }
+  sim.tasks.finalize();
+  return sim.simulate(device_to_index.size());
+}
+
+float run_direct(SyntheticModel const &m,
+                 SyntheticMachine const &machine,
+                 EventDrivenSimulator &sim) {
+  sim.reset();
+  for (int l = 0; l < m.num_layers; l++) {
+    for (int d = 0; d < m.num_gpus; d++) {
+      sim.tasks.add_task(SimTask::TASK_FORWARD,
+                         d,
+                         m.compute_times[l * m.num_gpus + d],
+                         SimNameTable::NO_NAME);
+    }
+  }
+  for (int l = 1; l < m.num_layers; l++) {
+    for (int d = 0; d < m.num_gpus; d++) {
+      SimTaskId src = (l - 1) * m.num_gpus + d;
+      int peer = (d + 1) % m.num_gpus;
+      sim.tasks.add_dependency(src, l * m.num_gpus + d);
+      add_segmented_transfer(sim.tasks,
+                             src,
+                             l * m.num_gpus + peer,
+                             machine.link_paths[d],
+                             m.message_sizes[l * m.num_gpus + d],
+                             SEGMENT_SIZE,
+                             m.max_num_segments,
+                             SimTask::TASK_COMM);
+    }
+  }
+  sim.tasks.finalize();
+  return sim.simulate(3 * m.num_gpus);
+}
+
+template <typename F>
+double time_ms(int iters, float &sim_time, F const &run) {
+  using Clock = std::chrono::steady_clock;
+  // warm up so that pooled storage is sized
+  sim_time = run();
+  auto start = Clock::now();
+  for (int i = 0; i < iters; i++) {
+    sim_time = run();
+  }
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+             .count() /
+         iters;
+}
+
+int main(int argc, char **argv) {
+  int num_layers = argc > 1 ? atoi(argv[1]) : 512;
+  int num_gpus = argc > 2 ? atoi(argv[2]) : 16;
+  int max_num_segments = argc > 3 ? atoi(argv[3]) : 8;
+  int iters = argc > 4 ? atoi(argv[4]) : 20;
+
+  SyntheticModel m = build_model(num_layers, num_gpus, max_num_segments, 0);
+  SyntheticMachine machine = build_machine(num_gpus);
+  EventDrivenSimulator sim;
+  run_direct(m, machine, sim);
+  printf("tasks(%zu) dependencies(%zu) devices(%d)\n",
+         sim.tasks.num_tasks(),
+         sim.tasks.num_dependencies(),
+         3 * num_gpus);
+
+  TaskManager task_manager(sim.tasks.num_tasks() + 2);
+  float legacy_time, lowered_time, direct_time;
+  double legacy_ms = time_ms(iters, legacy_time, [&]() {
+    return run_legacy(m, machine, task_manager);
+  });
+  double lowered_ms = time_ms(iters, lowered_time, [&]() {
+    return run_lowered(m, machine, task_manager, sim);
+  });
+  double direct_ms = time_ms(
+      iters, direct_time, [&]() { return run_direct(m, machine, sim); });
+
+  printf("legacy:  %.3lf ms/simulation (simulated %.4f ms)\n",
+         legacy_ms,
+         legacy_time);
+  printf("lowered: %.3lf ms/simulation (simulated %.4f ms)\n",
+         lowered_ms,
+         lowered_time);
+  printf("direct:  %.3lf ms/simulation (simulated %.4f ms)\n",
+         direct_ms,
+         direct_time);
+  printf("speedup over legacy: %.2lfx, over lowered: %.2lfx\n",
+         legacy_ms / direct_ms,
+         lowered_ms / direct_ms);
+  // The loops pop tasks in ready-time order but may break ties differently,
+  // which can change the order of equally ready tasks on a device
+  if (legacy_time != direct_time) {
+    printf("note: simulated times differ by %.6f ms due to tie breaking\n",
+           direct_time - legacy_time);
+  }
+  return 0;
+}
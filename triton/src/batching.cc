@@ -0,0 +1,63 @@
+/* Copyright 2022 NVIDIA CORPORATION
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "batching.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace triton { namespace backend { namespace legion {
+
+std::vector<ExecutionBatch>
+PlanExecutionBatches(const std::vector<size_t>& request_rows, size_t max_rows)
+{
+  assert(max_rows > 0);
+  std::vector<ExecutionBatch> batches;
+  for (size_t idx = 0; idx < request_rows.size(); idx++) {
+    size_t offset = 0;
+    while (offset < request_rows[idx]) {
+      if (batches.empty() || (batches.back().rows_ == max_rows)) {
+        batches.emplace_back();
+        batches.back().rows_ = 0;
+      }
+      ExecutionBatch& batch = batches.back();
+      BatchSlice slice;
+      slice.request_index_ = idx;
+      slice.request_offset_ = offset;
+      slice.batch_offset_ = batch.rows_;
+      slice.rows_ =
+          std::min(request_rows[idx] - offset, max_rows - batch.rows_);
+      batch.slices_.push_back(slice);
+      batch.rows_ += slice.rows_;
+      offset += slice.rows_;
+    }
+  }
+  return batches;
+}
+
+std::vector<int>
+LastBatchOfRequests(
+    const std::vector<ExecutionBatch>& batches, size_t request_count)
+{
+  std::vector<int> last_batch(request_count, -1);
+  for (size_t idx = 0; idx < batches.size(); idx++) {
+    for (const auto& slice : batches[idx].slices_) {
+      last_batch[slice.request_index_] = idx;
+    }
+  }
+  return last_batch;
+}
+
+}}}  // namespace triton::backend::legion
@@ -0,0 +1,58 @@
+/* Copyright 2022 NVIDIA CORPORATION
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __LEGION_TRITON_BATCHING_H__
+#define __LEGION_TRITON_BATCHING_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace triton { namespace backend { namespace legion {
+
+// Consecutive rows of a request that are executed together with the rows of
+// other requests
+struct BatchSlice {
+  uint32_t request_index_;
+  size_t request_offset_;  // first row of the slice in the request
+  size_t batch_offset_;    // first row of the slice in the batch
+  size_t rows_;
+};
+
+// The rows of one execution of the model, the rest of which is padding
+struct ExecutionBatch {
+  std::vector<BatchSlice> slices_;
+  size_t rows_;
+};
+
+//
+// PlanExecutionBatches
+//
+// Packs the rows of the requests, in order, into as few executions of at
+// most 'max_rows' rows as possible. A request that does not fit in the rows
+// left in a batch continues in the next one, so requests larger than
+// 'max_rows' are split instead of failed. Requests without rows get no
+// slice.
+//
+std::vector<ExecutionBatch> PlanExecutionBatches(
+    const std::vector<size_t>& request_rows, size_t max_rows);
+
+// Index of the last batch with rows of each request, or -1 if none
+std::vector<int> LastBatchOfRequests(
+    const std::vector<ExecutionBatch>& batches, size_t request_count);
+
+}}}  // namespace triton::backend::legion
+
+#endif  // __LEGION_TRITON_BATCHING_H__
@@ -14,6 +14,9 @@
  */
 
 #include "instance.h"
+#include <cstring>
+#include <future>
+#include <memory>
 #include "strategy.h"
 #include "tensor.h"
 
@@ -247,21 +250,26 @@ LegionModelInstance::ProcessRequests(
     return;
   }
 
-  // Make sure the maximum batch size is not exceeded. The
-  // total_batch_size must be 1 for models that don't support batching
-  // (i.e. max_batch_size == 0). If max_batch_size is exceeded then
-  // scheduler has done something badly wrong so fail and release all
-  // requests.
-  if ((total_batch_size != 1) && (total_batch_size > (size_t)max_batch_size)) {
-    RequestsRespondWithError(
-        requests, request_count,
-        TRITONSERVER_ErrorNew(
-            TRITONSERVER_ERROR_INTERNAL,
-            std::string(
-                "batch size " + std::to_string(total_batch_size) + " for '" +
-                Name() + "', max allowed is " + std::to_string(max_batch_size))
-                .c_str()));
-    return;
+  // The regions of the model hold 'max_batch_size' rows, so the requests
+  // are merged into executions of up to that many rows, and requests
+  // larger than that are split over several executions instead of being
+  // failed. Models that don't support batching (i.e. max_batch_size == 0)
+  // execute one request at a time.
+  const size_t max_rows = (max_batch_size > 0) ? max_batch_size : 1;
+  const std::vector<ExecutionBatch> batches =
+      PlanExecutionBatches(request_batch_sizes, max_rows);
+  const std::vector<int> last_batch =
+      LastBatchOfRequests(batches, request_count);
+  // Batches made of 'max_rows' rows of one request use the buffers of the
+  // request in place, the others are gathered into staging buffers on the
+  // CPU
+  std::vector<bool> need_host_buffers(request_count, false);
+  for (const auto& batch : batches) {
+    if ((batch.slices_.size() != 1) || (batch.rows_ != max_rows)) {
+      for (const auto& slice : batch.slices_) {
+        need_host_buffers[slice.request_index_] = true;
+      }
+    }
   }
 
   // At this point we are committed to running inference with all
@@ -269,7 +277,7 @@ LegionModelInstance::ProcessRequests(
   // processing if there is an error with any request that error will
   // be sent immediately with the corresponding response (and the
   // response unique_ptr will then be nullptr). The request object
-  // itself will not be released until after all inferencing is done
+  // itself will not be released until after its last batch is done
   // (below) as we may need to access the request object when
   // determine how to process outputs (for example, even if we don't
   // need the outputs for a request that has an error, we do need to
@@ -291,40 +299,130 @@ LegionModelInstance::ProcessRequests(
   }
 
   // Prepare I/O
-  std::vector<InputTensor> inputs;
-  if (!SetInputTensors(
-          total_batch_size, requests, request_count, &responses, inputs)) {
+  std::vector<RequestTensor> inputs;
+  if (!CollectRequestInputs(
+          request_batch_sizes, need_host_buffers, requests, request_count,
+          &responses, inputs)) {
     return;
   }
 
-  std::vector<OutputTensor> outputs;
-  if (!SetOutputTensors(
-          total_batch_size, request_batch_sizes, requests, request_count,
+  std::vector<RequestTensor> outputs;
+  if (!CollectRequestOutputs(
+          request_batch_sizes, need_host_buffers, requests, request_count,
           &responses, outputs)) {
     return;
   }
 
-  std::vector<uint64_t> compute_input_end_ns(request_count);
-  std::vector<uint64_t> compute_output_start_ns(request_count);
-  RunModel(inputs, outputs, compute_input_end_ns, compute_output_start_ns);
+  // Fail the requests of a batch that could not be staged. Only called once
+  // the batch before it is done, as that one may still write into the
+  // output buffers of the same requests.
+  auto fail = [&](const size_t batch_idx, TRITONSERVER_Error* err) {
+    for (const auto& slice : batches[batch_idx].slices_) {
+      GUARDED_RESPOND_IF_ERROR(
+          responses, slice.request_index_,
+          TRITONSERVER_ErrorNew(
+              TRITONSERVER_ErrorCode(err), TRITONSERVER_ErrorMessage(err)));
+    }
+    TRITONSERVER_ErrorDelete(err);
+  };
+  // Run a staged batch on its own thread, so that the next one can be
+  // staged and the previous one answered in the meantime
+  auto launch = [this](StagedBatch* staged) -> std::future<void> {
+    if (staged->skip_) {
+      return std::future<void>();
+    }
+    return std::async(std::launch::async, [this, staged]() {
+      RunModel(
+          staged->inputs_, staged->outputs_, staged->compute_input_end_ns_,
+          staged->compute_output_start_ns_);
+    });
+  };
+
+  std::vector<uint64_t> compute_input_end_ns(request_count, 0);
+  std::vector<uint64_t> compute_output_start_ns(request_count, 0);
+  std::vector<bool> succeeded(request_count, false);
+  std::unique_ptr<StagedBatch> current(new StagedBatch());
+  SET_TIMESTAMP(current->stage_start_ns_);
+  TRITONSERVER_Error* err = StageBatch(
+      batches[0], max_rows, inputs, outputs, responses, current.get());
+  if (err != nullptr) {
+    fail(0, err);
+    current->skip_ = true;
+  }
+  std::future<void> execution = launch(current.get());
+  for (size_t batch_idx = 0; batch_idx < batches.size(); batch_idx++) {
+    const ExecutionBatch& batch = batches[batch_idx];
+    std::unique_ptr<StagedBatch> next;
+    err = nullptr;
+    if ((batch_idx + 1) < batches.size()) {
+      next.reset(new StagedBatch());
+      SET_TIMESTAMP(next->stage_start_ns_);
+      err = StageBatch(
+          batches[batch_idx + 1], max_rows, inputs, outputs, responses,
+          next.get());
+    }
+    if (execution.valid()) {
+      execution.get();
+    }
+    if (err != nullptr) {
+      fail(batch_idx + 1, err);
+      next->skip_ = true;
+    }
+    std::future<void> next_execution;
+    if (next != nullptr) {
+      next_execution = launch(next.get());
+    }
+
+    if (!current->skip_) {
+      ScatterBatch(batch, *current, outputs, responses);
+
+      uint64_t batch_end_ns = 0;
+      SET_TIMESTAMP(batch_end_ns);
+      // There are two types of statistics that we can report... the
+      // statistics for each execution of the model, reported here,
+      // and statistics for each individual request, reported below
+      // once its last execution is done.
+      LOG_IF_ERROR(
+          TRITONBACKEND_ModelInstanceReportBatchStatistics(
+              TritonModelInstance(), batch.rows_, current->stage_start_ns_,
+              current->compute_input_end_ns_.front(),
+              current->compute_output_start_ns_.front(), batch_end_ns),
+          "failed reporting batch request statistics");
+      for (const auto& slice : batch.slices_) {
+        const uint32_t r = slice.request_index_;
+        if (compute_input_end_ns[r] == 0) {
+          compute_input_end_ns[r] = current->compute_input_end_ns_.front();
+        }
+        compute_output_start_ns[r] =
+            current->compute_output_start_ns_.front();
+      }
+    }
+
+    // Requests are done once their last batch is, and we can send
+    // their responses. This is the last (and only) response that we
+    // are sending for the request so we must mark it FINAL. If there
+    // is an error when sending all we can do is log it.
+    for (const auto& slice : batch.slices_) {
+      const uint32_t r = slice.request_index_;
+      if ((last_batch[r] != (int)batch_idx) || (responses[r] == nullptr)) {
+        continue;
+      }
+      LOG_IF_ERROR(
+          TRITONBACKEND_ResponseSend(
+              responses[r], TRITONSERVER_RESPONSE_COMPLETE_FINAL,
+              nullptr /* success */),
+          "failed sending response");
+      responses[r] = nullptr;
+      succeeded[r] = true;
+    }
+
+    current = std::move(next);
+    execution = std::move(next_execution);
+  }
 
   uint64_t request_end_ns = request_start_ns;
   SET_TIMESTAMP(request_end_ns);
 
-  // There are two types of statistics that we can report... the
-  // statistics for the entire batch of requests that we just executed
-  // and statistics for each individual request. Statistics for each
-  // individual request were reported above inside the loop as each
-  // request was processed (or for failed requests we report that
-  // failure below). Here we report statistics for the entire batch of
-  // requests.
-  LOG_IF_ERROR(
-      TRITONBACKEND_ModelInstanceReportBatchStatistics(
-          TritonModelInstance(), total_batch_size, request_start_ns,
-          compute_input_end_ns.front(), compute_output_start_ns.front(),
-          request_end_ns),
-      "failed reporting batch request statistics");
-
   // We could have released each request as soon as we sent the
   // corresponding response. But for clarity we just release them all
   // here. Note that is something goes wrong when releasing a request
@@ -333,31 +431,19 @@ LegionModelInstance::ProcessRequests(
   for (uint32_t r = 0; r < request_count; ++r) {
     TRITONBACKEND_Request* request = requests[r];
 
-    // If we get to this point then there hasn't been any error and
-    // the response is complete and we can send it. This is the last
-    // (and only) response that we are sending for the request so we
-    // must mark it FINAL. If there is an error when sending all we
-    // can do is log it.
-    LOG_IF_ERROR(
-        TRITONBACKEND_ResponseSend(
-            responses[r], TRITONSERVER_RESPONSE_COMPLETE_FINAL,
-            nullptr /* success */),
-        "failed sending response");
-
     // Report statistics for the successful request. For an instance
     // using the CPU we don't associate any device with the
     // statistics, otherwise we associate the instance's device.
-    LOG_IF_ERROR(
-        TRITONBACKEND_ModelInstanceReportStatistics(
-            TritonModelInstance(), request, true /* success */,
-            request_start_ns, compute_input_end_ns[r],
-            compute_output_start_ns[r], request_end_ns),
-        "failed reporting request statistics");
-
-    // Before releasing, record failed requests as those where
-    // responses[r] is nullptr. The timestamps are ignored in this
-    // case.
-    if (responses[r] == nullptr) {
+    // Failed requests are those that have not been answered with
+    // success. The timestamps are ignored in this case.
+    if (succeeded[r]) {
+      LOG_IF_ERROR(
+          TRITONBACKEND_ModelInstanceReportStatistics(
+              TritonModelInstance(), request, true /* success */,
+              request_start_ns, compute_input_end_ns[r],
+              compute_output_start_ns[r], request_end_ns),
+          "failed reporting request statistics");
+    } else {
       LOG_IF_ERROR(
           TRITONBACKEND_ModelInstanceReportStatistics(
               TritonModelInstance(), request, false /* success */, 0, 0, 0, 0),
@@ -371,16 +457,14 @@ LegionModelInstance::ProcessRequests(
 }
 
 bool
-LegionModelInstance::SetInputTensors(
-    const size_t total_batch_size, TRITONBACKEND_Request** requests,
-    const uint32_t request_count,
+LegionModelInstance::CollectRequestInputs(
+    const std::vector<size_t>& request_batch_sizes,
+    const std::vector<bool>& need_host_buffers,
+    TRITONBACKEND_Request** requests, const uint32_t request_count,
     std::vector<TRITONBACKEND_Response*>* responses,
-    std::vector<InputTensor>& inputs)
+    std::vector<RequestTensor>& inputs)
 {
-  // [FIXME] more checking in terms of expected byte size and actual byte size
   const int max_batch_size = Model()->MaxBatchSize();
-  size_t padding_batch_size =
-      (max_batch_size == 0) ? 0 : max_batch_size - total_batch_size;
 
   // All requests must have equally-sized input tensors so use any
   // request as the representative for the input tensors.
@@ -389,9 +473,8 @@ LegionModelInstance::SetInputTensors(
       false, responses, request_count,
       TRITONBACKEND_RequestInputCount(requests[0], &input_count));
   inputs.resize(input_count);
-  LegionTritonRuntime* runtime = model_state_->runtime_;
   for (uint32_t input_idx = 0; input_idx < input_count; input_idx++) {
-    InputTensor& tensor = inputs[input_idx];
+    RequestTensor& tensor = inputs[input_idx];
     TRITONBACKEND_Input* input;
     RESPOND_ALL_AND_RETURN_IF_ERROR(
         false, responses, request_count,
@@ -418,146 +501,121 @@ LegionModelInstance::SetInputTensors(
         tensor.strides_[i - 1] = tensor.strides_[i] * batchn_shape[i];
       }
     }
+    tensor.row_byte_size_ = (max_batch_size == 0)
+                                ? GetByteSize(input_datatype, batchn_shape)
+                                : tensor.strides_[0];
+    tensor.buffers_.resize(request_count, nullptr);
+    tensor.buffer_locations_.resize(
+        request_count, std::make_pair(TRITONSERVER_MEMORY_CPU, 0));
 
     for (size_t request_idx = 0; request_idx < request_count; ++request_idx) {
+      if ((*responses)[request_idx] == nullptr) {
+        continue;
+      }
       TRITONBACKEND_Input* input;
-      RESPOND_ALL_AND_RETURN_IF_ERROR(
-          false, responses, request_count,
+      GUARDED_RESPOND_IF_ERROR(
+          *responses, request_idx,
           TRITONBACKEND_RequestInputByIndex(
               requests[request_idx], input_idx, &input));
+      if ((*responses)[request_idx] == nullptr) {
+        continue;
+      }
 
       uint64_t total_buffer_byte_size;
       uint32_t buffer_count;
-      RESPOND_ALL_AND_RETURN_IF_ERROR(
-          false, responses, request_count,
+      GUARDED_RESPOND_IF_ERROR(
+          *responses, request_idx,
           TRITONBACKEND_InputProperties(
               input, nullptr, nullptr, nullptr, nullptr,
               &total_buffer_byte_size, &buffer_count));
+      if ((*responses)[request_idx] == nullptr) {
+        continue;
+      }
+      // Rows are located by their size, so make sure the request has
+      // the rows it claims
+      const uint64_t expected_byte_size =
+          tensor.row_byte_size_ * request_batch_sizes[request_idx];
+      if (total_buffer_byte_size != expected_byte_size) {
+        GUARDED_RESPOND_IF_ERROR(
+            *responses, request_idx,
+            TRITONSERVER_ErrorNew(
+                TRITONSERVER_ERROR_INVALID_ARG,
+                std::string(
+                    "input '" + tensor.name_ + "' has " +
+                    std::to_string(total_buffer_byte_size) +
+                    " bytes, expected " + std::to_string(expected_byte_size))
+                    .c_str()));
+        continue;
+      }
 
-      // Check if the input buffers need to be preprocessed into
-      // contiguous buffer that satisfies the constraints
-      bool need_preprocess = false;
-      std::vector<const void*> buffers;
-      std::vector<Memory> buffer_memories;
-      std::vector<std::pair<TRITONSERVER_MemoryType, int64_t>> buffer_locations;
-      // FIXME need to understand how a buffer satisfies the constraints,
-      // currently the request input must be in one contiguous buffer, and
-      // we shouldn't need to concatenate buffer for requests as splitting along
-      // batch dimension should be okay.
-      need_preprocess = (buffer_count > 1);
+      // Check if the input buffers need to be preprocessed into one
+      // contiguous buffer, on the CPU if the rows are to be gathered
+      const void* buffer = nullptr;
+      TRITONSERVER_MemoryType memory_type = TRITONSERVER_MEMORY_CPU;
+      int64_t memory_type_id = 0;
+      bool need_preprocess = (buffer_count > 1);
       if (!need_preprocess) {
-        const void* buffer;
         uint64_t buffer_byte_size;
-        TRITONSERVER_MemoryType memory_type;
-        int64_t memory_type_id;
-        RESPOND_ALL_AND_RETURN_IF_ERROR(
-            false, responses, request_count,
+        GUARDED_RESPOND_IF_ERROR(
+            *responses, request_idx,
             TRITONBACKEND_InputBuffer(
                 input, 0, &buffer, &buffer_byte_size, &memory_type,
                 &memory_type_id));
-        buffers.emplace_back(buffer);
-        buffer_locations.emplace_back(memory_type, memory_type_id);
-        buffer_memories.emplace_back(
-            runtime->FindMemory(memory_type, memory_type_id));
+        if ((*responses)[request_idx] == nullptr) {
+          continue;
+        }
+        need_preprocess = need_host_buffers[request_idx] &&
+                          (memory_type == TRITONSERVER_MEMORY_GPU);
       }
-      // for (size_t buffer_idx = 0; buffer_idx < buffer_count; ++buffer_count)
-      // {
-      //   const void* buffer;
-      //   uint64_t buffer_byte_size;
-      //   TRITONSERVER_MemoryType memory_type;
-      //   int64_t memory_type_id;
-      //   RESPOND_ALL_AND_RETURN_IF_ERROR(
-      //       false, responses, request_count,
-      //       TRITONBACKEND_InputBuffer(
-      //           input, buffer_idx, &buffer, &buffer_byte_size, &memory_type,
-      //           &memory_type_id));
-      //   // Check if the buffer is good
-      //   for (auto it = tensor.strides_.cbegin();
-      //        it != tensor.strides_.cend(); ++it) {
-      //     if (*it <= buffer_byte_size) {
-      //       need_preprocess = ((buffer_byte_size % *it) != 0);
-      //       break;
-      //     }
-      //   }
-      //   if (need_preprocess) {
-      //     break;
-      //   } else {
-      //     buffers.emplace_back(buffer);
-      //     buffer_locations.emplace_back(memory_type, memory_type_id);
-      //   }
-      // }
       if (need_preprocess) {
-        // FIXME using CPU for now, can be smart based on what kind of input
-        // buffer that the model prefers
         BackendMemory* backend_memory;
-        RESPOND_ALL_AND_RETURN_IF_ERROR(
-            false, responses, request_count,
+        GUARDED_RESPOND_IF_ERROR(
+            *responses, request_idx,
             BackendMemory::Create(
                 Model()->TritonMemoryManager(),
                 BackendMemory::AllocationType::CPU, 0, total_buffer_byte_size,
                 &backend_memory));
+        if ((*responses)[request_idx] == nullptr) {
+          continue;
+        }
         tensor.allocated_memory_.emplace_back(backend_memory);
-        RESPOND_ALL_AND_RETURN_IF_ERROR(
-            false, responses, request_count,
+        GUARDED_RESPOND_IF_ERROR(
+            *responses, request_idx,
             ReadInputTensor(
-                requests[request_idx], input_name, backend_memory->MemoryPtr(),
-                &total_buffer_byte_size));
-        tensor.buffers_.emplace_back(backend_memory->MemoryPtr());
-        tensor.buffer_locations_.emplace_back(
-            backend_memory->MemoryType(), backend_memory->MemoryTypeId());
-        tensor.buffer_memories_.emplace_back(runtime->FindMemory(
-            backend_memory->MemoryType(), backend_memory->MemoryTypeId()));
-      } else {
-        std::copy(
-            buffers.begin(), buffers.end(),
-            std::back_inserter(tensor.buffers_));
-        std::copy(
-            buffer_locations.begin(), buffer_locations.end(),
-            std::back_inserter(tensor.buffer_locations_));
-        std::copy(
-            buffer_memories.begin(), buffer_memories.end(),
-            std::back_inserter(tensor.buffer_memories_));
+                requests[request_idx], tensor.name_,
+                backend_memory->MemoryPtr(), &total_buffer_byte_size));
+        if ((*responses)[request_idx] == nullptr) {
+          continue;
+        }
+        buffer = backend_memory->MemoryPtr();
+        memory_type = backend_memory->MemoryType();
+        memory_type_id = backend_memory->MemoryTypeId();
       }
-    }
-
-    if (padding_batch_size != 0) {
-      size_t byte_size = tensor.strides_[0] * padding_batch_size;
-      BackendMemory* backend_memory;
-      RESPOND_ALL_AND_RETURN_IF_ERROR(
-          false, responses, request_count,
-          BackendMemory::Create(
-              Model()->TritonMemoryManager(),
-              BackendMemory::AllocationType::CPU, 0, byte_size,
-              &backend_memory));
-      tensor.allocated_memory_.emplace_back(backend_memory);
-      // set the value of the padding to zeros
-      memset(backend_memory->MemoryPtr(), 0, byte_size);
-      tensor.buffers_.emplace_back(backend_memory->MemoryPtr());
-      tensor.buffer_locations_.emplace_back(
-          backend_memory->MemoryType(), backend_memory->MemoryTypeId());
+      // Inputs are only read, from the request buffers or from copies
+      tensor.buffers_[request_idx] =
+          const_cast<char*>(static_cast<const char*>(buffer));
+      tensor.buffer_locations_[request_idx] =
+          std::make_pair(memory_type, memory_type_id);
     }
   }
   return true;
 }
 
 bool
-LegionModelInstance::SetOutputTensors(
-    const size_t total_batch_size,
+LegionModelInstance::CollectRequestOutputs(
     const std::vector<size_t>& request_batch_sizes,
+    const std::vector<bool>& need_host_buffers,
     TRITONBACKEND_Request** requests, const uint32_t request_count,
     std::vector<TRITONBACKEND_Response*>* responses,
-    std::vector<OutputTensor>& outputs)
+    std::vector<RequestTensor>& outputs)
 {
   const int max_batch_size = Model()->MaxBatchSize();
-  size_t padding_batch_size =
-      (max_batch_size == 0) ? 0 : max_batch_size - total_batch_size;
 
   const auto& output_infos = model_state_->OutputInfos();
   outputs.reserve(output_infos.size());
-  LegionTritonRuntime* runtime = model_state_->runtime_;
   for (const auto& output_info : output_infos) {
     outputs.emplace_back();
-    OutputTensor& tensor = outputs.back();
+    RequestTensor& tensor = outputs.back();
     tensor.name_ = std::get<0>(output_info);
     const auto& triton_dtype = std::get<1>(output_info);
     // Make a copy of it as the batch dimension will be updated to
@@ -575,9 +633,16 @@ LegionModelInstance::SetOutputTensors(
     if (max_batch_size != 0) {
       batch1_byte_size /= batchn_shape[0];
     }
+    tensor.row_byte_size_ = batch1_byte_size;
+    tensor.buffers_.resize(request_count, nullptr);
+    tensor.buffer_locations_.resize(
+        request_count, std::make_pair(TRITONSERVER_MEMORY_CPU, 0));
     // Prepare the output buffer for each response, if the output is not
-    // requested, backend managed buffer will be used
+    // requested, the rows are computed into backend managed buffers
     for (size_t request_idx = 0; request_idx < request_count; ++request_idx) {
+      if ((*responses)[request_idx] == nullptr) {
+        continue;
+      }
       uint32_t requested_output_count;
       RESPOND_ALL_AND_RETURN_IF_ERROR(
           false, responses, request_count,
@@ -596,66 +661,193 @@ LegionModelInstance::SetOutputTensors(
           break;
         }
       }
-      if (found) {
-        if (max_batch_size != 0) {
-          batchn_shape[0] = request_batch_sizes[request_idx];
-        }
-        TRITONBACKEND_Output* response_output;
-        RESPOND_ALL_AND_RETURN_IF_ERROR(
-            false, responses, request_count,
-            TRITONBACKEND_ResponseOutput(
-                (*responses)[request_idx], &response_output,
-                tensor.name_.c_str(), triton_dtype, batchn_shape.data(),
-                batchn_shape.size()));
-        void* buffer;
-        // FIXME using CPU for now, can be smart based on what kind of output
-        // buffer that the model produce
-        TRITONSERVER_MemoryType memory_type = TRITONSERVER_MEMORY_CPU;
-        int64_t memory_type_id = 0;
-        RESPOND_ALL_AND_RETURN_IF_ERROR(
-            false, responses, request_count,
-            TRITONBACKEND_OutputBuffer(
-                response_output, &buffer,
-                batch1_byte_size * request_batch_sizes[request_idx],
-                &memory_type, &memory_type_id));
-        tensor.buffers_.emplace_back(buffer);
-        tensor.buffer_locations_.emplace_back(memory_type, memory_type_id);
+      if (!found) {
+        continue;
+      }
+      if (max_batch_size != 0) {
+        batchn_shape[0] = request_batch_sizes[request_idx];
+      }
+      TRITONBACKEND_Output* response_output;
+      GUARDED_RESPOND_IF_ERROR(
+          *responses, request_idx,
+          TRITONBACKEND_ResponseOutput(
+              (*responses)[request_idx], &response_output,
+              tensor.name_.c_str(), triton_dtype, batchn_shape.data(),
+              batchn_shape.size()));
+      if ((*responses)[request_idx] == nullptr) {
+        continue;
+      }
+      void* buffer;
+      // FIXME using CPU for now, can be smart based on what kind of output
+      // buffer that the model produce
+      TRITONSERVER_MemoryType memory_type = TRITONSERVER_MEMORY_CPU;
+      int64_t memory_type_id = 0;
+      GUARDED_RESPOND_IF_ERROR(
+          *responses, request_idx,
+          TRITONBACKEND_OutputBuffer(
+              response_output, &buffer,
+              batch1_byte_size * request_batch_sizes[request_idx],
+              &memory_type, &memory_type_id));
+      if ((*responses)[request_idx] == nullptr) {
+        continue;
+      }
+      // Rows computed into staging buffers are copied on the CPU
+      if (need_host_buffers[request_idx] &&
+          (memory_type == TRITONSERVER_MEMORY_GPU)) {
+        GUARDED_RESPOND_IF_ERROR(
+            *responses, request_idx,
+            TRITONSERVER_ErrorNew(
+                TRITONSERVER_ERROR_UNSUPPORTED,
+                std::string(
+                    "output '" + tensor.name_ +
+                    "' of a batched request must be in CPU memory")
+                    .c_str()));
+        continue;
+      }
+      tensor.buffers_[request_idx] = static_cast<char*>(buffer);
+      tensor.buffer_locations_[request_idx] =
+          std::make_pair(memory_type, memory_type_id);
+    }
+  }
+  return true;
+}
+
+TRITONSERVER_Error*
+LegionModelInstance::StageBatch(
+    const ExecutionBatch& batch, const size_t max_rows,
+    const std::vector<RequestTensor>& inputs,
+    const std::vector<RequestTensor>& outputs,
+    const std::vector<TRITONBACKEND_Response*>& responses,
+    StagedBatch* staged)
+{
+  staged->skip_ = true;
+  for (const auto& slice : batch.slices_) {
+    if (responses[slice.request_index_] != nullptr) {
+      staged->skip_ = false;
+    }
+  }
+  if (staged->skip_) {
+    return nullptr;
+  }
+  staged->compute_input_end_ns_.resize(1);
+  staged->compute_output_start_ns_.resize(1);
+  const bool in_place =
+      (batch.slices_.size() == 1) && (batch.rows_ == max_rows);
+  LegionTritonRuntime* runtime = model_state_->runtime_;
+
+  staged->inputs_.resize(inputs.size());
+  for (size_t input_idx = 0; input_idx < inputs.size(); input_idx++) {
+    const RequestTensor& request_tensor = inputs[input_idx];
+    InputTensor& tensor = staged->inputs_[input_idx];
+    tensor.name_ = request_tensor.name_;
+    tensor.strides_ = request_tensor.strides_;
+    const size_t row_byte_size = request_tensor.row_byte_size_;
+    if (in_place) {
+      const BatchSlice& slice = batch.slices_.front();
+      const auto& location =
+          request_tensor.buffer_locations_[slice.request_index_];
+      tensor.buffers_.emplace_back(
+          request_tensor.buffers_[slice.request_index_] +
+          slice.request_offset_ * row_byte_size);
+      tensor.buffer_locations_.emplace_back(location);
+      tensor.buffer_memories_.emplace_back(
+          runtime->FindMemory(location.first, location.second));
+      continue;
+    }
+    BackendMemory* backend_memory;
+    RETURN_IF_ERROR(BackendMemory::Create(
+        Model()->TritonMemoryManager(), BackendMemory::AllocationType::CPU, 0,
+        max_rows * row_byte_size, &backend_memory));
+    tensor.allocated_memory_.emplace_back(backend_memory);
+    char* staging = backend_memory->MemoryPtr();
+    for (const auto& slice : batch.slices_) {
+      char* dst = staging + slice.batch_offset_ * row_byte_size;
+      if (responses[slice.request_index_] == nullptr) {
+        // set the rows of failed requests to zeros
+        memset(dst, 0, slice.rows_ * row_byte_size);
+        continue;
+      }
+      memcpy(
+          dst,
+          request_tensor.buffers_[slice.request_index_] +
+              slice.request_offset_ * row_byte_size,
+          slice.rows_ * row_byte_size);
+    }
+    // set the value of the padding to zeros
+    memset(
+        staging + batch.rows_ * row_byte_size, 0,
+        (max_rows - batch.rows_) * row_byte_size);
+    tensor.buffers_.emplace_back(staging);
+    tensor.buffer_locations_.emplace_back(
+        backend_memory->MemoryType(), backend_memory->MemoryTypeId());
+    tensor.buffer_memories_.emplace_back(runtime->FindMemory(
+        backend_memory->MemoryType(), backend_memory->MemoryTypeId()));
+  }
+
+  staged->outputs_.resize(outputs.size());
+  staged->scatter_outputs_.resize(outputs.size(), false);
+  for (size_t output_idx = 0; output_idx < outputs.size(); output_idx++) {
+    const RequestTensor& request_tensor = outputs[output_idx];
+    OutputTensor& tensor = staged->outputs_[output_idx];
+    tensor.name_ = request_tensor.name_;
+    tensor.strides_ = request_tensor.strides_;
+    const size_t row_byte_size = request_tensor.row_byte_size_;
+    if (in_place) {
+      const BatchSlice& slice = batch.slices_.front();
+      if (request_tensor.buffers_[slice.request_index_] != nullptr) {
+        const auto& location =
+            request_tensor.buffer_locations_[slice.request_index_];
+        tensor.buffers_.emplace_back(
+            request_tensor.buffers_[slice.request_index_] +
+            slice.request_offset_ * row_byte_size);
+        tensor.buffer_locations_.emplace_back(location);
         tensor.buffer_memories_.emplace_back(
-            runtime->FindMemory(memory_type, memory_type_id));
-      } else {
-        BackendMemory* backend_memory;
-        RESPOND_ALL_AND_RETURN_IF_ERROR(
-            false, responses, request_count,
-            BackendMemory::Create(
-                Model()->TritonMemoryManager(),
-                BackendMemory::AllocationType::CPU, 0,
-                batch1_byte_size * request_batch_sizes[request_idx],
-                &backend_memory));
-        tensor.allocated_memory_.emplace_back(backend_memory);
-        tensor.buffers_.emplace_back(backend_memory->MemoryPtr());
-        tensor.buffer_locations_.emplace_back(
-            backend_memory->MemoryType(), backend_memory->MemoryTypeId());
-        tensor.buffer_memories_.emplace_back(runtime->FindMemory(
-            backend_memory->MemoryType(), backend_memory->MemoryTypeId()));
+            runtime->FindMemory(location.first, location.second));
+        continue;
       }
     }
-    if (padding_batch_size != 0) {
-      BackendMemory* backend_memory;
-      RESPOND_ALL_AND_RETURN_IF_ERROR(
-          false, responses, request_count,
-          BackendMemory::Create(
-              Model()->TritonMemoryManager(),
-              BackendMemory::AllocationType::CPU, 0,
-              batch1_byte_size * padding_batch_size, &backend_memory));
-      tensor.allocated_memory_.emplace_back(backend_memory);
-      tensor.buffers_.emplace_back(backend_memory->MemoryPtr());
-      tensor.buffer_locations_.emplace_back(
-          backend_memory->MemoryType(), backend_memory->MemoryTypeId());
-      tensor.buffer_memories_.emplace_back(runtime->FindMemory(
-          backend_memory->MemoryType(), backend_memory->MemoryTypeId()));
+    // The part of the output that is not requested goes to the staging
+    // buffer as well
+    BackendMemory* backend_memory;
+    RETURN_IF_ERROR(BackendMemory::Create(
+        Model()->TritonMemoryManager(), BackendMemory::AllocationType::CPU, 0,
+        max_rows * row_byte_size, &backend_memory));
+    tensor.allocated_memory_.emplace_back(backend_memory);
+    tensor.buffers_.emplace_back(backend_memory->MemoryPtr());
+    tensor.buffer_locations_.emplace_back(
+        backend_memory->MemoryType(), backend_memory->MemoryTypeId());
+    tensor.buffer_memories_.emplace_back(runtime->FindMemory(
+        backend_memory->MemoryType(), backend_memory->MemoryTypeId()));
+    staged->scatter_outputs_[output_idx] = !in_place;
+  }
+  return nullptr;
+}
+
+void
+LegionModelInstance::ScatterBatch(
+    const ExecutionBatch& batch, const StagedBatch& staged,
+    const std::vector<RequestTensor>& outputs,
+    const std::vector<TRITONBACKEND_Response*>& responses)
+{
+  for (size_t output_idx = 0; output_idx < outputs.size(); output_idx++) {
+    if (!staged.scatter_outputs_[output_idx]) {
+      continue;
+    }
+    const RequestTensor& request_tensor = outputs[output_idx];
+    const size_t row_byte_size = request_tensor.row_byte_size_;
+    const char* staging =
+        static_cast<const char*>(staged.outputs_[output_idx].buffers_[0]);
+    for (const auto& slice : batch.slices_) {
+      char* buffer = request_tensor.buffers_[slice.request_index_];
+      if ((buffer == nullptr) || (responses[slice.request_index_] == nullptr)) {
+        continue;
+      }
+      memcpy(
+          buffer + slice.request_offset_ * row_byte_size,
+          staging + slice.batch_offset_ * row_byte_size,
+          slice.rows_ * row_byte_size);
     }
   }
-  return true;
 }
 
 IndexSpace
@@ -16,6 +16,7 @@
 #ifndef __LEGION_TRITON_INSTANCE_H__
 #define __LEGION_TRITON_INSTANCE_H__
 
+#include "batching.h"
 #include "legion.h"
 #include "model.h"
 #include "runtime.h"
@@ -47,6 +48,35 @@ struct OutputTensor {
   std::vector<std::unique_ptr<BackendMemory>> allocated_memory_;
 };
 
+// A tensor of the requests of one ProcessRequests call, with the rows of
+// each request in one contiguous buffer
+struct RequestTensor {
+  std::string name_;
+  std::vector<int64_t> strides_;
+  // Bytes of a batch row, or of the whole tensor for models without batching
+  size_t row_byte_size_;
+  // Per request; nullptr for failed requests and for outputs that are not
+  // requested
+  std::vector<char*> buffers_;
+  std::vector<std::pair<TRITONSERVER_MemoryType, int64_t>> buffer_locations_;
+  // A placeholder for the memory acquired to hold the inputs that had to be
+  // gathered into one buffer, or copied to the CPU
+  std::vector<std::unique_ptr<BackendMemory>> allocated_memory_;
+};
+
+// The tensors of one execution of the model
+struct StagedBatch {
+  std::vector<InputTensor> inputs_;
+  std::vector<OutputTensor> outputs_;
+  // Outputs computed into staging buffers, to be copied to the requests
+  std::vector<bool> scatter_outputs_;
+  // No request of the batch is left to respond to
+  bool skip_;
+  uint64_t stage_start_ns_;
+  std::vector<uint64_t> compute_input_end_ns_;
+  std::vector<uint64_t> compute_output_start_ns_;
+};
+
 //
 // LegionModelInstance
 //
@@ -105,21 +135,40 @@ class LegionModelInstance : public BackendModelInstance {
     LegionModelInstance* const instance_state;
   };
 
-  // Set the input tensors for running the model, in case of error, responses
-  // will be returned with error and the function will return false.
-  // Returns true on success.
-  bool SetInputTensors(
-      const size_t total_batch_size, TRITONBACKEND_Request** requests,
-      const uint32_t request_count,
+  // Collect the input tensors of each request. Requests that need host
+  // buffers get their inputs copied to the CPU if they are not there. In
+  // case of error with a request, its response will be returned with error;
+  // in case of error with every request, responses will be returned with
+  // error and the function will return false. Returns true on success.
+  bool CollectRequestInputs(
+      const std::vector<size_t>& request_batch_sizes,
+      const std::vector<bool>& need_host_buffers,
+      TRITONBACKEND_Request** requests, const uint32_t request_count,
       std::vector<TRITONBACKEND_Response*>* responses,
-      std::vector<InputTensor>& inputs);
+      std::vector<RequestTensor>& inputs);
 
-  bool SetOutputTensors(
-      const size_t total_batch_size,
+  bool CollectRequestOutputs(
       const std::vector<size_t>& request_batch_sizes,
+      const std::vector<bool>& need_host_buffers,
       TRITONBACKEND_Request** requests, const uint32_t request_count,
       std::vector<TRITONBACKEND_Response*>* responses,
-      std::vector<OutputTensor>& outputs);
+      std::vector<RequestTensor>& outputs);
+
+  // Set the tensors of one execution of the model, gathering the rows of the
+  // requests of the batch into staging buffers unless the batch is made of
+  // 'max_rows' rows of one request
+  TRITONSERVER_Error* StageBatch(
+      const ExecutionBatch& batch, const size_t max_rows,
+      const std::vector<RequestTensor>& inputs,
+      const std::vector<RequestTensor>& outputs,
+      const std::vector<TRITONBACKEND_Response*>& responses,
+      StagedBatch* staged);
+
+  // Copy the rows of the staged outputs to the requests
+  void ScatterBatch(
+      const ExecutionBatch& batch, const StagedBatch& staged,
+      const std::vector<RequestTensor>& outputs,
+      const std::vector<TRITONBACKEND_Response*>& responses);
 
   LegionModelInstance(
       TRITONBACKEND_ModelInstance* triton_model_instance,
@@ -0,0 +1,97 @@
+/* Copyright 2022 NVIDIA CORPORATION
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gtest/gtest.h"
+
+#include "batching.h"
+
+namespace {
+
+namespace tbl = triton::backend::legion;
+
+#define CHECK_SLICE(                                                     \
+    slice__, request_index__, request_offset__, batch_offset__, rows__)  \
+  do {                                                                   \
+    EXPECT_EQ(slice__.request_index_, request_index__);                  \
+    EXPECT_EQ(slice__.request_offset_, request_offset__);                \
+    EXPECT_EQ(slice__.batch_offset_, batch_offset__);                    \
+    EXPECT_EQ(slice__.rows_, rows__);                                    \
+  } while (false)
+
+TEST(BatchingTest, MergeSmallRequests)
+{
+  std::vector<size_t> request_rows{1, 2, 1, 3};
+  auto batches = tbl::PlanExecutionBatches(request_rows, 8);
+  ASSERT_EQ(batches.size(), 1u);
+  EXPECT_EQ(batches[0].rows_, 7u);
+  ASSERT_EQ(batches[0].slices_.size(), 4u);
+  CHECK_SLICE(batches[0].slices_[0], 0u, 0u, 0u, 1u);
+  CHECK_SLICE(batches[0].slices_[1], 1u, 0u, 1u, 2u);
+  CHECK_SLICE(batches[0].slices_[2], 2u, 0u, 3u, 1u);
+  CHECK_SLICE(batches[0].slices_[3], 3u, 0u, 4u, 3u);
+  EXPECT_EQ(
+      tbl::LastBatchOfRequests(batches, request_rows.size()),
+      std::vector<int>({0, 0, 0, 0}));
+}
+
+TEST(BatchingTest, FillBatchesAcrossRequests)
+{
+  // The second request continues in the next batch
+  std::vector<size_t> request_rows{3, 3, 2};
+  auto batches = tbl::PlanExecutionBatches(request_rows, 4);
+  ASSERT_EQ(batches.size(), 2u);
+  EXPECT_EQ(batches[0].rows_, 4u);
+  ASSERT_EQ(batches[0].slices_.size(), 2u);
+  CHECK_SLICE(batches[0].slices_[0], 0u, 0u, 0u, 3u);
+  CHECK_SLICE(batches[0].slices_[1], 1u, 0u, 3u, 1u);
+  EXPECT_EQ(batches[1].rows_, 4u);
+  ASSERT_EQ(batches[1].slices_.size(), 2u);
+  CHECK_SLICE(batches[1].slices_[0], 1u, 1u, 0u, 2u);
+  CHECK_SLICE(batches[1].slices_[1], 2u, 0u, 2u, 2u);
+  EXPECT_EQ(
+      tbl::LastBatchOfRequests(batches, request_rows.size()),
+      std::vector<int>({0, 1, 1}));
+}
+
+TEST(BatchingTest, SplitOversizedRequest)
+{
+  // Requests without rows get no slice
+  std::vector<size_t> request_rows{10, 0, 1};
+  auto batches = tbl::PlanExecutionBatches(request_rows, 4);
+  ASSERT_EQ(batches.size(), 3u);
+  CHECK_SLICE(batches[0].slices_[0], 0u, 0u, 0u, 4u);
+  CHECK_SLICE(batches[1].slices_[0], 0u, 4u, 0u, 4u);
+  ASSERT_EQ(batches[2].slices_.size(), 2u);
+  CHECK_SLICE(batches[2].slices_[0], 0u, 8u, 0u, 2u);
+  CHECK_SLICE(batches[2].slices_[1], 2u, 0u, 2u, 1u);
+  EXPECT_EQ(batches[2].rows_, 3u);
+  EXPECT_EQ(
+      tbl::LastBatchOfRequests(batches, request_rows.size()),
+      std::vector<int>({2, -1, 2}));
+}
+
+TEST(BatchingTest, OneRowPerExecution)
+{
+  // Models without batching execute one request at a time
+  std::vector<size_t> request_rows{1, 1, 1};
+  auto batches = tbl::PlanExecutionBatches(request_rows, 1);
+  ASSERT_EQ(batches.size(), 3u);
+  for (size_t idx = 0; idx < batches.size(); idx++) {
+    ASSERT_EQ(batches[idx].slices_.size(), 1u);
+    CHECK_SLICE(batches[idx].slices_[0], idx, 0u, 0u, 1u);
+  }
+}
+
+}  // namespace